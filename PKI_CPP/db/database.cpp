@@ -1,4 +1,59 @@
 #include "database.h"
+#include "migrations.h"
+
+static std::string columnText(sqlite3_stmt* stmt, int column)
+{
+    const unsigned char* text = sqlite3_column_text(stmt, column);
+    return text ? reinterpret_cast<const char*>(text) : "";
+}
+
+// Декодирует UTF-8 в кодовые точки; false, если последовательность некорректна
+static bool decodeUtf8(const std::string& value, std::vector<unsigned>& codePoints)
+{
+    for (size_t i = 0; i < value.size();) {
+        unsigned char lead = value[i];
+        size_t length = lead < 0x80 ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xE ? 3 : (lead >> 3) == 0x1E ? 4 : 0;
+        if (length == 0 || i + length > value.size()) {
+            return false;
+        }
+        unsigned codePoint = length == 1 ? lead : lead & (0x7F >> length);
+        for (size_t k = 1; k < length; ++k) {
+            unsigned char next = value[i + k];
+            if ((next & 0xC0) != 0x80) {
+                return false;
+            }
+            codePoint = (codePoint << 6) | (next & 0x3F);
+        }
+        codePoints.push_back(codePoint);
+        i += length;
+    }
+    return true;
+}
+
+// Старые записи содержат UTF-8, повторно закодированный как Latin-1 (строка передавалась как MBSTRING_ASC).
+// Если после обратного преобразования получается корректный UTF-8, используется он. Только для parseSubject:
+// у правильно закодированного значения эвристика могла бы исказить текст.
+static std::string repairDoubleEncoding(const std::string& value)
+{
+    std::vector<unsigned> codePoints;
+    if (!decodeUtf8(value, codePoints)) {
+        return value;
+    }
+
+    std::string bytes;
+    bool hasHighBytes = false;
+    for (unsigned codePoint : codePoints) {
+        if (codePoint > 0xFF) {
+            return value;
+        }
+        hasHighBytes = hasHighBytes || codePoint >= 0x80;
+        bytes += static_cast<char>(codePoint);
+    }
+
+    std::vector<unsigned> repaired;
+    return hasHighBytes && decodeUtf8(bytes, repaired) ? bytes : value;
+}
+
 
 Database::Database(const std::string& dbFileName, const std::string& password)
     : db(nullptr), dbFileName(dbFileName), password(password)
@@ -22,6 +77,10 @@ void Database::open() {
     int resultCode = sqlite3_open(dbFileName.c_str(), &db);
     checkError(resultCode, "Не удалось открыть базу данных");
 
+    // При занятой базе запрос ждет блокировку до 5 секунд, а не завершается сразу с SQLITE_BUSY.
+    // Режим журнала здесь не меняется: WAL включают установка УЦ и выпускающие процессы (enableWal)
+    sqlite3_busy_timeout(db, 5000);
+
 // #ifdef SQLITE_HAS_CODEC
 //     resultCode = sqlite3_key(db, password.c_str(), password.size());
 //     checkError(resultCode, "Не удалось установить ключ шифрования");
@@ -30,6 +89,22 @@ void Database::open() {
     std::cout << "База данных успешно открыта.\n";
 }
 
+// WAL: читатели (утилиты, резервное копирование) не блокируют запись. Режим сохраняется в файле базы,
+// рядом с ней появляются файлы -wal и -shm; повторный вызов для базы в WAL ничего не меняет
+void Database::enableWal() {
+    sqlite3_stmt* stmt = nullptr;
+    checkError(sqlite3_prepare_v2(db, "PRAGMA journal_mode = WAL;", -1, &stmt, nullptr), "Не удалось включить режим WAL");
+    int resultCode = sqlite3_step(stmt);
+    std::string journalMode = resultCode == SQLITE_ROW && sqlite3_column_text(stmt, 0)
+        ? reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)) : "";
+    sqlite3_finalize(stmt);
+    checkError(resultCode == SQLITE_ROW ? SQLITE_OK : resultCode, "Не удалось включить режим WAL");
+    // База в памяти WAL не поддерживает; в остальных случаях читатели будут блокировать запись
+    if (journalMode != "wal" && journalMode != "memory") {
+        std::cerr << "База данных осталась в режиме журнала " << journalMode << ", а не WAL: " << dbFileName << "\n";
+    }
+}
+
 void Database::close() {
     if (db) {
         sqlite3_close(db);
@@ -69,18 +144,53 @@ void Database::executeQuery(const std::string& query) {
 }
 
 
+int Database::readUserVersion()
+{
+    sqlite3_stmt* stmt;
+    checkError(sqlite3_prepare_v2(db, "PRAGMA user_version;", -1, &stmt, nullptr), "Не удалось прочитать версию схемы");
+
+    int version = 0;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        version = sqlite3_column_int(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+
+    return version;
+}
+
+
 void Database::initializeSchema()
 {
-    std::ifstream file(DB_SCHEMA);
-    if (!file.is_open()) {
-        std::cerr << "Не удалось открыть файл: " << DB_SCHEMA << std::endl;
+    const int latestVersion = DB_MIGRATIONS[std::size(DB_MIGRATIONS) - 1].version;
+
+    // База уже актуальна: никаких DDL и обращений к файлам схемы
+    if (readUserVersion() >= latestVersion) {
         return;
     }
 
-    std::stringstream buffer;
-    buffer << file.rdbuf();
-    
-    executeQuery(buffer.str());
+    // IMMEDIATE сразу берет блокировку записи, чтобы параллельно стартующие процессы не применили миграции дважды
+    executeQuery("BEGIN IMMEDIATE;");
+    try {
+        int currentVersion = readUserVersion();
+
+        for (const auto& migration : DB_MIGRATIONS) {
+            if (migration.version <= currentVersion) {
+                continue;
+            }
+
+            executeQuery(migration.sql);
+            if (migration.afterApply) {
+                migration.afterApply(db);
+            }
+            executeQuery("PRAGMA user_version = " + std::to_string(migration.version) + ";");
+            std::cout << "Применена миграция схемы " << migration.version << ": " << migration.description << "\n";
+        }
+
+        executeQuery("COMMIT;");
+    } catch (const std::exception& ex) {
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        throw std::runtime_error(std::string("Не удалось применить миграции схемы: ") + ex.what());
+    }
 }
 
 
@@ -100,7 +210,7 @@ void Database::addRootCert(const std::string &certName, const std::string& seria
     sqlite3_bind_text(stmt, 1, certName.c_str(), -1, SQLITE_STATIC);
     sqlite3_bind_text(stmt, 2, serial.c_str(), -1, SQLITE_STATIC);
     sqlite3_bind_text(stmt, 3, info.c_str(), -1, SQLITE_STATIC);
-    sqlite3_bind_text(stmt, 4, std::to_string(validity).c_str(), -1, SQLITE_STATIC);  
+    sqlite3_bind_int(stmt, 4, validity);  
 
 
     if (sqlite3_step(stmt) != SQLITE_DONE) {
@@ -113,21 +223,25 @@ void Database::addRootCert(const std::string &certName, const std::string& seria
 }
 
 
-void Database::addIsuuerCSR(const std::string &csrName, const std::string& info)
+void Database::addIsuuerCSR(const std::string &csrName, const std::string& info, const SubjectFields& subject)
 {
     if (csrName.empty() || info.empty()) {
         throw std::runtime_error("addIsuuerCSR: ошибка: все поля должны быть заполнены.");
     }
 
-    const std::string sql = "INSERT INTO issuing_csr (csrName, info) VALUES (?, ?);";
+    const std::string sql = "INSERT INTO issuing_csr (csrName, info, subjectC, subjectO, subjectCN, subjectSAN) VALUES (?, ?, ?, ?, ?, ?);";
     sqlite3_stmt* stmt;
 
     if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
         throw std::runtime_error("Failed to prepare statement: " + std::string(sqlite3_errmsg(db)));
     }
 
-    sqlite3_bind_text(stmt, 1, (csrName + ".csr.pem").c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 1, (csrName + ".csr.pem").c_str(), -1, SQLITE_TRANSIENT);
     sqlite3_bind_text(stmt, 2, info.c_str(), -1, SQLITE_STATIC);  
+    sqlite3_bind_text(stmt, 3, subject.country.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 4, subject.organization.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 5, subject.commonName.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 6, subject.san.c_str(), -1, SQLITE_STATIC);
 
     if (sqlite3_step(stmt) != SQLITE_DONE) {
         sqlite3_finalize(stmt);
@@ -139,13 +253,14 @@ void Database::addIsuuerCSR(const std::string &csrName, const std::string& info)
 }
 
 
-void Database::addIssuerCert(const std::string &certName, const std::string &serial, const std::string &certDataFrom, const std::string &certDataTo, const std::string &info)
+void Database::addIssuerCert(const std::string &certName, const std::string &serial, const std::string &certDataFrom, const std::string &certDataTo, const std::string &info, const SubjectFields& subject, const std::string &keyHash)
 {
     if (certName.empty() || serial.empty() || certDataFrom.empty() || certDataTo.empty() || info.empty()) {
         throw std::runtime_error("addIssuerCert: ошибка: все поля должны быть заполнены.");
     }
 
-    const std::string sql = "INSERT INTO issuing_certs (certName, serial, certDataFrom, certDataTo, info) VALUES (?, ?, ?, ?, ?)";
+    const std::string sql = "INSERT INTO issuing_certs (certName, serial, certDataFrom, certDataTo, info, subjectC, subjectO, subjectCN, subjectSAN, keyHash, issuedAt) "
+                            "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, datetime('now'))";
     sqlite3_stmt* stmt;
 
     if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
@@ -157,6 +272,15 @@ void Database::addIssuerCert(const std::string &certName, const std::string &ser
     sqlite3_bind_text(stmt, 3, certDataFrom.c_str(), -1, SQLITE_STATIC);
     sqlite3_bind_text(stmt, 4, certDataTo.c_str(), -1, SQLITE_STATIC);  
     sqlite3_bind_text(stmt, 5, info.c_str(), -1, SQLITE_STATIC);  
+    sqlite3_bind_text(stmt, 6, subject.country.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 7, subject.organization.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 8, subject.commonName.c_str(), -1, SQLITE_STATIC);
+    sqlite3_bind_text(stmt, 9, subject.san.c_str(), -1, SQLITE_STATIC);
+    if (keyHash.empty()) {
+        sqlite3_bind_null(stmt, 10);
+    } else {
+        sqlite3_bind_text(stmt, 10, keyHash.c_str(), -1, SQLITE_STATIC);
+    }
 
     if (sqlite3_step(stmt) != SQLITE_DONE) {
         sqlite3_finalize(stmt);
@@ -192,6 +316,610 @@ void Database::actionWithIssuerCert(const std::string &serial, std::string actio
     std::cout << "Статуст сертификата с серийным номером " + serial + " был изменен на " + action + ".\n";
 }
 
+std::vector<std::string> Database::selectSerialsForRevocation(const RevocationQuery& query)
+{
+    if (query.serials.empty() && query.organization.empty() && query.issuedFrom.empty() && query.issuedTo.empty() && query.keyHash.empty()) {
+        throw std::runtime_error("selectSerialsForRevocation: не задано ни одного условия отбора.");
+    }
+
+    std::string sql = "SELECT DISTINCT serial FROM issuing_certs WHERE status = 'active'";
+    std::vector<std::string> params;
+
+    if (!query.organization.empty()) {
+        sql += " AND subjectO = ?";
+        params.push_back(query.organization);
+    }
+    if (!query.issuedFrom.empty()) {
+        sql += " AND issuedAt >= ?";
+        params.push_back(query.issuedFrom);
+    }
+    if (!query.issuedTo.empty()) {
+        sql += " AND issuedAt < ?";
+        params.push_back(query.issuedTo);
+    }
+    if (!query.keyHash.empty()) {
+        sql += " AND keyHash = ?";
+        params.push_back(query.keyHash);
+    }
+    if (!query.serials.empty()) {
+        sql += " AND serial = ?";
+    }
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        throw std::runtime_error("selectSerialsForRevocation: " + std::string(sqlite3_errmsg(db)));
+    }
+
+    for (size_t i = 0; i < params.size(); ++i) {
+        sqlite3_bind_text(stmt, static_cast<int>(i + 1), params[i].c_str(), -1, SQLITE_STATIC);
+    }
+
+    // Список серийных номеров проверяется по одному тем же подготовленным запросом
+    std::vector<std::string> serials;
+    std::set<std::string> seen;
+    const size_t passes = query.serials.empty() ? 1 : query.serials.size();
+
+    for (size_t pass = 0; pass < passes; ++pass) {
+        if (!query.serials.empty()) {
+            sqlite3_reset(stmt);
+            sqlite3_bind_text(stmt, static_cast<int>(params.size() + 1), query.serials[pass].c_str(), -1, SQLITE_STATIC);
+        }
+
+        int resultCode;
+        while ((resultCode = sqlite3_step(stmt)) == SQLITE_ROW) {
+            std::string serial = columnText(stmt, 0);
+            if (seen.insert(serial).second) {
+                serials.push_back(serial);
+            }
+        }
+
+        if (resultCode != SQLITE_DONE) {
+            std::string error = sqlite3_errmsg(db);
+            sqlite3_finalize(stmt);
+            throw std::runtime_error("selectSerialsForRevocation: " + error);
+        }
+    }
+
+    sqlite3_finalize(stmt);
+    return serials;
+}
+
+
+int Database::revokeIssuerCerts(const std::vector<std::string>& serials, int reasonCode, time_t revokedAt,
+                                const std::function<void()>& beforeCommit)
+{
+    // Приостановленный сертификат (причина 6) можно отозвать окончательно: меняется только причина
+    const std::string sql = "UPDATE issuing_certs SET revokedAt = CASE WHEN status = 'active' THEN datetime(?1, 'unixepoch') ELSE revokedAt END, "
+                            "status = 'revoked', revocationReason = ?2 "
+                            "WHERE serial = ?3 AND (status = 'active' OR (?2 <> 6 AND status = 'revoked' AND revocationReason = 6));";
+    int changed = 0;
+
+    // Все записи обновляются в одной транзакции: либо отозваны все, либо ни одна
+    executeQuery("BEGIN IMMEDIATE;");
+    sqlite3_stmt* stmt = nullptr;
+    try {
+        checkError(sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr), "revokeIssuerCerts: не удалось подготовить запрос");
+
+        sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(revokedAt));
+        sqlite3_bind_int(stmt, 2, reasonCode);
+
+        for (const auto& serial : serials) {
+            sqlite3_bind_text(stmt, 3, serial.c_str(), -1, SQLITE_STATIC);
+            if (sqlite3_step(stmt) != SQLITE_DONE) {
+                throw std::runtime_error("revokeIssuerCerts: " + std::string(sqlite3_errmsg(db)));
+            }
+            changed += sqlite3_changes(db);
+            sqlite3_reset(stmt);
+        }
+
+        sqlite3_finalize(stmt);
+        stmt = nullptr;
+        if (beforeCommit) {
+            beforeCommit();
+        }
+        executeQuery("COMMIT;");
+    } catch (const std::exception&) {
+        sqlite3_finalize(stmt);
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        throw;
+    }
+
+    return changed;
+}
+
+
+// Оставляет из serials те номера, для которых запрос sql с единственным параметром находит (found = true)
+// или не находит строку; порядок и повторы сохраняются
+static std::vector<std::string> filterSerials(sqlite3* db, const char* sql, const std::vector<std::string>& serials, bool found)
+{
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        throw std::runtime_error("filterSerials: " + std::string(sqlite3_errmsg(db)));
+    }
+
+    std::vector<std::string> result;
+    for (const auto& serial : serials) {
+        sqlite3_bind_text(stmt, 1, serial.c_str(), -1, SQLITE_STATIC);
+        int resultCode = sqlite3_step(stmt);
+        if (resultCode != SQLITE_ROW && resultCode != SQLITE_DONE) {
+            std::string error = sqlite3_errmsg(db);
+            sqlite3_finalize(stmt);
+            throw std::runtime_error("filterSerials: " + error);
+        }
+        if ((resultCode == SQLITE_ROW) == found) {
+            result.push_back(serial);
+        }
+        sqlite3_reset(stmt);
+    }
+
+    sqlite3_finalize(stmt);
+    return result;
+}
+
+
+std::vector<std::string> Database::selectUnknownSerials(const std::vector<std::string>& serials)
+{
+    return filterSerials(db, "SELECT 1 FROM issuing_certs WHERE serial = ? LIMIT 1;", serials, false);
+}
+
+
+std::vector<std::string> Database::selectSuspendedSerials(const std::vector<std::string>& serials)
+{
+    // 6 - CertificateHold по RFC 5280
+    return filterSerials(db, "SELECT 1 FROM issuing_certs WHERE serial = ? AND status = 'revoked' AND revocationReason = 6 LIMIT 1;",
+                         serials, true);
+}
+
+
+int Database::releaseIssuerCerts(const std::vector<std::string>& serials, const std::function<void()>& beforeCommit)
+{
+    const std::string sql = "UPDATE issuing_certs SET status = 'active', revokedAt = NULL, revocationReason = NULL "
+                            "WHERE serial = ? AND status = 'revoked' AND revocationReason = 6;";
+    int changed = 0;
+
+    executeQuery("BEGIN IMMEDIATE;");
+    sqlite3_stmt* stmt = nullptr;
+    try {
+        checkError(sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr), "releaseIssuerCerts: не удалось подготовить запрос");
+
+        for (const auto& serial : serials) {
+            sqlite3_bind_text(stmt, 1, serial.c_str(), -1, SQLITE_STATIC);
+            if (sqlite3_step(stmt) != SQLITE_DONE) {
+                throw std::runtime_error("releaseIssuerCerts: " + std::string(sqlite3_errmsg(db)));
+            }
+            changed += sqlite3_changes(db);
+            sqlite3_reset(stmt);
+        }
+
+        sqlite3_finalize(stmt);
+        stmt = nullptr;
+        if (beforeCommit) {
+            beforeCommit();
+        }
+        executeQuery("COMMIT;");
+    } catch (const std::exception&) {
+        sqlite3_finalize(stmt);
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        throw;
+    }
+
+    return changed;
+}
+
+
+std::vector<RevokedCertRecord> Database::selectRevokedCerts(time_t revokedSince)
+{
+    // Истекшие сертификаты тоже имеют статус 'revoked', но без причины отзыва; в выборку они не попадают.
+    // Записи, отозванные до появления revocationReason, учитываются, пока срок их действия не истек.
+    // Архивные сертификаты, отозванные с причиной, остаются в выборке (частичный индекс idx_archived_certs_revoked_at)
+    std::string sql = "SELECT serial, COALESCE(revocationReason, 0), COALESCE(CAST(strftime('%s', revokedAt) AS INTEGER), 0) "
+                      "FROM issuing_certs WHERE status = 'revoked' AND (revocationReason IS NOT NULL OR certDataTo >= datetime('now'))";
+    std::string archivedSql = " UNION ALL SELECT serial, revocationReason, COALESCE(CAST(strftime('%s', revokedAt) AS INTEGER), 0) "
+                              "FROM archived_certs WHERE revocationReason IS NOT NULL";
+    if (revokedSince > 0) {
+        sql += " AND revokedAt >= datetime(?1, 'unixepoch')";
+        archivedSql += " AND revokedAt >= datetime(?1, 'unixepoch')";
+    }
+    sql += archivedSql;
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        throw std::runtime_error("selectRevokedCerts: " + std::string(sqlite3_errmsg(db)));
+    }
+    if (revokedSince > 0) {
+        sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(revokedSince));
+    }
+
+    std::vector<RevokedCertRecord> records;
+    int resultCode;
+    while ((resultCode = sqlite3_step(stmt)) == SQLITE_ROW) {
+        records.push_back({columnText(stmt, 0), sqlite3_column_int(stmt, 1), static_cast<time_t>(sqlite3_column_int64(stmt, 2))});
+    }
+
+    sqlite3_finalize(stmt);
+    if (resultCode != SQLITE_DONE) {
+        throw std::runtime_error("selectRevokedCerts: " + std::string(sqlite3_errmsg(db)));
+    }
+
+    return records;
+}
+
+
+std::vector<std::string> Database::selectIssuedSerials()
+{
+    const char* sql = "SELECT serial FROM issuing_certs UNION SELECT serial FROM archived_certs";
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        throw std::runtime_error("selectIssuedSerials: " + std::string(sqlite3_errmsg(db)));
+    }
+
+    std::vector<std::string> serials;
+    int resultCode;
+    while ((resultCode = sqlite3_step(stmt)) == SQLITE_ROW) {
+        serials.push_back(columnText(stmt, 0));
+    }
+
+    sqlite3_finalize(stmt);
+    if (resultCode != SQLITE_DONE) {
+        throw std::runtime_error("selectIssuedSerials: " + std::string(sqlite3_errmsg(db)));
+    }
+
+    return serials;
+}
+
+
+std::vector<CertStatusRecord> Database::selectCertStatuses()
+{
+    // Действующие и отозванные сертификаты; истекшие (статус 'revoked' без причины) не выбираются.
+    // Отозванные с причиной берутся и из архива: перенос в сегмент не должен менять ответ OCSP на "unauthorized".
+    // Строка переносится в архив с прежним id, поэтому при повторяющихся серийных номерах последней идет самая поздняя запись.
+    const char* sql = "SELECT serial, status = 'revoked', COALESCE(revocationReason, 0), "
+                      "COALESCE(CAST(strftime('%s', revokedAt) AS INTEGER), 0), id FROM issuing_certs "
+                      "WHERE status = 'active' OR revocationReason IS NOT NULL OR certDataTo >= datetime('now') "
+                      "UNION ALL SELECT serial, 1, revocationReason, "
+                      "COALESCE(CAST(strftime('%s', revokedAt) AS INTEGER), 0), id FROM archived_certs "
+                      "WHERE revocationReason IS NOT NULL ORDER BY 5";
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        throw std::runtime_error("selectCertStatuses: " + std::string(sqlite3_errmsg(db)));
+    }
+
+    std::vector<CertStatusRecord> records;
+    int resultCode;
+    while ((resultCode = sqlite3_step(stmt)) == SQLITE_ROW) {
+        records.push_back({columnText(stmt, 0), sqlite3_column_int(stmt, 1) != 0, sqlite3_column_int(stmt, 2),
+                           static_cast<time_t>(sqlite3_column_int64(stmt, 3)), ""});
+    }
+
+    sqlite3_finalize(stmt);
+    if (resultCode != SQLITE_DONE) {
+        throw std::runtime_error("selectCertStatuses: " + std::string(sqlite3_errmsg(db)));
+    }
+
+    return records;
+}
+
+
+bool Database::selectCertStatus(const std::string& serial, CertStatusRecord& record)
+{
+    // При повторяющихся серийных номерах берется самая поздняя запись; если среди живых строк
+    // сертификата нет, статус берется из архива
+    for (const char* table : {"issuing_certs", "archived_certs"}) {
+        std::string sql = std::string("SELECT serial, revocationReason IS NOT NULL, COALESCE(revocationReason, 0), "
+                                      "COALESCE(CAST(strftime('%s', revokedAt) AS INTEGER), 0), status FROM ") + table +
+                          " WHERE serial = ? ORDER BY id DESC LIMIT 1";
+
+        sqlite3_stmt* stmt;
+        if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+            throw std::runtime_error("selectCertStatus: " + std::string(sqlite3_errmsg(db)));
+        }
+        sqlite3_bind_text(stmt, 1, serial.c_str(), -1, SQLITE_STATIC);
+
+        int resultCode = sqlite3_step(stmt);
+        if (resultCode == SQLITE_ROW) {
+            record = {columnText(stmt, 0), sqlite3_column_int(stmt, 1) != 0, sqlite3_column_int(stmt, 2),
+                      static_cast<time_t>(sqlite3_column_int64(stmt, 3)), columnText(stmt, 4)};
+        }
+
+        sqlite3_finalize(stmt);
+        if (resultCode != SQLITE_ROW && resultCode != SQLITE_DONE) {
+            throw std::runtime_error("selectCertStatus: " + std::string(sqlite3_errmsg(db)));
+        }
+        if (resultCode == SQLITE_ROW) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+std::vector<IssuerCertRecord> Database::selectExpiringCerts(int withinDays, int limit)
+{
+    // Условие повторяет частичный индекс idx_issuing_certs_expiring, поэтому выборка идет по нему
+    const char* sql = "SELECT id, certName, serial, certDataFrom, certDataTo, info, status, subjectC, subjectO, subjectCN, subjectSAN "
+                      "FROM issuing_certs WHERE status = 'active' AND renewedBy IS NULL AND certDataTo < datetime('now', ?) "
+                      "ORDER BY certDataTo LIMIT ?";
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        throw std::runtime_error("selectExpiringCerts: " + std::string(sqlite3_errmsg(db)));
+    }
+    const std::string modifier = "+" + std::to_string(withinDays) + " days";
+    sqlite3_bind_text(stmt, 1, modifier.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int(stmt, 2, limit > 0 ? limit : -1);
+
+    std::vector<IssuerCertRecord> records;
+    int resultCode;
+    while ((resultCode = sqlite3_step(stmt)) == SQLITE_ROW) {
+        IssuerCertRecord record;
+        record.id = sqlite3_column_int(stmt, 0);
+        record.certName = columnText(stmt, 1);
+        record.serial = columnText(stmt, 2);
+        record.certDataFrom = columnText(stmt, 3);
+        record.certDataTo = columnText(stmt, 4);
+        record.info = columnText(stmt, 5);
+        record.status = columnText(stmt, 6);
+        record.subject = {columnText(stmt, 7), columnText(stmt, 8), columnText(stmt, 9), columnText(stmt, 10)};
+        records.push_back(std::move(record));
+    }
+
+    sqlite3_finalize(stmt);
+    if (resultCode != SQLITE_DONE) {
+        throw std::runtime_error("selectExpiringCerts: " + std::string(sqlite3_errmsg(db)));
+    }
+
+    return records;
+}
+
+
+std::vector<bool> Database::addRenewedCerts(const std::vector<RenewedCertRecord>& records)
+{
+    const char* linkSql = "UPDATE issuing_certs SET renewedBy = ? WHERE id = ? AND status = 'active' AND renewedBy IS NULL;";
+    const char* insertSql = "INSERT INTO issuing_certs (certName, serial, certDataFrom, certDataTo, info, subjectC, subjectO, subjectCN, "
+                            "subjectSAN, keyHash, issuedAt, renewedFrom) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, datetime('now'), ?);";
+    std::vector<bool> added(records.size(), false);
+
+    // Связь и новая запись появляются вместе: либо сохранены все продления, либо ни одно
+    executeQuery("BEGIN IMMEDIATE;");
+    sqlite3_stmt* link = nullptr;
+    sqlite3_stmt* insert = nullptr;
+    try {
+        checkError(sqlite3_prepare_v2(db, linkSql, -1, &link, nullptr), "addRenewedCerts: не удалось подготовить запрос");
+        checkError(sqlite3_prepare_v2(db, insertSql, -1, &insert, nullptr), "addRenewedCerts: не удалось подготовить запрос");
+
+        for (size_t i = 0; i < records.size(); ++i) {
+            const RenewedCertRecord& record = records[i];
+
+            sqlite3_bind_text(link, 1, record.serial.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_int(link, 2, record.oldId);
+            if (sqlite3_step(link) != SQLITE_DONE) {
+                throw std::runtime_error("addRenewedCerts: " + std::string(sqlite3_errmsg(db)));
+            }
+            sqlite3_reset(link);
+            if (sqlite3_changes(db) == 0) {
+                continue;
+            }
+
+            const SubjectFields& subject = record.subject;
+            sqlite3_bind_text(insert, 1, record.certName.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_text(insert, 2, record.serial.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_text(insert, 3, record.certDataFrom.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_text(insert, 4, record.certDataTo.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_text(insert, 5, record.info.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_text(insert, 6, subject.country.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(insert, 7, subject.organization.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(insert, 8, subject.commonName.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(insert, 9, subject.san.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(insert, 10, record.keyHash.c_str(), -1, SQLITE_STATIC);
+            sqlite3_bind_text(insert, 11, record.oldSerial.c_str(), -1, SQLITE_STATIC);
+            if (sqlite3_step(insert) != SQLITE_DONE) {
+                throw std::runtime_error("addRenewedCerts: " + std::string(sqlite3_errmsg(db)));
+            }
+            sqlite3_reset(insert);
+            added[i] = true;
+        }
+
+        sqlite3_finalize(link);
+        sqlite3_finalize(insert);
+        link = insert = nullptr;
+        executeQuery("COMMIT;");
+    } catch (const std::exception&) {
+        sqlite3_finalize(link);
+        sqlite3_finalize(insert);
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        throw;
+    }
+
+    return added;
+}
+
+
+std::vector<ArchivedCertRecord> Database::selectArchivableCerts(int retentionDays, int limit)
+{
+    const char* sql = "SELECT id, certName, serial, certDataFrom, certDataTo, info, status, COALESCE(revocationReason, -1), "
+                      "COALESCE(revokedAt, '') FROM issuing_certs WHERE certDataTo < datetime('now', ?) ORDER BY certDataTo LIMIT ?";
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        throw std::runtime_error("selectArchivableCerts: " + std::string(sqlite3_errmsg(db)));
+    }
+    const std::string modifier = "-" + std::to_string(retentionDays) + " days";
+    sqlite3_bind_text(stmt, 1, modifier.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int(stmt, 2, limit > 0 ? limit : -1);
+
+    std::vector<ArchivedCertRecord> records;
+    int resultCode;
+    while ((resultCode = sqlite3_step(stmt)) == SQLITE_ROW) {
+        ArchivedCertRecord record;
+        record.id = sqlite3_column_int(stmt, 0);
+        record.certName = columnText(stmt, 1);
+        record.serial = columnText(stmt, 2);
+        record.certDataFrom = columnText(stmt, 3);
+        record.certDataTo = columnText(stmt, 4);
+        record.info = columnText(stmt, 5);
+        record.status = columnText(stmt, 6);
+        record.revocationReason = sqlite3_column_int(stmt, 7);
+        record.revokedAt = columnText(stmt, 8);
+        records.push_back(std::move(record));
+    }
+
+    sqlite3_finalize(stmt);
+    if (resultCode != SQLITE_DONE) {
+        throw std::runtime_error("selectArchivableCerts: " + std::string(sqlite3_errmsg(db)));
+    }
+
+    return records;
+}
+
+
+std::vector<bool> Database::archiveCerts(const std::vector<ArchivedCertRecord>& records)
+{
+    // Статус и данные отзыва копируются из самой строки: отзыв, случившийся после выборки, не теряется
+    const char* insertSql = "INSERT INTO archived_certs (id, certName, serial, certDataFrom, certDataTo, info, status, revocationReason, "
+                            "revokedAt, segment, segmentOffset, segmentLength) SELECT id, certName, serial, certDataFrom, certDataTo, "
+                            "info, status, revocationReason, revokedAt, ?, ?, ? FROM issuing_certs WHERE id = ? AND certDataTo = ?;";
+    const char* deleteSql = "DELETE FROM issuing_certs WHERE id = ?;";
+    std::vector<bool> archived(records.size(), false);
+
+    executeQuery("BEGIN IMMEDIATE;");
+    sqlite3_stmt* insert = nullptr;
+    sqlite3_stmt* remove = nullptr;
+    try {
+        checkError(sqlite3_prepare_v2(db, insertSql, -1, &insert, nullptr), "archiveCerts: не удалось подготовить запрос");
+        checkError(sqlite3_prepare_v2(db, deleteSql, -1, &remove, nullptr), "archiveCerts: не удалось подготовить запрос");
+
+        for (size_t i = 0; i < records.size(); ++i) {
+            const ArchivedCertRecord& record = records[i];
+
+            if (record.segment.empty()) {
+                sqlite3_bind_null(insert, 1);
+            } else {
+                sqlite3_bind_text(insert, 1, record.segment.c_str(), -1, SQLITE_STATIC);
+            }
+            sqlite3_bind_int64(insert, 2, record.offset);
+            sqlite3_bind_int64(insert, 3, record.length);
+            sqlite3_bind_int(insert, 4, record.id);
+            sqlite3_bind_text(insert, 5, record.certDataTo.c_str(), -1, SQLITE_STATIC);
+            if (sqlite3_step(insert) != SQLITE_DONE) {
+                throw std::runtime_error("archiveCerts: " + std::string(sqlite3_errmsg(db)));
+            }
+            sqlite3_reset(insert);
+            if (sqlite3_changes(db) == 0) {
+                continue;
+            }
+
+            sqlite3_bind_int(remove, 1, record.id);
+            if (sqlite3_step(remove) != SQLITE_DONE) {
+                throw std::runtime_error("archiveCerts: " + std::string(sqlite3_errmsg(db)));
+            }
+            sqlite3_reset(remove);
+            archived[i] = true;
+        }
+
+        sqlite3_finalize(insert);
+        sqlite3_finalize(remove);
+        insert = remove = nullptr;
+        executeQuery("COMMIT;");
+    } catch (const std::exception&) {
+        sqlite3_finalize(insert);
+        sqlite3_finalize(remove);
+        sqlite3_exec(db, "ROLLBACK;", nullptr, nullptr, nullptr);
+        throw;
+    }
+
+    return archived;
+}
+
+
+bool Database::selectArchivedCert(const std::string& serial, ArchivedCertRecord& record)
+{
+    const char* sql = "SELECT id, certName, serial, certDataFrom, certDataTo, info, status, COALESCE(revocationReason, -1), "
+                      "COALESCE(revokedAt, ''), COALESCE(segment, ''), segmentOffset, segmentLength FROM archived_certs "
+                      "WHERE serial = ? ORDER BY id DESC LIMIT 1";
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        throw std::runtime_error("selectArchivedCert: " + std::string(sqlite3_errmsg(db)));
+    }
+    sqlite3_bind_text(stmt, 1, serial.c_str(), -1, SQLITE_STATIC);
+
+    int resultCode = sqlite3_step(stmt);
+    if (resultCode == SQLITE_ROW) {
+        record.id = sqlite3_column_int(stmt, 0);
+        record.certName = columnText(stmt, 1);
+        record.serial = columnText(stmt, 2);
+        record.certDataFrom = columnText(stmt, 3);
+        record.certDataTo = columnText(stmt, 4);
+        record.info = columnText(stmt, 5);
+        record.status = columnText(stmt, 6);
+        record.revocationReason = sqlite3_column_int(stmt, 7);
+        record.revokedAt = columnText(stmt, 8);
+        record.segment = columnText(stmt, 9);
+        record.offset = sqlite3_column_int64(stmt, 10);
+        record.length = sqlite3_column_int64(stmt, 11);
+    }
+
+    sqlite3_finalize(stmt);
+    if (resultCode != SQLITE_ROW && resultCode != SQLITE_DONE) {
+        throw std::runtime_error("selectArchivedCert: " + std::string(sqlite3_errmsg(db)));
+    }
+
+    return resultCode == SQLITE_ROW;
+}
+
+
+std::vector<ChangeEvent> Database::readEvents(long long afterSeq, int limit)
+{
+    const char* sql = "SELECT seq, createdAt, type, tableName, rowId, serial, name, status, COALESCE(reasonCode, -1) "
+                      "FROM events WHERE seq > ? ORDER BY seq LIMIT ?";
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        throw std::runtime_error("readEvents: " + std::string(sqlite3_errmsg(db)));
+    }
+    sqlite3_bind_int64(stmt, 1, afterSeq);
+    sqlite3_bind_int(stmt, 2, limit);
+
+    std::vector<ChangeEvent> events;
+    int resultCode;
+    while ((resultCode = sqlite3_step(stmt)) == SQLITE_ROW) {
+        ChangeEvent event;
+        event.seq = sqlite3_column_int64(stmt, 0);
+        event.createdAt = columnText(stmt, 1);
+        event.type = columnText(stmt, 2);
+        event.tableName = columnText(stmt, 3);
+        event.rowId = sqlite3_column_int64(stmt, 4);
+        event.serial = columnText(stmt, 5);
+        event.name = columnText(stmt, 6);
+        event.status = columnText(stmt, 7);
+        event.reasonCode = sqlite3_column_int(stmt, 8);
+        events.push_back(event);
+    }
+
+    sqlite3_finalize(stmt);
+    if (resultCode != SQLITE_DONE) {
+        throw std::runtime_error("readEvents: " + std::string(sqlite3_errmsg(db)));
+    }
+
+    return events;
+}
+
+
+long long Database::lastEventSeq()
+{
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, "SELECT COALESCE(MAX(seq), 0) FROM events", -1, &stmt, nullptr) != SQLITE_OK) {
+        throw std::runtime_error("lastEventSeq: " + std::string(sqlite3_errmsg(db)));
+    }
+    long long seq = sqlite3_step(stmt) == SQLITE_ROW ? sqlite3_column_int64(stmt, 0) : 0;
+    sqlite3_finalize(stmt);
+    return seq;
+}
+
+
 int Database::deleteFromReqTable(const std::string &reqName)
 {
     std::string sql = "DELETE FROM issuing_csr WHERE csrName = ?";
@@ -218,3 +946,239 @@ int Database::deleteFromReqTable(const std::string &reqName)
     std::cout << "Запрос '" + reqName + "' был успешно удален из таблицы.\n";
     return 1;
 }
+
+
+SubjectFields Database::subjectFromName(const X509_NAME* name)
+{
+    // Первая запись с нужным NID; значение переводится в UTF-8 из любого строкового типа ASN.1 как есть:
+    // эвристика repairDoubleEncoding применяется только к старым строкам при заполнении столбцов миграцией
+    auto entryText = [name](int nid) {
+        int index = name ? X509_NAME_get_index_by_NID(name, nid, -1) : -1;
+        if (index < 0) {
+            return std::string();
+        }
+
+        unsigned char* utf8 = nullptr;
+        int length = ASN1_STRING_to_UTF8(&utf8, X509_NAME_ENTRY_get_data(X509_NAME_get_entry(name, index)));
+        if (length < 0) {
+            return std::string();
+        }
+        std::string value(reinterpret_cast<const char*>(utf8), length);
+        OPENSSL_free(utf8);
+        return value;
+    };
+
+    SubjectFields subject;
+    subject.country = entryText(NID_countryName);
+    subject.organization = entryText(NID_organizationName);
+    subject.commonName = entryText(NID_commonName);
+    return subject;
+}
+
+
+SubjectFields Database::parseSubject(const std::string& oneline)
+{
+    // Формат X509_NAME_oneline: /C=RU/O=Org/CN=Name, байты вне ASCII экранированы как \xHH.
+    // Новое поле начинается с '/', за которым следует имя атрибута и '='.
+    SubjectFields subject;
+    size_t pos = 0;
+
+    auto isFieldStart = [&oneline](size_t slash) {
+        size_t i = slash + 1;
+        while (i < oneline.size() && (std::isalnum(static_cast<unsigned char>(oneline[i])) || oneline[i] == '.')) {
+            ++i;
+        }
+        return i > slash + 1 && i < oneline.size() && oneline[i] == '=';
+    };
+
+    auto unescape = [](const std::string& value) {
+        std::string result;
+        for (size_t i = 0; i < value.size(); ++i) {
+            if (value[i] == '\\' && i + 3 < value.size() && value[i + 1] == 'x'
+                && std::isxdigit(static_cast<unsigned char>(value[i + 2])) && std::isxdigit(static_cast<unsigned char>(value[i + 3]))) {
+                result += static_cast<char>(std::stoi(value.substr(i + 2, 2), nullptr, 16));
+                i += 3;
+            } else {
+                result += value[i];
+            }
+        }
+        return result;
+    };
+
+    while (pos < oneline.size()) {
+        if (oneline[pos] != '/' || !isFieldStart(pos)) {
+            ++pos;
+            continue;
+        }
+
+        size_t eq = oneline.find('=', pos);
+        size_t end = eq + 1;
+        while (end < oneline.size() && !(oneline[end] == '/' && isFieldStart(end))) {
+            ++end;
+        }
+
+        std::string key = oneline.substr(pos + 1, eq - pos - 1);
+        std::string value = repairDoubleEncoding(unescape(oneline.substr(eq + 1, end - eq - 1)));
+
+        if (key == "C") {
+            subject.country = value;
+        } else if (key == "O") {
+            subject.organization = value;
+        } else if (key == "CN") {
+            subject.commonName = value;
+        }
+
+        pos = end;
+    }
+
+    return subject;
+}
+
+
+// Формирует часть запроса FROM ... WHERE ... ORDER BY для поиска по субъекту в таблице table (псевдоним t)
+std::string Database::buildSubjectSearch(const SubjectSearchQuery& query, const std::string& table, std::vector<std::string>& params)
+{
+    std::vector<std::string> conditions;
+    std::string from = " FROM " + table + " t";
+    std::string order = " ORDER BY t.id DESC";
+
+    if (!query.country.empty()) {
+        conditions.push_back("t.subjectC = ?");
+        params.push_back(query.country);
+    }
+
+    if (!query.organization.empty()) {
+        conditions.push_back("t.subjectO = ?");
+        params.push_back(query.organization);
+    }
+
+    // Префикс CN превращается в диапазон [prefix, prefix с увеличенным последним байтом), чтобы работал индекс
+    if (!query.commonNamePrefix.empty()) {
+        std::string upper = query.commonNamePrefix;
+        while (!upper.empty() && static_cast<unsigned char>(upper.back()) == 0xFF) {
+            upper.pop_back();
+        }
+
+        conditions.push_back("t.subjectCN >= ?");
+        params.push_back(query.commonNamePrefix);
+
+        if (!upper.empty()) {
+            upper.back() = static_cast<char>(static_cast<unsigned char>(upper.back()) + 1);
+            conditions.push_back("t.subjectCN < ?");
+            params.push_back(upper);
+        }
+    }
+
+    // Каждое слово ищется по префиксу; кавычки внутри слова экранируются по правилам FTS5
+    if (!query.text.empty()) {
+        std::string match;
+        std::istringstream words(query.text);
+        std::string word;
+
+        while (words >> word) {
+            std::string quoted;
+            for (char c : word) {
+                quoted += c;
+                if (c == '"') {
+                    quoted += '"';
+                }
+            }
+            match += (match.empty() ? "" : " ") + std::string("\"") + quoted + "\"*";
+        }
+
+        // Выборка идет от FTS-индекса в порядке убывания rowid: FTS5 отдает документы потоком,
+        // и LIMIT останавливает чтение даже для слов, встречающихся в каждой записи
+        if (!match.empty()) {
+            from = " FROM " + table + "_fts f JOIN " + table + " t ON t.id = f.rowid";
+            order = " ORDER BY f.rowid DESC";
+            conditions.insert(conditions.begin(), "f." + table + "_fts MATCH ?");
+            params.insert(params.begin(), match);
+        }
+    }
+
+    std::string where;
+    for (const auto& condition : conditions) {
+        where += (where.empty() ? " WHERE " : " AND ") + condition;
+    }
+
+    return from + where + order;
+}
+
+
+std::vector<IssuerCertRecord> Database::searchIssuerCerts(const SubjectSearchQuery& query)
+{
+    std::vector<std::string> params;
+    const std::string sql =
+        "SELECT t.id, t.certName, t.serial, t.certDataFrom, t.certDataTo, t.info, t.status, "
+        "t.subjectC, t.subjectO, t.subjectCN, t.subjectSAN"
+        + buildSubjectSearch(query, "issuing_certs", params) + " LIMIT ?;";
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        throw std::runtime_error("searchIssuerCerts: " + std::string(sqlite3_errmsg(db)));
+    }
+
+    for (size_t i = 0; i < params.size(); ++i) {
+        sqlite3_bind_text(stmt, static_cast<int>(i + 1), params[i].c_str(), -1, SQLITE_STATIC);
+    }
+    sqlite3_bind_int(stmt, static_cast<int>(params.size() + 1), query.limit);
+
+    std::vector<IssuerCertRecord> records;
+    int resultCode;
+    while ((resultCode = sqlite3_step(stmt)) == SQLITE_ROW) {
+        IssuerCertRecord record;
+        record.id = sqlite3_column_int(stmt, 0);
+        record.certName = columnText(stmt, 1);
+        record.serial = columnText(stmt, 2);
+        record.certDataFrom = columnText(stmt, 3);
+        record.certDataTo = columnText(stmt, 4);
+        record.info = columnText(stmt, 5);
+        record.status = columnText(stmt, 6);
+        record.subject = {columnText(stmt, 7), columnText(stmt, 8), columnText(stmt, 9), columnText(stmt, 10)};
+        records.push_back(std::move(record));
+    }
+
+    sqlite3_finalize(stmt);
+    if (resultCode != SQLITE_DONE) {
+        throw std::runtime_error("searchIssuerCerts: " + std::string(sqlite3_errmsg(db)));
+    }
+
+    return records;
+}
+
+
+std::vector<IssuerCSRRecord> Database::searchIssuerCSRs(const SubjectSearchQuery& query)
+{
+    std::vector<std::string> params;
+    const std::string sql =
+        "SELECT t.id, t.csrName, t.info, t.subjectC, t.subjectO, t.subjectCN, t.subjectSAN"
+        + buildSubjectSearch(query, "issuing_csr", params) + " LIMIT ?;";
+
+    sqlite3_stmt* stmt;
+    if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        throw std::runtime_error("searchIssuerCSRs: " + std::string(sqlite3_errmsg(db)));
+    }
+
+    for (size_t i = 0; i < params.size(); ++i) {
+        sqlite3_bind_text(stmt, static_cast<int>(i + 1), params[i].c_str(), -1, SQLITE_STATIC);
+    }
+    sqlite3_bind_int(stmt, static_cast<int>(params.size() + 1), query.limit);
+
+    std::vector<IssuerCSRRecord> records;
+    int resultCode;
+    while ((resultCode = sqlite3_step(stmt)) == SQLITE_ROW) {
+        IssuerCSRRecord record;
+        record.id = sqlite3_column_int(stmt, 0);
+        record.csrName = columnText(stmt, 1);
+        record.info = columnText(stmt, 2);
+        record.subject = {columnText(stmt, 3), columnText(stmt, 4), columnText(stmt, 5), columnText(stmt, 6)};
+        records.push_back(std::move(record));
+    }
+
+    sqlite3_finalize(stmt);
+    if (resultCode != SQLITE_DONE) {
+        throw std::runtime_error("searchIssuerCSRs: " + std::string(sqlite3_errmsg(db)));
+    }
+
+    return records;
+}
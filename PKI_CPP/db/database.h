@@ -4,16 +4,123 @@
 #define ISSUER_CERTS_TABLE "issuing_certs"
 #define ISSUER_CSR_TABLE "issuing_csr"
 
+#include <openssl/x509.h>
 #include <sqlite3.h>
 #include <string>
 #include <iostream>
 #include <stdexcept>
-#include <fstream>
+#include <iterator>
+#include <ctime>
 #include <sstream>
+#include <cctype>
 #include <vector>
+#include <set>
+#include <functional>
 
 #include "../paths.hpp"
 
+// Поля субъекта сертификата или запроса, хранящиеся в отдельных индексируемых столбцах
+struct SubjectFields {
+    std::string country;
+    std::string organization;
+    std::string commonName;
+    std::string san;
+};
+
+// Параметры поиска по субъекту; пустые поля в фильтре не участвуют
+struct SubjectSearchQuery {
+    std::string country;
+    std::string organization;
+    std::string commonNamePrefix;
+    std::string text;       // полнотекстовый поиск по субъекту (FTS5), слова ищутся по префиксу
+    int limit = 100;
+};
+
+struct IssuerCertRecord {
+    int id = 0;
+    std::string certName;
+    std::string serial;
+    std::string certDataFrom;
+    std::string certDataTo;
+    std::string info;
+    std::string status;
+    SubjectFields subject;
+};
+
+struct IssuerCSRRecord {
+    int id = 0;
+    std::string csrName;
+    std::string info;
+    SubjectFields subject;
+};
+
+// Отбор действующих сертификатов для массового отзыва; заданные условия объединяются через AND
+struct RevocationQuery {
+    std::vector<std::string> serials;
+    std::string organization;
+    std::string issuedFrom;     // "ГГГГ-ММ-ДД[ ЧЧ:ММ:СС]", включительно
+    std::string issuedTo;       // "ГГГГ-ММ-ДД[ ЧЧ:ММ:СС]", не включительно
+    std::string keyHash;
+};
+
+// Отозванный сертификат для построения индекса статусов
+struct RevokedCertRecord {
+    std::string serial;
+    int reasonCode = 0;
+    time_t revokedAt = 0;
+};
+
+// Текущий статус выданного сертификата для предварительно подписанных ответов OCSP
+struct CertStatusRecord {
+    std::string serial;
+    bool revoked = false;
+    int reasonCode = 0;
+    time_t revokedAt = 0;
+    std::string status;         // значение столбца status; заполняется только selectCertStatus
+};
+
+// Запись журнала изменений events
+struct ChangeEvent {
+    long long seq = 0;
+    std::string createdAt;
+    std::string type;           // root_cert_added, csr_added, csr_deleted, cert_issued, cert_revoked, cert_expired, cert_reactivated, cert_renewed, cert_archived
+    std::string tableName;
+    long long rowId = 0;
+    std::string serial;
+    std::string name;
+    std::string status;
+    int reasonCode = -1;        // -1 - причина не задана
+};
+
+// Сертификат, выпущенный на замену истекающего (строка oldId с номером oldSerial)
+struct RenewedCertRecord {
+    int oldId = 0;
+    std::string oldSerial;
+    std::string certName;
+    std::string serial;
+    std::string certDataFrom;
+    std::string certDataTo;
+    std::string info;
+    std::string keyHash;
+    SubjectFields subject;
+};
+
+// Сертификат в холодном архиве: строка archived_certs и место DER в сегменте (segment пуст, если файла не было)
+struct ArchivedCertRecord {
+    int id = 0;
+    std::string certName;
+    std::string serial;
+    std::string certDataFrom;
+    std::string certDataTo;
+    std::string info;
+    std::string status;
+    int revocationReason = -1;  // -1 - причина не задана
+    std::string revokedAt;
+    std::string segment;
+    long long offset = 0;
+    long long length = 0;
+};
+
 class Database {
 private:
     sqlite3* db;                 
@@ -23,6 +130,8 @@ private:
     void checkError(int resultCode, const std::string& errorMessage);
     void executeQuery(const std::string& query); // нужно переписать методы класса с использованием приватного метода
     void initializeSchema();
+    int readUserVersion();
+    std::string buildSubjectSearch(const SubjectSearchQuery& query, const std::string& table, std::vector<std::string>& params);
 
 public:
 
@@ -30,6 +139,8 @@ public:
     ~Database();
     void open();                       
     void close();  
+    // Переводит базу в режим WAL (один раз: при установке УЦ и в выпускающих процессах)
+    void enableWal();
     void clear();
 
 
@@ -42,7 +153,8 @@ public:
 
     void addIsuuerCSR(
         const std::string& csrName,
-        const std::string& info
+        const std::string& info,
+        const SubjectFields& subject
     );
 
     void addIssuerCert(
@@ -50,7 +162,9 @@ public:
         const std::string& serial,
         const std::string& certDataFrom,
         const std::string& certDataTo,
-        const std::string& info
+        const std::string& info,
+        const SubjectFields& subject,
+        const std::string& keyHash = ""
     );
 
     // void revokeRootCert(); 
@@ -59,8 +173,54 @@ public:
 
     void actionWithIssuerCert(const std::string& serial, std::string action);
 
+    std::vector<std::string> selectSerialsForRevocation(const RevocationQuery& query);
+    // Отзывает действующие сертификаты, а при причине, отличной от CertificateHold, и приостановленные (причина
+    // заменяется, дата отзыва остается прежней). beforeCommit вызывается внутри транзакции перед COMMIT:
+    // исключение из него откатывает изменения
+    int revokeIssuerCerts(const std::vector<std::string>& serials, int reasonCode, time_t revokedAt,
+                          const std::function<void()>& beforeCommit = nullptr);
+    // Серийные номера из serials, которых нет среди выданных сертификатов
+    std::vector<std::string> selectUnknownSerials(const std::vector<std::string>& serials);
+    // Серийные номера из serials, приостановленные отзывом с причиной CertificateHold
+    std::vector<std::string> selectSuspendedSerials(const std::vector<std::string>& serials);
+    // Снимает приостановку одной транзакцией: статус снова 'active', в журнал пишется cert_reactivated
+    int releaseIssuerCerts(const std::vector<std::string>& serials, const std::function<void()>& beforeCommit = nullptr);
+    std::vector<RevokedCertRecord> selectRevokedCerts(time_t revokedSince = 0);
+    // Серийные номера всех выданных сертификатов, включая перенесенные в архив
+    std::vector<std::string> selectIssuedSerials();
+    std::vector<CertStatusRecord> selectCertStatuses();
+    bool selectCertStatus(const std::string& serial, CertStatusRecord& record);
+
+    // Действующие и еще не продленные сертификаты, срок которых истекает в ближайшие withinDays дней
+    // (включая уже истекшие, но не помеченные); limit <= 0 - без ограничения
+    std::vector<IssuerCertRecord> selectExpiringCerts(int withinDays, int limit = 0);
+    // Добавляет продленные сертификаты и связывает их с предшественниками одной транзакцией.
+    // Запись пропускается (false), если предшественник тем временем отозван или уже продлен
+    std::vector<bool> addRenewedCerts(const std::vector<RenewedCertRecord>& records);
+
+    // Сертификаты, срок которых истек больше retentionDays дней назад, вместе с данными отзыва; limit <= 0 - без ограничения
+    std::vector<ArchivedCertRecord> selectArchivableCerts(int retentionDays, int limit = 0);
+    // Переносит строки из issuing_certs в archived_certs одной транзакцией. Запись пропускается (false),
+    // если строка тем временем удалена или ее срок изменен
+    std::vector<bool> archiveCerts(const std::vector<ArchivedCertRecord>& records);
+    // Самая поздняя архивная запись с серийным номером serial
+    bool selectArchivedCert(const std::string& serial, ArchivedCertRecord& record);
+
+    // Чтение журнала изменений после контрольной точки afterSeq, по возрастанию seq
+    std::vector<ChangeEvent> readEvents(long long afterSeq, int limit = 1000);
+    long long lastEventSeq();
+
     void displayTable(const std::string& tableName);
 
     int deleteFromReqTable(const std::string &reqName);
+
+    std::vector<IssuerCertRecord> searchIssuerCerts(const SubjectSearchQuery& query);
+    std::vector<IssuerCSRRecord> searchIssuerCSRs(const SubjectSearchQuery& query);
+
+    // Поля субъекта из X509_NAME: значения берутся из записей имени, а не из текста
+    static SubjectFields subjectFromName(const X509_NAME* name);
+    // Разбор однострочной формы /C=../O=../CN=.. только для старых строк, у которых есть лишь столбец info:
+    // '/' внутри значения в ней не экранируется, поэтому новые записи используют subjectFromName
+    static SubjectFields parseSubject(const std::string& oneline);
 };
 
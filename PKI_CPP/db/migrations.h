@@ -0,0 +1,399 @@
+#pragma once
+
+#include "database.h"
+
+// Миграции схемы базы данных, встроенные в исполняемые файлы.
+// Номер применённой миграции хранится в PRAGMA user_version.
+// Новые изменения схемы добавляются только новой миграцией в конец списка,
+// уже выпущенные миграции не редактируются.
+
+struct Migration {
+    int version;
+    const char* description;
+    const char* sql;
+    void (*afterApply)(sqlite3* db); // заполнение данных, которое нельзя выразить на SQL (может быть nullptr)
+};
+
+
+// Заполняет столбцы субъекта для строк, созданных до миграции 2, и FTS-индексы
+static void backfillSubjectColumns(sqlite3* db)
+{
+    for (const std::string table : {"issuing_certs", "issuing_csr"}) {
+        // Индекс сначала строится по текущему содержимому, чтобы триггер обновления
+        // мог корректно удалить старые записи; дальше FTS синхронизируется триггерами
+        std::string rebuildSql = "INSERT INTO " + table + "_fts(" + table + "_fts) VALUES('rebuild');";
+        if (sqlite3_exec(db, rebuildSql.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK) {
+            throw std::runtime_error("backfillSubjectColumns: " + std::string(sqlite3_errmsg(db)));
+        }
+
+        // Строки сначала читаются целиком: обновление идет по тому же индексу subjectCN, что и выборка
+        std::vector<std::pair<int, std::string>> rows;
+        sqlite3_stmt* select;
+        std::string selectSql = "SELECT id, info FROM " + table + " WHERE subjectCN IS NULL;";
+
+        if (sqlite3_prepare_v2(db, selectSql.c_str(), -1, &select, nullptr) != SQLITE_OK) {
+            throw std::runtime_error("backfillSubjectColumns: " + std::string(sqlite3_errmsg(db)));
+        }
+        while (sqlite3_step(select) == SQLITE_ROW) {
+            const unsigned char* info = sqlite3_column_text(select, 1);
+            rows.emplace_back(sqlite3_column_int(select, 0), info ? reinterpret_cast<const char*>(info) : "");
+        }
+        sqlite3_finalize(select);
+
+        sqlite3_stmt* update;
+        std::string updateSql = "UPDATE " + table + " SET subjectC = ?, subjectO = ?, subjectCN = ? WHERE id = ?;";
+
+        if (sqlite3_prepare_v2(db, updateSql.c_str(), -1, &update, nullptr) != SQLITE_OK) {
+            throw std::runtime_error("backfillSubjectColumns: " + std::string(sqlite3_errmsg(db)));
+        }
+
+        for (const auto& [id, info] : rows) {
+            SubjectFields subject = Database::parseSubject(info);
+
+            sqlite3_bind_text(update, 1, subject.country.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(update, 2, subject.organization.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(update, 3, subject.commonName.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int(update, 4, id);
+
+            if (sqlite3_step(update) != SQLITE_DONE) {
+                std::string error = sqlite3_errmsg(db);
+                sqlite3_finalize(update);
+                throw std::runtime_error("backfillSubjectColumns: " + error);
+            }
+            sqlite3_reset(update);
+        }
+
+        sqlite3_finalize(update);
+    }
+}
+
+
+static const Migration DB_MIGRATIONS[] = {
+    {
+        1,
+        "Начальная схема: root_certs, issuing_csr, issuing_certs",
+        R"SQL(
+-- Таблица для корневых сертификатов
+CREATE TABLE IF NOT EXISTS root_certs (
+    id INTEGER PRIMARY KEY AUTOINCREMENT,
+    certName TEXT NOT NULL,
+    serial TEXT NOT NULL,
+    info TEXT NOT NULL,
+    validity INTEGER NOT NULL,
+    status TEXT NOT NULL DEFAULT 'active' CHECK(status IN ('active', 'revoked')) -- нужно добавить триггер для автоматического обновления статуса если срок истек
+);
+
+-- i
+CREATE TABLE IF NOT EXISTS issuing_csr (
+    id INTEGER PRIMARY KEY AUTOINCREMENT,
+    csrName TEXT NOT NULL,
+    info TEXT NOT NULL
+);
+
+-- Таблица для сертификатов, выданных эмитентом
+CREATE TABLE IF NOT EXISTS issuing_certs (
+    id INTEGER PRIMARY KEY AUTOINCREMENT,
+    certName TEXT NOT NULL,
+    serial TEXT NOT NULL,
+    certDataFrom DATETIME DEFAULT CURRENT_TIMESTAMP NOT NULL,
+    certDataTo DATETIME DEFAULT CURRENT_TIMESTAMP NOT NULL,
+    info TEXT NOT NULL,
+    status TEXT NOT NULL DEFAULT 'active' CHECK(status IN ('active', 'revoked'))
+);
+
+-- Триггер для обновления статуса после вставки
+CREATE TRIGGER IF NOT EXISTS update_cert_status_after_insert
+AFTER INSERT ON issuing_certs
+FOR EACH ROW
+BEGIN
+    UPDATE issuing_certs
+    SET status = CASE
+        WHEN certDataTo < CURRENT_TIMESTAMP THEN 'revoked'
+        ELSE 'active'
+    END
+    WHERE id = NEW.id;
+END;
+
+-- Триггер для обновления статуса после обновления
+CREATE TRIGGER IF NOT EXISTS update_cert_status_after_update
+AFTER UPDATE ON issuing_certs
+FOR EACH ROW
+BEGIN
+    UPDATE issuing_certs
+    SET status = CASE
+        WHEN certDataTo < CURRENT_TIMESTAMP THEN 'revoked'
+        ELSE 'active'
+    END
+    WHERE id = NEW.id;
+END;
+)SQL",
+        nullptr
+    },
+    {
+        2,
+        "Столбцы субъекта (C, O, CN, SAN) с индексами и полнотекстовый поиск FTS5",
+        R"SQL(
+ALTER TABLE issuing_certs ADD COLUMN subjectC TEXT;
+ALTER TABLE issuing_certs ADD COLUMN subjectO TEXT;
+ALTER TABLE issuing_certs ADD COLUMN subjectCN TEXT;
+ALTER TABLE issuing_certs ADD COLUMN subjectSAN TEXT;
+
+ALTER TABLE issuing_csr ADD COLUMN subjectC TEXT;
+ALTER TABLE issuing_csr ADD COLUMN subjectO TEXT;
+ALTER TABLE issuing_csr ADD COLUMN subjectCN TEXT;
+ALTER TABLE issuing_csr ADD COLUMN subjectSAN TEXT;
+
+-- Поиск по организации (и CN внутри организации) и по префиксу CN
+CREATE INDEX IF NOT EXISTS idx_issuing_certs_subject_o_cn ON issuing_certs(subjectO, subjectCN);
+CREATE INDEX IF NOT EXISTS idx_issuing_certs_subject_cn ON issuing_certs(subjectCN);
+CREATE INDEX IF NOT EXISTS idx_issuing_csr_subject_o_cn ON issuing_csr(subjectO, subjectCN);
+CREATE INDEX IF NOT EXISTS idx_issuing_csr_subject_cn ON issuing_csr(subjectCN);
+
+-- Полнотекстовые индексы по субъекту, содержимое берется из основных таблиц
+CREATE VIRTUAL TABLE IF NOT EXISTS issuing_certs_fts USING fts5(
+    subjectCN, subjectO, subjectC, subjectSAN,
+    content='issuing_certs', content_rowid='id',
+    tokenize='unicode61 remove_diacritics 2', prefix='2 3'
+);
+
+CREATE VIRTUAL TABLE IF NOT EXISTS issuing_csr_fts USING fts5(
+    subjectCN, subjectO, subjectC, subjectSAN,
+    content='issuing_csr', content_rowid='id',
+    tokenize='unicode61 remove_diacritics 2', prefix='2 3'
+);
+
+-- Синхронизация FTS-индексов с таблицами
+CREATE TRIGGER IF NOT EXISTS issuing_certs_fts_after_insert
+AFTER INSERT ON issuing_certs
+BEGIN
+    INSERT INTO issuing_certs_fts(rowid, subjectCN, subjectO, subjectC, subjectSAN)
+    VALUES (NEW.id, NEW.subjectCN, NEW.subjectO, NEW.subjectC, NEW.subjectSAN);
+END;
+
+CREATE TRIGGER IF NOT EXISTS issuing_certs_fts_after_delete
+AFTER DELETE ON issuing_certs
+BEGIN
+    INSERT INTO issuing_certs_fts(issuing_certs_fts, rowid, subjectCN, subjectO, subjectC, subjectSAN)
+    VALUES ('delete', OLD.id, OLD.subjectCN, OLD.subjectO, OLD.subjectC, OLD.subjectSAN);
+END;
+
+CREATE TRIGGER IF NOT EXISTS issuing_certs_fts_after_update
+AFTER UPDATE OF subjectCN, subjectO, subjectC, subjectSAN ON issuing_certs
+BEGIN
+    INSERT INTO issuing_certs_fts(issuing_certs_fts, rowid, subjectCN, subjectO, subjectC, subjectSAN)
+    VALUES ('delete', OLD.id, OLD.subjectCN, OLD.subjectO, OLD.subjectC, OLD.subjectSAN);
+    INSERT INTO issuing_certs_fts(rowid, subjectCN, subjectO, subjectC, subjectSAN)
+    VALUES (NEW.id, NEW.subjectCN, NEW.subjectO, NEW.subjectC, NEW.subjectSAN);
+END;
+
+CREATE TRIGGER IF NOT EXISTS issuing_csr_fts_after_insert
+AFTER INSERT ON issuing_csr
+BEGIN
+    INSERT INTO issuing_csr_fts(rowid, subjectCN, subjectO, subjectC, subjectSAN)
+    VALUES (NEW.id, NEW.subjectCN, NEW.subjectO, NEW.subjectC, NEW.subjectSAN);
+END;
+
+CREATE TRIGGER IF NOT EXISTS issuing_csr_fts_after_delete
+AFTER DELETE ON issuing_csr
+BEGIN
+    INSERT INTO issuing_csr_fts(issuing_csr_fts, rowid, subjectCN, subjectO, subjectC, subjectSAN)
+    VALUES ('delete', OLD.id, OLD.subjectCN, OLD.subjectO, OLD.subjectC, OLD.subjectSAN);
+END;
+
+CREATE TRIGGER IF NOT EXISTS issuing_csr_fts_after_update
+AFTER UPDATE OF subjectCN, subjectO, subjectC, subjectSAN ON issuing_csr
+BEGIN
+    INSERT INTO issuing_csr_fts(issuing_csr_fts, rowid, subjectCN, subjectO, subjectC, subjectSAN)
+    VALUES ('delete', OLD.id, OLD.subjectCN, OLD.subjectO, OLD.subjectC, OLD.subjectSAN);
+    INSERT INTO issuing_csr_fts(rowid, subjectCN, subjectO, subjectC, subjectSAN)
+    VALUES (NEW.id, NEW.subjectCN, NEW.subjectO, NEW.subjectC, NEW.subjectSAN);
+END;
+)SQL",
+        backfillSubjectColumns
+    },
+    {
+        3,
+        "Данные отзыва и хэш ключа в issuing_certs, триггер статуса больше не сбрасывает отзыв",
+        R"SQL(
+-- Прежний триггер после любого UPDATE возвращал статус 'active' и отменял отзыв
+DROP TRIGGER IF EXISTS update_cert_status_after_update;
+DROP TRIGGER IF EXISTS update_cert_status_after_insert;
+
+ALTER TABLE issuing_certs ADD COLUMN keyHash TEXT;            -- SHA-256 от SubjectPublicKeyInfo, hex
+ALTER TABLE issuing_certs ADD COLUMN issuedAt DATETIME;
+ALTER TABLE issuing_certs ADD COLUMN revokedAt DATETIME;
+ALTER TABLE issuing_certs ADD COLUMN revocationReason INTEGER; -- код RevocationReason
+
+UPDATE issuing_certs SET issuedAt = certDataFrom WHERE issuedAt IS NULL;
+
+CREATE INDEX IF NOT EXISTS idx_issuing_certs_serial ON issuing_certs(serial);
+CREATE INDEX IF NOT EXISTS idx_issuing_certs_key_hash ON issuing_certs(keyHash);
+CREATE INDEX IF NOT EXISTS idx_issuing_certs_issued_at ON issuing_certs(issuedAt);
+
+-- Истекшие сертификаты помечаются как отозванные, действующий статус не трогается
+CREATE TRIGGER IF NOT EXISTS update_cert_status_after_insert
+AFTER INSERT ON issuing_certs
+FOR EACH ROW
+WHEN NEW.certDataTo < CURRENT_TIMESTAMP
+BEGIN
+    UPDATE issuing_certs SET status = 'revoked' WHERE id = NEW.id;
+END;
+
+CREATE TRIGGER IF NOT EXISTS update_cert_status_after_update
+AFTER UPDATE OF certDataTo ON issuing_certs
+FOR EACH ROW
+WHEN NEW.certDataTo < CURRENT_TIMESTAMP
+BEGIN
+    UPDATE issuing_certs SET status = 'revoked' WHERE id = NEW.id;
+END;
+)SQL",
+        nullptr
+    },
+    {
+        4,
+        "Индекс по времени отзыва для инкрементального обновления индекса статусов",
+        R"SQL(
+CREATE INDEX IF NOT EXISTS idx_issuing_certs_revoked_at ON issuing_certs(revokedAt);
+)SQL",
+        nullptr
+    },
+    {
+        5,
+        "Журнал изменений events: выпуск, отзыв, запросы и корневые сертификаты",
+        R"SQL(
+-- Журнал только дописывается; seq монотонно растет и не переиспользуется (AUTOINCREMENT),
+-- поэтому потребитель читает изменения после своей контрольной точки: WHERE seq > ?
+CREATE TABLE IF NOT EXISTS events (
+    seq INTEGER PRIMARY KEY AUTOINCREMENT,
+    createdAt TEXT NOT NULL DEFAULT (strftime('%Y-%m-%d %H:%M:%f', 'now')),
+    type TEXT NOT NULL,
+    tableName TEXT NOT NULL,
+    rowId INTEGER NOT NULL,
+    serial TEXT,
+    name TEXT,
+    status TEXT,
+    reasonCode INTEGER
+);
+
+CREATE TRIGGER IF NOT EXISTS events_no_update
+BEFORE UPDATE ON events
+BEGIN
+    SELECT RAISE(ABORT, 'events: журнал изменений только дописывается');
+END;
+
+CREATE TRIGGER IF NOT EXISTS events_no_delete
+BEFORE DELETE ON events
+BEGIN
+    SELECT RAISE(ABORT, 'events: журнал изменений только дописывается');
+END;
+
+-- Существующие строки попадают в журнал как начальное состояние, чтобы потребитель мог начать с seq = 0
+INSERT INTO events(type, tableName, rowId, serial, name, status)
+SELECT 'root_cert_added', 'root_certs', id, serial, certName, status FROM root_certs ORDER BY id;
+INSERT INTO events(type, tableName, rowId, name)
+SELECT 'csr_added', 'issuing_csr', id, csrName FROM issuing_csr ORDER BY id;
+INSERT INTO events(type, tableName, rowId, serial, name, status)
+SELECT 'cert_issued', 'issuing_certs', id, serial, certName, 'active' FROM issuing_certs ORDER BY id;
+INSERT INTO events(type, tableName, rowId, serial, name, status, reasonCode)
+SELECT CASE WHEN revocationReason IS NULL THEN 'cert_expired' ELSE 'cert_revoked' END,
+       'issuing_certs', id, serial, certName, status, revocationReason
+FROM issuing_certs WHERE status = 'revoked' ORDER BY id;
+
+-- События пишутся триггерами в той же транзакции, что и само изменение
+CREATE TRIGGER IF NOT EXISTS root_certs_event_after_insert
+AFTER INSERT ON root_certs
+BEGIN
+    INSERT INTO events(type, tableName, rowId, serial, name, status)
+    VALUES ('root_cert_added', 'root_certs', NEW.id, NEW.serial, NEW.certName, NEW.status);
+END;
+
+CREATE TRIGGER IF NOT EXISTS issuing_csr_event_after_insert
+AFTER INSERT ON issuing_csr
+BEGIN
+    INSERT INTO events(type, tableName, rowId, name) VALUES ('csr_added', 'issuing_csr', NEW.id, NEW.csrName);
+END;
+
+CREATE TRIGGER IF NOT EXISTS issuing_csr_event_after_delete
+AFTER DELETE ON issuing_csr
+BEGIN
+    INSERT INTO events(type, tableName, rowId, name) VALUES ('csr_deleted', 'issuing_csr', OLD.id, OLD.csrName);
+END;
+
+CREATE TRIGGER IF NOT EXISTS issuing_certs_event_after_insert
+AFTER INSERT ON issuing_certs
+BEGIN
+    INSERT INTO events(type, tableName, rowId, serial, name, status)
+    VALUES ('cert_issued', 'issuing_certs', NEW.id, NEW.serial, NEW.certName, NEW.status);
+END;
+
+-- Отзыв (с причиной), истечение срока (отзыв триггером без причины) и возврат в действующие
+CREATE TRIGGER IF NOT EXISTS issuing_certs_event_after_status_update
+AFTER UPDATE OF status, revocationReason ON issuing_certs
+WHEN OLD.status IS NOT NEW.status OR OLD.revocationReason IS NOT NEW.revocationReason
+BEGIN
+    INSERT INTO events(type, tableName, rowId, serial, name, status, reasonCode)
+    VALUES (CASE WHEN NEW.status = 'active' THEN 'cert_reactivated'
+                 WHEN NEW.revocationReason IS NULL THEN 'cert_expired'
+                 ELSE 'cert_revoked' END,
+            'issuing_certs', NEW.id, NEW.serial, NEW.certName, NEW.status, NEW.revocationReason);
+END;
+)SQL",
+        nullptr
+    },
+    {
+        6,
+        "Связь продленных сертификатов с предшественниками и индекс истекающих",
+        R"SQL(
+ALTER TABLE issuing_certs ADD COLUMN renewedFrom TEXT;   -- серийный номер сертификата, который продлевался
+ALTER TABLE issuing_certs ADD COLUMN renewedBy TEXT;     -- серийный номер сертификата, выпущенного на замену
+
+-- Частичный индекс покрывает только кандидатов на продление: действующие и еще не продленные
+CREATE INDEX IF NOT EXISTS idx_issuing_certs_expiring ON issuing_certs(certDataTo)
+WHERE status = 'active' AND renewedBy IS NULL;
+
+CREATE TRIGGER IF NOT EXISTS issuing_certs_event_after_renewal
+AFTER UPDATE OF renewedBy ON issuing_certs
+WHEN OLD.renewedBy IS NULL AND NEW.renewedBy IS NOT NULL
+BEGIN
+    INSERT INTO events(type, tableName, rowId, serial, name, status)
+    VALUES ('cert_renewed', 'issuing_certs', NEW.id, NEW.serial, NEW.certName, NEW.status);
+END;
+)SQL",
+        nullptr
+    },
+    {
+        7,
+        "Холодный архив: индекс сертификатов, перенесенных из issuing_certs в сжатые сегменты",
+        R"SQL(
+-- Узкая таблица поиска: где в архиве лежит DER и данные, нужные для статуса и отзыва.
+-- Строка issuing_certs удаляется в той же транзакции, что и вставка сюда
+CREATE TABLE IF NOT EXISTS archived_certs (
+    id INTEGER PRIMARY KEY,                 -- id строки issuing_certs
+    certName TEXT NOT NULL,
+    serial TEXT NOT NULL,
+    certDataFrom DATETIME NOT NULL,
+    certDataTo DATETIME NOT NULL,
+    info TEXT NOT NULL,
+    status TEXT NOT NULL,
+    revocationReason INTEGER,
+    revokedAt DATETIME,
+    segment TEXT,                           -- NULL, если файла сертификата не было
+    segmentOffset INTEGER NOT NULL DEFAULT 0,
+    segmentLength INTEGER NOT NULL DEFAULT 0,
+    archivedAt DATETIME NOT NULL DEFAULT CURRENT_TIMESTAMP
+);
+
+CREATE INDEX IF NOT EXISTS idx_archived_certs_serial ON archived_certs(serial);
+-- Отозванные с причиной остаются в индексе статусов и после архивации
+CREATE INDEX IF NOT EXISTS idx_archived_certs_revoked_at ON archived_certs(revokedAt) WHERE revocationReason IS NOT NULL;
+
+CREATE TRIGGER IF NOT EXISTS archived_certs_event_after_insert
+AFTER INSERT ON archived_certs
+BEGIN
+    INSERT INTO events(type, tableName, rowId, serial, name, status, reasonCode)
+    VALUES ('cert_archived', 'issuing_certs', NEW.id, NEW.serial, NEW.certName, NEW.status, NEW.revocationReason);
+END;
+)SQL",
+        nullptr
+    },
+};
@@ -59,6 +59,18 @@ int main() {
         case 14:
             menu.get()->displayCSRs();
             break;
+        case 15:
+            menu.get()->signAllUserReqs();
+            break;
+        case 16:
+            menu.get()->searchIssuerCerts();
+            break;
+        case 17:
+            menu.get()->renewExpiringCerts();
+            break;
+        case 18:
+            menu.get()->releaseUserCert();
+            break;
         case 0:
             exit(0);
         default:
@@ -0,0 +1,187 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "../db/database.h"
+#include "../paths.hpp"
+#include "../utils/CertArchive.hpp"
+#include "../utils/Keys.hpp"
+#include "../utils/OCSPCache.hpp"
+#include "../utils/PemCodec.hpp"
+
+using namespace std;
+
+// Каждый отозванный сертификат, в том числе перенесенный в архив, должен получать ответ OCSP "revoked":
+// кэш строится так же, как в pki_crlserver --ocsp, и ответ разбирается обратно. Возвращает число расхождений
+static size_t checkRevokedOcsp(Database& db) {
+    Keys keys;
+    EvpPkeyPtr signerKey = ObjectLoader::loadPrivateKey((filesystem::path(ROOT_PRIVATE_KEY_PATH) / keys.getRootPkeyName()).string());
+    X509Ptr issuerCert = ObjectLoader::loadX509((filesystem::path(ROOT_CERTS_PATH) / ADMIN_CERT_NAME).string());
+    if (!signerKey || !issuerCert) {
+        throw runtime_error("не удалось прочитать ключ или сертификат КУЦ для проверки OCSP.");
+    }
+    OCSPCache cache(issuerCert.get(), signerKey.get());
+    cache.refresh(db);
+
+    size_t checked = 0, archived = 0, mismatched = 0;
+    for (const auto& record : db.selectRevokedCerts()) {
+        // Повторяющийся серийный номер с более поздней действующей записью отозванным не считается
+        RevocationIndex::SerialKey key;
+        CertStatusRecord current;
+        if (!RevocationIndex::toSerialKey(record.serial, key) || !db.selectCertStatus(record.serial, current) || !current.revoked) {
+            continue;
+        }
+        ++checked;
+        ArchivedCertRecord archivedRecord;
+        bool isArchived = db.selectArchivedCert(record.serial, archivedRecord);
+        archived += isArchived ? 1 : 0;
+
+        int status = -1;
+        auto der = cache.lookup(key);
+        if (der) {
+            const unsigned char* cursor = reinterpret_cast<const unsigned char*>(der->data());
+            OcspResponsePtr response(d2i_OCSP_RESPONSE(nullptr, &cursor, static_cast<long>(der->size())));
+            OcspBasicRespPtr basic(response ? OCSP_response_get1_basic(response.get()) : nullptr);
+            OCSP_SINGLERESP* single = basic ? OCSP_resp_get0(basic.get(), 0) : nullptr;
+            status = single ? OCSP_single_get0_status(single, nullptr, nullptr, nullptr, nullptr) : -1;
+        }
+        if (status != V_OCSP_CERTSTATUS_REVOKED) {
+            ++mismatched;
+            cout << record.serial << (isArchived ? " (в архиве)" : "") << ": ответ OCSP не \"revoked\"\n";
+        }
+    }
+    cout << "OCSP: проверено отозванных " << checked << ", из них в архиве " << archived << ", расхождений " << mismatched << "\n";
+    return mismatched;
+}
+
+// Перенос истекших сертификатов в холодный архив, например из cron:
+//   pki_archive run --retention-days 365 [--limit N] [--dry-run] [--retrain] [--crl <file>]
+//   pki_archive get <serial> [--out <file>] [--der]     сертификат из архива (по умолчанию PEM в stdout)
+//   pki_archive verify [--ocsp]                         проверка CRC всех записей и степень сжатия;
+//                                                       --ocsp - отозванные из архива по-прежнему получают ответ OCSP "revoked"
+int main(int argc, char* argv[]) {
+    string dbPath = DB_PATH;
+    string dbPassword = "1234";
+    string certsDir = ISSUER_CERTS_PATH;
+    string archiveDir = ARCHIVE_PATH;
+    string outPath;
+    bool der = false;
+    string command;
+    string serial;
+    bool ocspCheck = false;
+    ArchiveOptions options;
+
+    // Парсинг аргументов
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--retention-days" && i + 1 < argc) {
+            options.retentionDays = std::max(0, std::stoi(argv[++i]));
+        } else if (arg == "--limit" && i + 1 < argc) {
+            options.limit = std::max(0, std::stoi(argv[++i]));
+        } else if (arg == "--segment-mb" && i + 1 < argc) {
+            options.segmentBytes = static_cast<size_t>(std::max(1, std::stoi(argv[++i]))) << 20;
+        } else if (arg == "--dry-run") {
+            options.dryRun = true;
+        } else if (arg == "--retrain") {
+            options.retrain = true;
+        } else if (arg == "--out" && i + 1 < argc) {
+            outPath = argv[++i];
+        } else if (arg == "--der") {
+            der = true;
+        } else if (arg == "--ocsp") {
+            ocspCheck = true;
+        } else if (arg == "--db" && i + 1 < argc) {
+            dbPath = argv[++i];
+        } else if (arg == "--db-password" && i + 1 < argc) {
+            dbPassword = argv[++i];
+        } else if (arg == "--crl" && i + 1 < argc) {
+            options.crlPath = argv[++i];
+        } else if (arg == "--certs-dir" && i + 1 < argc) {
+            certsDir = argv[++i];
+        } else if (arg == "--archive-dir" && i + 1 < argc) {
+            archiveDir = argv[++i];
+        } else if (arg == "--help") {
+            cout << "Usage: " << argv[0] << " run [--retention-days N] [--limit N] [--segment-mb N] [--dry-run] [--retrain] [--crl <file>]\n"
+                 << "       " << argv[0] << " get <serial> [--out <file>] [--der]\n"
+                 << "       " << argv[0] << " verify [--ocsp]\n"
+                 << "Общие параметры: [--db <file>] [--db-password <pwd>] [--certs-dir <dir>] [--archive-dir <dir>]\n";
+            return 0;
+        } else if (!arg.starts_with("--") && command.empty()) {
+            command = arg;
+        } else if (!arg.starts_with("--") && command == "get" && serial.empty()) {
+            serial = arg;
+        } else {
+            cerr << "Неизвестный аргумент: " << arg << endl;
+            return 1;
+        }
+    }
+
+    try {
+        CertArchive archive(archiveDir);
+        if (command == "verify") {
+            ArchiveStats stats = archive.verify();
+            cout << "Сегментов: " << stats.segments << ", записей: " << stats.records << ", повреждено: " << stats.corrupted
+                 << ", DER: " << stats.derBytes << " байт, на диске: " << stats.storedBytes << " байт";
+            if (stats.derBytes > 0) {
+                cout << " (" << 100 * stats.storedBytes / stats.derBytes << "%)";
+            }
+            cout << "\n";
+            size_t mismatched = 0;
+            if (ocspCheck) {
+                Database db(dbPath, dbPassword);
+                mismatched = checkRevokedOcsp(db);
+            }
+            return stats.corrupted == 0 && mismatched == 0 ? 0 : 2;
+        }
+
+        Database db(dbPath, dbPassword);
+        if (command == "get" && !serial.empty()) {
+            ArchivedCertRecord record;
+            if (!db.selectArchivedCert(serial, record)) {
+                cerr << "Сертификата " << serial << " нет в архиве.\n";
+                return 1;
+            }
+            string content = archive.read(record);
+            if (!der) {
+                content = PemCodec::encode(content, PEM_STRING_X509);
+            }
+            if (outPath.empty()) {
+                cout.write(content.data(), content.size());
+            } else {
+                ofstream(outPath, ios::binary | ios::trunc).write(content.data(), content.size());
+            }
+            cerr << record.certName << "  " << record.status << "  до " << record.certDataTo << "  сегмент " << record.segment << "\n";
+            return 0;
+        }
+        if (command != "run") {
+            cerr << "Укажите команду: run, get или verify (--help).\n";
+            return 1;
+        }
+
+        ArchiveReport report = archive.run(db, options, certsDir);
+        if (options.dryRun) {
+            for (const auto& record : report.candidates) {
+                cout << record.serial << "  " << record.certName << "  истек " << record.certDataTo << "\n";
+            }
+        }
+        for (const auto& [failedSerial, error] : report.errors) {
+            cout << failedSerial << "  ошибка: " << error << "\n";
+        }
+        cout << "Кандидатов: " << report.selected << ", перенесено: " << report.archived << " (без файла: " << report.withoutFile
+             << "), ошибок: " << report.failed << "\n";
+        if (report.derBytes > 0) {
+            cout << "DER " << report.derBytes << " байт -> " << report.compressedBytes << " байт ("
+                 << 100 * report.compressedBytes / report.derBytes << "%), словарь " << report.dictionary << ", сегменты:";
+            for (const auto& segment : report.segments) {
+                cout << " " << segment;
+            }
+            cout << "\n";
+        }
+        return report.failed == 0 ? 0 : 2;
+    } catch (const std::exception& ex) {
+        cerr << "Ошибка архивации: " << ex.what() << endl;
+        return 1;
+    }
+}
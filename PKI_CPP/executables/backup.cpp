@@ -0,0 +1,137 @@
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "../paths.hpp"
+#include "../utils/Backup.hpp"
+
+using namespace std;
+
+// Резервное копирование УЦ на ходу, например из cron:
+//   pki_backup [run] [--step-pages N] [--step-pause-ms N] [--max-mb-per-sec N] [--segment-kb N]
+//                                                                          новая копия (только изменившиеся объекты)
+//   pki_backup list                                                        манифесты по порядку
+//   pki_backup verify [<манифест>]                                         наличие и SHA-256 всех объектов копии
+//   pki_backup restore [<манифест>] --to <dir>                             базы и дерево CA/ в dir
+// Запускается из корня проекта ради путей из paths.hpp; без имени берется последний манифест.
+
+// Копирование идет с пониженным приоритетом процессора и ввода-вывода, чтобы не отнимать их у выпуска
+static void lowerPriority() {
+    // SCHED_IDLE: копия получает процессор только когда он свободен от выпуска; иначе хотя бы nice 19
+    sched_param param{};
+    if (sched_setscheduler(0, SCHED_IDLE, &param) != 0) {
+        setpriority(PRIO_PROCESS, 0, 19);
+    }
+#ifdef SYS_ioprio_set
+    const int whoProcess = 1, classIdle = 3;
+    syscall(SYS_ioprio_set, whoProcess, 0, classIdle << 13);
+#endif
+}
+
+
+int main(int argc, char* argv[]) {
+    string command = "run";
+    string manifestName;
+    string backupDir = BACKUP_PATH;
+    string targetDir;
+    BackupOptions options;
+    bool commandSet = false;
+
+    // Парсинг аргументов
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--step-pages" && i + 1 < argc) {
+            options.stepPages = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--step-pause-ms" && i + 1 < argc) {
+            options.stepPause = chrono::milliseconds(std::max(0, std::stoi(argv[++i])));
+        } else if (arg == "--max-mb-per-sec" && i + 1 < argc) {
+            options.maxBytesPerSecond = static_cast<size_t>(std::max(0, std::stoi(argv[++i]))) << 20;
+        } else if (arg == "--segment-kb" && i + 1 < argc) {
+            options.segmentBytes = static_cast<size_t>(std::max(4, std::stoi(argv[++i]))) << 10;
+        } else if (arg == "--backup-dir" && i + 1 < argc) {
+            backupDir = argv[++i];
+        } else if (arg == "--to" && i + 1 < argc) {
+            targetDir = argv[++i];
+        } else if (arg == "--help") {
+            cout << "Usage: " << argv[0] << " [run] [--step-pages N] [--step-pause-ms N] [--max-mb-per-sec N] [--segment-kb N] [--backup-dir <dir>]\n"
+                 << "       " << argv[0] << " list [--backup-dir <dir>]\n"
+                 << "       " << argv[0] << " verify [<manifest>] [--backup-dir <dir>]\n"
+                 << "       " << argv[0] << " restore [<manifest>] --to <dir> [--backup-dir <dir>]\n";
+            return 0;
+        } else if (!arg.starts_with("--") && !commandSet) {
+            command = arg;
+            commandSet = true;
+        } else if (!arg.starts_with("--") && manifestName.empty() && (command == "verify" || command == "restore")) {
+            manifestName = arg;
+        } else {
+            cerr << "Неизвестный аргумент: " << arg << endl;
+            return 1;
+        }
+    }
+
+    try {
+        CABackup backup(backupDir);
+        if (command == "list") {
+            for (const auto& name : backup.list()) {
+                BackupManifest manifest = backup.readManifest(name);
+                size_t bytes = 0;
+                for (const auto& file : manifest.files) {
+                    bytes += file.size;
+                }
+                for (const auto& database : manifest.databases) {
+                    bytes += database.size;
+                }
+                cout << name << "  " << manifest.createdAt << "  баз: " << manifest.databases.size() << ", файлов: "
+                     << manifest.files.size() << ", " << bytes << " байт";
+                if (!manifest.missing.empty()) {
+                    cout << ", без файла: " << manifest.missing.size();
+                }
+                cout << "\n";
+            }
+            return 0;
+        }
+        if (command == "verify") {
+            BackupVerifyReport report = backup.verify(manifestName);
+            cout << "Объектов: " << report.objects << ", отсутствует: " << report.missingObjects
+                 << ", повреждено: " << report.corruptedObjects << "\n";
+            return report.missingObjects == 0 && report.corruptedObjects == 0 ? 0 : 2;
+        }
+        if (command == "restore") {
+            if (targetDir.empty()) {
+                cerr << "Укажите директорию восстановления: --to <dir>.\n";
+                return 1;
+            }
+            backup.restore(manifestName, targetDir);
+            cout << "Копия " << backup.readManifest(manifestName).name << " восстановлена в " << targetDir << "\n";
+            return 0;
+        }
+        if (command != "run") {
+            cerr << "Укажите команду: run, list, verify или restore (--help).\n";
+            return 1;
+        }
+
+        lowerPriority();
+        BackupReport report = backup.run(options);
+        const BackupManifest& manifest = report.manifest;
+        for (const auto& database : manifest.databases) {
+            cout << database.path << ": " << database.size << " байт, сегментов " << database.segments.size()
+                 << ", журнал до seq " << database.eventSeq << "\n";
+        }
+        cout << "Копия " << manifest.name << " (предыдущая: " << (manifest.previous.empty() ? "нет" : manifest.previous)
+             << "): файлов " << manifest.files.size() << ", без изменений " << report.filesUnchanged << ", записано объектов "
+             << report.objectsWritten << " (" << report.bytesWritten << " байт), шагов копирования базы " << report.dbSteps
+             << ", снимок " << report.snapshotMs << " мс, всего " << report.totalMs << " мс\n";
+        for (const auto& path : manifest.missing) {
+            cout << "Нет файла для строки снимка: " << path << "\n";
+        }
+        return 0;
+    } catch (const std::exception& ex) {
+        cerr << "Ошибка резервного копирования: " << ex.what() << endl;
+        return 1;
+    }
+}
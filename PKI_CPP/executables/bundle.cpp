@@ -0,0 +1,327 @@
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+#include "../paths.hpp"
+#include "../utils/Handles.hpp"
+#include "../utils/ObjectLoader.hpp"
+#include "../utils/OutputFormat.hpp"
+#include "../utils/PemCodec.hpp"
+
+using namespace std;
+
+// Массовый импорт и экспорт сертификатов в PEM-бандлах и опись (серийный номер, срок, субъект).
+// Base64 считает PemCodec; PEM, который он не принимает, разбирается OpenSSL.
+//   pki_bundle export [--certs-dir <dir>] [--out <file>]      все сертификаты директории (PEM и DER) в один бандл
+//   pki_bundle import <bundle> [--out-dir <dir>]               бандл в файлы <serial>.cert.pem в формате из output_format.conf
+//   pki_bundle list <bundle|dir>                               опись сертификатов
+//   pki_bundle check [--max-length N] [--iterations N]         сверка ядер с OpenSSL и замер скорости
+
+using CertificateVisitor = function<void(const string& der)>;
+
+// Перебирает сертификаты в PEM-тексте; блоки, которые PemCodec не принимает, читает PEM_read_bio
+static size_t forEachPemCertificate(string_view text, const CertificateVisitor& visit) {
+    size_t count = 0;
+    size_t offset = 0;
+    PemCodec::Block block;
+    while (offset < text.size()) {
+        if (PemCodec::decodeNext(text, offset, block)) {
+            if (block.label == PEM_STRING_X509) {
+                visit(block.der);
+                ++count;
+            }
+            continue;
+        }
+        if (text.find("-----BEGIN ", offset) == string_view::npos) {
+            break;
+        }
+
+        BioPtr bio(BIO_new_mem_buf(text.data() + offset, static_cast<int>(text.size() - offset)));
+        X509Ptr cert(bio ? PEM_read_bio_X509(bio.get(), nullptr, nullptr, nullptr) : nullptr);
+        if (!cert) {
+            throw runtime_error("не удалось разобрать PEM со смещения " + to_string(offset) + ".");
+        }
+        // Читатель остановился после разобранного блока: продолжаем с этого места
+        offset = text.size() - BIO_pending(bio.get());
+        string der(i2d_X509(cert.get(), nullptr), '\0');
+        unsigned char* cursor = reinterpret_cast<unsigned char*>(der.data());
+        i2d_X509(cert.get(), &cursor);
+        visit(der);
+        ++count;
+    }
+    return count;
+}
+
+
+static size_t forEachFileCertificate(const string& path, const CertificateVisitor& visit) {
+    MappedFile file(path);
+    if (!file.isOpen()) {
+        throw runtime_error("не удалось открыть " + path + ".");
+    }
+    if (ObjectLoader::detectEncoding(file.data(), file.size()) == ObjectEncoding::DER) {
+        visit(string(reinterpret_cast<const char*>(file.data()), file.size()));
+        return 1;
+    }
+    return forEachPemCertificate(string_view(reinterpret_cast<const char*>(file.data()), file.size()), visit);
+}
+
+
+// Файлы сертификатов директории; x.der пропускается, если рядом есть x.pem (см. OutputFormat.hpp)
+static vector<string> certificateFiles(const string& directory) {
+    vector<string> paths;
+    for (const auto& entry : filesystem::directory_iterator(directory)) {
+        filesystem::path file = entry.path();
+        if (!entry.is_regular_file()) {
+            continue;
+        }
+        if (file.extension() == ".pem" ||
+            (file.extension() == ".der" && !filesystem::exists(filesystem::path(file).replace_extension(".pem")))) {
+            paths.push_back(file.string());
+        }
+    }
+    sort(paths.begin(), paths.end());
+    return paths;
+}
+
+
+static X509Ptr parseDer(const string& der) {
+    const unsigned char* cursor = reinterpret_cast<const unsigned char*>(der.data());
+    return X509Ptr(d2i_X509(nullptr, &cursor, static_cast<long>(der.size())));
+}
+
+
+static double elapsedMs(chrono::steady_clock::time_point from) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - from).count();
+}
+
+
+static int exportBundle(const string& certsDir, const string& outPath) {
+    ofstream file;
+    if (!outPath.empty()) {
+        file.open(outPath, ios::binary | ios::trunc);
+        if (!file) {
+            cerr << "Не удалось открыть " << outPath << " для записи.\n";
+            return 1;
+        }
+    }
+    ostream& out = outPath.empty() ? cout : file;
+
+    auto started = chrono::steady_clock::now();
+    size_t exported = 0, failed = 0, bytes = 0;
+    for (const auto& path : certificateFiles(certsDir)) {
+        try {
+            exported += forEachFileCertificate(path, [&](const string& der) {
+                string pem = PemCodec::encode(der, PEM_STRING_X509);
+                bytes += pem.size();
+                out.write(pem.data(), pem.size());
+            });
+        } catch (const std::runtime_error& ex) {
+            cerr << path << ": " << ex.what() << "\n";
+            ++failed;
+        }
+    }
+    out.flush();
+    cerr << "Экспортировано сертификатов: " << exported << " (" << bytes << " байт) за " << elapsedMs(started)
+         << " мс, ошибок: " << failed << ", base64: " << PemCodec::kernelName(PemCodec::kernel()) << "\n";
+    return failed == 0 && out ? 0 : 2;
+}
+
+
+static int importBundle(const string& bundlePath, const string& outDir) {
+    OutputFormat format = OutputFormats::current().certs;
+    auto started = chrono::steady_clock::now();
+    size_t imported = 0, skipped = 0;
+    try {
+        forEachFileCertificate(bundlePath, [&](const string& der) {
+            X509Ptr cert = parseDer(der);
+            if (!cert) {
+                ++skipped;
+                return;
+            }
+            string certPath = (filesystem::path(outDir) / (serialToDecimal(X509_get0_serialNumber(cert.get())) + ".cert.pem")).string();
+            if (Artifacts::exists(certPath)) {
+                ++skipped;
+                return;
+            }
+            Artifacts::write(Artifacts::encodeDer(der, PEM_STRING_X509, certPath, format), certPath, format);
+            ++imported;
+        });
+    } catch (const std::runtime_error& ex) {
+        cerr << bundlePath << ": " << ex.what() << "\n";
+        return 2;
+    }
+    cerr << "Импортировано сертификатов: " << imported << ", пропущено (уже есть или не разобраны): " << skipped
+         << ", формат " << OutputFormats::name(format) << ", за " << elapsedMs(started) << " мс\n";
+    return 0;
+}
+
+
+static int listCertificates(const string& path) {
+    vector<string> files = filesystem::is_directory(path) ? certificateFiles(path) : vector<string>{path};
+    size_t total = 0, failed = 0;
+    for (const auto& file : files) {
+        try {
+            total += forEachFileCertificate(file, [&](const string& der) {
+                X509Ptr cert = parseDer(der);
+                if (!cert) {
+                    cout << file << "  не разобран\n";
+                    ++failed;
+                    return;
+                }
+                struct tm notAfter = {};
+                ASN1_TIME_to_tm(X509_get0_notAfter(cert.get()), &notAfter);
+                char date[32];
+                strftime(date, sizeof(date), "%Y-%m-%d", &notAfter);
+                cout << serialToDecimal(X509_get0_serialNumber(cert.get())) << "  " << date << "  "
+                     << nameToOneline(X509_get_subject_name(cert.get())) << "\n";
+            });
+        } catch (const std::runtime_error& ex) {
+            cerr << file << ": " << ex.what() << "\n";
+            ++failed;
+        }
+    }
+    cout << "Сертификатов: " << total << ", ошибок: " << failed << "\n";
+    return failed == 0 ? 0 : 2;
+}
+
+
+// Сверка всех ядер с OpenSSL байт в байт и замер кодирования и разбора PEM размера типичного сертификата
+static int checkCodec(size_t maxLength, int iterations) {
+    string report;
+    if (!PemCodec::selfCheck(&report, maxLength)) {
+        cerr << "Расхождение с OpenSSL: " << report << "\n";
+        return 1;
+    }
+    cout << "Сверка с OpenSSL пройдена (длины 0.." << maxLength << ")\n";
+
+    mt19937 random(1);
+    string der(1200, '\0');
+    for (auto& byte : der) {
+        byte = static_cast<char>(random());
+    }
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(der.data());
+    string pem = PemCodec::encode(der, PEM_STRING_X509);
+    size_t sink = 0;
+
+    auto started = chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        BioPtr bio(BIO_new(BIO_s_mem()));
+        PEM_write_bio(bio.get(), PEM_STRING_X509, "", bytes, static_cast<long>(der.size()));
+        sink += BIO_pending(bio.get());
+    }
+    double encodeMs = elapsedMs(started);
+    started = chrono::steady_clock::now();
+    for (int i = 0; i < iterations; ++i) {
+        BioPtr bio(BIO_new_mem_buf(pem.data(), static_cast<int>(pem.size())));
+        char* name = nullptr;
+        char* header = nullptr;
+        unsigned char* data = nullptr;
+        long length = 0;
+        PEM_read_bio(bio.get(), &name, &header, &data, &length);
+        sink += length;
+        OPENSSL_free(name);
+        OPENSSL_free(header);
+        OPENSSL_free(data);
+    }
+    double decodeMs = elapsedMs(started);
+    cout << "openssl  кодирование " << encodeMs * 1000 / iterations << " мкс, разбор " << decodeMs * 1000 / iterations << " мкс\n";
+
+    Base64Kernel selected = PemCodec::kernel();
+    for (Base64Kernel kernel : {Base64Kernel::Scalar, Base64Kernel::SSE4, Base64Kernel::AVX2}) {
+        if (!PemCodec::setKernel(kernel)) {
+            continue;
+        }
+        started = chrono::steady_clock::now();
+        for (int i = 0; i < iterations; ++i) {
+            sink += PemCodec::encode(der, PEM_STRING_X509).size();
+        }
+        encodeMs = elapsedMs(started);
+        started = chrono::steady_clock::now();
+        string decoded;
+        for (int i = 0; i < iterations; ++i) {
+            PemCodec::decode(pem, PEM_STRING_X509, decoded);
+            sink += decoded.size();
+        }
+        decodeMs = elapsedMs(started);
+        cout << PemCodec::kernelName(kernel) << string(9 - string(PemCodec::kernelName(kernel)).size(), ' ')
+             << "кодирование " << encodeMs * 1000 / iterations << " мкс, разбор " << decodeMs * 1000 / iterations << " мкс\n";
+    }
+    PemCodec::setKernel(selected);
+    return sink == 0 ? 1 : 0;
+}
+
+
+int main(int argc, char* argv[]) {
+    string command;
+    vector<string> positional;
+    string certsDir = ISSUER_CERTS_PATH;
+    string outPath;
+    string outDir = ISSUER_CERTS_PATH;
+    size_t maxLength = 2048;
+    int iterations = 100000;
+
+    // Парсинг аргументов
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--certs-dir" && i + 1 < argc) {
+            certsDir = argv[++i];
+        } else if (arg == "--out" && i + 1 < argc) {
+            outPath = argv[++i];
+        } else if (arg == "--out-dir" && i + 1 < argc) {
+            outDir = argv[++i];
+        } else if (arg == "--max-length" && i + 1 < argc) {
+            maxLength = std::stoul(argv[++i]);
+        } else if (arg == "--iterations" && i + 1 < argc) {
+            iterations = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--kernel" && i + 1 < argc) {
+            string name = argv[++i];
+            bool found = false;
+            for (Base64Kernel kernel : {Base64Kernel::Scalar, Base64Kernel::SSE4, Base64Kernel::AVX2}) {
+                if (name == PemCodec::kernelName(kernel)) {
+                    found = PemCodec::setKernel(kernel);
+                }
+            }
+            if (!found) {
+                cerr << "Ядро " << name << " не поддерживается этим процессором.\n";
+                return 1;
+            }
+        } else if (arg == "--help") {
+            cout << "Usage: " << argv[0] << " export [--certs-dir <dir>] [--out <file>]\n"
+                 << "       " << argv[0] << " import <bundle> [--out-dir <dir>]\n"
+                 << "       " << argv[0] << " list <bundle|dir>\n"
+                 << "       " << argv[0] << " check [--max-length N] [--iterations N]\n"
+                 << "Общий параметр: --kernel scalar|sse4|avx2 (по умолчанию лучшее доступное)\n";
+            return 0;
+        } else if (!arg.starts_with("--")) {
+            (command.empty() ? command : positional.emplace_back()) = arg;
+        } else {
+            cerr << "Неизвестный аргумент: " << arg << endl;
+            return 1;
+        }
+    }
+
+    try {
+        if (command == "export") {
+            return exportBundle(certsDir, outPath);
+        } else if (command == "import" && positional.size() == 1) {
+            return importBundle(positional[0], outDir);
+        } else if (command == "list" && positional.size() == 1) {
+            return listCertificates(positional[0]);
+        } else if (command == "check") {
+            return checkCodec(maxLength, iterations);
+        }
+    } catch (const std::exception& ex) {
+        cerr << "Ошибка: " << ex.what() << endl;
+        return 1;
+    }
+    cerr << "Укажите команду: export, import, list или check (--help).\n";
+    return 1;
+}
@@ -0,0 +1,240 @@
+#include <csignal>
+#include <iostream>
+#include <string>
+
+#include <sys/resource.h>
+
+#include "../paths.hpp"
+#include "../utils/CRLDistribution.hpp"
+#include "../utils/CRLScheduler.hpp"
+#include "../utils/Certificates.hpp"
+#include "../utils/IssuerShards.hpp"
+#include "../utils/Keys.hpp"
+#include "../utils/OCSPCache.hpp"
+
+using namespace std;
+
+static DistributionServer* runningServer = nullptr;
+
+static void handleStopSignal(int) {
+    if (runningServer) {
+        runningServer->stop();
+    }
+}
+
+// Тысячи опрашивающих клиентов держат по соединению, поэтому поднимаем мягкий лимит дескрипторов до жесткого
+static void raiseFileLimit() {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+// Запрос OCSP методом GET: base64 от DER в пути, возможно с URL-кодированием (RFC 6960, приложение A.1)
+static string decodeOcspGetPath(string_view path) {
+    string base64;
+    for (size_t i = 0; i < path.size(); ++i) {
+        if (path[i] == '%' && i + 2 < path.size()) {
+            base64 += static_cast<char>(std::stoi(string(path.substr(i + 1, 2)), nullptr, 16));
+            i += 2;
+        } else {
+            base64 += path[i];
+        }
+    }
+    if (base64.empty() || base64.size() % 4 != 0) {
+        return "";
+    }
+
+    string der(base64.size() / 4 * 3, '\0');
+    int length = EVP_DecodeBlock(reinterpret_cast<unsigned char*>(der.data()), reinterpret_cast<const unsigned char*>(base64.data()), base64.size());
+    if (length < 0) {
+        return "";
+    }
+    size_t padding = base64.size() - base64.find_last_not_of('=') - 1;
+    der.resize(length - padding);
+    return der;
+}
+
+int main(int argc, char* argv[]) {
+    string bindAddress = "0.0.0.0";
+    int port = 8080;
+    int reloadInterval = 1000;
+    int maxAge = 300;
+    int idleTimeout = 30;
+    size_t maxConnections = 10000;
+    bool ocsp = false;
+    string dbPassword = "1234";
+    int ocspValidity = 86400;
+    int ocspMargin = 0;
+    int ocspRefresh = 60;
+    bool crlRegenerate = false;
+    string crlPath = (filesystem::path(CRL_PATH) / DEFAULT_CRL_NAME).string();
+    int crlValidity = CRL_UPDATE_TIME;
+    int crlOverlap = 0;
+    int crlCheck = 60;
+
+    // Парсинг аргументов
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--bind" && i + 1 < argc) {
+            bindAddress = argv[++i];
+        } else if (arg == "--port" && i + 1 < argc) {
+            port = std::stoi(argv[++i]);
+        } else if (arg == "--reload-interval" && i + 1 < argc) {
+            reloadInterval = std::max(10, std::stoi(argv[++i]));
+        } else if (arg == "--max-age" && i + 1 < argc) {
+            maxAge = std::max(0, std::stoi(argv[++i]));
+        } else if (arg == "--idle-timeout" && i + 1 < argc) {
+            idleTimeout = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--max-connections" && i + 1 < argc) {
+            maxConnections = std::stoul(argv[++i]);
+        } else if (arg == "--ocsp") {
+            ocsp = true;
+        } else if (arg == "--db-password" && i + 1 < argc) {
+            dbPassword = argv[++i];
+        } else if (arg == "--ocsp-validity" && i + 1 < argc) {
+            ocspValidity = std::max(60, std::stoi(argv[++i]));
+        } else if (arg == "--ocsp-margin" && i + 1 < argc) {
+            ocspMargin = std::max(0, std::stoi(argv[++i]));
+        } else if (arg == "--ocsp-refresh" && i + 1 < argc) {
+            ocspRefresh = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--crl-regenerate") {
+            crlRegenerate = true;
+        } else if (arg == "--crl" && i + 1 < argc) {
+            crlPath = argv[++i];
+        } else if (arg == "--crl-validity" && i + 1 < argc) {
+            crlValidity = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--crl-overlap" && i + 1 < argc) {
+            crlOverlap = std::max(0, std::stoi(argv[++i]));
+        } else if (arg == "--crl-check" && i + 1 < argc) {
+            crlCheck = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--help") {
+            cout << "Usage: " << argv[0] << " [--bind <addr>] [--port N] [--reload-interval ms] [--max-age s]"
+                 << " [--idle-timeout s] [--max-connections N]"
+                 << " [--ocsp [--db-password <pwd>] [--ocsp-validity s] [--ocsp-margin s] [--ocsp-refresh s]]"
+                 << " [--crl-regenerate [--crl <file>] [--crl-validity days] [--crl-overlap s] [--crl-check s]]\n";
+            return 0;
+        } else {
+            cerr << "Неизвестный аргумент: " << arg << endl;
+            return 1;
+        }
+    }
+
+    signal(SIGPIPE, SIG_IGN);
+    raiseFileLimit();
+
+    try {
+        // Шарды из shards.conf публикуют CRL и сертификат УЦ под /shards/<имя>/; шард на путях основного УЦ уже покрыт
+        vector<IssuerShardConfig> shards;
+        for (const auto& config : ShardRouter::loadConfig()) {
+            if (filesystem::path(config.crlPath).parent_path().lexically_normal() != filesystem::path(CRL_PATH).lexically_normal()) {
+                shards.push_back(config);
+            }
+        }
+
+        DistributionCatalog catalog;
+        for (const auto& config : shards) {
+            catalog.addSource(filesystem::path(config.crlPath).parent_path().string(), "/shards/" + config.name + "/crl/", true);
+            catalog.addFileSource(config.certPath, "/shards/" + config.name + "/ca/", false);
+        }
+        catalog.reload();
+
+        DistributionServer server(catalog, bindAddress, port, maxAge, idleTimeout, maxConnections);
+
+        // CRL переподписывается в фоне до nextUpdate; каталог подхватывает новый файл при очередной сверке
+        EvpPkeyPtr crlKey;
+        unique_ptr<CRLScheduler> crlScheduler;
+        if (crlRegenerate) {
+            Keys keys;
+            crlKey = keys.readExistingKeyFromPath(filesystem::path(ROOT_PRIVATE_KEY_PATH) / keys.getRootPkeyName());
+            if (!crlKey) {
+                throw runtime_error("Не удалось прочитать ключ КУЦ для переподписи CRL.");
+            }
+            crlScheduler = make_unique<CRLScheduler>(crlPath, crlKey.get(), crlValidity, crlOverlap, crlCheck);
+            crlScheduler->start();
+        }
+
+        // Ответы OCSP подписываются заранее в фоне, обработчик только ищет готовый ответ.
+        // У КУЦ и каждого инициализированного шарда свой кэш; запрос направляется по издателю
+        vector<unique_ptr<OCSPCache>> ocspCaches;
+        vector<unique_ptr<OCSPScheduler>> ocspSchedulers;
+        if (ocsp) {
+            Keys keys;
+            Certificates certificates;
+            EvpPkeyPtr signerKey = keys.readExistingKeyFromPath(filesystem::path(ROOT_PRIVATE_KEY_PATH) / keys.getRootPkeyName());
+            X509Ptr issuerCert = certificates.readExistingX509FromPath(filesystem::path(ROOT_CERTS_PATH) / ADMIN_CERT_NAME);
+            if (!signerKey || !issuerCert) {
+                throw runtime_error("Не удалось прочитать ключ или сертификат КУЦ для подписи ответов OCSP.");
+            }
+            ocspCaches.push_back(make_unique<OCSPCache>(issuerCert.get(), signerKey.get(), ocspValidity, ocspMargin));
+            {
+                Database db(DB_PATH, dbPassword);
+                OCSPRefreshStats stats = ocspCaches.back()->refresh(db);
+                cout << "OCSP: подписано ответов " << stats.signedResponses << endl;
+            }
+            ocspSchedulers.push_back(make_unique<OCSPScheduler>(*ocspCaches.back(), DB_PATH, dbPassword, ocspRefresh));
+
+            for (const auto& config : shards) {
+                if (!IssuerShard(config).isInitialized()) {
+                    continue;
+                }
+                EvpPkeyPtr shardKey = ObjectLoader::loadPrivateKey(config.keyPath);
+                X509Ptr shardCert = ObjectLoader::loadX509(config.certPath);
+                if (!shardKey || !shardCert) {
+                    throw runtime_error("Не удалось прочитать ключ или сертификат шарда " + config.name + " для подписи ответов OCSP.");
+                }
+                ocspCaches.push_back(make_unique<OCSPCache>(shardCert.get(), shardKey.get(), ocspValidity, ocspMargin));
+                {
+                    Database db(config.dbPath, config.dbPassword);
+                    OCSPRefreshStats stats = ocspCaches.back()->refresh(db);
+                    cout << "OCSP " << config.name << ": подписано ответов " << stats.signedResponses << endl;
+                }
+                ocspSchedulers.push_back(make_unique<OCSPScheduler>(*ocspCaches.back(), config.dbPath, config.dbPassword, ocspRefresh));
+            }
+            for (auto& scheduler : ocspSchedulers) {
+                scheduler->start();
+            }
+
+            vector<const OCSPCache*> caches;
+            for (const auto& cache : ocspCaches) {
+                caches.push_back(cache.get());
+            }
+            server.addHandler("/ocsp", [caches](string_view method, string_view path, string_view body) {
+                DistributionReply reply;
+                if (method == "POST" && path.empty()) {
+                    reply.body = OCSPCache::respond(caches, body);
+                } else if ((method == "GET" || method == "HEAD") && path.starts_with("/")) {
+                    string der = decodeOcspGetPath(path.substr(1));
+                    if (!der.empty()) {
+                        reply.body = OCSPCache::respond(caches, der);
+                    }
+                }
+                reply.contentType = "application/ocsp-response";
+                return reply;
+            });
+        }
+
+        runningServer = &server;
+        signal(SIGINT, handleStopSignal);
+        signal(SIGTERM, handleStopSignal);
+
+        cout << "Раздача CRL и сертификатов на " << bindAddress << ":" << port << endl;
+        for (const auto& url : catalog.urls()) {
+            cout << "  " << url << "\n";
+        }
+        cout.flush();
+
+        server.run(reloadInterval);
+        runningServer = nullptr;
+
+        const DistributionStats& stats = server.getStats();
+        cout << "Соединений: " << stats.connections << ", 200: " << stats.ok << ", 304: " << stats.notModified
+             << ", 404: " << stats.notFound << ", ошибок: " << stats.errors << endl;
+    } catch (const std::runtime_error& ex) {
+        cerr << ex.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
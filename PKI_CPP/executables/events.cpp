@@ -0,0 +1,161 @@
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include "../db/database.h"
+#include "../paths.hpp"
+
+using namespace std;
+
+static volatile sig_atomic_t stopRequested = 0;
+
+static void handleStopSignal(int) {
+    stopRequested = 1;
+}
+
+// Сообщения Database пишутся в cout; на время работы с базой они уводятся в cerr, чтобы не смешиваться с событиями
+struct CoutToCerr {
+    streambuf* saved = cout.rdbuf(cerr.rdbuf());
+    ~CoutToCerr() { cout.rdbuf(saved); }
+};
+
+static string jsonEscape(const string& value) {
+    string result;
+    for (unsigned char c : value) {
+        switch (c) {
+            case '"': result += "\\\""; break;
+            case '\\': result += "\\\\"; break;
+            case '\n': result += "\\n"; break;
+            case '\r': result += "\\r"; break;
+            case '\t': result += "\\t"; break;
+            default:
+                if (c < 0x20) {
+                    char buffer[8];
+                    snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                    result += buffer;
+                } else {
+                    result += static_cast<char>(c);
+                }
+        }
+    }
+    return result;
+}
+
+static void printEvent(const ChangeEvent& event) {
+    cout << "{\"seq\":" << event.seq << ",\"createdAt\":\"" << jsonEscape(event.createdAt) << "\",\"type\":\"" << event.type
+         << "\",\"table\":\"" << event.tableName << "\",\"rowId\":" << event.rowId;
+    if (!event.serial.empty()) cout << ",\"serial\":\"" << jsonEscape(event.serial) << "\"";
+    if (!event.name.empty()) cout << ",\"name\":\"" << jsonEscape(event.name) << "\"";
+    if (!event.status.empty()) cout << ",\"status\":\"" << event.status << "\"";
+    if (event.reasonCode >= 0) cout << ",\"reason\":" << event.reasonCode;
+    cout << "}\n";
+}
+
+static long long readCheckpoint(const string& path) {
+    ifstream in(path);
+    long long seq = 0;
+    return (in >> seq) ? seq : 0;
+}
+
+// Контрольная точка пишется во временный файл и переименовывается: при сбое остается прежняя, а не пустая
+static void writeCheckpoint(const string& path, long long seq) {
+    string temporary = path + ".tmp";
+    {
+        ofstream out(temporary, ios::trunc);
+        out << seq << "\n";
+        if (!out.flush()) {
+            throw runtime_error("Не удалось записать контрольную точку " + temporary + ".");
+        }
+    }
+    filesystem::rename(temporary, path);
+}
+
+int main(int argc, char* argv[]) {
+    string dbPath = DB_PATH;
+    string dbPassword = "1234";
+    string checkpointPath;
+    long long afterSeq = -1;
+    bool follow = false;
+    int pollInterval = 500;
+    int batchSize = 1000;
+
+    // Парсинг аргументов
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--db" && i + 1 < argc) {
+            dbPath = argv[++i];
+        } else if (arg == "--db-password" && i + 1 < argc) {
+            dbPassword = argv[++i];
+        } else if (arg == "--checkpoint" && i + 1 < argc) {
+            checkpointPath = argv[++i];
+        } else if (arg == "--after" && i + 1 < argc) {
+            afterSeq = std::stoll(argv[++i]);
+        } else if (arg == "--follow") {
+            follow = true;
+        } else if (arg == "--poll-interval" && i + 1 < argc) {
+            pollInterval = std::max(10, std::stoi(argv[++i]));
+        } else if (arg == "--batch" && i + 1 < argc) {
+            batchSize = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--help") {
+            cout << "Usage: " << argv[0] << " [--db <file>] [--db-password <pwd>] [--checkpoint <file> | --after <seq>]"
+                 << " [--follow] [--poll-interval ms] [--batch N]\n";
+            return 0;
+        } else {
+            cerr << "Неизвестный аргумент: " << arg << endl;
+            return 1;
+        }
+    }
+
+    if (afterSeq < 0) {
+        afterSeq = checkpointPath.empty() ? 0 : readCheckpoint(checkpointPath);
+    }
+
+    signal(SIGINT, handleStopSignal);
+    signal(SIGTERM, handleStopSignal);
+
+    try {
+        unique_ptr<Database> db;
+        {
+            CoutToCerr redirect;
+            db = make_unique<Database>(dbPath, dbPassword);
+        }
+
+        // События выводятся строками JSON; контрольная точка сдвигается только после вывода пачки
+        while (!stopRequested) {
+            vector<ChangeEvent> events = db->readEvents(afterSeq, batchSize);
+            for (const auto& event : events) {
+                printEvent(event);
+            }
+            cout.flush();
+
+            if (!events.empty()) {
+                afterSeq = events.back().seq;
+                if (!checkpointPath.empty()) {
+                    writeCheckpoint(checkpointPath, afterSeq);
+                }
+            }
+
+            if (static_cast<int>(events.size()) == batchSize) {
+                continue;
+            }
+            if (!follow) {
+                break;
+            }
+            this_thread::sleep_for(chrono::milliseconds(pollInterval));
+        }
+
+        CoutToCerr redirect;
+        db.reset();
+    } catch (const std::exception& ex) {
+        cerr << ex.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,610 @@
+#include <iostream>
+#include <iomanip>
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "../db/database.h"
+#include "../utils/Keys.hpp"
+#include "../utils/Certificates.hpp"
+#include "../utils/CRL.hpp"
+#include "../utils/CSRValidator.hpp"
+#include "../utils/UserFileParser.hpp"
+#include "../utils/ThreadPool.hpp"
+#include "../utils/RevocationIndex.hpp"
+#include "../utils/AsyncPipeline.hpp"
+#include "../utils/JobScheduler.hpp"
+#include "../utils/KeyPool.hpp"
+#include "../utils/OpenSSLAllocator.hpp"
+
+using namespace std;
+using Clock = chrono::steady_clock;
+
+#define LOADGEN_ORGANIZATION "Loadgen Org"
+#define LOADGEN_COUNTRY "RU"
+
+struct LoadgenOptions {
+    size_t count = 100;
+    size_t threads = thread::hardware_concurrency();
+    double rate = 0;              // операций в секунду, 0 — без ограничения
+    string keyType = "rsa2048";
+    string caKeyType = "rsa4096";
+    double revokeRatio = 0.1;
+    string scratchDir;
+    bool keep = false;
+    unsigned seed = 1;
+    size_t statusLookups = 1000000;
+    bool async = false;           // выпуск через IssuancePipeline: пул CPU размером threads и пул I/O
+    size_t ioThreads = 2;
+    bool scheduler = false;       // IssuancePipeline на планировщике с кражей работы и пулом ключей
+    AllocatorMode allocator = AllocatorMode::System;
+};
+
+enum Stage { StageKeygen, StageCSR, StageValidate, StageSign, StagePKCS12, StageRevoke, StageTotal, StageCount };
+
+static const char* stageNames[StageCount] = {"keygen", "csr", "validate", "sign", "pkcs12", "revoke", "total"};
+
+// Замеры задержек по этапам, в миллисекундах
+class LatencyRecorder {
+private:
+    mutex samplesMutex;
+    vector<double> samples[StageCount];
+public:
+    void add(Stage stage, double ms) {
+        lock_guard<mutex> lock(samplesMutex);
+        samples[stage].push_back(ms);
+    }
+
+    void report(ostream& out) {
+        out << left << setw(10) << "stage" << right << setw(8) << "count"
+            << setw(11) << "p50,ms" << setw(11) << "p90,ms" << setw(11) << "p99,ms" << setw(11) << "max,ms" << "\n";
+
+        for (int stage = 0; stage < StageCount; ++stage) {
+            vector<double>& values = samples[stage];
+            if (values.empty()) {
+                continue;
+            }
+            sort(values.begin(), values.end());
+            auto percentile = [&values](double p) {
+                size_t rank = static_cast<size_t>(p * (values.size() - 1) + 0.5);
+                return values[rank];
+            };
+            out << left << setw(10) << stageNames[stage] << right << setw(8) << values.size() << fixed << setprecision(2)
+                << setw(11) << percentile(0.50) << setw(11) << percentile(0.90)
+                << setw(11) << percentile(0.99) << setw(11) << values.back() << "\n";
+        }
+    }
+};
+
+// Выделения памяти OpenSSL по этапам; этап целиком выполняется в одном потоке, поэтому
+// достаточно разности счетчиков потока до и после него
+class AllocationRecorder {
+private:
+    atomic<size_t> samples[StageCount] = {};
+    atomic<size_t> allocations[StageCount] = {};
+    atomic<size_t> bytes[StageCount] = {};
+public:
+    void add(Stage stage, const ThreadAllocationCounters& before) {
+        ThreadAllocationCounters after = OpenSSLAllocator::threadCounters();
+        ++samples[stage];
+        allocations[stage] += after.allocations - before.allocations;
+        bytes[stage] += after.bytes - before.bytes;
+    }
+
+    void report(ostream& out) {
+        out << left << setw(10) << "stage" << right << setw(8) << "count" << setw(14) << "allocs/op" << setw(12) << "KiB/op" << "\n";
+        for (int stage = 0; stage < StageCount; ++stage) {
+            size_t count = samples[stage];
+            if (count == 0) {
+                continue;
+            }
+            out << left << setw(10) << stageNames[stage] << right << setw(8) << count << fixed << setprecision(1)
+                << setw(14) << static_cast<double>(allocations[stage]) / count
+                << setw(12) << bytes[stage] / 1024.0 / count << "\n";
+        }
+    }
+};
+
+static double elapsedMs(Clock::time_point from) {
+    return chrono::duration<double, milli>(Clock::now() - from).count();
+}
+
+// Создает структуру каталогов CA внутри scratch-директории и копирует конфигурацию эмитентского УЦ
+static void prepareScratch(const filesystem::path& scratch) {
+    for (const char* dir : {ROOT_PRIVATE_KEY_PATH, ROOT_CERTS_PATH, ISSUER_PRIVATE_KEY_PATH, ISSUER_CERTS_PATH,
+                            ISSUER_CSR_PATH, CRL_PATH, PKCS12_PATH, USER_REQS_PATH, TEMP_PATH}) {
+        filesystem::create_directories(scratch / dir);
+    }
+    filesystem::create_directories((scratch / DB_PATH).parent_path());
+    filesystem::create_directories((scratch / ISSUER_CNF).parent_path());
+
+    filesystem::copy_file(ISSUER_CNF, scratch / ISSUER_CNF, filesystem::copy_options::overwrite_existing);
+}
+
+// Самоподписанный сертификат УЦ для нагрузочного прогона (без интерактивного ввода)
+static X509Ptr createScratchRoot(EVP_PKEY* caKey) {
+    X509Ptr cert(X509_new());
+    X509_set_version(cert.get(), X509_VERSION_3);
+    ASN1_INTEGER_set(X509_get_serialNumber(cert.get()), 1);
+    X509_gmtime_adj(X509_get_notBefore(cert.get()), 0);
+    X509_gmtime_adj(X509_get_notAfter(cert.get()), 60L * 60 * 24 * 365);
+
+    X509_NAME* name = X509_get_subject_name(cert.get());
+    X509_NAME_add_entry_by_txt(name, "C", MBSTRING_ASC, reinterpret_cast<const unsigned char*>(LOADGEN_COUNTRY), -1, -1, 0);
+    X509_NAME_add_entry_by_txt(name, "O", MBSTRING_ASC, reinterpret_cast<const unsigned char*>(LOADGEN_ORGANIZATION), -1, -1, 0);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("Loadgen Root CA"), -1, -1, 0);
+    X509_set_issuer_name(cert.get(), name);
+    X509_set_pubkey(cert.get(), caKey);
+
+    X509V3_CTX ctx;
+    X509V3_set_ctx_nodb(&ctx);
+    X509V3_set_ctx(&ctx, cert.get(), cert.get(), nullptr, nullptr, 0);
+    for (auto [nid, value] : {pair{NID_basic_constraints, "critical,CA:TRUE"}, pair{NID_key_usage, "critical,keyCertSign,cRLSign"}}) {
+        X509ExtensionPtr ext(X509V3_EXT_conf_nid(nullptr, &ctx, nid, value));
+        X509_add_ext(cert.get(), ext.get(), -1);
+    }
+
+    if (X509_sign(cert.get(), caKey, digestForKey(caKey)) <= 0) {
+        throw runtime_error("createScratchRoot: не удалось подписать сертификат УЦ.");
+    }
+
+    filesystem::path certPath = filesystem::path(ROOT_CERTS_PATH) / ADMIN_CERT_NAME;
+    BioPtr certBio(BIO_new_file(certPath.c_str(), "w"));
+    if (!certBio || PEM_write_bio_X509(certBio.get(), cert.get()) == 0) {
+        throw runtime_error("createScratchRoot: не удалось сохранить сертификат УЦ.");
+    }
+
+    return cert;
+}
+
+static void printUsage(const char* program) {
+    cerr << "Usage: " << program << " [--count N] [--threads N] [--rate OPS] [--key-type T] [--ca-key-type T]\n"
+         << "       [--revoke-ratio R] [--scratch DIR] [--keep] [--seed N] [--status-lookups N]\n"
+         << "       [--async [--io-threads N] | --scheduler] [--openssl-alloc system|count|pool]\n"
+         << "Key types: rsa2048, rsa3072, rsa4096, ec-p256, ec-p384, ed25519\n";
+}
+
+int main(int argc, char* argv[]) {
+    LoadgenOptions options;
+
+    // Парсинг аргументов
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--count" && i + 1 < argc) {
+            options.count = std::stoul(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            options.threads = std::max<size_t>(1, std::stoul(argv[++i]));
+        } else if (arg == "--rate" && i + 1 < argc) {
+            options.rate = std::stod(argv[++i]);
+        } else if (arg == "--key-type" && i + 1 < argc) {
+            options.keyType = argv[++i];
+        } else if (arg == "--ca-key-type" && i + 1 < argc) {
+            options.caKeyType = argv[++i];
+        } else if (arg == "--revoke-ratio" && i + 1 < argc) {
+            options.revokeRatio = std::stod(argv[++i]);
+        } else if (arg == "--scratch" && i + 1 < argc) {
+            options.scratchDir = argv[++i];
+        } else if (arg == "--keep") {
+            options.keep = true;
+        } else if (arg == "--seed" && i + 1 < argc) {
+            options.seed = std::stoul(argv[++i]);
+        } else if (arg == "--status-lookups" && i + 1 < argc) {
+            options.statusLookups = std::stoul(argv[++i]);
+        } else if (arg == "--async") {
+            options.async = true;
+        } else if (arg == "--scheduler") {
+            options.async = true;
+            options.scheduler = true;
+        } else if (arg == "--io-threads" && i + 1 < argc) {
+            options.ioThreads = std::max<size_t>(1, std::stoul(argv[++i]));
+        } else if (arg == "--openssl-alloc" && i + 1 < argc && OpenSSLAllocator::parseMode(argv[i + 1], options.allocator)) {
+            ++i;
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    // До первого обращения к OpenSSL, иначе распределитель уже не заменить
+    if (!OpenSSLAllocator::install(options.allocator)) {
+        cerr << "Не удалось установить распределитель OpenSSL " << OpenSSLAllocator::modeName(options.allocator) << ".\n";
+        return 1;
+    }
+
+    // Scratch-директория повторяет структуру проекта, поэтому пути из paths.hpp работают относительно нее
+    if (options.scratchDir.empty()) {
+        char tmpl[] = "/tmp/pki_loadgen.XXXXXX";
+        if (!mkdtemp(tmpl)) {
+            cerr << "Не удалось создать временную директорию.\n";
+            return 1;
+        }
+        options.scratchDir = tmpl;
+    }
+    filesystem::path scratch = filesystem::absolute(options.scratchDir);
+
+    try {
+        prepareScratch(scratch);
+    } catch (const std::exception& ex) {
+        cerr << "Не удалось подготовить scratch-директорию (запускайте из корня проекта): " << ex.what() << "\n";
+        return 1;
+    }
+    filesystem::current_path(scratch);
+
+    // Подробный вывод операций заглушается, отчет печатается в исходный stdout
+    ostream report(cout.rdbuf());
+    cout.rdbuf(nullptr);
+
+    srand(options.seed);
+
+    EvpPkeyPtr caKey = Keys::generateKeyOfType(options.caKeyType);
+    X509Ptr rootCert = createScratchRoot(caKey.get());
+
+    Database db(DB_PATH, "loadgen");
+    Certificates certificates;
+    string crlPath = (filesystem::path(CRL_PATH) / DEFAULT_CRL_NAME).string();
+    CRL crl(crlPath, caKey.get(), rootCert.get());
+    CSRValidator validator(rootCert.get());
+
+    LatencyRecorder latencies;
+    RevocationIndex revocationIndex;
+    vector<string> issuedSerials(options.count);
+    mutex crlMutex;
+    atomic<size_t> failed{0}, rejected{0}, revokedCount{0};
+
+    report << "pki_loadgen: " << options.count << " операций, потоков " << options.threads
+           << ", ключи " << options.keyType << ", УЦ " << options.caKeyType
+           << (options.scheduler ? string(", scheduler") : options.async ? ", async, потоков I/O " + to_string(options.ioThreads) : string(""))
+           << ", rate " << (options.rate > 0 ? to_string(options.rate) : string("unlimited"))
+           << ", распределитель OpenSSL " << OpenSSLAllocator::modeName(options.allocator)
+           << ", scratch " << scratch << "\n";
+
+    // Заранее определяем, какие сертификаты будут отозваны, чтобы выбор не зависел от порядка потоков
+    vector<bool> toRevoke(options.count);
+    mt19937 rng(options.seed);
+    bernoulli_distribution revokeDist(std::clamp(options.revokeRatio, 0.0, 1.0));
+    for (size_t i = 0; i < options.count; ++i) {
+        toRevoke[i] = revokeDist(rng);
+    }
+    // Каждый второй отзыв - приостановка; половину приостановок после прогона снимает CRL::releaseSerials
+    auto revocationReasonFor = [](size_t index) { return index % 2 == 0 ? CertificateHold : KeyCompromise; };
+
+    AllocationRecorder stageAllocations;
+    AllocatorStats allocatorBefore = OpenSSLAllocator::getStats();
+    OpenSSLAllocator::resetPeak();
+    auto runStart = Clock::now();
+
+    auto issueOne = [&](size_t index) {
+        // Плановое время старта операции; задержка total считается от него, чтобы учесть очередь
+        auto scheduled = runStart;
+        if (options.rate > 0) {
+            scheduled += chrono::duration_cast<Clock::duration>(chrono::duration<double>(index / options.rate));
+            this_thread::sleep_until(scheduled);
+        }
+
+        string userName = "user_" + to_string(index);
+        try {
+            // Синтетическая пользовательская запись, как ее оставляет регистратор
+            filesystem::path userInfoPath = filesystem::path(USER_REQS_PATH) / (userName + ".txt");
+            {
+                ofstream userInfo(userInfoPath);
+                userInfo << "fio: Synthetic User " << index << "\n"
+                         << "countryName: " << LOADGEN_COUNTRY << "\n"
+                         << "organizationName: " << LOADGEN_ORGANIZATION << "\n"
+                         << "password: pw" << index << "\n";
+            }
+            UserInfo user = parseUserInfo(userInfoPath);
+
+            ThreadAllocationCounters opAllocations = OpenSSLAllocator::threadCounters();
+            ThreadAllocationCounters stageAllocationsBefore = opAllocations;
+            auto stageStart = Clock::now();
+            EvpPkeyPtr userKey = Keys::generateKeyOfType(options.keyType);
+            latencies.add(StageKeygen, elapsedMs(stageStart));
+            stageAllocations.add(StageKeygen, stageAllocationsBefore);
+
+            stageAllocationsBefore = OpenSSLAllocator::threadCounters();
+            stageStart = Clock::now();
+            X509ReqPtr req = certificates.genereteIssuerCSR(db, userKey.get(), userName, user.countryName, user.organizationName, user.fio);
+            latencies.add(StageCSR, elapsedMs(stageStart));
+            stageAllocations.add(StageCSR, stageAllocationsBefore);
+
+            stageAllocationsBefore = OpenSSLAllocator::threadCounters();
+            stageStart = Clock::now();
+            CSRValidationResult validation = validator.validate(req.get());
+            latencies.add(StageValidate, elapsedMs(stageStart));
+            stageAllocations.add(StageValidate, stageAllocationsBefore);
+            if (!validation.valid) {
+                ++rejected;
+                throw runtime_error("запрос отклонен: " + validation.reason);
+            }
+
+            stageAllocationsBefore = OpenSSLAllocator::threadCounters();
+            stageStart = Clock::now();
+            X509Ptr userCert = certificates.signIssuerReqCSR(userName + ".cert.pem", req.get(), rootCert.get(), caKey.get(), db);
+            latencies.add(StageSign, elapsedMs(stageStart));
+            stageAllocations.add(StageSign, stageAllocationsBefore);
+            issuedSerials[index] = serialToDecimal(X509_get_serialNumber(userCert.get()));
+
+            stageAllocationsBefore = OpenSSLAllocator::threadCounters();
+            stageStart = Clock::now();
+            Pkcs12Ptr p12 = certificates.generatePKCS12(userCert.get(), userKey.get(), user.password, userName);
+            latencies.add(StagePKCS12, elapsedMs(stageStart));
+            stageAllocations.add(StagePKCS12, stageAllocationsBefore);
+            if (!p12) {
+                throw runtime_error("не удалось создать PKCS#12");
+            }
+
+            if (toRevoke[index]) {
+                stageAllocationsBefore = OpenSSLAllocator::threadCounters();
+                stageStart = Clock::now();
+                {
+                    lock_guard<mutex> lock(crlMutex);
+                    crl.addRevokedCertificate(crlPath, userCert.get(), caKey.get(), db, revocationReasonFor(index));
+                }
+                revocationIndex.add({issuedSerials[index]}, revocationReasonFor(index), time(nullptr));
+                latencies.add(StageRevoke, elapsedMs(stageStart));
+                stageAllocations.add(StageRevoke, stageAllocationsBefore);
+                ++revokedCount;
+            }
+
+            latencies.add(StageTotal, elapsedMs(scheduled));
+            stageAllocations.add(StageTotal, opAllocations);
+        } catch (const std::exception& ex) {
+            ++failed;
+            cerr << userName << ": " << ex.what() << "\n";
+        }
+    };
+
+    // Асинхронный вариант: те же этапы, но выпуск идет через IssuancePipeline, и ни один поток не ждет другого этапа.
+    // С --scheduler этапы становятся классами задач одного планировщика с кражей работы: подпись и PKCS#12 — обычные,
+    // запись в базу и отзыв — короткие, а ключи берутся из KeyPool, который пополняется длинными задачами.
+    unique_ptr<ThreadPool> cpuPool, ioPool;
+    unique_ptr<JobScheduler> scheduler;
+    unique_ptr<KeyPool> keyPool;
+    optional<Executor> cpuExecutor, ioExecutor;
+    if (options.scheduler) {
+        scheduler = make_unique<JobScheduler>(options.threads);
+        keyPool = make_unique<KeyPool>(*scheduler, options.keyType, options.threads * 4);
+        cpuExecutor.emplace(scheduler->lane(JobClass::Normal));
+        ioExecutor.emplace(scheduler->lane(JobClass::Short));
+    } else if (options.async) {
+        cpuPool = make_unique<ThreadPool>(options.threads);
+        ioPool = make_unique<ThreadPool>(options.ioThreads);
+        cpuExecutor.emplace(*cpuPool);
+        ioExecutor.emplace(*ioPool);
+    }
+    unique_ptr<IssuancePipeline> pipeline;
+    if (options.async) {
+        pipeline = make_unique<IssuancePipeline>(*cpuExecutor, *ioExecutor, rootCert.get(), caKey.get(), db);
+    }
+
+    auto issueOneAsync = [&](size_t index, Clock::time_point scheduled) -> Task<void> {
+        string userName = "user_" + to_string(index);
+        co_await resumeOn(*cpuExecutor);
+
+        auto stageStart = Clock::now();
+        IssuanceRequest request;
+        request.name = userName;
+        if (keyPool) {
+            // Ключ из запаса; при пустом запасе генерация уходит длинной задачей и не задерживает подписи
+            request.userKey = keyPool->tryAcquire();
+            if (!request.userKey) {
+                co_await resumeOn(scheduler->lane(JobClass::Long));
+                request.userKey = Keys::generateKeyOfType(options.keyType);
+            }
+        } else {
+            request.userKey = Keys::generateKeyOfType(options.keyType);
+        }
+        request.pkcs12Password = "pw" + to_string(index);
+        latencies.add(StageKeygen, elapsedMs(stageStart));
+
+        stageStart = Clock::now();
+        request.req = Certificates::buildIssuerCSR(request.userKey.get(), LOADGEN_COUNTRY, LOADGEN_ORGANIZATION, "Synthetic User " + to_string(index));
+        latencies.add(StageCSR, elapsedMs(stageStart));
+
+        IssuanceResult result = co_await pipeline->issue(std::move(request));
+        latencies.add(StageValidate, result.validateMs);
+        latencies.add(StageSign, result.signMs + result.persistMs);
+        latencies.add(StagePKCS12, result.pkcs12Ms);
+        issuedSerials[index] = result.serial;
+
+        if (toRevoke[index]) {
+            co_await resumeOn(*ioExecutor);
+            stageStart = Clock::now();
+            {
+                lock_guard<mutex> lock(crlMutex);
+                crl.addRevokedCertificate(crlPath, result.cert.get(), caKey.get(), db, revocationReasonFor(index));
+            }
+            revocationIndex.add({issuedSerials[index]}, revocationReasonFor(index), time(nullptr));
+            latencies.add(StageRevoke, elapsedMs(stageStart));
+            ++revokedCount;
+        }
+
+        latencies.add(StageTotal, elapsedMs(scheduled));
+    };
+
+    if (options.async) {
+        vector<future<void>> pending;
+        pending.reserve(options.count);
+        for (size_t i = 0; i < options.count; ++i) {
+            auto scheduled = runStart;
+            if (options.rate > 0) {
+                scheduled += chrono::duration_cast<Clock::duration>(chrono::duration<double>(i / options.rate));
+                this_thread::sleep_until(scheduled);
+            }
+            pending.push_back(spawn(issueOneAsync(i, scheduled)));
+        }
+        for (size_t i = 0; i < options.count; ++i) {
+            try {
+                pending[i].get();
+            } catch (const IssuanceRejected& ex) {
+                ++rejected;
+                ++failed;
+                cerr << "user_" << i << ": " << ex.what() << "\n";
+            } catch (const std::exception& ex) {
+                ++failed;
+                cerr << "user_" << i << ": " << ex.what() << "\n";
+            }
+        }
+    } else {
+        ThreadPool pool(options.threads);
+        vector<future<void>> pending;
+        pending.reserve(options.count);
+        for (size_t i = 0; i < options.count; ++i) {
+            pending.push_back(pool.submit([&issueOne, i] { issueOne(i); }));
+        }
+        for (auto& task : pending) {
+            task.get();
+        }
+    }
+
+    double wallSeconds = chrono::duration<double>(Clock::now() - runStart).count();
+    AllocatorStats allocatorStats = OpenSSLAllocator::getStats();
+    size_t succeeded = options.count - failed;
+
+    // Снятие приостановки: индекс прогона обновляется удалением, индекс, построенный до снятия, - через refresh
+    RevocationIndex refreshedIndex;
+    refreshedIndex.rebuild(db);
+    vector<string> releaseCandidates;
+    for (size_t i = 0; i < options.count; i += 4) {
+        if (toRevoke[i] && !issuedSerials[i].empty()) {
+            releaseCandidates.push_back(issuedSerials[i]);
+        }
+    }
+    vector<string> released = releaseCandidates.empty() ? vector<string>() : db.selectSuspendedSerials(releaseCandidates);
+    if (!released.empty()) {
+        CRL::releaseSerials(crlPath, released, caKey.get(), db);
+        revocationIndex.remove(released);
+    }
+    refreshedIndex.refresh(db);
+
+    // Оба индекса сверяются с построенным заново из issuing_certs: статус и причина отзыва
+    RevocationIndex rebuiltIndex;
+    rebuiltIndex.rebuild(db);
+    size_t statusMismatches = 0;
+    for (size_t i = 0; i < options.count; ++i) {
+        if (issuedSerials[i].empty()) {
+            continue;
+        }
+        RevocationStatus expected = rebuiltIndex.lookup(issuedSerials[i]);
+        for (const RevocationIndex* index : {&revocationIndex, &refreshedIndex}) {
+            RevocationStatus actual = index->lookup(issuedSerials[i]);
+            if (actual.revoked != expected.revoked || (expected.revoked && actual.reasonCode != expected.reasonCode)) {
+                ++statusMismatches;
+            }
+        }
+    }
+
+    // Пропускная способность проверок статуса: все потоки читают индекс одновременно
+    double lookupSeconds = 0;
+    if (options.statusLookups > 0 && succeeded > 0) {
+        vector<string> probes;
+        for (const auto& serial : issuedSerials) {
+            if (!serial.empty()) {
+                probes.push_back(serial);
+            }
+        }
+
+        vector<RevocationIndex::SerialKey> keys(probes.size());
+        for (size_t i = 0; i < probes.size(); ++i) {
+            RevocationIndex::toSerialKey(probes[i], keys[i]);
+        }
+
+        atomic<size_t> hits{0};
+        auto lookupStart = Clock::now();
+        {
+            vector<thread> workers;
+            size_t perThread = options.statusLookups / options.threads + 1;
+            for (size_t t = 0; t < options.threads; ++t) {
+                workers.emplace_back([&, t] {
+                    size_t localHits = 0;
+                    for (size_t i = 0; i < perThread; ++i) {
+                        localHits += revocationIndex.lookup(keys[(i * 7919 + t) % keys.size()]).revoked;
+                    }
+                    hits += localHits;
+                });
+            }
+            for (auto& worker : workers) {
+                worker.join();
+            }
+        }
+        lookupSeconds = chrono::duration<double>(Clock::now() - lookupStart).count();
+    }
+
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    double userCpu = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6;
+    double sysCpu = usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+
+    uintmax_t scratchBytes = 0;
+    for (const auto& entry : filesystem::recursive_directory_iterator(scratch)) {
+        if (entry.is_regular_file()) {
+            scratchBytes += entry.file_size();
+        }
+    }
+
+    report << "\nУспешно: " << succeeded << ", отклонено: " << rejected << ", ошибок: " << failed
+           << ", отозвано: " << revokedCount << ", снято приостановок: " << released.size() << "\n";
+    report << fixed << setprecision(2)
+           << "Время: " << wallSeconds << " c, пропускная способность: " << succeeded / wallSeconds << " оп/с\n\n";
+    latencies.report(report);
+    report << "\nCPU user: " << userCpu << " c, sys: " << sysCpu << " c, загрузка: "
+           << (userCpu + sysCpu) / wallSeconds * 100 << "%\n"
+           << "Max RSS: " << usage.ru_maxrss / 1024.0 << " MiB, page faults minor/major: "
+           << usage.ru_minflt << "/" << usage.ru_majflt << "\n"
+           << "Context switches vol/invol: " << usage.ru_nvcsw << "/" << usage.ru_nivcsw
+           << ", block I/O in/out: " << usage.ru_inblock << "/" << usage.ru_oublock << "\n"
+           << "Scratch на диске: " << scratchBytes / (1024.0 * 1024.0) << " MiB\n";
+
+    report << "Индекс отзыва: " << revocationIndex.size() << " записей, расхождений с базой: " << statusMismatches;
+    if (lookupSeconds > 0) {
+        size_t lookups = (options.statusLookups / options.threads + 1) * options.threads;
+        report << ", проверок статуса: " << setprecision(0) << lookups / lookupSeconds << " в секунду";
+    }
+    report << "\n";
+
+    if (options.allocator != AllocatorMode::System) {
+        size_t runAllocations = allocatorStats.allocations - allocatorBefore.allocations;
+        report << "\nРаспределитель OpenSSL (" << OpenSSLAllocator::modeName(options.allocator) << "): выделений "
+               << runAllocations << ", на операцию " << setprecision(1) << (succeeded > 0 ? static_cast<double>(runAllocations) / succeeded : 0.0)
+               << ", realloc " << allocatorStats.reallocs - allocatorBefore.reallocs
+               << ", пик " << setprecision(2) << allocatorStats.peakBytes / (1024.0 * 1024.0) << " MiB";
+        if (options.allocator == AllocatorMode::Pool) {
+            report << ", из кэша потока " << setprecision(1) << 100.0 * (allocatorStats.poolHits - allocatorBefore.poolHits) / max<size_t>(1, runAllocations)
+                   << "%, пополнений " << allocatorStats.refills - allocatorBefore.refills << ", крупных " << allocatorStats.largeAllocations - allocatorBefore.largeAllocations
+                   << ", слэбы " << setprecision(2) << allocatorStats.slabBytes / (1024.0 * 1024.0) << " MiB";
+        }
+        report << "\n";
+        // В асинхронном режиме этапы переходят между потоками, и счетчики потока к ним неприменимы
+        if (!options.async) {
+            stageAllocations.report(report);
+        }
+    }
+
+    if (scheduler) {
+        JobSchedulerStats stats = scheduler->getStats();
+        report << "Планировщик: коротких задач " << stats.executed[static_cast<int>(JobClass::Short)]
+               << ", обычных " << stats.executed[static_cast<int>(JobClass::Normal)]
+               << ", длинных " << stats.executed[static_cast<int>(JobClass::Long)] << ", украдено " << stats.stolen
+               << "; пул ключей: из запаса " << keyPool->getHits() << ", сгенерировано на месте " << keyPool->getMisses() << "\n";
+    }
+
+    db.close();
+
+    if (!options.keep) {
+        filesystem::current_path("/");
+        filesystem::remove_all(scratch);
+    }
+
+    return failed == 0 && statusMismatches == 0 ? 0 : 1;
+}
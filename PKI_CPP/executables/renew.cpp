@@ -0,0 +1,104 @@
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "../db/database.h"
+#include "../paths.hpp"
+#include "../utils/Certificates.hpp"
+#include "../utils/Keys.hpp"
+#include "../utils/Renewal.hpp"
+#include "../utils/RevocationSnapshot.hpp"
+
+using namespace std;
+
+// Продление истекающих сертификатов без интерактивного меню, например из cron:
+// pki_renew --days 30 --validity 365 --revoke-superseded
+int main(int argc, char* argv[]) {
+    string dbPath = DB_PATH;
+    string dbPassword = "1234";
+    string keyPath;
+    string certPath = (filesystem::path(ROOT_CERTS_PATH) / ADMIN_CERT_NAME).string();
+    string certsDir = ISSUER_CERTS_PATH;
+    string crlPath = (filesystem::path(CRL_PATH) / DEFAULT_CRL_NAME).string();
+    RenewalOptions options;
+
+    // Парсинг аргументов
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--days" && i + 1 < argc) {
+            options.withinDays = std::max(0, std::stoi(argv[++i]));
+        } else if (arg == "--validity" && i + 1 < argc) {
+            options.validityDays = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--limit" && i + 1 < argc) {
+            options.limit = std::max(0, std::stoi(argv[++i]));
+        } else if (arg == "--threads" && i + 1 < argc) {
+            options.threads = std::max(1, std::stoi(argv[++i]));
+        } else if (arg == "--revoke-superseded") {
+            options.revokePredecessors = true;
+        } else if (arg == "--dry-run") {
+            options.dryRun = true;
+        } else if (arg == "--db" && i + 1 < argc) {
+            dbPath = argv[++i];
+        } else if (arg == "--db-password" && i + 1 < argc) {
+            dbPassword = argv[++i];
+        } else if (arg == "--key" && i + 1 < argc) {
+            keyPath = argv[++i];
+        } else if (arg == "--cert" && i + 1 < argc) {
+            certPath = argv[++i];
+        } else if (arg == "--certs-dir" && i + 1 < argc) {
+            certsDir = argv[++i];
+        } else if (arg == "--crl" && i + 1 < argc) {
+            crlPath = argv[++i];
+        } else if (arg == "--help") {
+            cout << "Usage: " << argv[0] << " [--days N] [--validity days] [--limit N] [--threads N] [--revoke-superseded] [--dry-run]"
+                 << " [--db <file>] [--db-password <pwd>] [--key <file>] [--cert <file>] [--certs-dir <dir>] [--crl <file>]\n";
+            return 0;
+        } else {
+            cerr << "Неизвестный аргумент: " << arg << endl;
+            return 1;
+        }
+    }
+
+    try {
+        Keys keys;
+        if (keyPath.empty()) {
+            keyPath = (filesystem::path(ROOT_PRIVATE_KEY_PATH) / keys.getRootPkeyName()).string();
+        }
+        EvpPkeyPtr caKey = keys.readExistingKeyFromPath(keyPath);
+        X509Ptr caCert = Certificates().readExistingX509FromPath(certPath);
+        if (!caKey || !caCert) {
+            cerr << "Не удалось прочитать ключ " << keyPath << " или сертификат " << certPath << ".\n";
+            return 1;
+        }
+
+        Database db(dbPath, dbPassword);
+        RenewalEngine engine(db, caCert.get(), caKey.get(), certsDir, crlPath);
+        RenewalReport report = engine.run(options);
+
+        for (const auto& result : report.results) {
+            cout << result.oldSerial << "  " << result.oldCertName;
+            if (options.dryRun) {
+                cout << "  истекает " << result.certDataTo << "\n";
+            } else if (result.serial.empty()) {
+                cout << "  ошибка: " << result.error << "\n";
+            } else {
+                cout << "  -> " << result.serial << "  " << result.certName << "  до " << result.certDataTo << "\n";
+            }
+        }
+        cout << "Кандидатов: " << report.selected << ", продлено: " << report.renewed << ", ошибок: " << report.failed;
+        if (options.revokePredecessors) {
+            cout << ", отозвано как Superseded: " << report.revoked;
+        }
+        cout << "\n";
+
+        if (report.revoked > 0) {
+            cout << "Опубликован снимок отзыва, версия " << RevocationSnapshot::publish(db) << "\n";
+        }
+        return report.failed == 0 ? 0 : 2;
+    } catch (const std::exception& ex) {
+        cerr << "Ошибка продления: " << ex.what() << endl;
+        return 1;
+    }
+}
@@ -0,0 +1,199 @@
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../paths.hpp"
+#include "../utils/IssuerShards.hpp"
+#include "../utils/RevocationSnapshot.hpp"
+
+using namespace std;
+
+// Добавляет путь к списку CSR: файл как есть, директорию — все .pem и .der файлы из нее
+// (.der пропускается, если рядом лежит тот же запрос в PEM)
+static void collectCsrPaths(const string& path, vector<string>& csrPaths) {
+    if (filesystem::is_directory(path)) {
+        for (const auto& entry : filesystem::directory_iterator(path)) {
+            filesystem::path file = entry.path();
+            if (!entry.is_regular_file()) {
+                continue;
+            }
+            if (file.extension() == ".pem" ||
+                (file.extension() == ".der" && !filesystem::exists(filesystem::path(file).replace_extension(".pem")))) {
+                csrPaths.push_back(file.string());
+            }
+        }
+    } else {
+        csrPaths.push_back(path);
+    }
+}
+
+static string csrOrganization(X509_REQ* req) {
+    return Database::subjectFromName(X509_REQ_get_subject_name(req)).organization;
+}
+
+// Выпуск по CSR: запросы группируются по шардам, каждый шард обслуживается своим потоком
+static int issueAll(ShardRouter& router, const vector<string>& csrPaths) {
+    map<IssuerShard*, vector<pair<string, X509ReqPtr>>> batches;
+    size_t failed = 0;
+    for (const auto& path : csrPaths) {
+        X509ReqPtr req = ObjectLoader::loadX509Req(path);
+        if (!req) {
+            cerr << path << ": не удалось прочитать CSR" << endl;
+            ++failed;
+            continue;
+        }
+        IssuerShard& shard = router.route(csrOrganization(req.get()));
+        batches[&shard].emplace_back(path, std::move(req));
+    }
+
+    auto started = chrono::steady_clock::now();
+    vector<thread> workers;
+    vector<size_t> issued(batches.size(), 0);
+    vector<size_t> errors(batches.size(), 0);
+    size_t index = 0;
+    for (auto& [shard, batch] : batches) {
+        workers.emplace_back([shard, &batch, &issued, &errors, index] {
+            for (auto& [path, req] : batch) {
+                string certFilename = filesystem::path(path).stem().string() + ".cert.pem";
+                try {
+                    shard->issue(req.get(), certFilename);
+                    ++issued[index];
+                } catch (const std::runtime_error& ex) {
+                    cerr << path << ": " << ex.what() << endl;
+                    ++errors[index];
+                }
+            }
+        });
+        ++index;
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+
+    size_t total = 0;
+    index = 0;
+    for (const auto& [shard, batch] : batches) {
+        cout << shard->getConfig().name << ": выпущено " << issued[index] << ", ошибок " << errors[index] << "\n";
+        total += issued[index];
+        failed += errors[index];
+        ++index;
+    }
+    cout << "Всего выпущено " << total << " за " << seconds << " с";
+    if (seconds > 0) {
+        cout << " (" << static_cast<size_t>(total / seconds) << " серт./с)";
+    }
+    cout << endl;
+    return failed ? 1 : 0;
+}
+
+static int initializeShards(ShardRouter& router, const string& keyType) {
+    string rootKeyPath;
+    for (const auto& entry : filesystem::directory_iterator(ROOT_PRIVATE_KEY_PATH)) {
+        if (entry.is_regular_file()) {
+            rootKeyPath = entry.path().string();
+        }
+    }
+    EvpPkeyPtr rootKey = ObjectLoader::loadPrivateKey(rootKeyPath);
+    string rootCertPath = (filesystem::path(ROOT_CERTS_PATH) / ADMIN_CERT_NAME).string();
+    X509Ptr rootCert = ObjectLoader::loadX509(rootCertPath);
+    if (!rootKey || !rootCert) {
+        cerr << "Не удалось прочитать ключ или сертификат КУЦ." << endl;
+        return 1;
+    }
+
+    for (size_t i = 0; i < router.size(); ++i) {
+        IssuerShard& shard = router.at(i);
+        bool existed = shard.isInitialized();
+        shard.initialize(rootCert.get(), rootKey.get(), keyType);
+        cout << shard.getConfig().name << ": " << (existed ? "уже инициализирован" : "создан") << " ("
+             << shard.getConfig().certPath << ")\n";
+    }
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+    string configPath = SHARDS_CONFIG;
+    string command;
+    string keyType = "ec-p256";
+    string shardName;
+    int reasonCode = 0;
+    vector<string> arguments;
+
+    // Парсинг аргументов
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--config" && i + 1 < argc) {
+            configPath = argv[++i];
+        } else if (arg == "--key-type" && i + 1 < argc) {
+            keyType = argv[++i];
+        } else if (arg == "--reason" && i + 1 < argc) {
+            reasonCode = std::stoi(argv[++i]);
+        } else if (arg == "--revoke" && i + 1 < argc) {
+            command = "revoke";
+            shardName = argv[++i];
+        } else if (arg == "--list" || arg == "--init" || arg == "--route" || arg == "--issue") {
+            command = arg.substr(2);
+        } else if (arg == "--help") {
+            cout << "Usage: " << argv[0] << " [--config <file>] --list | --init [--key-type <type>] | --route <org> ... |"
+                 << " --issue <csr|dir> ... | --revoke <shard> [--reason N] <serial> ...\n";
+            return 0;
+        } else {
+            arguments.push_back(arg);
+        }
+    }
+
+    try {
+        ShardRouter router(ShardRouter::loadConfig(configPath));
+
+        if (command == "init") {
+            return initializeShards(router, keyType);
+        }
+        if (command == "route") {
+            for (const auto& organization : arguments) {
+                cout << organization << " -> " << router.route(organization).getConfig().name << "\n";
+            }
+            return 0;
+        }
+        if (command == "issue") {
+            vector<string> csrPaths;
+            for (const auto& path : arguments) {
+                collectCsrPaths(path, csrPaths);
+            }
+            return issueAll(router, csrPaths);
+        }
+        if (command == "revoke") {
+            IssuerShard* shard = router.find(shardName);
+            if (!shard) {
+                cerr << "Шард " << shardName << " не найден." << endl;
+                return 1;
+            }
+            size_t added = shard->revoke(arguments, reasonCode);
+            cout << shardName << ": отозвано " << added << " сертификатов" << endl;
+            // Снимок общий для всех издателей: /status видит отзыв сразу, не дожидаясь публикации из меню
+            Database db(DB_PATH, "1234");
+            cout << "Опубликован снимок отзыва, версия " << RevocationSnapshot::publish(db) << endl;
+            return 0;
+        }
+
+        for (size_t i = 0; i < router.size(); ++i) {
+            const IssuerShardConfig& config = router.at(i).getConfig();
+            cout << config.name << (router.at(i).isInitialized() ? "" : " (не инициализирован)") << "\n"
+                 << "  ключ: " << config.keyPath << "\n  сертификат УЦ: " << config.certPath
+                 << "\n  сертификаты: " << config.certsDir << "\n  CRL: " << config.crlPath
+                 << "\n  база: " << config.dbPath << "\n";
+            for (const auto& organization : config.organizations) {
+                cout << "  организация: " << organization << "\n";
+            }
+        }
+    } catch (const std::exception& ex) {
+        cerr << ex.what() << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,185 @@
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "../utils/Handles.hpp"
+#include "../utils/Keys.hpp"
+#include "../utils/Certificates.hpp"
+#include "../utils/CRL.hpp"
+#include "../utils/CSRValidator.hpp"
+#include "../utils/OpenSSLAllocator.hpp"
+
+using namespace std;
+
+// Резидентная память процесса в КиБ
+static long residentKb() {
+    ifstream statm("/proc/self/statm");
+    long sizePages = 0, residentPages = 0;
+    statm >> sizePages >> residentPages;
+    return residentPages * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+// Самоподписанный сертификат УЦ в памяти
+static X509Ptr buildSoakRoot(EVP_PKEY* caKey) {
+    X509Ptr cert(X509_new());
+    ASN1_INTEGER_set(X509_get_serialNumber(cert.get()), 1);
+    X509_gmtime_adj(X509_get_notBefore(cert.get()), 0);
+    X509_gmtime_adj(X509_get_notAfter(cert.get()), 60L * 60 * 24 * 365);
+
+    X509_NAME* name = X509_get_subject_name(cert.get());
+    X509_NAME_add_entry_by_txt(name, "C", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("RU"), -1, -1, 0);
+    X509_NAME_add_entry_by_txt(name, "O", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("Soak Org"), -1, -1, 0);
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC, reinterpret_cast<const unsigned char*>("Soak Root CA"), -1, -1, 0);
+    X509_set_issuer_name(cert.get(), name);
+    X509_set_pubkey(cert.get(), caKey);
+
+    if (X509_sign(cert.get(), caKey, digestForKey(caKey)) <= 0) {
+        throw runtime_error("buildSoakRoot: не удалось подписать сертификат УЦ.");
+    }
+    return cert;
+}
+
+int main(int argc, char* argv[]) {
+    size_t iterations = 1000000;
+    string keyType = "ec-p256";
+    string caKeyType = "ec-p256";
+    size_t crlBatch = 1000;
+    size_t p12Every = 1000;
+    bool freshKeys = false;
+    long maxGrowthKb = 2048;
+    AllocatorMode allocator = AllocatorMode::System;
+
+    // Парсинг аргументов
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--iterations" && i + 1 < argc) {
+            iterations = std::stoul(argv[++i]);
+        } else if (arg == "--key-type" && i + 1 < argc) {
+            keyType = argv[++i];
+        } else if (arg == "--ca-key-type" && i + 1 < argc) {
+            caKeyType = argv[++i];
+        } else if (arg == "--crl-batch" && i + 1 < argc) {
+            crlBatch = std::max<size_t>(1, std::stoul(argv[++i]));
+        } else if (arg == "--p12-every" && i + 1 < argc) {
+            p12Every = std::stoul(argv[++i]);
+        } else if (arg == "--fresh-keys") {
+            freshKeys = true;
+        } else if (arg == "--max-growth-kb" && i + 1 < argc) {
+            maxGrowthKb = std::stol(argv[++i]);
+        } else if (arg == "--openssl-alloc" && i + 1 < argc && OpenSSLAllocator::parseMode(argv[i + 1], allocator)) {
+            ++i;
+        } else {
+            cerr << "Usage: " << argv[0] << " [--iterations N] [--key-type T] [--ca-key-type T] [--crl-batch N]\n"
+                 << "       [--p12-every N] [--fresh-keys] [--max-growth-kb KB] [--openssl-alloc system|count|pool]\n";
+            return 1;
+        }
+    }
+
+    // До первого обращения к OpenSSL, иначе распределитель уже не заменить
+    if (!OpenSSLAllocator::install(allocator)) {
+        cerr << "Не удалось установить распределитель OpenSSL " << OpenSSLAllocator::modeName(allocator) << ".\n";
+        return 1;
+    }
+
+    EvpPkeyPtr caKey = Keys::generateKeyOfType(caKeyType);
+    X509Ptr rootCert = buildSoakRoot(caKey.get());
+    EvpPkeyPtr sharedUserKey = Keys::generateKeyOfType(keyType);
+
+    unique_ptr<CSRValidator> validator;
+    try {
+        validator = make_unique<CSRValidator>(rootCert.get());
+    } catch (const std::runtime_error& ex) {
+        cerr << "Проверка CSR пропускается: " << ex.what() << "\n";
+    }
+
+    // Замеры RSS: после прогрева и далее равномерно по ходу прогона
+    const size_t samples = 20;
+    const size_t sampleStep = std::max<size_t>(1, iterations / samples);
+    long baselineKb = -1;
+    long lastKb = 0;
+
+    X509CrlPtr crl(X509_CRL_new());
+    AllocatorStats allocatorBefore = OpenSSLAllocator::getStats();
+    auto start = chrono::steady_clock::now();
+
+    cout << setw(12) << "iteration" << setw(12) << "rss,KiB" << "\n";
+
+    for (size_t i = 1; i <= iterations; ++i) {
+        EvpPkeyPtr freshKey = freshKeys ? Keys::generateKeyOfType(keyType) : nullptr;
+        EVP_PKEY* userKey = freshKeys ? freshKey.get() : sharedUserKey.get();
+
+        X509ReqPtr req = Certificates::buildIssuerCSR(userKey, "RU", "Soak Org", "user " + to_string(i));
+        if (validator && !validator->validate(req.get()).valid) {
+            cerr << "Итерация " << i << ": запрос отклонен\n";
+            return 1;
+        }
+
+        X509Ptr cert = Certificates::buildIssuerCert(req.get(), rootCert.get(), caKey.get());
+        IssuedCertInfo info = Certificates::describeCertificate(cert.get());
+
+        // Кодирование сертификата в PEM, как при записи в файл
+        BioPtr pem(BIO_new(BIO_s_mem()));
+        PEM_write_bio_X509(pem.get(), cert.get());
+
+        X509RevokedPtr revoked = CRL::buildRevokedEntry(info.serial, KeyCompromise, time(nullptr));
+        X509_CRL_add0_revoked(crl.get(), revoked.release());
+
+        // CRL подписывается пакетами и пересоздается, чтобы его рост не маскировал утечки
+        if (i % crlBatch == 0) {
+            X509_CRL_set_issuer_name(crl.get(), X509_get_subject_name(rootCert.get()));
+            Asn1TimePtr now(ASN1_TIME_set(nullptr, time(nullptr)));
+            X509_CRL_set1_lastUpdate(crl.get(), now.get());
+            X509_CRL_sign(crl.get(), caKey.get(), digestForKey(caKey.get()));
+            BioPtr der(BIO_new(BIO_s_mem()));
+            i2d_X509_CRL_bio(der.get(), crl.get());
+            crl.reset(X509_CRL_new());
+        }
+
+        if (p12Every > 0 && i % p12Every == 0) {
+            Pkcs12Ptr p12(PKCS12_create("soak", "User Certificate", userKey, cert.get(), 0, 0, 0, 0, 0, 0));
+        }
+
+        if (i % sampleStep == 0 || i == iterations) {
+            lastKb = residentKb();
+            // первая точка считается прогревом: пулы аллокатора и OpenSSL уже заполнены
+            if (baselineKb < 0) {
+                baselineKb = lastKb;
+            }
+            cout << setw(12) << i << setw(12) << lastKb << "\n" << flush;
+        }
+    }
+
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    long growthKb = lastKb - baselineKb;
+
+    cout << "\nИтераций: " << iterations << ", время: " << fixed << setprecision(1) << seconds << " c ("
+         << setprecision(0) << iterations / seconds << " оп/с)\n"
+         << "RSS после прогрева: " << baselineKb << " KiB, в конце: " << lastKb << " KiB, прирост: " << growthKb << " KiB\n";
+
+    if (allocator != AllocatorMode::System) {
+        AllocatorStats stats = OpenSSLAllocator::getStats();
+        size_t allocations = stats.allocations - allocatorBefore.allocations;
+        cout << "Распределитель OpenSSL (" << OpenSSLAllocator::modeName(allocator) << "): выделений на итерацию "
+             << setprecision(1) << static_cast<double>(allocations) / iterations
+             << ", занято " << stats.bytesInUse / 1024 << " KiB, пик " << stats.peakBytes / 1024 << " KiB";
+        if (allocator == AllocatorMode::Pool) {
+            cout << ", из кэша потока " << 100.0 * (stats.poolHits - allocatorBefore.poolHits) / std::max<size_t>(1, allocations)
+                 << "%, слэбы " << stats.slabBytes / 1024 << " KiB";
+        }
+        cout << "\n";
+    }
+
+    if (growthKb > maxGrowthKb) {
+        cout << "FAIL: прирост RSS превышает " << maxGrowthKb << " KiB\n";
+        return 1;
+    }
+
+    cout << "OK: RSS стабилен\n";
+    return 0;
+}
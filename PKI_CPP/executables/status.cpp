@@ -0,0 +1,84 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../paths.hpp"
+#include "../db/database.h"
+#include "../utils/RevocationSnapshot.hpp"
+
+using namespace std;
+
+static void printStatus(RevocationSnapshot& snapshot, const string& serial) {
+    RevocationStatus status = snapshot.lookup(serial);
+    if (!status.issued) {
+        cout << serial << ": unknown\n";
+    } else if (status.revoked) {
+        cout << serial << ": revoked (reason " << status.reasonCode << ", at " << status.revokedAt << ")\n";
+    } else {
+        cout << serial << ": good\n";
+    }
+}
+
+int main(int argc, char* argv[]) {
+    string snapshotPath = REVOCATION_SNAPSHOT_PATH;
+    bool publish = false;
+    bool serviceMode = false;
+    vector<string> serials;
+
+    // Парсинг аргументов
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--snapshot" && i + 1 < argc) {
+            snapshotPath = argv[++i];
+        } else if (arg == "--publish") {
+            publish = true;
+        } else if (arg == "--stdin") {
+            serviceMode = true;
+        } else if (arg == "--help") {
+            cout << "Usage: " << argv[0] << " [--snapshot <file>] [--publish] [--stdin] [serial ...]\n";
+            return 0;
+        } else {
+            serials.push_back(arg);
+        }
+    }
+
+    // Публикация снимка из issuing_certs
+    if (publish) {
+        try {
+            Database db(DB_PATH, "1234");
+            uint64_t generation = RevocationSnapshot::publish(db, snapshotPath);
+            cout << "Опубликован снимок отзыва " << snapshotPath << ", версия " << generation << "\n";
+        } catch (const std::runtime_error& ex) {
+            cerr << ex.what() << "\n";
+            return 1;
+        }
+    }
+
+    if (serials.empty() && !serviceMode) {
+        return 0;
+    }
+
+    try {
+        RevocationSnapshot snapshot(snapshotPath);
+
+        for (const auto& serial : serials) {
+            printStatus(snapshot, serial);
+        }
+
+        // Режим сервиса: серийные номера построчно из stdin, снимок подхватывается при замене
+        if (serviceMode) {
+            string serial;
+            while (getline(cin, serial)) {
+                if (!serial.empty()) {
+                    printStatus(snapshot, serial);
+                    cout.flush();
+                }
+            }
+        }
+    } catch (const std::runtime_error& ex) {
+        cerr << ex.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
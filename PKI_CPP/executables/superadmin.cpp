@@ -7,6 +7,7 @@
 #include "../utils/Keys.hpp"
 #include "../utils/Certificates.hpp"
 #include "../utils/CRL.hpp"
+#include "../utils/RevocationSnapshot.hpp"
 
 using namespace std;
 
@@ -16,7 +17,7 @@ int main(int argc, char* argv[]) {
         return 1;
     }
 
-    int key_length;
+    int key_length = 0;
     string root_key_name;
     string issuer_key_name;
     string root_cert_name;
@@ -53,19 +54,27 @@ int main(int argc, char* argv[]) {
 
     //инициализация бд
     unique_ptr<Database> db = make_unique<Database>(DB_PATH, db_password);
+    db.get()->enableWal();
 
     unique_ptr<Keys> keys = make_unique<Keys>();
     unique_ptr<Certificates> certs = make_unique<Certificates>();
 
     // //генерация приватных ключей для КУЦ и УЦ
-    EVP_PKEY* pkey = keys.get()->generateKey(ROOT_PRIVATE_KEY_PATH, root_key_name);
+    EvpPkeyPtr pkey = keys.get()->generateKey(ROOT_PRIVATE_KEY_PATH, root_key_name);
     keys.get()->generateKey(ISSUER_PRIVATE_KEY_PATH, issuer_key_name);
 
     // //генерация самоподписанного сертификата
-    X509* root_cert = certs.get()->generateCertificate(*db, pkey, ROOT_CERTS_PATH, root_cert_name);
+    X509Ptr root_cert = certs.get()->generateCertificate(*db, pkey.get(), ROOT_CERTS_PATH, root_cert_name);
 
     // //инициализация crl файла и структуры
-    unique_ptr<CRL> crl = make_unique<CRL>((filesystem::path(CRL_PATH) / crl_name).string(), pkey, root_cert);
+    unique_ptr<CRL> crl = make_unique<CRL>((filesystem::path(CRL_PATH) / crl_name).string(), pkey.get(), root_cert.get());
+
+    // //снимок статусов отзыва для локальных процессов
+    try {
+        RevocationSnapshot::publish(*db);
+    } catch (const std::runtime_error& ex) {
+        cerr << ex.what() << endl;
+    }
 
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,117 @@
+#include <iostream>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "../paths.hpp"
+#include "../utils/ChainVerifier.hpp"
+
+using namespace std;
+
+// Добавляет путь к списку проверяемых: файл как есть, директорию — все файлы из нее
+static void collectCertPaths(const string& path, vector<string>& certPaths) {
+    if (filesystem::is_directory(path)) {
+        for (const auto& entry : filesystem::directory_iterator(path)) {
+            if (entry.is_regular_file()) {
+                certPaths.push_back(entry.path().string());
+            }
+        }
+    } else {
+        certPaths.push_back(path);
+    }
+}
+
+static size_t printResults(const vector<VerificationResult>& results) {
+    size_t failed = 0;
+    for (const auto& result : results) {
+        if (result.valid && !result.crlChecked) {
+            cout << result.certPath << ": OK (CRL не опубликован, отзыв не проверен)\n";
+        } else if (result.valid) {
+            cout << result.certPath << ": OK\n";
+        } else {
+            cout << result.certPath << ": FAIL (" << result.errorCode << " " << result.error << ")\n";
+            ++failed;
+        }
+    }
+    cout.flush();
+    return failed;
+}
+
+int main(int argc, char* argv[]) {
+    string caCertPath = string(ROOT_CERTS_PATH) + "/" + ADMIN_CERT_NAME;
+    string crlDir = CRL_PATH;
+    size_t threads = thread::hardware_concurrency();
+    size_t batchSize = 256;
+    bool serviceMode = false;
+    vector<string> inputs;
+
+    // Парсинг аргументов
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--ca" && i + 1 < argc) {
+            caCertPath = argv[++i];
+        } else if (arg == "--crl-dir" && i + 1 < argc) {
+            crlDir = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            threads = std::stoul(argv[++i]);
+        } else if (arg == "--batch" && i + 1 < argc) {
+            batchSize = std::max<size_t>(1, std::stoul(argv[++i]));
+        } else if (arg == "--stdin") {
+            serviceMode = true;
+        } else if (arg == "--help") {
+            cout << "Usage: " << argv[0] << " [--ca <root cert>] [--crl-dir <dir>] [--threads N] [--batch N] [--stdin] [cert|dir ...]\n";
+            return 0;
+        } else {
+            inputs.push_back(arg);
+        }
+    }
+
+    unique_ptr<ChainVerifier> verifier;
+    try {
+        verifier = make_unique<ChainVerifier>(caCertPath, crlDir);
+    } catch (const std::exception& ex) {
+        cerr << ex.what() << endl;
+        return 2;
+    }
+
+    cerr << "Хранилище доверия загружено, CRL: " << verifier->crlCount() << "\n";
+
+    size_t failed = 0;
+
+    // Сервисный режим: пути читаются из stdin, пустая строка или заполненный пакет запускают проверку.
+    // Хранилище перестраивается перед пакетом только если сертификат УЦ или CRL изменились.
+    if (serviceMode) {
+        vector<string> batch;
+        string line;
+        while (getline(cin, line)) {
+            if (!line.empty()) {
+                batch.push_back(line);
+            }
+            if ((line.empty() && !batch.empty()) || batch.size() >= batchSize) {
+                failed += printResults(verifier->verifyBatch(batch, threads));
+                batch.clear();
+            }
+        }
+        if (!batch.empty()) {
+            failed += printResults(verifier->verifyBatch(batch, threads));
+        }
+        return failed == 0 ? 0 : 1;
+    }
+
+    if (inputs.empty()) {
+        inputs.push_back(ISSUER_CERTS_PATH);
+    }
+
+    vector<string> certPaths;
+    for (const auto& input : inputs) {
+        collectCertPaths(input, certPaths);
+    }
+
+    for (size_t offset = 0; offset < certPaths.size(); offset += batchSize) {
+        vector<string> batch(certPaths.begin() + offset, certPaths.begin() + min(certPaths.size(), offset + batchSize));
+        failed += printResults(verifier->verifyBatch(batch, threads));
+    }
+
+    cerr << "Проверено: " << certPaths.size() << ", не прошли проверку: " << failed << "\n";
+    return failed == 0 ? 0 : 1;
+}
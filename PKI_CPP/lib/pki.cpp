@@ -0,0 +1,249 @@
+#include "./pki.h"
+
+#include <filesystem>
+#include <mutex>
+
+#include <openssl/pem.h>
+
+#include "../db/database.h"
+#include "../paths.hpp"
+#include "../utils/AdmissionQueue.hpp"
+#include "../utils/CRL.hpp"
+#include "../utils/CSRValidator.hpp"
+#include "../utils/Certificates.hpp"
+#include "../utils/Keys.hpp"
+#include "../utils/ObjectLoader.hpp"
+#include "../utils/OutputFormat.hpp"
+#include "../utils/PemCodec.hpp"
+#include "../utils/RevocationSnapshot.hpp"
+
+using namespace std;
+
+namespace pki {
+
+struct Authority::Impl {
+    AuthorityConfig config;
+    mutex storeMutex;           // база и CRL изменяются последовательно
+    unique_ptr<Database> db;
+    EvpPkeyPtr key;
+    X509Ptr caCert;
+    unique_ptr<CSRValidator> validator;
+    unique_ptr<AdmissionQueue> admission;   // объявлена последней: при разрушении сначала дорабатывает запросы
+
+    IssuedCertificate issueNow(const string& csrPem, const string& certName);
+};
+
+
+// Запрос ставится в очередь своего класса; вызывающий поток ждет результата
+template <typename F>
+static auto runAdmitted(AdmissionQueue& admission, RequestClass requestClass, F&& task) {
+    try {
+        return admission.submit(requestClass, std::forward<F>(task)).get();
+    } catch (const AdmissionRejected& ex) {
+        throw Overloaded(ex.what());
+    }
+}
+
+
+static string readFileToString(const string& path) {
+    BioPtr bio(BIO_new_file(path.c_str(), "rb"));
+    if (!bio) {
+        throw runtime_error("Не удалось открыть файл " + path + ".");
+    }
+    string content;
+    char buffer[4096];
+    int length;
+    while ((length = BIO_read(bio.get(), buffer, sizeof(buffer))) > 0) {
+        content.append(buffer, length);
+    }
+    return content;
+}
+
+
+Authority::Authority(const AuthorityConfig& config) : impl(make_unique<Impl>()) {
+    impl->config = config;
+    AuthorityConfig& paths = impl->config;
+    Keys keys;
+    if (paths.keyPath.empty()) paths.keyPath = (filesystem::path(ROOT_PRIVATE_KEY_PATH) / keys.getRootPkeyName()).string();
+    if (paths.certPath.empty()) paths.certPath = (filesystem::path(ROOT_CERTS_PATH) / ADMIN_CERT_NAME).string();
+    if (paths.certsDir.empty()) paths.certsDir = ISSUER_CERTS_PATH;
+    if (paths.crlPath.empty()) paths.crlPath = (filesystem::path(CRL_PATH) / DEFAULT_CRL_NAME).string();
+    if (paths.dbPath.empty()) paths.dbPath = DB_PATH;
+
+    Certificates certificates;
+    impl->key = keys.readExistingKeyFromPath(paths.keyPath);
+    impl->caCert = certificates.readExistingX509FromPath(paths.certPath);
+    if (!impl->key || !impl->caCert) {
+        throw runtime_error("Authority: не удалось прочитать ключ " + paths.keyPath + " или сертификат " + paths.certPath + ".");
+    }
+    impl->validator = make_unique<CSRValidator>(impl->caCert.get());
+    impl->db = make_unique<Database>(paths.dbPath, paths.dbPassword);
+    impl->db->enableWal();
+
+    size_t workers = paths.workers ? paths.workers : max(1u, thread::hardware_concurrency());
+    impl->admission = make_unique<AdmissionQueue>(workers, AdmissionPolicy::forThreads(workers, paths.maxQueuedIssuance));
+}
+
+
+Authority::~Authority() = default;
+
+
+IssuedCertificate Authority::issue(const string& csrPem, const string& certName) {
+    return runAdmitted(*impl->admission, RequestClass::Issuance, [&] { return impl->issueNow(csrPem, certName); });
+}
+
+
+IssuedCertificate Authority::Impl::issueNow(const string& csrPem, const string& certName) {
+    if (certName.empty() || certName.find('/') != string::npos || certName.starts_with(".")) {
+        throw runtime_error("issue: недопустимое имя сертификата " + certName + ".");
+    }
+
+    // CSR принимается и в PEM, и в DER; PEM разбирается PemCodec, а необычный PEM - OpenSSL
+    X509ReqPtr req;
+    const unsigned char* csrData = reinterpret_cast<const unsigned char*>(csrPem.data());
+    string csrDer;
+    if (ObjectLoader::detectEncoding(csrData, csrPem.size()) == ObjectEncoding::DER) {
+        req.reset(d2i_X509_REQ(nullptr, &csrData, static_cast<long>(csrPem.size())));
+    } else if (PemCodec::decode(csrPem, PEM_STRING_X509_REQ, csrDer)) {
+        const unsigned char* cursor = reinterpret_cast<const unsigned char*>(csrDer.data());
+        req.reset(d2i_X509_REQ(nullptr, &cursor, static_cast<long>(csrDer.size())));
+    } else {
+        BioPtr csrBio(BIO_new_mem_buf(csrPem.data(), static_cast<int>(csrPem.size())));
+        req.reset(csrBio ? PEM_read_bio_X509_REQ(csrBio.get(), nullptr, nullptr, nullptr) : nullptr);
+    }
+    if (!req) {
+        throw runtime_error("issue: не удалось разобрать CSR.");
+    }
+
+    CSRValidationResult validation = validator->validate(req.get());
+    if (!validation.valid) {
+        throw runtime_error("issue: запрос отклонен: " + validation.reason);
+    }
+
+    // Подпись не трогает общих данных и выполняется вне блокировки
+    X509Ptr cert = Certificates::buildIssuerCert(req.get(), caCert.get(), key.get());
+    IssuedCertInfo certInfo = Certificates::describeCertificate(cert.get());
+
+    // Файл пишется в формате из конфигурации; в ответе сертификат всегда в PEM
+    string certPath = (filesystem::path(config.certsDir) / certName).string();
+    OutputFormat certFormat = OutputFormats::current().certs;
+    vector<pair<string, string>> encoded = Artifacts::encodeX509(cert.get(), certPath, certFormat);
+    string pem = OutputFormats::writesPem(certFormat) ? encoded.front().second : PemCodec::encode(encoded.front().second, PEM_STRING_X509);
+
+    IssuedCertificate result{certName, certInfo.serial, certInfo.info, certInfo.notBefore, certInfo.notAfter, std::move(pem)};
+
+    lock_guard<mutex> lock(storeMutex);
+    if (Artifacts::exists(certPath)) {
+        throw runtime_error("issue: сертификат " + certPath + " уже существует.");
+    }
+    try {
+        Artifacts::write(encoded, certPath, certFormat);
+    } catch (const std::runtime_error&) {
+        throw runtime_error("issue: не удалось сохранить сертификат " + certPath + ".");
+    }
+
+    try {
+        db->addIssuerCert(certName, certInfo.serial, certInfo.notBefore, certInfo.notAfter, certInfo.info, certInfo.subject, certInfo.keyHash);
+    } catch (const std::runtime_error&) {
+        for (const auto& file : encoded) {
+            filesystem::remove(file.first);
+        }
+        throw;
+    }
+    return result;
+}
+
+
+size_t Authority::revoke(const vector<string>& serials, int reasonCode) {
+    return runAdmitted(*impl->admission, RequestClass::Revocation, [&] {
+        lock_guard<mutex> lock(impl->storeMutex);
+        size_t added = CRL::revokeSerials(impl->config.crlPath, serials, impl->key.get(), *impl->db, reasonCode);
+
+        // Снимок для /status публикуется из базы основного УЦ (вместе с шардами); УЦ на другой базе
+        // публикуют его через pki_shards --revoke или pki_status --publish
+        if (added > 0 && filesystem::path(impl->config.dbPath).lexically_normal() == filesystem::path(DB_PATH).lexically_normal()) {
+            try {
+                RevocationSnapshot::publish(*impl->db);
+            } catch (const std::runtime_error& ex) {
+                throw runtime_error(string("revoke: сертификаты отозваны, но снимок отзыва не опубликован: ") + ex.what());
+            }
+        }
+        return added;
+    });
+}
+
+
+CertificateStatus Authority::status(const string& serial) {
+    CertStatusRecord record;
+    CertificateStatus result;
+    result.serial = serial;
+
+    lock_guard<mutex> lock(impl->storeMutex);
+    if (impl->db->selectCertStatus(serial, record)) {
+        result.known = true;
+        result.status = record.status;
+        result.revoked = record.revoked;
+        result.reasonCode = record.reasonCode;
+        result.revokedAt = record.revokedAt;
+    }
+    return result;
+}
+
+
+vector<CertificateRecord> Authority::search(const string& organization, const string& commonNamePrefix, const string& text, int limit) {
+    SubjectSearchQuery query;
+    query.organization = organization;
+    query.commonNamePrefix = commonNamePrefix;
+    query.text = text;
+    query.limit = limit;
+
+    vector<IssuerCertRecord> records;
+    {
+        lock_guard<mutex> lock(impl->storeMutex);
+        records = impl->db->searchIssuerCerts(query);
+    }
+
+    vector<CertificateRecord> result;
+    result.reserve(records.size());
+    for (const auto& record : records) {
+        result.push_back({record.certName, record.serial, record.certDataFrom, record.certDataTo, record.status,
+                          record.subject.country, record.subject.organization, record.subject.commonName});
+    }
+    return result;
+}
+
+
+string Authority::crl() {
+    lock_guard<mutex> lock(impl->storeMutex);
+    string path = ObjectLoader::resolve(impl->config.crlPath);
+    if (path.empty() || path == impl->config.crlPath) {
+        return readFileToString(impl->config.crlPath);
+    }
+    // CRL опубликован только в DER: отдаем его в PEM, как и раньше
+    X509CrlPtr crl = ObjectLoader::loadCRL(path);
+    if (!crl) {
+        throw runtime_error("crl: не удалось прочитать " + path + ".");
+    }
+    return Artifacts::encodeCRL(crl.get(), impl->config.crlPath, OutputFormat::PEM).front().second;
+}
+
+
+void Authority::publishCrl() {
+    runAdmitted(*impl->admission, RequestClass::CrlPublication, [&] {
+        lock_guard<mutex> lock(impl->storeMutex);
+        CRL::regenerateCRL(impl->config.crlPath, impl->key.get());
+    });
+}
+
+
+vector<QueueStats> Authority::queueStats() const {
+    vector<QueueStats> result;
+    for (RequestClass requestClass : {RequestClass::Revocation, RequestClass::CrlPublication, RequestClass::Issuance}) {
+        AdmissionClassStats stats = impl->admission->getStats(requestClass);
+        result.push_back({requestClassName(requestClass), stats.queued, stats.running, stats.admitted, stats.rejected,
+                          stats.completed, stats.averageWaitMs(), stats.maxWaitMs});
+    }
+    return result;
+}
+
+}
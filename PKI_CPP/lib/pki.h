@@ -0,0 +1,108 @@
+#pragma once
+
+#include <ctime>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Встраиваемое ядро УЦ: выпуск, отзыв и запросы статуса без запуска отдельных процессов.
+// Заголовок не тянет OpenSSL и SQLite, поэтому его можно подключать из расширений других языков.
+namespace pki {
+
+// Пустые пути заменяются расположением из paths.hpp
+struct AuthorityConfig {
+    std::string keyPath;        // ключ подписи; по умолчанию ключ КУЦ
+    std::string certPath;       // сертификат УЦ; по умолчанию сертификат КУЦ
+    std::string certsDir;       // куда сохраняются выпущенные сертификаты
+    std::string crlPath;
+    std::string dbPath;
+    std::string dbPassword = "1234";
+    size_t workers = 0;                 // потоки очереди запросов; 0 — по числу ядер
+    size_t maxQueuedIssuance = 10000;   // сверх этого выпуски и экспорт отклоняются исключением Overloaded
+};
+
+struct IssuedCertificate {
+    std::string certName;
+    std::string serial;
+    std::string subject;
+    std::string notBefore;
+    std::string notAfter;
+    std::string pem;
+};
+
+struct CertificateStatus {
+    std::string serial;
+    bool known = false;         // сертификат с таким номером выпускался этим УЦ
+    std::string status;         // active, suspended, revoked
+    bool revoked = false;       // отозван с указанием причины
+    int reasonCode = 0;
+    time_t revokedAt = 0;
+};
+
+struct CertificateRecord {
+    std::string certName;
+    std::string serial;
+    std::string notBefore;
+    std::string notAfter;
+    std::string status;
+    std::string country;
+    std::string organization;
+    std::string commonName;
+};
+
+// Состояние очереди запросов одного класса: revocation, crl, issuance
+struct QueueStats {
+    std::string requestClass;
+    size_t queued = 0;
+    size_t running = 0;
+    size_t admitted = 0;
+    size_t rejected = 0;
+    size_t completed = 0;
+    double averageWaitMs = 0;
+    double maxWaitMs = 0;
+};
+
+// Очередь выпуска переполнена; запрос можно повторить позже
+class Overloaded : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// Ошибки сообщаются исключением std::runtime_error.
+// Методы можно вызывать из нескольких потоков. Выпуск, отзыв и публикация CRL проходят через
+// очередь с приоритетами: отзыв и публикация CRL обгоняют выпуск, поэтому срочный отзыв
+// не ждет накопившихся подписей. Запись в базу и переподпись CRL выполняются последовательно.
+class Authority {
+public:
+    explicit Authority(const AuthorityConfig& config = AuthorityConfig());
+    ~Authority();
+
+    Authority(const Authority&) = delete;
+    Authority& operator=(const Authority&) = delete;
+
+    // Проверяет CSR (PEM) по политике УЦ, подписывает, сохраняет certName в certsDir и регистрирует в базе
+    IssuedCertificate issue(const std::string& csrPem, const std::string& certName);
+
+    // Добавляет номера в CRL с одной переподписью; возвращает число новых записей
+    size_t revoke(const std::vector<std::string>& serials, int reasonCode);
+
+    CertificateStatus status(const std::string& serial);
+
+    std::vector<CertificateRecord> search(const std::string& organization, const std::string& commonNamePrefix,
+                                          const std::string& text, int limit = 100);
+
+    // Текущий CRL в PEM
+    std::string crl();
+
+    // Переподписывает CRL с новыми датами выпуска
+    void publishCrl();
+
+    std::vector<QueueStats> queueStats() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> impl;
+};
+
+}
@@ -0,0 +1,304 @@
+// Расширение Python над libpki: server.py выпускает, отзывает и проверяет сертификаты в своем процессе.
+// На время работы ядра GIL отпускается, поэтому параллельные запросы FastAPI подписываются одновременно.
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+#include "./pki.h"
+
+using namespace std;
+
+static PyObject* PkiError = nullptr;
+static PyObject* PkiOverloaded = nullptr;
+
+// Открытый УЦ модуля; вызовы держат свою копию указателя, поэтому повторный open() не рвет идущие операции
+static shared_ptr<pki::Authority> authority;
+static mutex authorityMutex;
+
+static shared_ptr<pki::Authority> currentAuthority() {
+    lock_guard<mutex> lock(authorityMutex);
+    if (!authority) {
+        PyErr_SetString(PkiError, "УЦ не открыт: сначала вызовите pki.open().");
+    }
+    return authority;
+}
+
+// Выполняет action без GIL; исключение ядра превращается в pki.Error, переполнение очереди — в pki.Overloaded
+template <typename Action>
+static bool runWithoutGil(Action&& action) {
+    string error;
+    PyObject* errorType = PkiError;
+    Py_BEGIN_ALLOW_THREADS
+    try {
+        action();
+    } catch (const pki::Overloaded& ex) {
+        error = ex.what();
+        errorType = PkiOverloaded;
+    } catch (const std::exception& ex) {
+        error = ex.what();
+        if (error.empty()) error = "ошибка ядра УЦ";
+    }
+    Py_END_ALLOW_THREADS
+    if (!error.empty()) {
+        PyErr_SetString(errorType, error.c_str());
+        return false;
+    }
+    return true;
+}
+
+static PyObject* pki_open(PyObject*, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"db_path", "db_password", "key_path", "cert_path", "certs_dir", "crl_path",
+                                     "workers", "max_queued", nullptr};
+    const char* dbPath = "";
+    const char* dbPassword = "1234";
+    const char* keyPath = "";
+    const char* certPath = "";
+    const char* certsDir = "";
+    const char* crlPath = "";
+    Py_ssize_t workers = 0;
+    Py_ssize_t maxQueued = 10000;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|ssssssnn", const_cast<char**>(keywords),
+                                     &dbPath, &dbPassword, &keyPath, &certPath, &certsDir, &crlPath, &workers, &maxQueued)) {
+        return nullptr;
+    }
+    if (workers < 0 || maxQueued < 0) {
+        PyErr_SetString(PyExc_ValueError, "workers и max_queued не могут быть отрицательными");
+        return nullptr;
+    }
+
+    pki::AuthorityConfig config;
+    config.dbPath = dbPath;
+    config.dbPassword = dbPassword;
+    config.keyPath = keyPath;
+    config.certPath = certPath;
+    config.certsDir = certsDir;
+    config.crlPath = crlPath;
+    config.workers = static_cast<size_t>(workers);
+    config.maxQueuedIssuance = static_cast<size_t>(maxQueued);
+
+    shared_ptr<pki::Authority> opened;
+    if (!runWithoutGil([&] { opened = make_shared<pki::Authority>(config); })) {
+        return nullptr;
+    }
+    lock_guard<mutex> lock(authorityMutex);
+    authority = std::move(opened);
+    Py_RETURN_NONE;
+}
+
+static PyObject* pki_issue(PyObject*, PyObject* args) {
+    const char* csrPem;
+    Py_ssize_t csrLength;
+    const char* certName;
+    if (!PyArg_ParseTuple(args, "s#s", &csrPem, &csrLength, &certName)) {
+        return nullptr;
+    }
+    shared_ptr<pki::Authority> current = currentAuthority();
+    if (!current) {
+        return nullptr;
+    }
+
+    string csr(csrPem, csrLength);
+    string name(certName);
+    pki::IssuedCertificate cert;
+    if (!runWithoutGil([&] { cert = current->issue(csr, name); })) {
+        return nullptr;
+    }
+    return Py_BuildValue("{s:s,s:s,s:s,s:s,s:s,s:s}", "cert_name", cert.certName.c_str(), "serial", cert.serial.c_str(),
+                         "subject", cert.subject.c_str(), "not_before", cert.notBefore.c_str(),
+                         "not_after", cert.notAfter.c_str(), "pem", cert.pem.c_str());
+}
+
+static PyObject* pki_revoke(PyObject*, PyObject* args) {
+    PyObject* serialList;
+    int reasonCode = 0;
+    if (!PyArg_ParseTuple(args, "O|i", &serialList, &reasonCode)) {
+        return nullptr;
+    }
+    PyObject* sequence = PySequence_Fast(serialList, "serials должен быть последовательностью строк");
+    if (!sequence) {
+        return nullptr;
+    }
+    vector<string> serials;
+    Py_ssize_t count = PySequence_Fast_GET_SIZE(sequence);
+    for (Py_ssize_t i = 0; i < count; ++i) {
+        const char* serial = PyUnicode_AsUTF8(PySequence_Fast_GET_ITEM(sequence, i));
+        if (!serial) {
+            Py_DECREF(sequence);
+            return nullptr;
+        }
+        serials.emplace_back(serial);
+    }
+    Py_DECREF(sequence);
+
+    shared_ptr<pki::Authority> current = currentAuthority();
+    if (!current) {
+        return nullptr;
+    }
+    size_t added = 0;
+    if (!runWithoutGil([&] { added = current->revoke(serials, reasonCode); })) {
+        return nullptr;
+    }
+    return PyLong_FromSize_t(added);
+}
+
+static PyObject* pki_status(PyObject*, PyObject* args) {
+    const char* serial;
+    if (!PyArg_ParseTuple(args, "s", &serial)) {
+        return nullptr;
+    }
+    shared_ptr<pki::Authority> current = currentAuthority();
+    if (!current) {
+        return nullptr;
+    }
+    string key(serial);
+    pki::CertificateStatus status;
+    if (!runWithoutGil([&] { status = current->status(key); })) {
+        return nullptr;
+    }
+    if (!status.known) {
+        return Py_BuildValue("{s:s,s:s}", "serial", status.serial.c_str(), "status", "unknown");
+    }
+    if (!status.revoked) {
+        return Py_BuildValue("{s:s,s:s}", "serial", status.serial.c_str(), "status", status.status.c_str());
+    }
+    return Py_BuildValue("{s:s,s:s,s:i,s:L}", "serial", status.serial.c_str(), "status", status.status.c_str(),
+                         "reason", status.reasonCode, "revoked_at", static_cast<long long>(status.revokedAt));
+}
+
+static PyObject* pki_search(PyObject*, PyObject* args, PyObject* kwargs) {
+    static const char* keywords[] = {"organization", "cn_prefix", "text", "limit", nullptr};
+    const char* organization = "";
+    const char* commonNamePrefix = "";
+    const char* text = "";
+    int limit = 100;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|sssi", const_cast<char**>(keywords),
+                                     &organization, &commonNamePrefix, &text, &limit)) {
+        return nullptr;
+    }
+    shared_ptr<pki::Authority> current = currentAuthority();
+    if (!current) {
+        return nullptr;
+    }
+    string organizationValue(organization), prefixValue(commonNamePrefix), textValue(text);
+    vector<pki::CertificateRecord> records;
+    if (!runWithoutGil([&] { records = current->search(organizationValue, prefixValue, textValue, limit); })) {
+        return nullptr;
+    }
+
+    PyObject* result = PyList_New(static_cast<Py_ssize_t>(records.size()));
+    if (!result) {
+        return nullptr;
+    }
+    for (size_t i = 0; i < records.size(); ++i) {
+        const pki::CertificateRecord& record = records[i];
+        PyObject* item = Py_BuildValue("{s:s,s:s,s:s,s:s,s:s,s:s,s:s,s:s}", "cert_name", record.certName.c_str(),
+                                       "serial", record.serial.c_str(), "not_before", record.notBefore.c_str(),
+                                       "not_after", record.notAfter.c_str(), "status", record.status.c_str(),
+                                       "country", record.country.c_str(), "organization", record.organization.c_str(),
+                                       "common_name", record.commonName.c_str());
+        if (!item) {
+            Py_DECREF(result);
+            return nullptr;
+        }
+        PyList_SET_ITEM(result, static_cast<Py_ssize_t>(i), item);
+    }
+    return result;
+}
+
+static PyObject* pki_crl(PyObject*, PyObject*) {
+    shared_ptr<pki::Authority> current = currentAuthority();
+    if (!current) {
+        return nullptr;
+    }
+    string pem;
+    if (!runWithoutGil([&] { pem = current->crl(); })) {
+        return nullptr;
+    }
+    return PyUnicode_FromStringAndSize(pem.data(), static_cast<Py_ssize_t>(pem.size()));
+}
+
+static PyObject* pki_publish_crl(PyObject*, PyObject*) {
+    shared_ptr<pki::Authority> current = currentAuthority();
+    if (!current) {
+        return nullptr;
+    }
+    if (!runWithoutGil([&] { current->publishCrl(); })) {
+        return nullptr;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* pki_queue_stats(PyObject*, PyObject*) {
+    shared_ptr<pki::Authority> current = currentAuthority();
+    if (!current) {
+        return nullptr;
+    }
+    vector<pki::QueueStats> stats = current->queueStats();
+
+    PyObject* result = PyDict_New();
+    if (!result) {
+        return nullptr;
+    }
+    for (const pki::QueueStats& classStats : stats) {
+        PyObject* item = Py_BuildValue("{s:n,s:n,s:n,s:n,s:n,s:d,s:d}",
+                                       "queued", static_cast<Py_ssize_t>(classStats.queued),
+                                       "running", static_cast<Py_ssize_t>(classStats.running),
+                                       "admitted", static_cast<Py_ssize_t>(classStats.admitted),
+                                       "rejected", static_cast<Py_ssize_t>(classStats.rejected),
+                                       "completed", static_cast<Py_ssize_t>(classStats.completed),
+                                       "average_wait_ms", classStats.averageWaitMs, "max_wait_ms", classStats.maxWaitMs);
+        if (!item || PyDict_SetItemString(result, classStats.requestClass.c_str(), item) < 0) {
+            Py_XDECREF(item);
+            Py_DECREF(result);
+            return nullptr;
+        }
+        Py_DECREF(item);
+    }
+    return result;
+}
+
+static PyMethodDef pkiMethods[] = {
+    {"open", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(pki_open)), METH_VARARGS | METH_KEYWORDS,
+     "open(db_path='', db_password='1234', key_path='', cert_path='', certs_dir='', crl_path='', workers=0, max_queued=10000)"
+     " — открыть УЦ"},
+    {"issue", pki_issue, METH_VARARGS, "issue(csr_pem, cert_name) -> dict — выпустить сертификат по CSR в PEM или DER"},
+    {"revoke", pki_revoke, METH_VARARGS, "revoke(serials, reason=0) -> int — отозвать сертификаты"},
+    {"status", pki_status, METH_VARARGS, "status(serial) -> dict — статус сертификата по базе"},
+    {"search", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(pki_search)), METH_VARARGS | METH_KEYWORDS,
+     "search(organization='', cn_prefix='', text='', limit=100) -> list — поиск выпущенных сертификатов"},
+    {"crl", pki_crl, METH_NOARGS, "crl() -> str — текущий CRL в PEM"},
+    {"publish_crl", pki_publish_crl, METH_NOARGS, "publish_crl() — переподписать CRL с новыми датами"},
+    {"queue_stats", pki_queue_stats, METH_NOARGS, "queue_stats() -> dict — глубина очередей и время ожидания по классам"},
+    {nullptr, nullptr, 0, nullptr}
+};
+
+static PyModuleDef pkiModule = {
+    PyModuleDef_HEAD_INIT, "pki", "Ядро УЦ PKI_CPP, встроенное в процесс Python", -1, pkiMethods,
+    nullptr, nullptr, nullptr, nullptr
+};
+
+PyMODINIT_FUNC PyInit_pki() {
+    PyObject* module = PyModule_Create(&pkiModule);
+    if (!module) {
+        return nullptr;
+    }
+    PkiError = PyErr_NewException("pki.Error", PyExc_RuntimeError, nullptr);
+    if (!PkiError || PyModule_AddObject(module, "Error", PkiError) < 0) {
+        Py_XDECREF(PkiError);
+        Py_DECREF(module);
+        return nullptr;
+    }
+    Py_INCREF(PkiError);
+
+    PkiOverloaded = PyErr_NewException("pki.Overloaded", PkiError, nullptr);
+    if (!PkiOverloaded || PyModule_AddObject(module, "Overloaded", PkiOverloaded) < 0) {
+        Py_XDECREF(PkiOverloaded);
+        Py_DECREF(module);
+        return nullptr;
+    }
+    Py_INCREF(PkiOverloaded);
+    return module;
+}
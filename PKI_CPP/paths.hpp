@@ -12,7 +12,6 @@
 #define USER_REQS_PATH "./PKI_CPP/CA/user_reqs_data"
 #define TEMP_PATH "./PKI_CPP/CA/temp"
 #define DB_PATH "./PKI_CPP/db/root.db"
-#define DB_SCHEMA "./PKI_CPP/db/schema.sql"
 #define ROOT_PRIVATE_KEY_PATH "./PKI_CPP/CA/root-ca/private"
 #define ROOT_CNF "./PKI_CPP/CA/config/root_openssl.cnf"
 #define ROOT_CERTS_PATH "./PKI_CPP/CA/root-ca/certs"
@@ -21,4 +20,11 @@
 #define ISSUER_CSR_PATH "./PKI_CPP/CA/issuing-ca/csr"
 #define ISSUER_CERTS_PATH "./PKI_CPP/CA/issuing-ca/certs"
 #define PKCS12_PATH "./PKI_CPP/CA/pkcs12"
-#define CRL_PATH "./PKI_CPP/CA/issuing-ca/crl"
\ No newline at end of file
+#define CRL_PATH "./PKI_CPP/CA/issuing-ca/crl"
+#define DEFAULT_CRL_NAME "issuer.crl.pem"
+#define REVOCATION_SNAPSHOT_PATH "./PKI_CPP/db/revocation.snapshot"
+#define SHARDS_CONFIG "./PKI_CPP/CA/config/shards.conf"
+#define SHARDS_PATH "./PKI_CPP/CA/shards"
+#define OUTPUT_FORMAT_CONFIG "./PKI_CPP/CA/config/output_format.conf"
+#define ARCHIVE_PATH "./PKI_CPP/CA/issuing-ca/archive"
+#define BACKUP_PATH "./PKI_CPP/backup"
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+using namespace std;
+
+// Очередь запросов с приоритетами и контролем допуска. Классы в порядке приоритета:
+// отзыв, публикация CRL, выпуск. Свободный поток всегда берет запрос
+// самого приоритетного класса, у которого не исчерпан бюджет параллельности.
+// Выпуск по умолчанию занимает не больше threads-1 потоков, поэтому отзыв ждет
+// не дольше одного уже идущего отзыва или публикации, сколько бы выпусков ни стояло в очереди.
+// Запрос сверх лимита очереди своего класса отклоняется сразу (AdmissionRejected).
+
+enum class RequestClass { Revocation = 0, CrlPublication = 1, Issuance = 2 };
+
+static constexpr int requestClassCount = 3;
+
+inline const char* requestClassName(RequestClass requestClass) {
+    static const char* names[requestClassCount] = {"revocation", "crl", "issuance"};
+    return names[static_cast<int>(requestClass)];
+}
+
+struct AdmissionClassPolicy {
+    size_t maxQueued = SIZE_MAX;    // сверх этого числа ожидающих запросы отклоняются
+    size_t maxRunning = SIZE_MAX;   // бюджет одновременно выполняемых запросов класса
+};
+
+struct AdmissionPolicy {
+    AdmissionClassPolicy classes[requestClassCount];
+
+    // Бюджеты по умолчанию: выпуск оставляет один поток отзыву и публикации CRL
+    static AdmissionPolicy forThreads(size_t threads, size_t maxQueuedIssuance = 10000);
+};
+
+struct AdmissionClassStats {
+    size_t queued = 0;
+    size_t running = 0;
+    size_t admitted = 0;
+    size_t rejected = 0;
+    size_t completed = 0;
+    double totalWaitMs = 0;
+    double maxWaitMs = 0;
+
+    double averageWaitMs() const { return completed + running ? totalWaitMs / (completed + running) : 0; }
+};
+
+class AdmissionRejected : public runtime_error {
+public:
+    using runtime_error::runtime_error;
+};
+
+class AdmissionQueue {
+private:
+    using Clock = chrono::steady_clock;
+
+    struct Pending {
+        function<void()> task;
+        Clock::time_point enqueued;
+    };
+
+    AdmissionPolicy policy;
+    mutable mutex queueMutex;
+    condition_variable condition;
+    deque<Pending> queues[requestClassCount];
+    AdmissionClassStats stats[requestClassCount];
+    bool stopping = false;
+    vector<thread> workers;
+
+    bool __pickLocked(int& requestClass) const;
+    void __workerLoop();
+
+public:
+    AdmissionQueue(size_t threadCount, const AdmissionPolicy& policy);
+    explicit AdmissionQueue(size_t threadCount = thread::hardware_concurrency());
+    ~AdmissionQueue();
+
+    AdmissionQueue(const AdmissionQueue&) = delete;
+    AdmissionQueue& operator=(const AdmissionQueue&) = delete;
+
+    // Ставит запрос в очередь его класса; при переполнении очереди бросает AdmissionRejected
+    template <typename F>
+    auto submit(RequestClass requestClass, F&& task) -> future<invoke_result_t<F>>;
+
+    AdmissionClassStats getStats(RequestClass requestClass) const;
+};
+
+
+inline AdmissionPolicy AdmissionPolicy::forThreads(size_t threads, size_t maxQueuedIssuance) {
+    AdmissionPolicy policy;
+    size_t bulk = threads > 1 ? threads - 1 : 1;
+    policy.classes[static_cast<int>(RequestClass::CrlPublication)].maxRunning = 1;    // CRL все равно переподписывается целиком
+    policy.classes[static_cast<int>(RequestClass::Issuance)] = {maxQueuedIssuance, bulk};
+    return policy;
+}
+
+
+inline AdmissionQueue::AdmissionQueue(size_t threadCount, const AdmissionPolicy& policy) : policy(policy) {
+    if (threadCount == 0) {
+        threadCount = 1;
+    }
+    workers.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; ++i) {
+        workers.emplace_back([this] { __workerLoop(); });
+    }
+}
+
+inline AdmissionQueue::AdmissionQueue(size_t threadCount)
+    : AdmissionQueue(threadCount, AdmissionPolicy::forThreads(threadCount == 0 ? 1 : threadCount)) {}
+
+inline AdmissionQueue::~AdmissionQueue() {
+    {
+        lock_guard<mutex> lock(queueMutex);
+        stopping = true;
+    }
+    condition.notify_all();
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+template <typename F>
+auto AdmissionQueue::submit(RequestClass requestClass, F&& task) -> future<invoke_result_t<F>> {
+    using Result = invoke_result_t<F>;
+    int index = static_cast<int>(requestClass);
+
+    auto packaged = make_shared<packaged_task<Result()>>(std::forward<F>(task));
+    future<Result> result = packaged->get_future();
+    {
+        lock_guard<mutex> lock(queueMutex);
+        if (stopping) {
+            throw runtime_error("AdmissionQueue: очередь уже остановлена.");
+        }
+        if (queues[index].size() >= policy.classes[index].maxQueued) {
+            ++stats[index].rejected;
+            throw AdmissionRejected(string("AdmissionQueue: очередь ") + requestClassName(requestClass) + " переполнена ("
+                                    + to_string(queues[index].size()) + " запросов).");
+        }
+        queues[index].push_back({[packaged] { (*packaged)(); }, Clock::now()});
+        ++stats[index].admitted;
+        stats[index].queued = queues[index].size();
+    }
+    condition.notify_all();
+
+    return result;
+}
+
+inline bool AdmissionQueue::__pickLocked(int& requestClass) const {
+    for (requestClass = 0; requestClass < requestClassCount; ++requestClass) {
+        if (!queues[requestClass].empty() && stats[requestClass].running < policy.classes[requestClass].maxRunning) {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline void AdmissionQueue::__workerLoop() {
+    while (true) {
+        Pending pending;
+        int requestClass = 0;
+        {
+            unique_lock<mutex> lock(queueMutex);
+            condition.wait(lock, [this, &requestClass] { return __pickLocked(requestClass) || stopping; });
+
+            // дорабатываем оставшиеся запросы перед остановкой
+            if (!__pickLocked(requestClass)) {
+                if (stopping) {
+                    return;
+                }
+                continue;
+            }
+
+            pending = std::move(queues[requestClass].front());
+            queues[requestClass].pop_front();
+
+            AdmissionClassStats& classStats = stats[requestClass];
+            double waitMs = chrono::duration<double, milli>(Clock::now() - pending.enqueued).count();
+            classStats.queued = queues[requestClass].size();
+            ++classStats.running;
+            classStats.totalWaitMs += waitMs;
+            classStats.maxWaitMs = max(classStats.maxWaitMs, waitMs);
+        }
+
+        pending.task();
+
+        {
+            lock_guard<mutex> lock(queueMutex);
+            --stats[requestClass].running;
+            ++stats[requestClass].completed;
+        }
+        // освободился бюджет класса: запрос, ждавший его, может быть взят другим потоком
+        condition.notify_all();
+    }
+}
+
+inline AdmissionClassStats AdmissionQueue::getStats(RequestClass requestClass) const {
+    lock_guard<mutex> lock(queueMutex);
+    return stats[static_cast<int>(requestClass)];
+}
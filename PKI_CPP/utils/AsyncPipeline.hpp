@@ -0,0 +1,308 @@
+#pragma once
+
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <filesystem>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <openssl/pem.h>
+#include <openssl/pkcs12.h>
+#include <openssl/rand.h>
+
+#include "../db/database.h"
+#include "../paths.hpp"
+#include "./CSRValidator.hpp"
+#include "./Certificates.hpp"
+#include "./Handles.hpp"
+#include "./JobScheduler.hpp"
+#include "./OutputFormat.hpp"
+#include "./ThreadPool.hpp"
+
+using namespace std;
+
+// Асинхронный выпуск на корутинах C++20. Выпуск — цепочка этапов
+// (проверка CSR -> выделение серийного номера -> подпись -> запись -> экспорт PKCS#12),
+// каждый этап переходит на свой пул: криптография на пуле CPU, файлы и база на пуле I/O.
+// Поток CPU никогда не ждет диска, поэтому множество выпусков перекрываются во времени.
+
+
+// Ленивая корутина с результатом T: начинает работу при co_await и возобновляет ожидающего по завершении
+template <typename T>
+class Task;
+
+struct TaskPromiseBase {
+    coroutine_handle<> continuation;
+    exception_ptr error;
+
+    suspend_always initial_suspend() noexcept { return {}; }
+
+    struct FinalAwaiter {
+        bool await_ready() const noexcept { return false; }
+        template <typename Promise>
+        coroutine_handle<> await_suspend(coroutine_handle<Promise> handle) noexcept {
+            coroutine_handle<> next = handle.promise().continuation;
+            return next ? next : noop_coroutine();
+        }
+        void await_resume() const noexcept {}
+    };
+
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() { error = current_exception(); }
+};
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase {
+    optional<T> value;
+
+    Task<T> get_return_object();
+    void return_value(T result) { value = std::move(result); }
+
+    T takeResult() {
+        if (this->error) {
+            rethrow_exception(this->error);
+        }
+        return std::move(*value);
+    }
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase {
+    Task<void> get_return_object();
+    void return_void() {}
+
+    void takeResult() {
+        if (error) {
+            rethrow_exception(error);
+        }
+    }
+};
+
+template <typename T = void>
+class Task {
+public:
+    using promise_type = TaskPromise<T>;
+
+private:
+    coroutine_handle<promise_type> handle;
+
+public:
+    explicit Task(coroutine_handle<promise_type> handle) : handle(handle) {}
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, nullptr)) {}
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task() {
+        if (handle) {
+            handle.destroy();
+        }
+    }
+
+    bool await_ready() const noexcept { return false; }
+    coroutine_handle<> await_suspend(coroutine_handle<> awaiting) noexcept {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+    T await_resume() { return handle.promise().takeResult(); }
+};
+
+template <typename T>
+inline Task<T> TaskPromise<T>::get_return_object() {
+    return Task<T>(coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void> TaskPromise<void>::get_return_object() {
+    return Task<void>(coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+
+// Где выполняется продолжение корутины: пул потоков или класс задач планировщика
+class Executor {
+private:
+    function<void(function<void()>)> postTask;
+
+public:
+    Executor(ThreadPool& pool) : postTask([&pool](function<void()> task) { pool.post(std::move(task)); }) {}
+    Executor(JobLane lane) : postTask([lane](function<void()> task) mutable { lane.post(std::move(task)); }) {}
+
+    void post(function<void()> task) const { postTask(std::move(task)); }
+};
+
+// Переносит продолжение корутины в исполнитель: co_await resumeOn(pool)
+struct ResumeOn {
+    Executor executor;
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(coroutine_handle<> handle) { executor.post([handle] { handle.resume(); }); }
+    void await_resume() const noexcept {}
+};
+
+inline ResumeOn resumeOn(Executor executor) {
+    return ResumeOn{std::move(executor)};
+}
+
+
+// Корутина без ожидающего: запускается сразу и сама освобождает кадр по завершении
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask get_return_object() noexcept { return {}; }
+        suspend_never initial_suspend() noexcept { return {}; }
+        suspend_never final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { terminate(); }
+    };
+};
+
+// Запускает задачу, не дожидаясь ее; результат или исключение передаются в future
+template <typename T>
+inline future<T> spawn(Task<T> task) {
+    auto result = make_shared<promise<T>>();
+    future<T> completion = result->get_future();
+    [](Task<T> task, shared_ptr<promise<T>> result) -> DetachedTask {
+        try {
+            if constexpr (is_void_v<T>) {
+                co_await task;
+                result->set_value();
+            } else {
+                result->set_value(co_await task);
+            }
+        } catch (...) {
+            result->set_exception(current_exception());
+        }
+    }(std::move(task), result);
+    return completion;
+}
+
+// Блокирует вызывающий поток до завершения задачи
+template <typename T>
+inline T syncWait(Task<T> task) {
+    return spawn(std::move(task)).get();
+}
+
+
+// Запрос был отклонен проверкой CSR, а не сбоем этапа
+class IssuanceRejected : public runtime_error {
+public:
+    using runtime_error::runtime_error;
+};
+
+struct IssuanceRequest {
+    X509ReqPtr req;
+    string name;                // имя файла сертификата и контейнера PKCS#12 без расширения
+    EvpPkeyPtr userKey;         // закрытый ключ владельца; без него экспорт PKCS#12 пропускается
+    string pkcs12Password;
+};
+
+struct IssuanceResult {
+    string name;
+    string serial;
+    X509Ptr cert;
+    double validateMs = 0;
+    double signMs = 0;
+    double persistMs = 0;
+    double pkcs12Ms = 0;
+};
+
+class IssuancePipeline {
+private:
+    Executor cpuPool;
+    Executor ioPool;
+    X509* caCert;
+    EVP_PKEY* caKey;
+    Database& db;
+    CSRValidator validator;
+    string certsDir;
+    string pkcs12Dir;
+    mutex dbMutex;              // одно соединение с базой на все потоки пула I/O
+
+    static double __elapsedMs(chrono::steady_clock::time_point from);
+    static void __writeFile(const filesystem::path& path, const string& content);
+
+public:
+    IssuancePipeline(Executor cpuPool, Executor ioPool, X509* caCert, EVP_PKEY* caKey, Database& db,
+                     const string& certsDir = ISSUER_CERTS_PATH, const string& pkcs12Dir = PKCS12_PATH)
+        : cpuPool(std::move(cpuPool)), ioPool(std::move(ioPool)), caCert(caCert), caKey(caKey), db(db), validator(caCert),
+          certsDir(certsDir), pkcs12Dir(pkcs12Dir) {}
+
+    IssuancePipeline(const IssuancePipeline&) = delete;
+    IssuancePipeline& operator=(const IssuancePipeline&) = delete;
+
+    Task<IssuanceResult> issue(IssuanceRequest request);
+};
+
+
+inline double IssuancePipeline::__elapsedMs(chrono::steady_clock::time_point from) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - from).count();
+}
+
+inline void IssuancePipeline::__writeFile(const filesystem::path& path, const string& content) {
+    BioPtr bio(BIO_new_file(path.c_str(), "wb"));
+    if (!bio || BIO_write(bio.get(), content.data(), static_cast<int>(content.size())) != static_cast<int>(content.size())) {
+        throw runtime_error("IssuancePipeline: не удалось записать " + path.string() + ".");
+    }
+}
+
+inline Task<IssuanceResult> IssuancePipeline::issue(IssuanceRequest request) {
+    IssuanceResult result;
+    result.name = request.name;
+
+    // Проверка CSR, выделение номера и подпись — на пуле CPU
+    co_await resumeOn(cpuPool);
+    auto stageStart = chrono::steady_clock::now();
+    CSRValidationResult validation = validator.validate(request.req.get());
+    result.validateMs = __elapsedMs(stageStart);
+    if (!validation.valid) {
+        throw IssuanceRejected("запрос " + request.name + " отклонен: " + validation.reason);
+    }
+
+    stageStart = chrono::steady_clock::now();
+    Asn1IntegerPtr serial = Certificates::allocateSerial();
+    result.cert = Certificates::buildIssuerCert(request.req.get(), caCert, caKey, serial.get());
+    IssuedCertInfo certInfo = Certificates::describeCertificate(result.cert.get());
+    result.serial = certInfo.serial;
+
+    string certPath = (filesystem::path(certsDir) / (request.name + ".cert.pem")).string();
+    OutputFormat certFormat = OutputFormats::current().certs;
+    vector<pair<string, string>> encoded = Artifacts::encodeX509(result.cert.get(), certPath, certFormat);
+    result.signMs = __elapsedMs(stageStart);
+
+    // Запись сертификата и регистрация в базе — на пуле I/O
+    co_await resumeOn(ioPool);
+    stageStart = chrono::steady_clock::now();
+    Artifacts::write(encoded, certPath, certFormat);
+    {
+        lock_guard<mutex> lock(dbMutex);
+        db.addIssuerCert(request.name + ".cert.pem", certInfo.serial, certInfo.notBefore, certInfo.notAfter, certInfo.info, certInfo.subject, certInfo.keyHash);
+    }
+    result.persistMs = __elapsedMs(stageStart);
+
+    if (!request.userKey) {
+        co_return result;
+    }
+
+    // Шифрование контейнера (PBKDF) — снова на пуле CPU, запись файла — на пуле I/O
+    co_await resumeOn(cpuPool);
+    stageStart = chrono::steady_clock::now();
+    Pkcs12Ptr p12(PKCS12_create(request.pkcs12Password.c_str(), "User Certificate", request.userKey.get(), result.cert.get(),
+                                nullptr, 0, 0, 0, 0, 0));
+    BioPtr p12Bio(BIO_new(BIO_s_mem()));
+    if (!p12 || !p12Bio || i2d_PKCS12_bio(p12Bio.get(), p12.get()) != 1) {
+        throw runtime_error("IssuancePipeline: не удалось создать PKCS#12 для " + request.name + ".");
+    }
+    char* p12Data = nullptr;
+    long p12Length = BIO_get_mem_data(p12Bio.get(), &p12Data);
+    string p12Der(p12Data, p12Length);
+    double pkcs12BuildMs = __elapsedMs(stageStart);
+
+    co_await resumeOn(ioPool);
+    stageStart = chrono::steady_clock::now();
+    __writeFile(filesystem::path(pkcs12Dir) / (request.name + ".p12"), p12Der);
+    result.pkcs12Ms = pkcs12BuildMs + __elapsedMs(stageStart);
+
+    co_return result;
+}
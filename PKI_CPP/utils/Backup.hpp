@@ -0,0 +1,689 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <openssl/evp.h>
+#include <sqlite3.h>
+
+#include "../paths.hpp"
+#include "./CRL.hpp"
+#include "./IssuerShards.hpp"
+#include "./ObjectLoader.hpp"
+
+using namespace std;
+
+// Резервное копирование баз и дерева CA/ без остановки выпуска.
+//
+// Согласованность. Под блокировками CRL всех шардов (CRLFileLock, ее же держит отзыв на время записи CRL
+// и обновления базы, а pki_archive - на время переноса строк и удаления файлов) в каждой базе открывается
+// читающая транзакция, и измененные файлы дерева CA/ читаются в память. Базы работают в режиме WAL, поэтому
+// транзакция фиксирует снимок, не мешая записи, а прочитанное содержимое не зависит от того, заменят ли файл
+// через rename или удалят. Файлы выданных сертификатов пишутся до транзакции в базе, так что каждая строка
+// снимка находит свой файл; строки без файла перечисляются в манифесте (missing). Блокировки держатся только
+// на время снимка; выпуск их не берет. Файлы сверх maxPinnedBytes (например, при первой копии большого УЦ)
+// закрепляются жесткими ссылками во временной директории: ссылки и их удаление - записи в журнал ФС,
+// общий с выпуском, поэтому в обычной инкрементальной копии их нет.
+//
+// Базы копируются в память через SQLite online backup API по stepPages страниц с паузой stepPause между
+// шагами из зафиксированного снимка: шаг не берет блокировок, которые ждал бы писатель, и не перезапускается
+// от параллельных изменений. Хэширование и запись объектов ограничены maxBytesPerSecond: на одном ядре с
+// выпуском копия идет короткими порциями, и подпись не ждет длинных отрезков копирования. Данные объектов
+// уходят на диск через sync_file_range сразу при записи, а fsync в конце коммитит журнал ФС только с метаданными.
+//
+// Инкрементальность. Хранилище BACKUP_PATH адресуется по содержимому: objects/<sha256>. Копия базы режется
+// на сегменты segmentBytes, файл CA/ — один объект; сохраняются только объекты, которых еще нет. Файл,
+// у которого размер, время изменения и inode совпадают с предыдущим манифестом, не читается вовсе.
+// Манифест manifests/<время>.manifest перечисляет сегменты баз и файлы с их объектами и ссылается на
+// предыдущий; по любому манифесту дерево восстанавливается целиком.
+
+struct BackupOptions {
+    int stepPages = 16;                         // страниц базы за шаг backup API
+    chrono::milliseconds stepPause{20};         // пауза между шагами
+    size_t maxBytesPerSecond = 4 << 20;         // хэширование и запись объектов; 0 - без ограничения
+    size_t segmentBytes = 256 << 10;            // сегмент копии базы, кратен размеру страницы
+    size_t maxPinnedBytes = 64 << 20;           // измененные файлы CA/, читаемые в память под блокировками
+    string caDir = "./PKI_CPP/CA";
+};
+
+struct BackupFileEntry {
+    string path;                // относительный путь, например PKI_CPP/CA/issuing-ca/certs/user1.cert.pem
+    unsigned mode = 0600;
+    unsigned long long size = 0;
+    long long mtime = 0;        // наносекунды
+    unsigned long long inode = 0;
+    string object;              // sha256 содержимого, hex
+};
+
+struct BackupDatabaseEntry {
+    string path;
+    int pageSize = 0;
+    unsigned long long size = 0;
+    long long eventSeq = 0;     // последнее событие журнала в снимке
+    vector<pair<string, unsigned long long>> segments;    // (объект, длина)
+};
+
+struct BackupManifest {
+    string name;
+    string previous;
+    string createdAt;
+    vector<BackupDatabaseEntry> databases;
+    vector<BackupFileEntry> files;
+    vector<pair<string, unsigned>> directories;    // (путь, права), чтобы восстановить и пустые директории
+    vector<string> missing;     // строки issuing_certs снимка без файла сертификата
+};
+
+struct BackupReport {
+    BackupManifest manifest;
+    size_t dbSteps = 0;
+    size_t objectsWritten = 0;
+    size_t bytesWritten = 0;
+    size_t filesUnchanged = 0;
+    double snapshotMs = 0;      // время под блокировками CRL
+    double totalMs = 0;
+};
+
+struct BackupVerifyReport {
+    size_t objects = 0;
+    size_t missingObjects = 0;
+    size_t corruptedObjects = 0;
+};
+
+class CABackup {
+private:
+    string backupDir;
+
+    static constexpr size_t WRITEBACK_CHUNK = 256 << 10;   // порция записи, отправляемая на диск сразу
+
+    struct SourceDatabase {
+        string path;
+        string certsDir;
+        sqlite3* connection = nullptr;
+    };
+
+    string __objectPath(const string& hash) const { return (filesystem::path(backupDir) / "objects" / hash.substr(0, 2) / hash).string(); }
+    string __manifestPath(const string& name) const { return (filesystem::path(backupDir) / "manifests" / (name + ".manifest")).string(); }
+    static string __sha256(const void* data, size_t length);
+    static bool __flush(int fd);
+    static void __writeFile(const string& path, const void* data, size_t length, mode_t mode, bool sync = true);
+    static string __relative(const string& path) { return filesystem::path(path).lexically_normal().string(); }
+    bool __storeObject(const string& hash, const void* data, size_t length) const;
+    string __newManifestName() const;
+    void __writeManifest(const BackupManifest& manifest) const;
+    static void __closeSources(vector<SourceDatabase>& sources);
+
+public:
+    explicit CABackup(const string& backupDir = BACKUP_PATH) : backupDir(backupDir) {}
+
+    BackupReport run(const BackupOptions& options = {});
+
+    vector<string> list() const;
+    // Пустое имя - последний манифест. Бросает runtime_error, если манифеста нет или он поврежден
+    BackupManifest readManifest(const string& name = "") const;
+    // Восстанавливает базы и файлы манифеста в targetDir (относительные пути сохраняются)
+    void restore(const string& name, const string& targetDir) const;
+    BackupVerifyReport verify(const string& name = "") const;
+};
+
+
+inline string CABackup::__sha256(const void* data, size_t length) {
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digestLength = 0;
+    if (EVP_Digest(data, length, digest, &digestLength, EVP_sha256(), nullptr) != 1) {
+        throw runtime_error("CABackup: не удалось вычислить SHA-256.");
+    }
+    static const char* hex = "0123456789abcdef";
+    string result;
+    for (unsigned int i = 0; i < digestLength; ++i) {
+        result += hex[digest[i] >> 4];
+        result += hex[digest[i] & 0x0f];
+    }
+    return result;
+}
+
+
+// Данные дописываются на диск через sync_file_range, минуя журнал ФС; fsync после этого коммитит журнал
+// только с метаданными файла и не держит в очереди fsync выпуска, пока пишутся данные копии
+inline bool CABackup::__flush(int fd) {
+    return sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER) == 0 &&
+           fsync(fd) == 0;
+}
+
+
+inline void CABackup::__writeFile(const string& path, const void* data, size_t length, mode_t mode, bool sync) {
+    filesystem::create_directories(filesystem::path(path).parent_path());
+    string tempPath = path + ".tmp." + to_string(getpid());
+    int fd = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, mode);
+    bool written = fd >= 0;
+    const char* bytes = static_cast<const char*>(data);
+    for (size_t offset = 0; written && offset < length;) {
+        ssize_t chunk = write(fd, bytes + offset, min(length - offset, WRITEBACK_CHUNK));
+        written = chunk > 0;
+        if (written) {
+            // Запись на диск начинается сразу и порциями, а не разом в fsync
+            sync_file_range(fd, offset, chunk, SYNC_FILE_RANGE_WRITE);
+            offset += chunk;
+        }
+    }
+    written = written && (!sync || __flush(fd));
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (!written || rename(tempPath.c_str(), path.c_str()) != 0) {
+        unlink(tempPath.c_str());
+        throw runtime_error("CABackup: не удалось записать " + path + ".");
+    }
+}
+
+
+// Объекты неизменяемы: уже сохраненный объект повторно не пишется. fsync сразу после записи объекта вставал бы
+// в очередь к коммиту журнала ФС вместе с fsync выпуска, поэтому новые объекты сбрасываются разом перед манифестом
+inline bool CABackup::__storeObject(const string& hash, const void* data, size_t length) const {
+    string path = __objectPath(hash);
+    if (filesystem::exists(path)) {
+        return false;
+    }
+    __writeFile(path, data, length, 0600, false);
+    return true;
+}
+
+
+inline vector<string> CABackup::list() const {
+    vector<string> names;
+    filesystem::path directory = filesystem::path(backupDir) / "manifests";
+    if (!filesystem::is_directory(directory)) {
+        return names;
+    }
+    for (const auto& entry : filesystem::directory_iterator(directory)) {
+        if (entry.path().extension() == ".manifest") {
+            names.push_back(entry.path().stem().string());
+        }
+    }
+    sort(names.begin(), names.end());
+    return names;
+}
+
+
+// Имена сортируются по времени создания: по ним находится предыдущий манифест
+inline string CABackup::__newManifestName() const {
+    auto now = chrono::system_clock::now();
+    time_t seconds = chrono::system_clock::to_time_t(now);
+    struct tm utc;
+    gmtime_r(&seconds, &utc);
+    char stamp[32];
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &utc);
+    char name[48];
+    long long milliseconds = chrono::duration_cast<chrono::milliseconds>(now.time_since_epoch()).count() % 1000;
+    snprintf(name, sizeof(name), "%s-%03lld", stamp, milliseconds);
+
+    string result = name;
+    for (int suffix = 2; filesystem::exists(__manifestPath(result)); ++suffix) {
+        char suffixed[64];
+        snprintf(suffixed, sizeof(suffixed), "%s-%03d", name, suffix);
+        result = suffixed;
+    }
+    return result;
+}
+
+
+inline void CABackup::__writeManifest(const BackupManifest& manifest) const {
+    ostringstream out;
+    out << "pki-backup 1\n"
+        << "created " << manifest.createdAt << "\n"
+        << "previous " << (manifest.previous.empty() ? "-" : manifest.previous) << "\n";
+    for (const auto& database : manifest.databases) {
+        out << "db " << database.pageSize << " " << database.size << " " << database.eventSeq << " " << database.path << "\n";
+        for (const auto& [object, length] : database.segments) {
+            out << "segment " << object << " " << length << "\n";
+        }
+    }
+    for (const auto& file : manifest.files) {
+        out << "file " << oct << file.mode << dec << " " << file.size << " " << file.mtime << " " << file.inode << " "
+            << file.object << " " << file.path << "\n";
+    }
+    for (const auto& [path, mode] : manifest.directories) {
+        out << "dir " << oct << mode << dec << " " << path << "\n";
+    }
+    for (const auto& path : manifest.missing) {
+        out << "missing " << path << "\n";
+    }
+    string content = out.str();
+    __writeFile(__manifestPath(manifest.name), content.data(), content.size(), 0600);
+}
+
+
+inline BackupManifest CABackup::readManifest(const string& name) const {
+    BackupManifest manifest;
+    manifest.name = name;
+    if (manifest.name.empty()) {
+        vector<string> names = list();
+        if (names.empty()) {
+            throw runtime_error("CABackup: в " + backupDir + " нет резервных копий.");
+        }
+        manifest.name = names.back();
+    }
+
+    ifstream in(__manifestPath(manifest.name));
+    string line;
+    if (!in || !getline(in, line) || line != "pki-backup 1") {
+        throw runtime_error("CABackup: не удалось прочитать манифест " + __manifestPath(manifest.name) + ".");
+    }
+    while (getline(in, line)) {
+        istringstream fields(line);
+        string kind;
+        fields >> kind;
+        if (kind == "created") {
+            fields >> manifest.createdAt;
+        } else if (kind == "previous") {
+            fields >> manifest.previous;
+            if (manifest.previous == "-") {
+                manifest.previous.clear();
+            }
+        } else if (kind == "db") {
+            BackupDatabaseEntry database;
+            fields >> database.pageSize >> database.size >> database.eventSeq >> ws;
+            getline(fields, database.path);
+            manifest.databases.push_back(database);
+        } else if (kind == "segment" && !manifest.databases.empty()) {
+            pair<string, unsigned long long> segment;
+            fields >> segment.first >> segment.second;
+            manifest.databases.back().segments.push_back(segment);
+        } else if (kind == "file") {
+            BackupFileEntry file;
+            fields >> oct >> file.mode >> dec >> file.size >> file.mtime >> file.inode >> file.object >> ws;
+            getline(fields, file.path);
+            manifest.files.push_back(file);
+        } else if (kind == "dir") {
+            pair<string, unsigned> directory;
+            fields >> oct >> directory.second >> dec >> ws;
+            getline(fields, directory.first);
+            manifest.directories.push_back(directory);
+        } else if (kind == "missing") {
+            string path;
+            getline(fields >> ws, path);
+            manifest.missing.push_back(path);
+        }
+        if (!fields && !fields.eof()) {
+            throw runtime_error("CABackup: поврежденная строка манифеста " + manifest.name + ": " + line);
+        }
+    }
+    return manifest;
+}
+
+
+inline void CABackup::__closeSources(vector<SourceDatabase>& sources) {
+    for (auto& source : sources) {
+        if (source.connection) {
+            sqlite3_exec(source.connection, "ROLLBACK;", nullptr, nullptr, nullptr);
+            sqlite3_close(source.connection);
+            source.connection = nullptr;
+        }
+    }
+}
+
+
+inline BackupReport CABackup::run(const BackupOptions& options) {
+    auto started = chrono::steady_clock::now();
+    BackupReport report;
+    BackupManifest& manifest = report.manifest;
+    vector<string> previousNames = list();
+    map<string, BackupFileEntry> previousFiles;
+    if (!previousNames.empty()) {
+        BackupManifest previous = readManifest(previousNames.back());
+        manifest.previous = previous.name;
+        for (auto& file : previous.files) {
+            previousFiles.emplace(file.path, file);
+        }
+    }
+    manifest.name = __newManifestName();
+    {
+        time_t now = time(nullptr);
+        struct tm utc;
+        gmtime_r(&now, &utc);
+        char stamp[32];
+        strftime(stamp, sizeof(stamp), "%Y-%m-%dT%H:%M:%SZ", &utc);
+        manifest.createdAt = stamp;
+    }
+
+    // Базы и CRL: основной УЦ и шарды (без shards.conf - только основной)
+    vector<SourceDatabase> sources;
+    vector<string> crlPaths;
+    set<string> databaseFiles;
+    for (const auto& config : ShardRouter::loadConfig()) {
+        string path = __relative(config.dbPath);
+        crlPaths.push_back(config.crlPath);
+        if (filesystem::exists(path) && databaseFiles.insert(path).second) {
+            for (const char* suffix : {"-wal", "-shm", "-journal"}) {
+                databaseFiles.insert(path + suffix);
+            }
+            sources.push_back({path, config.certsDir, nullptr});
+        }
+    }
+
+    string stagingDir = (filesystem::path(TEMP_PATH) / ("backup-" + to_string(getpid()))).string();
+
+    // Ограничение скорости: после каждой порции ждем, пока средняя скорость не опустится до maxBytesPerSecond
+    auto throttleStarted = chrono::steady_clock::now();
+    unsigned long long throttledBytes = 0;
+    auto throttle = [&](size_t bytes) {
+        if (options.maxBytesPerSecond == 0) {
+            return;
+        }
+        throttledBytes += bytes;
+        this_thread::sleep_until(throttleStarted + chrono::microseconds(throttledBytes * 1000000 / options.maxBytesPerSecond));
+    };
+    struct Staged {
+        BackupFileEntry entry;
+        bool pinned = false;    // содержимое прочитано под блокировками
+        string content;
+        string stagedPath;      // жесткая ссылка сверх maxPinnedBytes; пусто и не pinned - файл не изменился
+    };
+    vector<Staged> staged;
+    unsigned long long pinnedBytes = 0;
+    vector<string> writtenObjects;     // новые объекты без fsync: сбрасываются перед манифестом
+
+    try {
+        // Снимок: блокировки CRL, читающие транзакции и жесткие ссылки на файлы
+        auto snapshotStarted = chrono::steady_clock::now();
+        {
+            vector<unique_ptr<CRLFileLock>> locks;
+            sort(crlPaths.begin(), crlPaths.end());
+            crlPaths.erase(unique(crlPaths.begin(), crlPaths.end()), crlPaths.end());
+            for (const auto& crlPath : crlPaths) {
+                if (filesystem::is_directory(filesystem::path(crlPath).parent_path())) {
+                    locks.push_back(make_unique<CRLFileLock>(crlPath));
+                }
+            }
+
+            for (auto& source : sources) {
+                if (sqlite3_open_v2(source.path.c_str(), &source.connection, SQLITE_OPEN_READWRITE, nullptr) != SQLITE_OK) {
+                    throw runtime_error("CABackup: не удалось открыть базу " + source.path + ".");
+                }
+                sqlite3_busy_timeout(source.connection, 5000);
+                // Без WAL читающая транзакция блокировала бы запись на все время копирования
+                sqlite3_stmt* stmt = nullptr;
+                bool wal = sqlite3_prepare_v2(source.connection, "PRAGMA journal_mode = WAL;", -1, &stmt, nullptr) == SQLITE_OK &&
+                           sqlite3_step(stmt) == SQLITE_ROW &&
+                           string(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0))) == "wal";
+                sqlite3_finalize(stmt);
+                stmt = nullptr;
+                if (!wal) {
+                    throw runtime_error("CABackup: не удалось перевести базу " + source.path + " в режим WAL.");
+                }
+                // Первое чтение внутри BEGIN фиксирует снимок базы до конца резервного копирования
+                if (sqlite3_exec(source.connection, "BEGIN;", nullptr, nullptr, nullptr) != SQLITE_OK ||
+                    sqlite3_prepare_v2(source.connection, "SELECT COALESCE(MAX(seq), 0) FROM events;", -1, &stmt, nullptr) != SQLITE_OK ||
+                    sqlite3_step(stmt) != SQLITE_ROW) {
+                    sqlite3_finalize(stmt);
+                    throw runtime_error("CABackup: не удалось начать снимок " + source.path + ": " + sqlite3_errmsg(source.connection));
+                }
+                BackupDatabaseEntry database;
+                database.path = source.path;
+                database.eventSeq = sqlite3_column_int64(stmt, 0);
+                manifest.databases.push_back(database);
+                sqlite3_finalize(stmt);
+            }
+
+            if (filesystem::is_directory(options.caDir)) {
+                for (auto iterator = filesystem::recursive_directory_iterator(options.caDir); iterator != filesystem::recursive_directory_iterator(); ++iterator) {
+                    string path = __relative(iterator->path().string());
+                    if (iterator->is_directory()) {
+                        if (path == __relative(TEMP_PATH)) {
+                            iterator.disable_recursion_pending();
+                        }
+                        manifest.directories.emplace_back(path, static_cast<unsigned>(iterator->status().permissions()));
+                        continue;
+                    }
+                    string fileName = iterator->path().filename().string();
+                    if (!iterator->is_regular_file() || databaseFiles.count(path) || fileName.ends_with(".lock") ||
+                        fileName.find(".tmp.") != string::npos) {
+                        continue;
+                    }
+
+                    struct stat info;
+                    if (lstat(path.c_str(), &info) != 0) {
+                        continue;
+                    }
+                    Staged file;
+                    file.entry = {path, static_cast<unsigned>(info.st_mode & 07777), static_cast<unsigned long long>(info.st_size),
+                                  static_cast<long long>(info.st_mtim.tv_sec) * 1000000000LL + info.st_mtim.tv_nsec,
+                                  static_cast<unsigned long long>(info.st_ino), ""};
+
+                    auto previous = previousFiles.find(path);
+                    if (previous != previousFiles.end() && previous->second.size == file.entry.size &&
+                        previous->second.mtime == file.entry.mtime && previous->second.inode == file.entry.inode) {
+                        file.entry.object = previous->second.object;
+                        ++report.filesUnchanged;
+                    } else if (pinnedBytes + file.entry.size <= options.maxPinnedBytes) {
+                        // Размер, время и inode берутся у открытого файла: его могли заменить после lstat
+                        if (file.entry.size > 0) {
+                            MappedFile mapped(path);
+                            if (!mapped.isOpen()) {
+                                continue;
+                            }
+                            const struct stat& opened = mapped.status();
+                            file.entry.mode = static_cast<unsigned>(opened.st_mode & 07777);
+                            file.entry.size = static_cast<unsigned long long>(opened.st_size);
+                            file.entry.mtime = static_cast<long long>(opened.st_mtim.tv_sec) * 1000000000LL + opened.st_mtim.tv_nsec;
+                            file.entry.inode = static_cast<unsigned long long>(opened.st_ino);
+                            file.content.assign(reinterpret_cast<const char*>(mapped.data()), mapped.size());
+                        }
+                        file.pinned = true;
+                        pinnedBytes += file.entry.size;
+                    } else {
+                        file.stagedPath = (filesystem::path(stagingDir) / path).string();
+                        filesystem::create_directories(filesystem::path(file.stagedPath).parent_path());
+                        // Другая файловая система: ссылку не создать, файл копируется сразу
+                        if (link(path.c_str(), file.stagedPath.c_str()) != 0) {
+                            filesystem::copy_file(path, file.stagedPath, filesystem::copy_options::overwrite_existing);
+                        }
+                    }
+                    staged.push_back(move(file));
+                }
+            }
+        }
+        report.snapshotMs = chrono::duration<double, milli>(chrono::steady_clock::now() - snapshotStarted).count();
+
+        // Каждая строка issuing_certs снимка должна найти свой файл в копии
+        set<string> capturedPaths;
+        for (const auto& file : staged) {
+            capturedPaths.insert(file.entry.path);
+        }
+        for (auto& source : sources) {
+            sqlite3_stmt* stmt = nullptr;
+            if (sqlite3_prepare_v2(source.connection, "SELECT DISTINCT certName FROM issuing_certs;", -1, &stmt, nullptr) != SQLITE_OK) {
+                sqlite3_finalize(stmt);
+                continue;
+            }
+            while (sqlite3_step(stmt) == SQLITE_ROW) {
+                const unsigned char* certName = sqlite3_column_text(stmt, 0);
+                string certPath = __relative((filesystem::path(source.certsDir) / (certName ? reinterpret_cast<const char*>(certName) : "")).string());
+                if (!capturedPaths.count(certPath) && !capturedPaths.count(__relative(ObjectLoader::derPathFor(certPath)))) {
+                    manifest.missing.push_back(certPath);
+                }
+            }
+            sqlite3_finalize(stmt);
+        }
+
+        // Копии баз из зафиксированных снимков небольшими шагами. Копия собирается в памяти: временный файл
+        // на диске выпуска добавлял бы создание, запись и удаление файла в журнал ФС, общий с fsync выпуска
+        for (size_t i = 0; i < sources.size(); ++i) {
+            BackupDatabaseEntry& database = manifest.databases[i];
+            sqlite3* destination = nullptr;
+            if (sqlite3_open(":memory:", &destination) != SQLITE_OK) {
+                sqlite3_close(destination);
+                throw runtime_error("CABackup: не удалось создать копию базы " + database.path + " в памяти.");
+            }
+            // Копия в памяти принимает страницы только своего размера
+            sqlite3_stmt* stmt = nullptr;
+            if (sqlite3_prepare_v2(sources[i].connection, "PRAGMA page_size;", -1, &stmt, nullptr) == SQLITE_OK &&
+                sqlite3_step(stmt) == SQLITE_ROW) {
+                string pragma = "PRAGMA page_size = " + to_string(sqlite3_column_int(stmt, 0)) + ";";
+                sqlite3_exec(destination, pragma.c_str(), nullptr, nullptr, nullptr);
+            }
+            sqlite3_finalize(stmt);
+            sqlite3_backup* backup = sqlite3_backup_init(destination, "main", sources[i].connection, "main");
+            int resultCode = backup ? SQLITE_OK : SQLITE_ERROR;
+            while (backup && (resultCode = sqlite3_backup_step(backup, options.stepPages)) == SQLITE_OK) {
+                ++report.dbSteps;
+                this_thread::sleep_for(options.stepPause);
+            }
+            if (backup) {
+                ++report.dbSteps;
+                sqlite3_backup_finish(backup);
+            }
+            sqlite3_int64 copySize = 0;
+            unsigned char* copy = resultCode == SQLITE_DONE ? sqlite3_serialize(destination, "main", &copySize, 0) : nullptr;
+            string error = sqlite3_errmsg(destination);
+            sqlite3_close(destination);
+            if (!copy) {
+                throw runtime_error("CABackup: не удалось скопировать базу " + database.path + ": " + error);
+            }
+            unique_ptr<unsigned char, decltype(&sqlite3_free)> copyGuard(copy, sqlite3_free);
+            sqlite3_exec(sources[i].connection, "ROLLBACK;", nullptr, nullptr, nullptr);
+            sqlite3_close(sources[i].connection);
+            sources[i].connection = nullptr;
+
+            // Сегменты кратны странице: изменение строки меняет только сегменты с ее страницами
+            database.pageSize = (copy[16] << 8) | copy[17];
+            database.pageSize = database.pageSize == 1 ? 65536 : database.pageSize;
+            database.size = static_cast<unsigned long long>(copySize);
+            size_t segmentBytes = max<size_t>(database.pageSize, options.segmentBytes / database.pageSize * database.pageSize);
+            for (size_t offset = 0; offset < database.size; offset += segmentBytes) {
+                size_t length = min<size_t>(segmentBytes, database.size - offset);
+                string hash = __sha256(copy + offset, length);
+                if (__storeObject(hash, copy + offset, length)) {
+                    writtenObjects.push_back(__objectPath(hash));
+                    ++report.objectsWritten;
+                    report.bytesWritten += length;
+                }
+                database.segments.emplace_back(hash, length);
+                throttle(length);
+            }
+        }
+
+        // Измененные файлы: прочитанные под блокировками или из закрепленных ссылок
+        for (auto& file : staged) {
+            if (file.pinned || !file.stagedPath.empty()) {
+                string content = std::move(file.content);
+                if (!file.pinned && file.entry.size > 0) {
+                    MappedFile mapped(file.stagedPath);
+                    if (!mapped.isOpen()) {
+                        throw runtime_error("CABackup: не удалось прочитать " + file.entry.path + ".");
+                    }
+                    content.assign(reinterpret_cast<const char*>(mapped.data()), mapped.size());
+                }
+                file.entry.size = content.size();
+                file.entry.object = __sha256(content.data(), content.size());
+                if (__storeObject(file.entry.object, content.data(), content.size())) {
+                    writtenObjects.push_back(__objectPath(file.entry.object));
+                    ++report.objectsWritten;
+                    report.bytesWritten += content.size();
+                }
+                throttle(content.size());
+            }
+            manifest.files.push_back(file.entry);
+        }
+    } catch (...) {
+        __closeSources(sources);
+        error_code ignored;
+        filesystem::remove_all(stagingDir, ignored);
+        throw;
+    }
+    error_code ignored;
+    filesystem::remove_all(stagingDir, ignored);
+
+    // Манифест пишется последним: незавершенная копия оставляет только лишние объекты. Сначала дожидаемся
+    // данных всех объектов, затем fsync: иначе первый же коммит журнала ждал бы данные остальных
+    for (int pass = 0; pass < 2; ++pass) {
+        for (const auto& path : writtenObjects) {
+            int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            bool synced = fd >= 0 && (pass == 0 ? sync_file_range(fd, 0, 0, SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+                                                                             SYNC_FILE_RANGE_WAIT_AFTER) == 0
+                                                : __flush(fd));
+            if (fd >= 0) {
+                close(fd);
+            }
+            if (!synced) {
+                throw runtime_error("CABackup: не удалось сбросить на диск объект " + path + ".");
+            }
+        }
+    }
+    __writeManifest(manifest);
+    report.totalMs = chrono::duration<double, milli>(chrono::steady_clock::now() - started).count();
+    return report;
+}
+
+
+inline void CABackup::restore(const string& name, const string& targetDir) const {
+    BackupManifest manifest = readManifest(name);
+    auto readObject = [this](const string& hash, unsigned long long size) {
+        MappedFile object(__objectPath(hash));
+        if (size > 0 && (!object.isOpen() || object.size() != size)) {
+            throw runtime_error("CABackup: объект " + hash + " отсутствует или поврежден.");
+        }
+        return size > 0 ? string(reinterpret_cast<const char*>(object.data()), object.size()) : string();
+    };
+
+    for (const auto& [path, mode] : manifest.directories) {
+        filesystem::path directory = filesystem::path(targetDir) / path;
+        filesystem::create_directories(directory);
+        filesystem::permissions(directory, static_cast<filesystem::perms>(mode));
+    }
+    for (const auto& database : manifest.databases) {
+        string content;
+        content.reserve(database.size);
+        for (const auto& [hash, length] : database.segments) {
+            content += readObject(hash, length);
+        }
+        __writeFile((filesystem::path(targetDir) / database.path).string(), content.data(), content.size(), 0600);
+    }
+    for (const auto& file : manifest.files) {
+        string content = readObject(file.object, file.size);
+        __writeFile((filesystem::path(targetDir) / file.path).string(), content.data(), content.size(), file.mode);
+    }
+}
+
+
+inline BackupVerifyReport CABackup::verify(const string& name) const {
+    BackupManifest manifest = readManifest(name);
+    map<string, unsigned long long> objects;
+    for (const auto& database : manifest.databases) {
+        for (const auto& [hash, length] : database.segments) {
+            objects.emplace(hash, length);
+        }
+    }
+    for (const auto& file : manifest.files) {
+        objects.emplace(file.object, file.size);
+    }
+
+    BackupVerifyReport report;
+    for (const auto& [hash, length] : objects) {
+        ++report.objects;
+        if (length == 0) {
+            continue;
+        }
+        MappedFile object(__objectPath(hash));
+        if (!object.isOpen()) {
+            ++report.missingObjects;
+        } else if (object.size() != length || __sha256(object.data(), object.size()) != hash) {
+            ++report.corruptedObjects;
+        }
+    }
+    return report;
+}
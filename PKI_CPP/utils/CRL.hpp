@@ -2,8 +2,14 @@
 
 #include <iostream>
 #include <fstream>
+#include <cerrno>
 #include <ctime>
 #include <limits> 
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <set>
+#include <vector>
 
 #include <openssl/x509.h> 
 #include <openssl/x509v3.h>      
@@ -11,41 +17,80 @@
 #include <openssl/bio.h>        
 #include <openssl/err.h>
 
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+
 #include "../db/database.h"
+#include "./Handles.hpp"
+#include "./ObjectLoader.hpp"
+#include "./OutputFormat.hpp"
 
 
-#define CRL_UPDATE_TIME 30 // период обновления crl (дней)
+#define CRL_UPDATE_TIME 30 // срок действия crl (дней): nextUpdate = lastUpdate + CRL_UPDATE_TIME; переподпись заранее - CRLScheduler
 
 using namespace std;
 
+// Коды CRLReason по RFC 5280 (значение 7 не используется)
 enum RevocationReason {
-    KeyCompromise = 0,
-    CACompromise = 1,
-    AffiliationChanged = 2,
-    Superseded = 3,
-    CessationOfOperation = 4,
-    CertificateHold = 5,
-    RemoveFromCRL = 6,
-    PrivilegeWithdrawn = 7,
-    AccessDenied = 8
+    Unspecified = 0,
+    KeyCompromise = 1,
+    CACompromise = 2,
+    AffiliationChanged = 3,
+    Superseded = 4,
+    CessationOfOperation = 5,
+    CertificateHold = 6,
+    RemoveFromCRL = 8,
+    PrivilegeWithdrawn = 9,
+    AccessDenied = 10   // aACompromise
+};
+
+// Блокировка CRL между процессами (flock на crlPath.lock): отзыв и переподпись не затирают друг друга
+class CRLFileLock {
+private:
+    int fd = -1;
+public:
+    explicit CRLFileLock(const string &crlPath);
+    ~CRLFileLock() { if (fd >= 0) close(fd); }
+
+    CRLFileLock(const CRLFileLock&) = delete;
+    CRLFileLock& operator=(const CRLFileLock&) = delete;
 };
 
 class CRL {
 private:
-    int __getRevocationReason();
+    static void __signCRL(X509_CRL *crl, EVP_PKEY *privateKey, int validityDays);
+    // Пары (временный файл, файл назначения) для каждого формата из OutputFormats::current().crl
+    using TempFiles = vector<pair<string, string>>;
+    static TempFiles __writeTempCRL(X509_CRL *crl, const string &crlPath);
+    // Заменяет файлы CRL, сохраняя прежние под временными именами: пары (копия прежнего или пусто, файл назначения)
+    static TempFiles __replaceCRL(const TempFiles &tempFiles);
+    static void __restoreCRL(const TempFiles &previous);
+    static void __commitCRL(const TempFiles &previous, const string &crlPath);
+    static void __discardTempCRL(const TempFiles &tempFiles);
+    // Публикует подписанный crl внутри транзакции базы: update получает шаг замены файлов для beforeCommit
+    static void __publishWithTransaction(X509_CRL *crl, const string &crlPath, const function<void(const function<void()>&)>& update);
 public:
     CRL(const string& crlPath, EVP_PKEY *privateKey, X509 *emitetCert) {
         createCRL(crlPath, privateKey, emitetCert);
     }
 
     void createCRL(const string& crlPath, EVP_PKEY *privateKey, X509 *emitetCert);
-    void regenerateCRL(const string &crlPath, EVP_PKEY *privateKey);
+    static void regenerateCRL(const string &crlPath, EVP_PKEY *privateKey);
+    // Подписывает crl с новыми lastUpdate/nextUpdate и атомарно заменяет файл: читатели видят старый или новый CRL целиком
+    static void publishCRL(X509_CRL *crl, const string &crlPath, EVP_PKEY *privateKey, int validityDays = CRL_UPDATE_TIME);
+    static X509CrlPtr readCRL(const string &crlPath);
     void addRevokedCertificate(const string &crlPath, X509* revokedCert, EVP_PKEY *privateKey, Database& db);
+    void addRevokedCertificate(const string &crlPath, X509* revokedCert, EVP_PKEY *privateKey, Database& db, int reasonCode);
+    static size_t revokeSerials(const string &crlPath, const vector<string> &serials, EVP_PKEY *privateKey, Database& db, int reasonCode);
+    static size_t releaseSerials(const string &crlPath, const vector<string> &serials, EVP_PKEY *privateKey, Database& db);
+    static X509RevokedPtr buildRevokedEntry(const string &serial, int reasonCode, time_t revocationTime);
+    static int getRevocationReason();
     static void displayCRLlist(const string& crlPath);
 };
 
 
-int CRL::__getRevocationReason() {
+inline int CRL::getRevocationReason() {
     int reasonCode;
     while (true) {
         cout << "Выберите причину отзыва сертификата:" << endl;
@@ -67,157 +112,385 @@ int CRL::__getRevocationReason() {
             cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n'); 
             cerr << "Неверный ввод. Пожалуйста, введите число от 0 до 8." << endl;
         } else {
-            return reasonCode; 
+            // номер пункта меню переводится в код причины RFC 5280
+            static const RevocationReason menuReasons[] = {
+                KeyCompromise, CACompromise, AffiliationChanged, Superseded, CessationOfOperation,
+                CertificateHold, RemoveFromCRL, PrivilegeWithdrawn, AccessDenied
+            };
+            return menuReasons[reasonCode]; 
         }
     }
 }
 
 
-void CRL::createCRL(const string& crlPath, EVP_PKEY *privateKey, X509 *emitetCert) {
-    X509_CRL *crl = X509_CRL_new();
+inline void CRL::createCRL(const string& crlPath, EVP_PKEY *privateKey, X509 *emitetCert) {
+    X509CrlPtr crl(X509_CRL_new());
     if (!crl) {
         cerr << "Failed to create CRL object." << endl;
+        return;
     }
 
-    X509_CRL_set_version(crl, 2);
+    X509_CRL_set_version(crl.get(), 1); // v2
 
     // Устанавливаем эмитента
     X509_NAME *issuerName = X509_get_subject_name(emitetCert);
-    X509_CRL_set_issuer_name(crl, issuerName);
+    X509_CRL_set_issuer_name(crl.get(), issuerName);
 
-    // Устанавливаем время создания и обновления
-    ASN1_TIME *now = ASN1_TIME_new();
-    ASN1_TIME_set(now, time(nullptr));
-    X509_CRL_set_lastUpdate(crl, now);
+    // Время создания и обновления устанавливается при подписи
+    try {
+        publishCRL(crl.get(), crlPath, privateKey);
+    } catch (const std::runtime_error& e) {
+        cerr << e.what() << endl;
+        return;
+    }
+
+    cout << "CRL успешно создан.\n";
+}
 
-    ASN1_TIME *nextUpdate = ASN1_TIME_new();
-    ASN1_TIME_adj(nextUpdate, time(nullptr), CRL_UPDATE_TIME, 0); 
-    X509_CRL_set_nextUpdate(crl, nextUpdate);
 
-    // Подписываем CRL
-    if (!X509_CRL_sign(crl, privateKey, EVP_sha256())) {
-        cerr << "Failed to sign CRL." << endl;
-        X509_CRL_free(crl);
+inline CRLFileLock::CRLFileLock(const string &crlPath) {
+    string lockPath = crlPath + ".lock";
+    fd = open(lockPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0 || flock(fd, LOCK_EX) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        throw runtime_error("CRL: не удалось заблокировать " + lockPath + ".");
     }
+}
+
+
+// Обновляет время выпуска CRL и подписывает его; nextUpdate отстоит от lastUpdate на validityDays дней
+inline void CRL::__signCRL(X509_CRL *crl, EVP_PKEY *privateKey, int validityDays) {
+    time_t now = time(nullptr);
 
-    // Сохраняем CRL в файл
-    FILE *file = fopen(crlPath.c_str(), "wb");
-    if (!file || !PEM_write_X509_CRL(file, crl)) {
-        cerr << "Failed to write CRL to file." << endl;
-        fclose(file);
-        X509_CRL_free(crl);
+    Asn1TimePtr lastUpdate(ASN1_TIME_set(nullptr, now));
+    X509_CRL_set1_lastUpdate(crl, lastUpdate.get());
+
+    Asn1TimePtr nextUpdate(ASN1_TIME_adj(nullptr, now, validityDays, 0));
+    X509_CRL_set1_nextUpdate(crl, nextUpdate.get());
+
+    if (!X509_CRL_sign(crl, privateKey, digestForKey(privateKey))) {
+        throw runtime_error("Failed to sign CRL.");
     }
+}
 
-    cout << "CRL успешно создан.\n";
 
-    fclose(file);
-    X509_CRL_free(crl);
+// Пишет CRL во временные файлы рядом с crlPath (PEM и/или DER, по настройке формата) и сбрасывает их
+// на диск. Имена не оканчиваются на .pem или .der, поэтому раздача CRL их не подхватывает
+inline CRL::TempFiles CRL::__writeTempCRL(X509_CRL *crl, const string &crlPath) {
+    TempFiles tempFiles;
+    for (const auto& [target, content] : Artifacts::encodeCRL(crl, crlPath, OutputFormats::current().crl)) {
+        string tempPath = target + ".tmp." + to_string(getpid());
+        int fd = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        bool written = fd >= 0;
+        for (size_t offset = 0; written && offset < content.size();) {
+            ssize_t chunk = write(fd, content.data() + offset, content.size() - offset);
+            written = chunk > 0;
+            offset += written ? chunk : 0;
+        }
+        written = written && fsync(fd) == 0;
+        if (fd >= 0) {
+            close(fd);
+        }
+        if (!written) {
+            unlink(tempPath.c_str());
+            __discardTempCRL(tempFiles);
+            throw runtime_error("Failed to open CRL file for writing.");
+        }
+        tempFiles.emplace_back(tempPath, target);
+    }
+    return tempFiles;
 }
 
 
-void CRL::regenerateCRL(const string &crlPath, EVP_PKEY *privateKey) {
-    FILE *file = fopen(crlPath.c_str(), "rb");
-    if (!file) {
-        cerr << "Failed to open CRL file." << endl;
+inline void CRL::__discardTempCRL(const TempFiles &tempFiles) {
+    for (const auto& tempFile : tempFiles) {
+        unlink(tempFile.first.c_str());
     }
+}
 
-    X509_CRL *crl = PEM_read_X509_CRL(file, nullptr, nullptr, nullptr);
-    fclose(file);
 
-    if (!crl) {
-        cerr << "Failed to read CRL." << endl;
+// Атомарно заменяет каждый файл CRL. Прежний файл остается жесткой ссылкой, пока замену не подтвердит
+// __commitCRL или не отменит __restoreCRL; если не удалась одна из замен, уже замененные файлы возвращаются
+inline CRL::TempFiles CRL::__replaceCRL(const TempFiles &tempFiles) {
+    TempFiles previous;
+    for (size_t i = 0; i < tempFiles.size(); ++i) {
+        const string& target = tempFiles[i].second;
+        string backupPath = target + ".tmp.prev." + to_string(getpid());
+        unlink(backupPath.c_str());
+        bool saved = link(target.c_str(), backupPath.c_str()) == 0;
+        if ((!saved && errno != ENOENT) || rename(tempFiles[i].first.c_str(), target.c_str()) != 0) {
+            if (saved) {
+                unlink(backupPath.c_str());
+            }
+            __discardTempCRL(TempFiles(tempFiles.begin() + i, tempFiles.end()));
+            __restoreCRL(previous);
+            throw runtime_error("Failed to replace CRL file " + target + ".");
+        }
+        previous.emplace_back(saved ? backupPath : string(), target);
     }
+    return previous;
+}
 
-    // Обновляем время
-    ASN1_TIME *now = ASN1_TIME_new();
-    ASN1_TIME_set(now, time(nullptr));
-    X509_CRL_set_lastUpdate(crl, now);
 
-    ASN1_TIME *nextUpdate = ASN1_TIME_new();
-    ASN1_TIME_adj(nextUpdate, time(nullptr), CRL_UPDATE_TIME, 0);
-    X509_CRL_set_nextUpdate(crl, nextUpdate);
+inline void CRL::__restoreCRL(const TempFiles &previous) {
+    for (const auto& [backupPath, target] : previous) {
+        if (backupPath.empty()) {
+            unlink(target.c_str());
+        } else if (rename(backupPath.c_str(), target.c_str()) != 0) {
+            cerr << "CRL: не удалось вернуть прежний файл " << target << ", он сохранен как " << backupPath << "\n";
+        }
+    }
+}
 
-    // Подписываем CRL заново
-    if (!X509_CRL_sign(crl, privateKey, EVP_sha256())) {
-        cerr << "Failed to re-sign CRL." << endl;
-        X509_CRL_free(crl);
+
+// Удаляет прежние файлы и вариант формата, который больше не публикуется
+inline void CRL::__commitCRL(const TempFiles &previous, const string &crlPath) {
+    for (const auto& [backupPath, target] : previous) {
+        if (!backupPath.empty()) {
+            unlink(backupPath.c_str());
+        }
+    }
+    for (const auto& path : Artifacts::staleVariants(crlPath, OutputFormats::current().crl)) {
+        unlink(path.c_str());
     }
+}
+
 
-    // Сохраняем обновлённый CRL
-    file = fopen(crlPath.c_str(), "wb");
-    if (!file || !PEM_write_X509_CRL(file, crl)) {
-        cerr << "Failed to write CRL to file." << endl;
-        fclose(file);
-        X509_CRL_free(crl);
+inline void CRL::__publishWithTransaction(X509_CRL *crl, const string &crlPath, const function<void(const function<void()>&)>& update) {
+    const TempFiles tempFiles = __writeTempCRL(crl, crlPath);
+    TempFiles previous;
+    bool replaced = false;
+    try {
+        update([&] {
+            previous = __replaceCRL(tempFiles);
+            replaced = true;
+        });
+    } catch (...) {
+        if (replaced) {
+            __restoreCRL(previous);
+        } else {
+            __discardTempCRL(tempFiles);
+        }
+        throw;
     }
+    __commitCRL(previous, crlPath);
+}
 
-    fclose(file);
-    X509_CRL_free(crl);
+
+inline void CRL::publishCRL(X509_CRL *crl, const string &crlPath, EVP_PKEY *privateKey, int validityDays) {
+    __signCRL(crl, privateKey, validityDays);
+    __commitCRL(__replaceCRL(__writeTempCRL(crl, crlPath)), crlPath);
 }
 
 
-void CRL::addRevokedCertificate(const string &crlPath, X509* revokedCert, EVP_PKEY *privateKey, Database& db) {
-    FILE *file = fopen(crlPath.c_str(), "rb");
-    if (!file) {
-        cerr << "Failed to open CRL file." << endl;
+inline X509CrlPtr CRL::readCRL(const string &crlPath) {
+    // Вызывающие изменяют и переподписывают CRL, поэтому берется собственная копия, а не объект из кэша
+    X509CrlPtr crl = ObjectLoader::loadCRL(crlPath, false);
+    if (!crl) {
+        cerr << "Failed to read CRL." << endl;
+        return nullptr;
     }
 
-    X509_CRL *crl = PEM_read_X509_CRL(file, nullptr, nullptr, nullptr);
-    fclose(file);
+    return crl;
+}
+
 
+inline void CRL::regenerateCRL(const string &crlPath, EVP_PKEY *privateKey) {
+    CRLFileLock lock(crlPath);
+    X509CrlPtr crl = readCRL(crlPath);
     if (!crl) {
-        cerr << "Failed to read CRL." << endl;
+        return;
     }
 
-    // Создаём новую запись
-    X509_REVOKED *revoked = X509_REVOKED_new();
-    if (!revoked) {
-        cerr << "Failed to create revoked entry." << endl;
-        X509_CRL_free(crl);
+    try {
+        publishCRL(crl.get(), crlPath, privateKey);
+    } catch (const std::runtime_error& e) {
+        cerr << e.what() << endl;
     }
+}
 
 
-    // Устанавливаем серийный номер
-    const ASN1_INTEGER* serial = X509_get_serialNumber(revokedCert);
-    BIGNUM* serialBN = ASN1_INTEGER_to_BN(serial, nullptr);
-    char* serialStr = BN_bn2dec(serialBN);
+// Запись CRL для сертификата с серийным номером в десятичном виде
+inline X509RevokedPtr CRL::buildRevokedEntry(const string &serial, int reasonCode, time_t revocationTime) {
+    X509RevokedPtr revoked(X509_REVOKED_new());
+    if (!revoked) {
+        throw runtime_error("Failed to create revoked entry.");
+    }
 
-    ASN1_INTEGER *asn1Serial = s2i_ASN1_INTEGER(nullptr, serialStr);
-    X509_REVOKED_set_serialNumber(revoked, asn1Serial);
+    // Устанавливаем серийный номер
+    Asn1IntegerPtr asn1Serial(s2i_ASN1_INTEGER(nullptr, serial.c_str()));
+    if (!asn1Serial) {
+        throw runtime_error("Invalid serial number: " + serial);
+    }
+    X509_REVOKED_set_serialNumber(revoked.get(), asn1Serial.get());
 
-    // Устанавливаем дату отзыва на сегодняшнюю дату
-    ASN1_TIME *revocationDate = ASN1_TIME_new();
-    time_t currentTime = time(nullptr); 
-    ASN1_TIME_set(revocationDate, currentTime); 
-    X509_REVOKED_set_revocationDate(revoked, revocationDate); 
+    // Устанавливаем дату отзыва
+    Asn1TimePtr revocationDate(ASN1_TIME_set(nullptr, revocationTime));
+    X509_REVOKED_set_revocationDate(revoked.get(), revocationDate.get());
 
     // Устанавливаем причину отзыва
-    int reasonCode = __getRevocationReason();
-
     if (reasonCode >= 0) {
-        ASN1_ENUMERATED *reason = ASN1_ENUMERATED_new();
-        ASN1_ENUMERATED_set(reason, reasonCode);
-        X509_REVOKED_add1_ext_i2d(revoked, NID_crl_reason, reason, 0, 0);
-        ASN1_ENUMERATED_free(reason);
+        Asn1EnumeratedPtr reason(ASN1_ENUMERATED_new());
+        ASN1_ENUMERATED_set(reason.get(), reasonCode);
+        X509_REVOKED_add1_ext_i2d(revoked.get(), NID_crl_reason, reason.get(), 0, 0);
     }
 
-    // Добавляем запись в CRL
-    X509_CRL_add0_revoked(crl, revoked);
+    return revoked;
+}
+
+
+inline void CRL::addRevokedCertificate(const string &crlPath, X509* revokedCert, EVP_PKEY *privateKey, Database& db) {
+    addRevokedCertificate(crlPath, revokedCert, privateKey, db, getRevocationReason());
+}
 
-    regenerateCRL(crlPath, privateKey);
 
-    fclose(file);
-    X509_CRL_free(crl);
-    cout << "Сертификат " + string(serialStr) + " был отозван.\n";
+inline void CRL::addRevokedCertificate(const string &crlPath, X509* revokedCert, EVP_PKEY *privateKey, Database& db, int reasonCode) {
+    string serialStr = serialToDecimal(X509_get_serialNumber(revokedCert));
 
     try {
-        db.actionWithIssuerCert(serialStr, "revoked");
+        revokeSerials(crlPath, {serialStr}, privateKey, db, reasonCode);
     } catch (const std::runtime_error& e) {
-        cerr << "Error executing query to update certificate status: " << e.what() << endl;
+        cerr << e.what() << endl;
+        return;
     }
+
+    cout << "Сертификат " + serialStr + " был отозван.\n";
 }
 
-void CRL::displayCRLlist(const string& crlPath) {
-    std::string command = "openssl crl -in " + crlPath + " -text -noout";
-    int result = system(command.c_str());
+
+// Список номеров для сообщения об ошибке
+inline string joinSerials(const vector<string> &serials) {
+    string result;
+    for (const auto& serial : serials) {
+        result += (result.empty() ? "" : ", ") + serial;
+    }
+    return result;
+}
+
+
+// Отзывает набор сертификатов: все записи добавляются в CRL, который подписывается один раз,
+// статусы в issuing_certs обновляются одной транзакцией. Новый CRL пишется во временный файл и заменяет
+// старый внутри этой транзакции перед COMMIT; если не удалась замена, транзакция откатывается, а если
+// COMMIT - возвращается прежний CRL, поэтому при ошибке CRL и база не расходятся.
+// Номера, которых нет среди выданных сертификатов, отклоняются целиком; в CRL попадают только действующие,
+// а у приостановленных (CertificateHold) при окончательном отзыве заменяется причина в записи CRL.
+inline size_t CRL::revokeSerials(const string &crlPath, const vector<string> &serials, EVP_PKEY *privateKey, Database& db, int reasonCode) {
+    CRLFileLock lock(crlPath);
+    vector<string> unknown = db.selectUnknownSerials(serials);
+    if (!unknown.empty()) {
+        throw runtime_error("revokeSerials: сертификаты не выдавались этим УЦ: " + joinSerials(unknown) + ".");
+    }
+    RevocationQuery activeQuery;
+    activeQuery.serials = serials;
+    vector<string> active = db.selectSerialsForRevocation(activeQuery);
+    const vector<string> suspended = reasonCode != CertificateHold ? db.selectSuspendedSerials(serials) : vector<string>();
+    const set<string> escalated(suspended.begin(), suspended.end());
+
+    X509CrlPtr crl = readCRL(crlPath);
+    if (!crl) {
+        throw runtime_error("revokeSerials: не удалось прочитать CRL " + crlPath + ".");
+    }
+
+    // Серийные номера, уже присутствующие в CRL, повторно не добавляются; у приостановленных заменяется причина
+    map<string, X509_REVOKED*> listed;
+    STACK_OF(X509_REVOKED)* revokedList = X509_CRL_get_REVOKED(crl.get());
+    for (int i = 0; i < sk_X509_REVOKED_num(revokedList); ++i) {
+        X509_REVOKED* entry = sk_X509_REVOKED_value(revokedList, i);
+        listed.emplace(serialToDecimal(X509_REVOKED_get0_serialNumber(entry)), entry);
+    }
+
+    time_t now = time(nullptr);
+    size_t added = 0;
+    for (const auto& serial : active) {
+        if (listed.count(serial)) {
+            continue;
+        }
+        X509RevokedPtr revoked = buildRevokedEntry(serial, reasonCode, now);
+        listed.emplace(serial, revoked.get());
+        X509_CRL_add0_revoked(crl.get(), revoked.release());
+        ++added;
+    }
+    for (const auto& serial : escalated) {
+        auto entry = listed.find(serial);
+        if (entry == listed.end()) {
+            X509RevokedPtr revoked = buildRevokedEntry(serial, reasonCode, now);
+            listed.emplace(serial, revoked.get());
+            X509_CRL_add0_revoked(crl.get(), revoked.release());
+        } else {
+            Asn1EnumeratedPtr reason(ASN1_ENUMERATED_new());
+            if (!reason || ASN1_ENUMERATED_set(reason.get(), reasonCode) != 1 ||
+                X509_REVOKED_add1_ext_i2d(entry->second, NID_crl_reason, reason.get(), 0, X509V3_ADD_REPLACE) != 1) {
+                throw runtime_error("revokeSerials: не удалось заменить причину отзыва " + serial + ".");
+            }
+        }
+        active.push_back(serial);
+        ++added;
+    }
+
+    // Записи сортируются по серийному номеру, как того ожидают проверяющие стороны
+    X509_CRL_sort(crl.get());
+
+    __signCRL(crl.get(), privateKey, CRL_UPDATE_TIME);
+    __publishWithTransaction(crl.get(), crlPath, [&](const function<void()>& replace) {
+        db.revokeIssuerCerts(active, reasonCode, now, replace);
+    });
+    return added;
+}
+
+
+// Снимает приостановку: записи CertificateHold удаляются из CRL (полный CRL просто перестает их содержать),
+// статусы возвращаются в 'active' одной транзакцией. CRL заменяется внутри нее, как у revokeSerials.
+// Номера, которые не приостановлены (нет в базе, действуют или отозваны по другой причине), отклоняются целиком.
+inline size_t CRL::releaseSerials(const string &crlPath, const vector<string> &serials, EVP_PKEY *privateKey, Database& db) {
+    CRLFileLock lock(crlPath);
+    const vector<string> suspended = db.selectSuspendedSerials(serials);
+    const set<string> released(suspended.begin(), suspended.end());
+    vector<string> rejected;
+    for (const auto& serial : serials) {
+        if (!released.count(serial)) {
+            rejected.push_back(serial);
+        }
+    }
+    if (!rejected.empty()) {
+        throw runtime_error("releaseSerials: сертификаты не приостановлены: " + joinSerials(rejected) + ".");
+    }
+
+    X509CrlPtr crl = readCRL(crlPath);
+    if (!crl) {
+        throw runtime_error("releaseSerials: не удалось прочитать CRL " + crlPath + ".");
+    }
+
+    size_t removed = 0;
+    STACK_OF(X509_REVOKED)* revokedList = X509_CRL_get_REVOKED(crl.get());
+    for (int i = sk_X509_REVOKED_num(revokedList) - 1; i >= 0; --i) {
+        X509_REVOKED* entry = sk_X509_REVOKED_value(revokedList, i);
+        if (!released.count(serialToDecimal(X509_REVOKED_get0_serialNumber(entry)))) {
+            continue;
+        }
+
+        // Из CRL убираются только записи приостановки: отзыв с другой причиной окончателен
+        Asn1EnumeratedPtr reason(static_cast<ASN1_ENUMERATED*>(X509_REVOKED_get_ext_d2i(entry, NID_crl_reason, nullptr, nullptr)));
+        if (!reason || ASN1_ENUMERATED_get(reason.get()) != CertificateHold) {
+            continue;
+        }
+        X509_REVOKED_free(sk_X509_REVOKED_delete(revokedList, i));
+        ++removed;
+    }
+
+    __signCRL(crl.get(), privateKey, CRL_UPDATE_TIME);
+    __publishWithTransaction(crl.get(), crlPath, [&](const function<void()>& replace) {
+        db.releaseIssuerCerts(suspended, replace);
+    });
+    return removed;
+}
+
+inline void CRL::displayCRLlist(const string& crlPath) {
+    string path = ObjectLoader::resolve(crlPath);
+    string inform = !path.empty() && path != crlPath ? " -inform DER" : "";
+    std::string command = "openssl crl -in " + (path.empty() ? crlPath : path) + inform + " -text -noout";
+    if (system(command.c_str()) != 0) {
+        cerr << "displayCRLlist: Ошибка при выводе CRL " << crlPath << "\n";
+    }
 }
@@ -0,0 +1,974 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+#include "../paths.hpp"
+#include "./Handles.hpp"
+#include "./ObjectLoader.hpp"
+#include "./PemCodec.hpp"
+
+using namespace std;
+
+// Раздача CRL и сертификатов УЦ по HTTP для проверяющих сторон.
+//
+// Каталог (DistributionCatalog) отслеживает PEM- и DER-файлы в директориях CRL и сертификатов и для каждого
+// публикует два представления: PEM (имя файла) и DER (имя без ".pem"; если расширения не остается,
+// добавляется ".crl" или ".cer"). Файл x.der публикуется под теми же адресами, что x.pem (см. OutputFormat.hpp);
+// если есть оба, источником служит PEM. Тела хранятся в одном memfd-буфере и отдаются через sendfile,
+// ETag и Last-Modified вычисляются один раз при загрузке файла: Last-Modified - thisUpdate CRL
+// (notBefore сертификата), Expires - nextUpdate. Поэтому периодический опрос неизменного CRL
+// обходится одним ответом 304 без чтения файлов.
+//
+// Сервер (DistributionServer) однопоточный, на epoll, поддерживает GET/HEAD, keep-alive и
+// конвейерные запросы; If-None-Match имеет приоритет над If-Modified-Since. Динамические ресурсы
+// (например, OCSP) подключаются обработчиками по префиксу пути через addHandler().
+
+// Буфер с телами ресурсов; старые области остаются доступны, пока на буфер ссылаются соединения
+struct DistributionArena {
+    int fd = -1;
+    size_t size = 0;
+
+    DistributionArena() {
+        fd = memfd_create("pki-distribution", MFD_CLOEXEC);
+        if (fd < 0) {
+            throw runtime_error("DistributionArena: не удалось создать memfd.");
+        }
+    }
+    ~DistributionArena() { if (fd >= 0) close(fd); }
+
+    DistributionArena(const DistributionArena&) = delete;
+    DistributionArena& operator=(const DistributionArena&) = delete;
+
+    off_t append(const void* data, size_t length) {
+        off_t offset = size;
+        const char* bytes = static_cast<const char*>(data);
+        size_t written = 0;
+        while (written < length) {
+            ssize_t n = pwrite(fd, bytes + written, length - written, offset + written);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                throw runtime_error("DistributionArena: ошибка записи в memfd.");
+            }
+            written += n;
+        }
+        size += length;
+        return offset;
+    }
+};
+
+// Опубликованное представление файла с заранее сформированными заголовками
+struct DistributionResource {
+    shared_ptr<DistributionArena> arena;
+    off_t offset = 0;
+    size_t size = 0;
+    time_t lastModified = 0;
+    time_t nextUpdate = 0;          // 0 - срок не задан (сертификаты)
+    string etag;
+    string contentHeaders;          // Content-Type, Content-Length
+    string validatorHeaders;        // ETag, Last-Modified, Expires
+};
+
+
+class DistributionCatalog {
+private:
+    struct Source {
+        string directory;
+        string urlPrefix;
+        bool isCRL;
+        string fileName;        // непусто - из директории публикуется только этот файл
+    };
+
+    struct FileState {
+        struct timespec modified = {};
+        off_t size = -1;
+        ino_t inode = 0;
+        vector<string> urls;
+    };
+
+    vector<Source> sources;
+    unordered_map<string, FileState> files;
+    unordered_map<string, shared_ptr<const DistributionResource>> resources;
+    shared_ptr<DistributionArena> arena = make_shared<DistributionArena>();
+    size_t liveBytes = 0;
+
+    bool __loadFile(const string& filePath, const Source& source, FileState& state);
+    shared_ptr<const DistributionResource> __makeResource(const string& body, const char* contentType, time_t lastModified, time_t nextUpdate);
+    void __removeUrls(const FileState& state);
+    void __compact();
+
+public:
+    DistributionCatalog();
+
+    // urlPrefix должен начинаться и заканчиваться на '/'
+    void addSource(const string& directory, const string& urlPrefix, bool isCRL);
+    // Отдельный файл, например сертификат УЦ шарда в директории рядом с базой и ключом
+    void addFileSource(const string& filePath, const string& urlPrefix, bool isCRL);
+
+    // Перечитывает только изменившиеся файлы; возвращает число обновленных и удаленных файлов
+    size_t reload();
+
+    shared_ptr<const DistributionResource> find(string_view url) const;
+    vector<string> urls() const;
+
+    static string httpDate(time_t time);
+    static time_t parseHttpDate(const string& value);
+};
+
+
+inline DistributionCatalog::DistributionCatalog() {
+    addSource(CRL_PATH, "/crl/", true);
+    addSource(ROOT_CRL, "/root-crl/", true);
+    addSource(ROOT_CERTS_PATH, "/ca/", false);
+    addSource(ISSUER_CERTS_PATH, "/certs/", false);
+}
+
+
+inline void DistributionCatalog::addSource(const string& directory, const string& urlPrefix, bool isCRL) {
+    sources.push_back({directory, urlPrefix, isCRL, ""});
+}
+
+
+inline void DistributionCatalog::addFileSource(const string& filePath, const string& urlPrefix, bool isCRL) {
+    filesystem::path path(filePath);
+    sources.push_back({path.parent_path().string(), urlPrefix, isCRL, path.filename().string()});
+}
+
+
+inline string DistributionCatalog::httpDate(time_t time) {
+    struct tm parts;
+    gmtime_r(&time, &parts);
+    char buffer[64];
+    strftime(buffer, sizeof(buffer), "%a, %d %b %Y %H:%M:%S GMT", &parts);
+    return buffer;
+}
+
+
+inline time_t DistributionCatalog::parseHttpDate(const string& value) {
+    struct tm parts = {};
+    const char* end = strptime(value.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &parts);
+    if (!end) {
+        return -1;
+    }
+    return timegm(&parts);
+}
+
+
+static time_t __asn1TimeToUnix(const ASN1_TIME* time) {
+    struct tm parts = {};
+    if (!time || ASN1_TIME_to_tm(time, &parts) != 1) {
+        return 0;
+    }
+    return timegm(&parts);
+}
+
+
+inline shared_ptr<const DistributionResource> DistributionCatalog::__makeResource(const string& body, const char* contentType, time_t lastModified, time_t nextUpdate) {
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digestLength = 0;
+    if (EVP_Digest(body.data(), body.size(), digest, &digestLength, EVP_sha256(), nullptr) != 1) {
+        throw runtime_error("DistributionCatalog: не удалось вычислить хэш ресурса.");
+    }
+
+    static const char hexDigits[] = "0123456789abcdef";
+    char timeHex[32];
+    snprintf(timeHex, sizeof(timeHex), "%llx", static_cast<unsigned long long>(lastModified));
+    string etag = string("\"") + timeHex + "-";
+    for (unsigned int i = 0; i < 8; ++i) {
+        etag += hexDigits[digest[i] >> 4];
+        etag += hexDigits[digest[i] & 0x0f];
+    }
+    etag += "\"";
+
+    auto resource = make_shared<DistributionResource>();
+    resource->arena = arena;
+    resource->offset = arena->append(body.data(), body.size());
+    resource->size = body.size();
+    resource->lastModified = lastModified;
+    resource->nextUpdate = nextUpdate;
+    resource->etag = etag;
+    resource->contentHeaders = string("Content-Type: ") + contentType + "\r\nContent-Length: " + to_string(body.size()) + "\r\n";
+    resource->validatorHeaders = "ETag: " + etag + "\r\nLast-Modified: " + httpDate(lastModified) + "\r\n";
+    if (nextUpdate) {
+        resource->validatorHeaders += "Expires: " + httpDate(nextUpdate) + "\r\n";
+    }
+    liveBytes += body.size();
+    return resource;
+}
+
+
+// Читает PEM- или DER-файл и публикует его PEM и DER представления; при ошибке разбора (например, файл
+// дописывается) прежние ресурсы остаются на месте до следующей попытки
+inline bool DistributionCatalog::__loadFile(const string& filePath, const Source& source, FileState& state) {
+    string der;
+    time_t lastModified = 0;
+    time_t nextUpdate = 0;
+
+    if (source.isCRL) {
+        X509CrlPtr crl = ObjectLoader::loadCRL(filePath, false);
+        int length = crl ? i2d_X509_CRL(crl.get(), nullptr) : 0;
+        if (length <= 0) {
+            return false;
+        }
+        der.resize(length);
+        unsigned char* cursor = reinterpret_cast<unsigned char*>(der.data());
+        i2d_X509_CRL(crl.get(), &cursor);
+        lastModified = __asn1TimeToUnix(X509_CRL_get0_lastUpdate(crl.get()));
+        nextUpdate = __asn1TimeToUnix(X509_CRL_get0_nextUpdate(crl.get()));
+    } else {
+        X509Ptr cert = ObjectLoader::loadX509(filePath, false);
+        int length = cert ? i2d_X509(cert.get(), nullptr) : 0;
+        if (length <= 0) {
+            return false;
+        }
+        der.resize(length);
+        unsigned char* cursor = reinterpret_cast<unsigned char*>(der.data());
+        i2d_X509(cert.get(), &cursor);
+        lastModified = __asn1TimeToUnix(X509_get0_notBefore(cert.get()));
+    }
+    string pem = PemCodec::encode(der, source.isCRL ? PEM_STRING_X509_CRL : PEM_STRING_X509);
+
+    // x.der публикуется под именами x.pem и x
+    string stem = filesystem::path(filePath).stem().string();
+    string fileName = stem + ".pem";
+    string derName = filesystem::path(stem).has_extension() ? stem : stem + (source.isCRL ? ".crl" : ".cer");
+
+    string pemUrl = source.urlPrefix + fileName;
+    string derUrl = source.urlPrefix + derName;
+    const char* derType = source.isCRL ? "application/pkix-crl" : "application/pkix-cert";
+
+    auto pemResource = __makeResource(pem, "application/x-pem-file", lastModified, nextUpdate);
+    auto derResource = __makeResource(der, derType, lastModified, nextUpdate);
+
+    __removeUrls(state);
+    resources[pemUrl] = pemResource;
+    resources[derUrl] = derResource;
+    state.urls = {pemUrl, derUrl};
+    return true;
+}
+
+
+inline void DistributionCatalog::__removeUrls(const FileState& state) {
+    for (const auto& url : state.urls) {
+        auto it = resources.find(url);
+        if (it != resources.end()) {
+            liveBytes -= it->second->size;
+            resources.erase(it);
+        }
+    }
+}
+
+
+// Переносит живые тела в новый буфер, когда старые версии занимают больше половины прежнего
+inline void DistributionCatalog::__compact() {
+    auto fresh = make_shared<DistributionArena>();
+    vector<char> buffer;
+    for (auto& [url, resource] : resources) {
+        buffer.resize(resource->size);
+        if (pread(arena->fd, buffer.data(), resource->size, resource->offset) != static_cast<ssize_t>(resource->size)) {
+            throw runtime_error("DistributionCatalog: ошибка чтения memfd при уплотнении.");
+        }
+        auto moved = make_shared<DistributionResource>(*resource);
+        moved->arena = fresh;
+        moved->offset = fresh->append(buffer.data(), buffer.size());
+        resource = moved;
+    }
+    arena = fresh;
+}
+
+
+inline size_t DistributionCatalog::reload() {
+    size_t changed = 0;
+    struct Present {
+        string filePath;
+        const Source* source;
+        struct stat info;
+    };
+    vector<Present> present;
+    unordered_set<string> seen;
+
+    for (const auto& source : sources) {
+        error_code ec;
+        if (!filesystem::is_directory(source.directory, ec)) {
+            continue;
+        }
+        for (const auto& entry : filesystem::directory_iterator(source.directory, ec)) {
+            const string filePath = entry.path().string();
+            const string extension = entry.path().extension().string();
+            if (!source.fileName.empty() && entry.path().filename() != source.fileName) {
+                continue;
+            }
+            if (extension != ".pem" && extension != ".der") {
+                continue;
+            }
+            // DER-вариант рядом с PEM публикует те же адреса: берется PEM
+            if (extension == ".der" && access(filesystem::path(filePath).replace_extension(".pem").c_str(), F_OK) == 0) {
+                continue;
+            }
+            struct stat info;
+            if (stat(filePath.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) {
+                continue;
+            }
+            present.push_back({filePath, &source, info});
+            seen.insert(filePath);
+        }
+    }
+
+    // Исчезнувшие файлы снимаются до загрузки, чтобы не удалить адреса, которые перешли к другому варианту формата
+    for (auto it = files.begin(); it != files.end();) {
+        if (!seen.count(it->first)) {
+            __removeUrls(it->second);
+            it = files.erase(it);
+            ++changed;
+        } else {
+            ++it;
+        }
+    }
+
+    for (const auto& [filePath, source, info] : present) {
+        auto it = files.find(filePath);
+        if (it != files.end() && it->second.inode == info.st_ino && it->second.size == info.st_size &&
+            it->second.modified.tv_sec == info.st_mtim.tv_sec && it->second.modified.tv_nsec == info.st_mtim.tv_nsec) {
+            continue;
+        }
+
+        FileState& state = files[filePath];
+        if (__loadFile(filePath, *source, state)) {
+            state.modified = info.st_mtim;
+            state.size = info.st_size;
+            state.inode = info.st_ino;
+            ++changed;
+        } else {
+            cerr << "DistributionCatalog: не удалось разобрать " << filePath << ", будет повторено." << endl;
+        }
+    }
+
+    if (arena->size > 2 * liveBytes + (1 << 20)) {
+        __compact();
+    }
+    return changed;
+}
+
+
+inline shared_ptr<const DistributionResource> DistributionCatalog::find(string_view url) const {
+    auto it = resources.find(string(url));
+    return it == resources.end() ? nullptr : it->second;
+}
+
+
+inline vector<string> DistributionCatalog::urls() const {
+    vector<string> result;
+    for (const auto& [url, resource] : resources) {
+        result.push_back(url);
+    }
+    sort(result.begin(), result.end());
+    return result;
+}
+
+
+// Ответ динамического обработчика; пустое тело означает 400 Bad Request
+struct DistributionReply {
+    shared_ptr<const string> body;
+    string contentType;
+    string extraHeaders;
+};
+
+// Получает метод, остаток пути после префикса и тело запроса
+using DistributionHandler = function<DistributionReply(string_view method, string_view path, string_view body)>;
+
+
+struct DistributionStats {
+    uint64_t connections = 0;
+    uint64_t ok = 0;
+    uint64_t notModified = 0;
+    uint64_t notFound = 0;
+    uint64_t errors = 0;
+};
+
+
+class DistributionServer {
+private:
+    struct Connection {
+        int fd = -1;
+        uint32_t events = 0;
+        string input;
+        string output;
+        size_t outputOffset = 0;
+        shared_ptr<const DistributionResource> body;
+        off_t bodyOffset = 0;
+        size_t bodyRemaining = 0;
+        bool closeAfterWrite = false;
+        bool peerClosed = false;
+        time_t lastActivity = 0;
+    };
+
+    struct Route {
+        string prefix;
+        DistributionHandler handler;
+    };
+
+    static constexpr size_t MAX_REQUEST_SIZE = 16 * 1024;
+    static constexpr size_t MAX_BODY_SIZE = 64 * 1024;
+
+    DistributionCatalog& catalog;
+    int listenFd = -1;
+    int epollFd = -1;
+    int maxAge;
+    int idleTimeout;
+    size_t maxConnections;
+    unordered_map<int, unique_ptr<Connection>> connections;
+    atomic<bool> stopping{false};
+    vector<Route> routes;
+    DistributionStats stats;
+    time_t dateCachedAt = 0;
+    string dateHeader;
+
+    void __accept();
+    void __onReadable(Connection& conn);
+    bool __processRequests(Connection& conn);
+    void __handleRequest(Connection& conn, string_view request, string_view body);
+    void __respondStatus(Connection& conn, const char* status, const char* extraHeaders = "");
+    bool __flush(Connection& conn);
+    void __updateInterest(Connection& conn);
+    void __close(Connection& conn);
+    void __closeIdle(time_t now);
+    const string& __date(time_t now);
+
+public:
+    DistributionServer(DistributionCatalog& catalog, const string& bindAddress, int port,
+                       int maxAge = 300, int idleTimeout = 30, size_t maxConnections = 10000);
+    ~DistributionServer();
+
+    DistributionServer(const DistributionServer&) = delete;
+    DistributionServer& operator=(const DistributionServer&) = delete;
+
+    // Обслуживает соединения до вызова stop(); каталог перечитывается раз в reloadIntervalMs
+    void run(int reloadIntervalMs = 1000);
+
+    // Запросы с путем, начинающимся с prefix, передаются обработчику (до поиска в каталоге)
+    void addHandler(const string& prefix, DistributionHandler handler) { routes.push_back({prefix, std::move(handler)}); }
+
+    // Безопасен для вызова из обработчика сигнала
+    void stop() { stopping.store(true); }
+
+    const DistributionStats& getStats() const { return stats; }
+};
+
+
+inline DistributionServer::DistributionServer(DistributionCatalog& catalog, const string& bindAddress, int port,
+                                              int maxAge, int idleTimeout, size_t maxConnections)
+    : catalog(catalog), maxAge(maxAge), idleTimeout(idleTimeout), maxConnections(maxConnections) {
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    if (inet_pton(AF_INET, bindAddress.c_str(), &address.sin_addr) != 1) {
+        throw runtime_error("DistributionServer: неверный адрес " + bindAddress + ".");
+    }
+
+    listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd < 0) {
+        throw runtime_error("DistributionServer: не удалось создать сокет.");
+    }
+    int enable = 1;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(listenFd, SOMAXCONN) != 0) {
+        close(listenFd);
+        throw runtime_error("DistributionServer: не удалось открыть порт " + to_string(port) + ": " + strerror(errno) + ".");
+    }
+
+    epollFd = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = listenFd;
+    if (epollFd < 0 || epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event) != 0) {
+        close(listenFd);
+        if (epollFd >= 0) close(epollFd);
+        throw runtime_error("DistributionServer: не удалось инициализировать epoll.");
+    }
+}
+
+
+inline DistributionServer::~DistributionServer() {
+    for (auto& [fd, conn] : connections) {
+        close(fd);
+    }
+    close(epollFd);
+    close(listenFd);
+}
+
+
+inline const string& DistributionServer::__date(time_t now) {
+    if (now != dateCachedAt) {
+        dateCachedAt = now;
+        dateHeader = "Date: " + DistributionCatalog::httpDate(now) + "\r\n";
+    }
+    return dateHeader;
+}
+
+
+inline void DistributionServer::run(int reloadIntervalMs) {
+    catalog.reload();
+    long long nextReload = 0;
+    timespec monotonic;
+    epoll_event events[256];
+
+    while (!stopping.load()) {
+        int count = epoll_wait(epollFd, events, 256, reloadIntervalMs);
+        if (count < 0 && errno != EINTR) {
+            throw runtime_error("DistributionServer: ошибка epoll_wait.");
+        }
+
+        for (int i = 0; i < count; ++i) {
+            if (events[i].data.fd == listenFd) {
+                __accept();
+                continue;
+            }
+            auto it = connections.find(events[i].data.fd);
+            if (it == connections.end()) {
+                continue;
+            }
+            Connection& conn = *it->second;
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                __close(conn);
+                continue;
+            }
+            if (events[i].events & EPOLLOUT) {
+                conn.lastActivity = time(nullptr);
+                if (!__flush(conn) || !__processRequests(conn)) {
+                    continue;
+                }
+                if (conn.peerClosed && conn.output.empty()) {
+                    __close(conn);
+                    continue;
+                }
+            }
+            if (events[i].events & EPOLLIN) {
+                __onReadable(conn);
+            }
+        }
+
+        clock_gettime(CLOCK_MONOTONIC, &monotonic);
+        long long nowMs = monotonic.tv_sec * 1000LL + monotonic.tv_nsec / 1000000;
+        if (nowMs >= nextReload) {
+            nextReload = nowMs + reloadIntervalMs;
+            try {
+                catalog.reload();
+            } catch (const std::runtime_error& ex) {
+                cerr << ex.what() << endl;
+            }
+            __closeIdle(time(nullptr));
+        }
+    }
+}
+
+
+inline void DistributionServer::__accept() {
+    while (true) {
+        int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        if (connections.size() >= maxConnections) {
+            close(fd);
+            ++stats.errors;
+            continue;
+        }
+
+        auto conn = make_unique<Connection>();
+        conn->fd = fd;
+        conn->events = EPOLLIN;
+        conn->lastActivity = time(nullptr);
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        if (epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            close(fd);
+            continue;
+        }
+        connections[fd] = std::move(conn);
+        ++stats.connections;
+    }
+}
+
+
+inline void DistributionServer::__onReadable(Connection& conn) {
+    char buffer[4096];
+    while (true) {
+        ssize_t n = recv(conn.fd, buffer, sizeof(buffer), 0);
+        if (n > 0) {
+            conn.input.append(buffer, n);
+            if (conn.input.size() > MAX_REQUEST_SIZE + MAX_BODY_SIZE) {
+                break;
+            }
+            continue;
+        }
+        if (n == 0) {
+            conn.peerClosed = true;
+        } else if (errno == EINTR) {
+            continue;
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            __close(conn);
+            return;
+        }
+        break;
+    }
+
+    conn.lastActivity = time(nullptr);
+    if (!__processRequests(conn)) {
+        return;
+    }
+    if (conn.peerClosed && conn.output.empty()) {
+        __close(conn);
+    }
+}
+
+
+static string __lowercase(string_view value) {
+    string result(value);
+    for (auto& c : result) {
+        c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+    }
+    return result;
+}
+
+
+static string_view __trim(string_view value) {
+    while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) value.remove_prefix(1);
+    while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) value.remove_suffix(1);
+    return value;
+}
+
+
+// Значение Content-Length из блока заголовков: 0, если заголовка нет, -1 при неверном значении
+// или Transfer-Encoding (chunked не поддерживается)
+static long long __contentLength(string_view headers) {
+    long long length = 0;
+    while (!headers.empty()) {
+        size_t end = headers.find("\r\n");
+        string_view line = headers.substr(0, end);
+        headers = end == string_view::npos ? string_view() : headers.substr(end + 2);
+
+        size_t colon = line.find(':');
+        if (colon == string_view::npos) {
+            continue;
+        }
+        string name = __lowercase(line.substr(0, colon));
+        if (name == "transfer-encoding") {
+            return -1;
+        }
+        if (name == "content-length") {
+            string value(__trim(line.substr(colon + 1)));
+            if (value.empty() || value.find_first_not_of("0123456789") != string::npos || value.size() > 18) {
+                return -1;
+            }
+            length = stoll(value);
+        }
+    }
+    return length;
+}
+
+
+// Обрабатывает накопленные запросы по одному: следующий разбирается только после отправки ответа.
+// Возвращает false, если соединение закрыто
+inline bool DistributionServer::__processRequests(Connection& conn) {
+    while (conn.output.empty()) {
+        size_t end = conn.input.find("\r\n\r\n");
+        if (end == string::npos) {
+            if (conn.input.size() > MAX_REQUEST_SIZE) {
+                conn.closeAfterWrite = true;
+                __respondStatus(conn, "431 Request Header Fields Too Large");
+                return __flush(conn);
+            }
+            return true;
+        }
+
+        long long length = __contentLength(string_view(conn.input).substr(0, end));
+        if (length < 0 || static_cast<size_t>(length) > MAX_BODY_SIZE) {
+            conn.closeAfterWrite = true;
+            __respondStatus(conn, length < 0 ? "400 Bad Request" : "413 Content Too Large");
+            ++stats.errors;
+            return __flush(conn);
+        }
+        if (conn.input.size() < end + 4 + length) {
+            return true;
+        }
+
+        string request = conn.input.substr(0, end);
+        string body = conn.input.substr(end + 4, length);
+        conn.input.erase(0, end + 4 + length);
+        __handleRequest(conn, request, body);
+        if (!__flush(conn)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+// Сравнение по If-None-Match: список меток через запятую или "*", слабые метки (W/) сравниваются по значению
+static bool __etagMatches(string_view header, const string& etag) {
+    while (!header.empty()) {
+        size_t comma = header.find(',');
+        string_view candidate = __trim(header.substr(0, comma));
+        if (candidate.starts_with("W/")) {
+            candidate.remove_prefix(2);
+        }
+        if (candidate == "*" || candidate == etag) {
+            return true;
+        }
+        if (comma == string_view::npos) {
+            break;
+        }
+        header.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+
+inline void DistributionServer::__respondStatus(Connection& conn, const char* status, const char* extraHeaders) {
+    conn.output = string("HTTP/1.1 ") + status + "\r\n" + __date(time(nullptr)) + extraHeaders + "Content-Length: 0\r\n";
+    if (conn.closeAfterWrite) {
+        conn.output += "Connection: close\r\n";
+    }
+    conn.output += "\r\n";
+}
+
+
+inline void DistributionServer::__handleRequest(Connection& conn, string_view request, string_view body) {
+    size_t lineEnd = request.find("\r\n");
+    string_view requestLine = request.substr(0, lineEnd);
+    string_view headers = lineEnd == string_view::npos ? string_view() : request.substr(lineEnd + 2);
+
+    size_t firstSpace = requestLine.find(' ');
+    size_t secondSpace = firstSpace == string_view::npos ? string_view::npos : requestLine.find(' ', firstSpace + 1);
+    if (secondSpace == string_view::npos) {
+        conn.closeAfterWrite = true;
+        __respondStatus(conn, "400 Bad Request");
+        ++stats.errors;
+        return;
+    }
+    string_view method = requestLine.substr(0, firstSpace);
+    string_view target = requestLine.substr(firstSpace + 1, secondSpace - firstSpace - 1);
+    string_view version = requestLine.substr(secondSpace + 1);
+
+    string_view ifNoneMatch;
+    string_view ifModifiedSince;
+    bool keepAlive = version == "HTTP/1.1";
+    while (!headers.empty()) {
+        size_t end = headers.find("\r\n");
+        string_view line = headers.substr(0, end);
+        headers = end == string_view::npos ? string_view() : headers.substr(end + 2);
+
+        size_t colon = line.find(':');
+        if (colon == string_view::npos) {
+            continue;
+        }
+        string name = __lowercase(line.substr(0, colon));
+        string_view value = __trim(line.substr(colon + 1));
+        if (name == "if-none-match") {
+            ifNoneMatch = value;
+        } else if (name == "if-modified-since") {
+            ifModifiedSince = value;
+        } else if (name == "connection") {
+            string lowered = __lowercase(value);
+            if (lowered == "close") keepAlive = false;
+            else if (lowered == "keep-alive") keepAlive = true;
+        }
+    }
+    conn.closeAfterWrite = conn.closeAfterWrite || !keepAlive;
+
+    size_t query = target.find('?');
+    if (query != string_view::npos) {
+        target = target.substr(0, query);
+    }
+
+    bool isHead = method == "HEAD";
+    for (const auto& route : routes) {
+        if (target.starts_with(route.prefix)) {
+            DistributionReply reply;
+            try {
+                reply = route.handler(method, target.substr(route.prefix.size()), body);
+            } catch (const std::exception& ex) {
+                cerr << ex.what() << endl;
+                __respondStatus(conn, "500 Internal Server Error");
+                ++stats.errors;
+                return;
+            }
+            if (!reply.body) {
+                __respondStatus(conn, "400 Bad Request");
+                ++stats.errors;
+                return;
+            }
+            conn.output = "HTTP/1.1 200 OK\r\n" + __date(time(nullptr)) + "Content-Type: " + reply.contentType +
+                          "\r\nContent-Length: " + to_string(reply.body->size()) + "\r\n" + reply.extraHeaders;
+            if (conn.closeAfterWrite) {
+                conn.output += "Connection: close\r\n";
+            }
+            conn.output += "\r\n";
+            if (!isHead) {
+                conn.output += *reply.body;
+            }
+            ++stats.ok;
+            return;
+        }
+    }
+
+    if (method != "GET" && !isHead) {
+        __respondStatus(conn, "405 Method Not Allowed", "Allow: GET, HEAD\r\n");
+        ++stats.errors;
+        return;
+    }
+
+    auto resource = catalog.find(target);
+    if (!resource) {
+        __respondStatus(conn, "404 Not Found");
+        ++stats.notFound;
+        return;
+    }
+
+    time_t now = time(nullptr);
+    long long age = maxAge;
+    if (resource->nextUpdate) {
+        age = min<long long>(age, max<long long>(0, resource->nextUpdate - now));
+    }
+    string cacheControl = "Cache-Control: public, max-age=" + to_string(age) + "\r\n";
+
+    bool notModified = false;
+    if (!ifNoneMatch.empty()) {
+        notModified = __etagMatches(ifNoneMatch, resource->etag);
+    } else if (!ifModifiedSince.empty()) {
+        time_t since = DistributionCatalog::parseHttpDate(string(ifModifiedSince));
+        notModified = since >= 0 && resource->lastModified <= since;
+    }
+
+    conn.output = notModified ? "HTTP/1.1 304 Not Modified\r\n" : "HTTP/1.1 200 OK\r\n";
+    conn.output += __date(now);
+    conn.output += cacheControl;
+    if (!notModified) {
+        conn.output += resource->contentHeaders;
+    }
+    conn.output += resource->validatorHeaders;
+    if (conn.closeAfterWrite) {
+        conn.output += "Connection: close\r\n";
+    }
+    conn.output += "\r\n";
+
+    if (notModified) {
+        ++stats.notModified;
+    } else {
+        ++stats.ok;
+        if (!isHead) {
+            conn.body = resource;
+            conn.bodyOffset = resource->offset;
+            conn.bodyRemaining = resource->size;
+        }
+    }
+}
+
+
+// Отправляет заголовки и тело (sendfile из memfd); возвращает false, если соединение закрыто
+inline bool DistributionServer::__flush(Connection& conn) {
+    while (conn.outputOffset < conn.output.size()) {
+        int flags = MSG_NOSIGNAL | (conn.bodyRemaining ? MSG_MORE : 0);
+        ssize_t n = send(conn.fd, conn.output.data() + conn.outputOffset, conn.output.size() - conn.outputOffset, flags);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                __updateInterest(conn);
+                return true;
+            }
+            __close(conn);
+            return false;
+        }
+        conn.outputOffset += n;
+    }
+
+    while (conn.bodyRemaining > 0) {
+        ssize_t n = sendfile(conn.fd, conn.body->arena->fd, &conn.bodyOffset, conn.bodyRemaining);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                __updateInterest(conn);
+                return true;
+            }
+        }
+        if (n <= 0) {
+            __close(conn);
+            return false;
+        }
+        conn.bodyRemaining -= n;
+    }
+
+    conn.output.clear();
+    conn.outputOffset = 0;
+    conn.body.reset();
+    if (conn.closeAfterWrite) {
+        __close(conn);
+        return false;
+    }
+    __updateInterest(conn);
+    return true;
+}
+
+
+inline void DistributionServer::__updateInterest(Connection& conn) {
+    uint32_t events = (conn.peerClosed ? 0u : static_cast<uint32_t>(EPOLLIN)) | (conn.output.empty() ? 0u : static_cast<uint32_t>(EPOLLOUT));
+    if (events == conn.events) {
+        return;
+    }
+    epoll_event event = {};
+    event.events = events;
+    event.data.fd = conn.fd;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, conn.fd, &event);
+    conn.events = events;
+}
+
+
+inline void DistributionServer::__close(Connection& conn) {
+    int fd = conn.fd;
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    close(fd);
+    connections.erase(fd);
+}
+
+
+inline void DistributionServer::__closeIdle(time_t now) {
+    vector<int> idle;
+    for (const auto& [fd, conn] : connections) {
+        if (now - conn->lastActivity > idleTimeout) {
+            idle.push_back(fd);
+        }
+    }
+    for (int fd : idle) {
+        __close(*connections[fd]);
+    }
+}
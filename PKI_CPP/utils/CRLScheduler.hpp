@@ -0,0 +1,201 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <ctime>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <sys/stat.h>
+
+#include "./CRL.hpp"
+#include "./Handles.hpp"
+#include "./ObjectLoader.hpp"
+
+using namespace std;
+
+// Фоновая переподпись CRL до наступления nextUpdate. Разобранный CRL хранится в памяти и перечитывается
+// с диска только если файл заменил другой процесс (отзыв через CRL::revokeSerials) — это видно по
+// inode, размеру и времени изменения. Когда до nextUpdate остается меньше overlap секунд, CRL
+// переподписывается с новыми датами и публикуется через временный файл и rename под CRLFileLock,
+// поэтому раздача и клиенты никогда не видят частично записанный файл, а стоимость переподписи
+// ложится на поток планировщика, а не на обработку запросов.
+
+struct CRLSchedulerStats {
+    size_t regenerations = 0;
+    size_t reloads = 0;             // сколько раз CRL пришлось разобрать с диска
+    time_t lastUpdate = 0;
+    time_t nextUpdate = 0;
+};
+
+class CRLScheduler {
+private:
+    struct FileState {
+        ino_t inode = 0;
+        off_t size = -1;
+        struct timespec modified = {};
+    };
+
+    string crlPath;
+    EVP_PKEY* signerKey;
+    int validityDays;
+    int overlap;
+    int checkInterval;
+
+    mutex crlMutex;                 // кэш CRL и статистика
+    X509CrlPtr cached;
+    FileState cachedState;
+    CRLSchedulerStats stats;
+
+    thread worker;
+    mutex waitMutex;
+    condition_variable wakeUp;
+    bool stopping = false;
+
+    static bool __statFile(const string& path, FileState& state);
+    static time_t __toTime(const ASN1_TIME* time);
+    void __syncLocked();
+    void __run();
+
+public:
+    // overlap - за сколько секунд до nextUpdate переподписывать (по умолчанию четверть срока действия);
+    // checkInterval - как часто сверяться с файлом, в секундах
+    CRLScheduler(const string& crlPath, EVP_PKEY* signerKey, int validityDays = CRL_UPDATE_TIME, int overlap = 0, int checkInterval = 60);
+    ~CRLScheduler() { stop(); }
+
+    CRLScheduler(const CRLScheduler&) = delete;
+    CRLScheduler& operator=(const CRLScheduler&) = delete;
+
+    // Переподписывает CRL, если до nextUpdate осталось меньше overlap секунд; возвращает true, если переподписан
+    bool regenerateIfDue(time_t now = time(nullptr));
+
+    void start() { worker = thread(&CRLScheduler::__run, this); }
+    void stop();
+
+    CRLSchedulerStats getStats();
+};
+
+
+inline CRLScheduler::CRLScheduler(const string& crlPath, EVP_PKEY* signerKey, int validityDays, int overlap, int checkInterval)
+    : crlPath(crlPath), signerKey(signerKey), validityDays(validityDays),
+      overlap(overlap > 0 ? overlap : validityDays * 86400 / 4), checkInterval(max(1, checkInterval)) {
+    if (!signerKey || validityDays <= 0) {
+        throw runtime_error("CRLScheduler: не задан ключ подписи или срок действия CRL.");
+    }
+    if (this->overlap >= validityDays * 86400) {
+        throw runtime_error("CRLScheduler: перекрытие должно быть меньше срока действия CRL.");
+    }
+    lock_guard<mutex> lock(crlMutex);
+    __syncLocked();
+}
+
+
+// CRL может быть опубликован только в DER: сверяемся с тем файлом, который есть на диске
+inline bool CRLScheduler::__statFile(const string& path, FileState& state) {
+    struct stat info;
+    string resolved = ObjectLoader::resolve(path);
+    if (resolved.empty() || stat(resolved.c_str(), &info) != 0) {
+        return false;
+    }
+    state.inode = info.st_ino;
+    state.size = info.st_size;
+    state.modified = info.st_mtim;
+    return true;
+}
+
+
+inline time_t CRLScheduler::__toTime(const ASN1_TIME* time) {
+    struct tm parts = {};
+    return time && ASN1_TIME_to_tm(time, &parts) ? timegm(&parts) : 0;
+}
+
+
+// Разбирает CRL с диска, только если файл сменился с момента последнего чтения или публикации
+inline void CRLScheduler::__syncLocked() {
+    FileState current;
+    if (!__statFile(crlPath, current)) {
+        throw runtime_error("CRLScheduler: файл " + crlPath + " не найден.");
+    }
+    if (cached && current.inode == cachedState.inode && current.size == cachedState.size &&
+        current.modified.tv_sec == cachedState.modified.tv_sec && current.modified.tv_nsec == cachedState.modified.tv_nsec) {
+        return;
+    }
+
+    X509CrlPtr crl = CRL::readCRL(crlPath);
+    if (!crl) {
+        throw runtime_error("CRLScheduler: не удалось разобрать " + crlPath + ".");
+    }
+    cached = std::move(crl);
+    cachedState = current;
+    stats.lastUpdate = __toTime(X509_CRL_get0_lastUpdate(cached.get()));
+    stats.nextUpdate = __toTime(X509_CRL_get0_nextUpdate(cached.get()));
+    ++stats.reloads;
+}
+
+
+inline bool CRLScheduler::regenerateIfDue(time_t now) {
+    lock_guard<mutex> lock(crlMutex);
+    __syncLocked();
+    if (stats.nextUpdate != 0 && now < stats.nextUpdate - overlap) {
+        return false;
+    }
+
+    // Под блокировкой файла еще раз сверяемся с диском: отзыв мог успеть заменить CRL
+    CRLFileLock fileLock(crlPath);
+    __syncLocked();
+    CRL::publishCRL(cached.get(), crlPath, signerKey, validityDays);
+
+    if (!__statFile(crlPath, cachedState)) {
+        cachedState = FileState{};      // при следующей сверке CRL будет перечитан
+    }
+    stats.lastUpdate = __toTime(X509_CRL_get0_lastUpdate(cached.get()));
+    stats.nextUpdate = __toTime(X509_CRL_get0_nextUpdate(cached.get()));
+    ++stats.regenerations;
+    return true;
+}
+
+
+inline void CRLScheduler::stop() {
+    {
+        lock_guard<mutex> lock(waitMutex);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+
+inline void CRLScheduler::__run() {
+    while (true) {
+        time_t wait = checkInterval;
+        try {
+            if (regenerateIfDue()) {
+                CRLSchedulerStats current = getStats();
+                cout << "CRL переподписан, nextUpdate " << current.nextUpdate << endl;
+            }
+            // Просыпаемся к сроку переподписи, если он раньше очередной сверки с файлом
+            CRLSchedulerStats current = getStats();
+            if (current.nextUpdate != 0) {
+                wait = clamp<time_t>(current.nextUpdate - overlap - time(nullptr), 1, checkInterval);
+            }
+        } catch (const std::runtime_error& ex) {
+            cerr << ex.what() << endl;
+        }
+
+        unique_lock<mutex> lock(waitMutex);
+        if (wakeUp.wait_for(lock, chrono::seconds(wait), [this] { return stopping; })) {
+            return;
+        }
+    }
+}
+
+
+inline CRLSchedulerStats CRLScheduler::getStats() {
+    lock_guard<mutex> lock(crlMutex);
+    return stats;
+}
@@ -0,0 +1,194 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <future>
+#include <stdexcept>
+
+#include <openssl/x509.h>
+#include <openssl/conf.h>
+#include <openssl/objects.h>
+#include <openssl/err.h>
+
+#include "../paths.hpp"
+#include "./ThreadPool.hpp"
+#include "./Handles.hpp"
+
+using namespace std;
+
+// Результат проверки одного запроса на сертификат
+struct CSRValidationResult {
+    bool valid = false;
+    string reason;
+};
+
+// Проверка CSR перед подписью: подпись запроса (proof-of-possession)
+// и соответствие субъекта политике из конфигурации эмитентского УЦ
+class CSRValidator {
+private:
+    struct PolicyRule {
+        int nid;
+        string field;
+        string rule; // match | supplied | optional
+    };
+
+    X509* caCert;
+    vector<PolicyRule> policy;
+
+    void __loadPolicy(const string& cnfPath);
+    static string __getNameEntry(X509_NAME* name, int nid);
+    string __checkPolicy(X509_NAME* subject) const;
+
+public:
+    CSRValidator(X509* caCert, const string& cnfPath = ISSUER_CNF) : caCert(caCert) {
+        if (!caCert) {
+            throw runtime_error("CSRValidator: передан некорректный указатель на сертификат УЦ.");
+        }
+        __loadPolicy(cnfPath);
+    }
+
+    CSRValidationResult validate(X509_REQ* req) const;
+    vector<CSRValidationResult> validateBatch(const vector<X509_REQ*>& reqs, size_t threadCount = thread::hardware_concurrency()) const;
+};
+
+
+inline void CSRValidator::__loadPolicy(const string& cnfPath) {
+    ConfPtr conf(NCONF_new(nullptr));
+    long errorLine = -1;
+    if (!conf || NCONF_load(conf.get(), cnfPath.c_str(), &errorLine) <= 0) {
+        throw runtime_error("CSRValidator: не удалось загрузить конфигурацию " + cnfPath + " (строка " + to_string(errorLine) + ").");
+    }
+
+    // секция УЦ берется из [ ca ] default_ca, при ее отсутствии используется CA_default
+    string caSection = "CA_default";
+    const char* defaultCa = NCONF_get_string(conf.get(), "ca", "default_ca");
+    if (defaultCa && NCONF_get_section(conf.get(), defaultCa)) {
+        caSection = defaultCa;
+    }
+    ERR_clear_error();
+
+    const char* policyName = NCONF_get_string(conf.get(), caSection.c_str(), "policy");
+    if (!policyName) {
+        throw runtime_error("CSRValidator: в секции " + caSection + " не указана политика (policy).");
+    }
+
+    STACK_OF(CONF_VALUE)* section = NCONF_get_section(conf.get(), policyName);
+    if (!section) {
+        throw runtime_error("CSRValidator: секция политики " + string(policyName) + " не найдена.");
+    }
+
+    for (int i = 0; i < sk_CONF_VALUE_num(section); ++i) {
+        CONF_VALUE* value = sk_CONF_VALUE_value(section, i);
+        int nid = OBJ_txt2nid(value->name);
+        if (nid == NID_undef) {
+            throw runtime_error("CSRValidator: неизвестное поле политики: " + string(value->name));
+        }
+
+        string rule = value->value;
+        if (rule != "match" && rule != "supplied" && rule != "optional") {
+            throw runtime_error("CSRValidator: неизвестное правило политики: " + rule);
+        }
+
+        policy.push_back({nid, value->name, rule});
+    }
+}
+
+
+inline string CSRValidator::__getNameEntry(X509_NAME* name, int nid) {
+    int index = X509_NAME_get_index_by_NID(name, nid, -1);
+    if (index < 0) {
+        return "";
+    }
+
+    ASN1_STRING* data = X509_NAME_ENTRY_get_data(X509_NAME_get_entry(name, index));
+    unsigned char* utf8 = nullptr;
+    int length = ASN1_STRING_to_UTF8(&utf8, data);
+    if (length < 0) {
+        return "";
+    }
+
+    OpenSSLStringPtr owner(reinterpret_cast<char*>(utf8));
+    return string(owner.get(), length);
+}
+
+
+// Возвращает пустую строку, если субъект удовлетворяет политике, иначе описание нарушения
+inline string CSRValidator::__checkPolicy(X509_NAME* subject) const {
+    X509_NAME* caSubject = X509_get_subject_name(caCert);
+
+    for (const auto& rule : policy) {
+        string reqValue = __getNameEntry(subject, rule.nid);
+
+        if (rule.rule == "supplied" && reqValue.empty()) {
+            return "поле " + rule.field + " обязательно и отсутствует в запросе";
+        }
+
+        if (rule.rule == "match") {
+            // поле, отсутствующее и в запросе, и в сертификате УЦ, считается совпадающим
+            string caValue = __getNameEntry(caSubject, rule.nid);
+            if (reqValue != caValue) {
+                return "поле " + rule.field + " должно совпадать с сертификатом УЦ (" + caValue + "), в запросе: " + reqValue;
+            }
+        }
+    }
+
+    return "";
+}
+
+
+inline CSRValidationResult CSRValidator::validate(X509_REQ* req) const {
+    CSRValidationResult result;
+
+    if (!req) {
+        result.reason = "пустой запрос";
+        return result;
+    }
+
+    EvpPkeyPtr reqPubKey(X509_REQ_get_pubkey(req));
+    if (!reqPubKey) {
+        result.reason = "не удалось извлечь публичный ключ из запроса";
+        return result;
+    }
+
+    // Проверка подписи запроса его же ключом (proof-of-possession)
+    if (X509_REQ_verify(req, reqPubKey.get()) != 1) {
+        ERR_clear_error();
+        result.reason = "подпись запроса не прошла проверку";
+        return result;
+    }
+
+    X509_NAME* subject = X509_REQ_get_subject_name(req);
+    if (!subject || X509_NAME_entry_count(subject) == 0) {
+        result.reason = "пустой субъект запроса";
+        return result;
+    }
+
+    result.reason = __checkPolicy(subject);
+    result.valid = result.reason.empty();
+    return result;
+}
+
+
+inline vector<CSRValidationResult> CSRValidator::validateBatch(const vector<X509_REQ*>& reqs, size_t threadCount) const {
+    vector<CSRValidationResult> results(reqs.size());
+    if (reqs.empty()) {
+        return results;
+    }
+
+    ThreadPool pool(min(threadCount == 0 ? size_t(1) : threadCount, reqs.size()));
+    vector<future<void>> pending;
+    pending.reserve(reqs.size());
+
+    for (size_t i = 0; i < reqs.size(); ++i) {
+        pending.push_back(pool.submit([this, &reqs, &results, i] {
+            results[i] = validate(reqs[i]);
+        }));
+    }
+
+    for (auto& task : pending) {
+        task.get();
+    }
+
+    return results;
+}
@@ -0,0 +1,554 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <openssl/x509.h>
+
+#include "../db/database.h"
+#include "../paths.hpp"
+#include "./CRL.hpp"
+#include "./Handles.hpp"
+#include "./ObjectLoader.hpp"
+
+using namespace std;
+
+// Холодный архив истекших сертификатов. Сертификаты, срок которых истек больше retentionDays дней назад
+// (в том числе отозванные), переносятся из ISSUER_CERTS_PATH и issuing_certs в сжатые сегменты ARCHIVE_PATH.
+// В базе остается узкая строка archived_certs: где лежит DER и данные отзыва, поэтому статус по серийному
+// номеру и индекс отозванных продолжают работать, а живые таблицы и директория хранят только действующие данные.
+//
+// Каждая запись сжимается отдельно (raw deflate) с общим словарем, собранным из образцов DER: имя издателя,
+// идентификаторы ключа УЦ, OID расширений и алгоритма подписи повторяются в каждом сертификате и кодируются
+// ссылками на словарь, при этом любую запись можно прочитать одним pread без распаковки соседних.
+//
+// Сегмент segment-NNNNNN.arc: заголовок ArchiveSegmentHeader, затем записи — ArchiveRecordHeader, серийный
+// номер и сжатый DER. Словарь хранится в dictionary-<Adler-32>.dict и указан в заголовке сегмента; новые
+// сегменты пишутся со словарем последнего сегмента, пока его не пересобрать (retrain). Сегмент публикуется
+// через временный файл и link под первым свободным номером до транзакции в базе, файлы сертификатов удаляются после нее.
+
+#define ARCHIVE_SEGMENT_MAGIC "PKIARC01"
+#define ARCHIVE_DICTIONARY_SIZE 32768   // окно deflate: словарь длиннее не используется
+
+struct ArchiveSegmentHeader {
+    char magic[8];
+    uint32_t dictionaryId;
+    uint32_t reserved;
+};
+
+struct ArchiveRecordHeader {
+    uint16_t serialLength;
+    uint16_t reserved;
+    uint32_t derLength;
+    uint32_t compressedLength;
+    uint32_t crc;               // CRC-32 исходного DER
+};
+
+struct ArchiveOptions {
+    int retentionDays = 365;    // архивировать сертификаты, истекшие больше N дней назад
+    int limit = 0;              // не больше стольких сертификатов за запуск; 0 - все
+    bool dryRun = false;        // только показать кандидатов
+    bool retrain = false;       // собрать новый словарь по текущей пачке
+    size_t segmentBytes = 64 << 20;
+    // CRL УЦ: под ее блокировкой (как у отзыва и снимка pki_backup) строки уходят из базы и удаляются файлы
+    string crlPath = (filesystem::path(CRL_PATH) / DEFAULT_CRL_NAME).string();
+};
+
+struct ArchiveReport {
+    size_t selected = 0;
+    size_t archived = 0;
+    size_t withoutFile = 0;     // строки без файла сертификата: переносятся только в индекс
+    size_t failed = 0;
+    size_t derBytes = 0;
+    size_t compressedBytes = 0;
+    string dictionary;
+    vector<string> segments;
+    vector<ArchivedCertRecord> candidates;
+    vector<pair<string, string>> errors;    // (серийный номер, причина)
+};
+
+struct ArchiveStats {
+    size_t segments = 0;
+    size_t records = 0;
+    size_t corrupted = 0;
+    size_t derBytes = 0;
+    size_t storedBytes = 0;     // размер сегментов на диске
+};
+
+class CertArchive {
+private:
+    string archiveDir;
+    mutable mutex dictionariesMutex;
+    mutable map<uint32_t, string> dictionaries;
+
+    struct Entry {
+        size_t index;           // позиция в списке кандидатов
+        string der;
+    };
+
+    string __segmentPath(const string& name) const { return (filesystem::path(archiveDir) / name).string(); }
+    string __dictionaryPath(uint32_t id) const;
+    const string& __dictionary(uint32_t id) const;
+    uint32_t __storeDictionary(const string& dictionary) const;
+    bool __readSegmentHeader(const string& path, ArchiveSegmentHeader& header) const;
+    vector<string> __segmentNames() const;
+    string __nextSegmentName() const;
+    string __writeSegment(const vector<Entry>& entries, size_t first, size_t last, vector<ArchivedCertRecord>& records,
+                          uint32_t dictionaryId, size_t& compressedBytes) const;
+
+    static string __compress(z_stream& stream, const string& der, const string& dictionary);
+    static bool __inflate(const unsigned char* data, size_t length, const string& dictionary, string& der);
+
+public:
+    explicit CertArchive(const string& archiveDir = ARCHIVE_PATH) : archiveDir(archiveDir) {}
+
+    // Общий словарь по образцам DER: образцы берутся равномерно по пачке, самые свежие ближе к концу словаря
+    static string trainDictionary(const vector<string>& samples);
+
+    ArchiveReport run(Database& db, const ArchiveOptions& options, const string& certsDir = ISSUER_CERTS_PATH);
+    // DER архивного сертификата. Бросает runtime_error, если записи нет или она повреждена
+    string read(const ArchivedCertRecord& record) const;
+    // Проверяет CRC всех записей всех сегментов
+    ArchiveStats verify() const;
+};
+
+
+inline string CertArchive::trainDictionary(const vector<string>& samples) {
+    string dictionary;
+    if (samples.empty()) {
+        return dictionary;
+    }
+    size_t averageSize = 0;
+    for (const auto& sample : samples) {
+        averageSize += sample.size();
+    }
+    averageSize = max<size_t>(1, averageSize / samples.size());
+    size_t count = min(samples.size(), max<size_t>(1, ARCHIVE_DICTIONARY_SIZE / averageSize));
+
+    for (size_t i = 0; i < count; ++i) {
+        dictionary += samples[i * samples.size() / count];
+    }
+    if (dictionary.size() > ARCHIVE_DICTIONARY_SIZE) {
+        dictionary.erase(0, dictionary.size() - ARCHIVE_DICTIONARY_SIZE);
+    }
+    return dictionary;
+}
+
+
+inline string CertArchive::__dictionaryPath(uint32_t id) const {
+    char name[32];
+    snprintf(name, sizeof(name), "dictionary-%08x.dict", id);
+    return __segmentPath(name);
+}
+
+
+inline const string& CertArchive::__dictionary(uint32_t id) const {
+    lock_guard<mutex> lock(dictionariesMutex);
+    auto found = dictionaries.find(id);
+    if (found != dictionaries.end()) {
+        return found->second;
+    }
+
+    MappedFile file(__dictionaryPath(id));
+    if (!file.isOpen()) {
+        throw runtime_error("CertArchive: нет словаря " + __dictionaryPath(id) + ".");
+    }
+    string dictionary(reinterpret_cast<const char*>(file.data()), file.size());
+    if (adler32(adler32(0, nullptr, 0), reinterpret_cast<const Bytef*>(dictionary.data()), dictionary.size()) != id) {
+        throw runtime_error("CertArchive: словарь " + __dictionaryPath(id) + " поврежден.");
+    }
+    return dictionaries.emplace(id, move(dictionary)).first->second;
+}
+
+
+inline uint32_t CertArchive::__storeDictionary(const string& dictionary) const {
+    uint32_t id = adler32(adler32(0, nullptr, 0), reinterpret_cast<const Bytef*>(dictionary.data()), dictionary.size());
+    string path = __dictionaryPath(id);
+    if (!filesystem::exists(path)) {
+        string tempPath = path + ".tmp." + to_string(getpid());
+        int fd = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        bool written = fd >= 0 && write(fd, dictionary.data(), dictionary.size()) == static_cast<ssize_t>(dictionary.size()) &&
+                       fsync(fd) == 0;
+        if (fd >= 0) {
+            close(fd);
+        }
+        if (!written || rename(tempPath.c_str(), path.c_str()) != 0) {
+            unlink(tempPath.c_str());
+            throw runtime_error("CertArchive: не удалось записать словарь " + path + ".");
+        }
+    }
+
+    lock_guard<mutex> lock(dictionariesMutex);
+    dictionaries.emplace(id, dictionary);
+    return id;
+}
+
+
+inline bool CertArchive::__readSegmentHeader(const string& path, ArchiveSegmentHeader& header) const {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    bool valid = pread(fd, &header, sizeof(header), 0) == sizeof(header) && memcmp(header.magic, ARCHIVE_SEGMENT_MAGIC, 8) == 0;
+    close(fd);
+    return valid;
+}
+
+
+inline vector<string> CertArchive::__segmentNames() const {
+    vector<string> names;
+    if (!filesystem::is_directory(archiveDir)) {
+        return names;
+    }
+    for (const auto& entry : filesystem::directory_iterator(archiveDir)) {
+        string name = entry.path().filename().string();
+        if (name.starts_with("segment-") && entry.path().extension() == ".arc") {
+            names.push_back(name);
+        }
+    }
+    sort(names.begin(), names.end());
+    return names;
+}
+
+
+inline string CertArchive::__nextSegmentName() const {
+    vector<string> names = __segmentNames();
+    unsigned long number = names.empty() ? 0 : stoul(names.back().substr(8, 6));
+    char name[32];
+    snprintf(name, sizeof(name), "segment-%06lu.arc", number + 1);
+    return name;
+}
+
+
+inline string CertArchive::__compress(z_stream& stream, const string& der, const string& dictionary) {
+    if (deflateReset(&stream) != Z_OK ||
+        deflateSetDictionary(&stream, reinterpret_cast<const Bytef*>(dictionary.data()), dictionary.size()) != Z_OK) {
+        throw runtime_error("CertArchive: ошибка zlib при сжатии.");
+    }
+    string compressed(deflateBound(&stream, der.size()), '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(der.data()));
+    stream.avail_in = der.size();
+    stream.next_out = reinterpret_cast<Bytef*>(compressed.data());
+    stream.avail_out = compressed.size();
+    if (deflate(&stream, Z_FINISH) != Z_STREAM_END) {
+        throw runtime_error("CertArchive: ошибка zlib при сжатии.");
+    }
+    compressed.resize(stream.total_out);
+    return compressed;
+}
+
+
+inline bool CertArchive::__inflate(const unsigned char* data, size_t length, const string& dictionary, string& der) {
+    z_stream stream = {};
+    if (inflateInit2(&stream, -MAX_WBITS) != Z_OK) {
+        return false;
+    }
+    bool inflated = inflateSetDictionary(&stream, reinterpret_cast<const Bytef*>(dictionary.data()), dictionary.size()) == Z_OK;
+    stream.next_in = const_cast<Bytef*>(data);
+    stream.avail_in = length;
+    stream.next_out = reinterpret_cast<Bytef*>(der.data());
+    stream.avail_out = der.size();
+    inflated = inflated && inflate(&stream, Z_FINISH) == Z_STREAM_END && stream.total_out == der.size();
+    inflateEnd(&stream);
+    return inflated;
+}
+
+
+// Пишет записи entries[first, last) в новый сегмент и заполняет их координаты в records
+inline string CertArchive::__writeSegment(const vector<Entry>& entries, size_t first, size_t last, vector<ArchivedCertRecord>& records,
+                                          uint32_t dictionaryId, size_t& compressedBytes) const {
+    const string& dictionary = __dictionary(dictionaryId);
+    z_stream stream = {};
+    if (deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+        throw runtime_error("CertArchive: не удалось инициализировать zlib.");
+    }
+
+    ArchiveSegmentHeader header = {};
+    memcpy(header.magic, ARCHIVE_SEGMENT_MAGIC, 8);
+    header.dictionaryId = dictionaryId;
+    string content(reinterpret_cast<const char*>(&header), sizeof(header));
+    try {
+        for (size_t i = first; i < last; ++i) {
+            const Entry& entry = entries[i];
+            ArchivedCertRecord& record = records[entry.index];
+            string compressed = __compress(stream, entry.der, dictionary);
+
+            ArchiveRecordHeader recordHeader = {};
+            recordHeader.serialLength = static_cast<uint16_t>(record.serial.size());
+            recordHeader.derLength = entry.der.size();
+            recordHeader.compressedLength = compressed.size();
+            recordHeader.crc = crc32(crc32(0, nullptr, 0), reinterpret_cast<const Bytef*>(entry.der.data()), entry.der.size());
+
+            record.offset = content.size();
+            content.append(reinterpret_cast<const char*>(&recordHeader), sizeof(recordHeader));
+            content += record.serial;
+            content += compressed;
+            record.length = content.size() - record.offset;
+            compressedBytes += compressed.size();
+        }
+    } catch (...) {
+        deflateEnd(&stream);
+        throw;
+    }
+    deflateEnd(&stream);
+
+    string tempPath = __segmentPath("segment-pending.tmp." + to_string(getpid()));
+    int fd = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    bool written = fd >= 0;
+    for (size_t offset = 0; written && offset < content.size();) {
+        ssize_t chunk = write(fd, content.data() + offset, content.size() - offset);
+        written = chunk > 0;
+        offset += written ? chunk : 0;
+    }
+    written = written && fsync(fd) == 0;
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (!written) {
+        unlink(tempPath.c_str());
+        throw runtime_error("CertArchive: не удалось записать сегмент " + tempPath + ".");
+    }
+
+    // Номер выбирается при публикации: link(), в отличие от rename(), не заменяет существующий файл,
+    // поэтому параллельный запуск, занявший тот же номер, не затирает чужой сегмент - берется следующий
+    string name;
+    for (;;) {
+        name = __nextSegmentName();
+        if (link(tempPath.c_str(), __segmentPath(name).c_str()) == 0) {
+            break;
+        }
+        if (errno != EEXIST) {
+            unlink(tempPath.c_str());
+            throw runtime_error("CertArchive: не удалось опубликовать сегмент " + __segmentPath(name) + ".");
+        }
+    }
+    unlink(tempPath.c_str());
+
+    for (size_t i = first; i < last; ++i) {
+        records[entries[i].index].segment = name;
+    }
+    return name;
+}
+
+
+inline ArchiveReport CertArchive::run(Database& db, const ArchiveOptions& options, const string& certsDir) {
+    if (options.retentionDays < 0) {
+        throw runtime_error("CertArchive: срок хранения не может быть отрицательным.");
+    }
+
+    ArchiveReport report;
+    report.candidates = db.selectArchivableCerts(options.retentionDays, options.limit);
+    report.selected = report.candidates.size();
+    if (options.dryRun || report.candidates.empty()) {
+        return report;
+    }
+    filesystem::create_directories(archiveDir);
+
+    // DER читается из файла в любом формате; строки без файла переносятся только в индекс
+    vector<ArchivedCertRecord>& records = report.candidates;
+    vector<Entry> entries;
+    vector<bool> accepted(records.size(), false);
+    for (size_t i = 0; i < records.size(); ++i) {
+        string certPath = (filesystem::path(certsDir) / records[i].certName).string();
+        if (ObjectLoader::resolve(certPath).empty()) {
+            accepted[i] = true;
+            ++report.withoutFile;
+            continue;
+        }
+
+        X509Ptr cert = ObjectLoader::loadX509(certPath, false);
+        int length = cert ? i2d_X509(cert.get(), nullptr) : 0;
+        if (length <= 0) {
+            report.errors.emplace_back(records[i].serial, "не удалось прочитать " + certPath);
+            continue;
+        }
+        if (serialToDecimal(X509_get_serialNumber(cert.get())) != records[i].serial) {
+            report.errors.emplace_back(records[i].serial, "серийный номер в файле " + certPath + " не совпадает с базой");
+            continue;
+        }
+        string der(length, '\0');
+        unsigned char* cursor = reinterpret_cast<unsigned char*>(der.data());
+        i2d_X509(cert.get(), &cursor);
+        report.derBytes += der.size();
+        entries.push_back({i, move(der)});
+        accepted[i] = true;
+    }
+
+    // Словарь последнего сегмента переиспользуется, чтобы все сегменты ссылались на небольшое число словарей
+    uint32_t dictionaryId = 0;
+    bool hasDictionary = false;
+    vector<string> segmentNames = __segmentNames();
+    ArchiveSegmentHeader lastHeader;
+    if (!options.retrain && !segmentNames.empty() && __readSegmentHeader(__segmentPath(segmentNames.back()), lastHeader)) {
+        dictionaryId = lastHeader.dictionaryId;
+        hasDictionary = true;
+    }
+    if (!entries.empty() && !hasDictionary) {
+        vector<string> samples;
+        for (const auto& entry : entries) {
+            samples.push_back(entry.der);
+        }
+        dictionaryId = __storeDictionary(trainDictionary(samples));
+    }
+    if (!entries.empty()) {
+        char id[16];
+        snprintf(id, sizeof(id), "%08x", dictionaryId);
+        report.dictionary = id;
+    }
+
+    // Сегменты пишутся до транзакции; если она не прошла, они удаляются
+    try {
+        for (size_t first = 0; first < entries.size();) {
+            size_t last = first;
+            size_t bytes = 0;
+            while (last < entries.size() && (last == first || bytes + entries[last].der.size() <= options.segmentBytes)) {
+                bytes += entries[last++].der.size();
+            }
+            report.segments.push_back(__writeSegment(entries, first, last, records, dictionaryId, report.compressedBytes));
+            first = last;
+        }
+    } catch (...) {
+        for (const auto& name : report.segments) {
+            filesystem::remove(__segmentPath(name));
+        }
+        throw;
+    }
+
+    vector<ArchivedCertRecord> toArchive;
+    vector<size_t> archiveIndex;
+    for (size_t i = 0; i < records.size(); ++i) {
+        if (accepted[i]) {
+            toArchive.push_back(records[i]);
+            archiveIndex.push_back(i);
+        }
+    }
+
+    // Без блокировки pki_backup мог бы увидеть строку в снимке базы до транзакции, а файл - уже удаленным
+    unique_ptr<CRLFileLock> lock;
+    if (filesystem::is_directory(filesystem::path(options.crlPath).parent_path())) {
+        lock = make_unique<CRLFileLock>(options.crlPath);
+    }
+
+    vector<bool> archived;
+    try {
+        archived = db.archiveCerts(toArchive);
+    } catch (const std::exception&) {
+        for (const auto& name : report.segments) {
+            filesystem::remove(__segmentPath(name));
+        }
+        throw;
+    }
+
+    // Записи, не попавшие в базу (строку изменили параллельно), остаются в сегменте мертвыми байтами
+    error_code ignored;
+    for (size_t j = 0; j < toArchive.size(); ++j) {
+        if (!archived[j]) {
+            report.errors.emplace_back(toArchive[j].serial, "строка изменена другим процессом");
+            continue;
+        }
+        string certPath = (filesystem::path(certsDir) / toArchive[j].certName).string();
+        filesystem::remove(certPath, ignored);
+        filesystem::remove(ObjectLoader::derPathFor(certPath), ignored);
+        ++report.archived;
+    }
+    report.failed = report.selected - report.archived;
+    return report;
+}
+
+
+inline string CertArchive::read(const ArchivedCertRecord& record) const {
+    if (record.segment.empty()) {
+        throw runtime_error("CertArchive: сертификат " + record.serial + " перенесен в архив без файла.");
+    }
+    string path = __segmentPath(record.segment);
+    ArchiveSegmentHeader header;
+    if (!__readSegmentHeader(path, header)) {
+        throw runtime_error("CertArchive: не удалось прочитать сегмент " + path + ".");
+    }
+
+    string content(record.length, '\0');
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    bool readOk = fd >= 0 && record.length >= static_cast<long long>(sizeof(ArchiveRecordHeader)) &&
+                  pread(fd, content.data(), content.size(), record.offset) == static_cast<ssize_t>(content.size());
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    ArchiveRecordHeader recordHeader;
+    if (readOk) {
+        memcpy(&recordHeader, content.data(), sizeof(recordHeader));
+        readOk = sizeof(recordHeader) + recordHeader.serialLength + recordHeader.compressedLength == content.size() &&
+                 content.compare(sizeof(recordHeader), recordHeader.serialLength, record.serial) == 0;
+    }
+    string der;
+    if (readOk) {
+        der.resize(recordHeader.derLength);
+        const unsigned char* compressed = reinterpret_cast<const unsigned char*>(content.data()) + sizeof(recordHeader) + recordHeader.serialLength;
+        readOk = __inflate(compressed, recordHeader.compressedLength, __dictionary(header.dictionaryId), der) &&
+                 crc32(crc32(0, nullptr, 0), reinterpret_cast<const Bytef*>(der.data()), der.size()) == recordHeader.crc;
+    }
+    if (!readOk) {
+        throw runtime_error("CertArchive: запись " + record.serial + " в " + path + " повреждена.");
+    }
+    return der;
+}
+
+
+inline ArchiveStats CertArchive::verify() const {
+    ArchiveStats stats;
+    for (const auto& name : __segmentNames()) {
+        string path = __segmentPath(name);
+        MappedFile file(path);
+        ArchiveSegmentHeader header;
+        ++stats.segments;
+        if (!file.isOpen() || file.size() < sizeof(header)) {
+            ++stats.corrupted;
+            continue;
+        }
+        stats.storedBytes += file.size();
+        memcpy(&header, file.data(), sizeof(header));
+        if (memcmp(header.magic, ARCHIVE_SEGMENT_MAGIC, 8) != 0) {
+            ++stats.corrupted;
+            continue;
+        }
+        const string& dictionary = __dictionary(header.dictionaryId);
+
+        for (size_t offset = sizeof(header); offset < file.size();) {
+            ArchiveRecordHeader recordHeader;
+            if (file.size() - offset < sizeof(recordHeader)) {
+                ++stats.corrupted;
+                break;
+            }
+            memcpy(&recordHeader, file.data() + offset, sizeof(recordHeader));
+            size_t end = offset + sizeof(recordHeader) + recordHeader.serialLength + recordHeader.compressedLength;
+            if (end > file.size()) {
+                ++stats.corrupted;
+                break;
+            }
+
+            string der(recordHeader.derLength, '\0');
+            const unsigned char* compressed = file.data() + offset + sizeof(recordHeader) + recordHeader.serialLength;
+            if (__inflate(compressed, recordHeader.compressedLength, dictionary, der) &&
+                crc32(crc32(0, nullptr, 0), reinterpret_cast<const Bytef*>(der.data()), der.size()) == recordHeader.crc) {
+                ++stats.records;
+                stats.derBytes += der.size();
+            } else {
+                ++stats.corrupted;
+            }
+            offset = end;
+        }
+    }
+    return stats;
+}
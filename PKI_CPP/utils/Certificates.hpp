@@ -15,25 +15,49 @@
 #include <openssl/bio.h>
 #include <openssl/err.h>
 #include <openssl/pkcs12.h>
+#include <openssl/rand.h>
 
 #include "../db/database.h"
 #include "../paths.hpp"
+#include "./Handles.hpp"
+#include "./ObjectLoader.hpp"
+#include "./OutputFormat.hpp"
 
 using namespace std;
 
+// Данные выпущенного сертификата для записи в базу данных
+struct IssuedCertInfo {
+    string serial;
+    string info;
+    string notBefore;
+    string notAfter;
+    string keyHash;
+    SubjectFields subject;
+};
+
 class Certificates {
 private:
     void __printPublicKey(EVP_PKEY* pkey);
     void __deleteCertificate(const string& cert);
 public:
-    X509_REQ* readExistingX509_ReqFromPath(const string& reqPath);
-    X509* readExistingX509FromPath(const string& certPath);
+    X509ReqPtr readExistingX509_ReqFromPath(const string& reqPath);
+    X509Ptr readExistingX509FromPath(const string& certPath);
+
+    X509Ptr generateCertificate(Database& db, EVP_PKEY* pkey, const string& certPath, const string& certFilename);
+    X509ReqPtr genereteIssuerCSR(Database& db, EVP_PKEY* pkey, const string& uniqueName, const string& countryName, const string& organizationName, const string& commonName);
+    Pkcs12Ptr generatePKCS12(X509* userCert, EVP_PKEY* userPkey, const string& password, const string& pkcs12Name);
 
-    X509* generateCertificate(Database& db, EVP_PKEY* pkey, const string& certPath, const string& certFilename);
-    X509_REQ* genereteIssuerCSR(Database& db, EVP_PKEY* pkey, const string& uniqueName, const string& countryName, const string& organizationName, const string& commonName);
-    PKCS12* generatePKCS12(X509* userCert, EVP_PKEY* userPkey, const string& password, const string& pkcs12Name);
+    X509Ptr signIssuerReqCSR(const string& certFilename, X509_REQ* req, X509* rootCert, EVP_PKEY* pkey, Database& db, const string& certsDir = ISSUER_CERTS_PATH);
 
-    X509* signIssuerReqCSR(const string& certFilename, X509_REQ* req, X509* rootCert, EVP_PKEY* pkey, Database& db);
+    // Построение объектов в памяти, без записи на диск и в базу данных
+    static X509ReqPtr buildIssuerCSR(EVP_PKEY* pkey, const string& countryName, const string& organizationName, const string& commonName);
+    static X509Ptr buildIssuerCert(X509_REQ* req, X509* rootCert, EVP_PKEY* pkey, ASN1_INTEGER* serial = nullptr);
+    static IssuedCertInfo describeCertificate(X509* cert);
+    // Случайный положительный 127-битный серийный номер из RAND_bytes: потокобезопасен и не повторяется между процессами
+    static Asn1IntegerPtr allocateSerial();
+    // Замена выпущенного этим УЦ сертификата: тот же субъект, ключ и расширения, случайный серийный номер,
+    // срок validityDays от текущего момента, но не дольше срока сертификата УЦ
+    static X509Ptr buildRenewedCert(X509* oldCert, X509* caCert, EVP_PKEY* caKey, int validityDays);
 
     void deleteX509_ReqFromDir(const string& reqName);
 
@@ -42,13 +66,13 @@ public:
 };
 
 
-void Certificates::__printPublicKey(EVP_PKEY* pkey) {
+inline void Certificates::__printPublicKey(EVP_PKEY* pkey) {
     if (!pkey) {
         std::cerr << "Ошибка: пустой указатель на ключ.\n";
         return;
     }
 
-    unique_ptr<BIO, decltype(&BIO_free_all)> bio(BIO_new(BIO_s_mem()), BIO_free_all);
+    BioPtr bio(BIO_new(BIO_s_mem()));
 
     if (PEM_write_bio_PUBKEY(bio.get(), pkey) != 1) {
         std::cerr << "Ошибка: не удалось записать публичный ключ в BIO.\n";
@@ -61,36 +85,21 @@ void Certificates::__printPublicKey(EVP_PKEY* pkey) {
 }
 
 
-X509_REQ* Certificates::readExistingX509_ReqFromPath(const string& reqPath) {
-    // Чтение существующего CSR из файла
-    unique_ptr<BIO, decltype(&BIO_free)> csrBio(BIO_new_file(reqPath.c_str(), "r"), BIO_free);
-    if (!csrBio) {
-        cerr << "readExistingX509_ReqFromPath: Ошибка: не удалось открыть файл CSR: " << reqPath << "\n";
-        return nullptr;
-    }
-
-    X509_REQ* existingReq = PEM_read_bio_X509_REQ(csrBio.get(), nullptr, nullptr, nullptr);
+inline X509ReqPtr Certificates::readExistingX509_ReqFromPath(const string& reqPath) {
+    // Чтение существующего CSR (PEM или DER) из файла
+    X509ReqPtr existingReq = ObjectLoader::loadX509Req(reqPath);
     if (!existingReq) {
-        cerr << "readExistingX509_ReqFromPath: Ошибка: не удалось прочитать CSR из файла.\n";
+        cerr << "readExistingX509_ReqFromPath: Ошибка: не удалось прочитать CSR из файла: " << reqPath << "\n";
         return nullptr;
     }
 
-    std::filesystem::path pathObj(reqPath);
-
     return existingReq;
 }
 
 
-X509* Certificates::readExistingX509FromPath(const string& certPath) {
-    // Открытие файла сертификата для чтения
-    unique_ptr<BIO, decltype(&BIO_free)> certBio(BIO_new_file(certPath.c_str(), "r"), BIO_free);
-    if (!certBio) {
-        cerr << "readExistingX509FromPath: Ошибка: не удалось открыть файл: " << certPath << endl;
-        return nullptr;
-    }
-
-    // Чтение сертификата из файла
-    X509* cert = PEM_read_bio_X509(certBio.get(), nullptr, nullptr, nullptr);
+inline X509Ptr Certificates::readExistingX509FromPath(const string& certPath) {
+    // Сертификат (PEM или DER) берется из кэша ObjectLoader, пока файл не изменился; объект общий и не изменяется
+    X509Ptr cert = ObjectLoader::loadX509(certPath);
     if (!cert) {
         cerr << "readExistingX509FromPath: Ошибка: не удалось прочитать сертификат из файла: " << certPath << endl;
         return nullptr;
@@ -100,7 +109,7 @@ X509* Certificates::readExistingX509FromPath(const string& certPath) {
 }
 
 
-X509* Certificates::generateCertificate(Database& db, EVP_PKEY* pkey, const string& certPath, const string& certFilename) {
+inline X509Ptr Certificates::generateCertificate(Database& db, EVP_PKEY* pkey, const string& certPath, const string& certFilename) {
 
     if (!pkey) {
         throw runtime_error("generateRootCertificate: передан некорректный указатель на ключ.\n");
@@ -118,8 +127,7 @@ X509* Certificates::generateCertificate(Database& db, EVP_PKEY* pkey, const stri
     // Проверка существования root_cert
     if (std::filesystem::exists(certFullpath)) {
         cout << "generateRootCertificate: Запрос с таким именем уже существует. Загружаем из файла.\n";
-        X509* cert = readExistingX509FromPath(certFullpath);
-        return cert;
+        return readExistingX509FromPath(certFullpath);
     }
 
     cout << "Введите количество дней действия сертификата: ";
@@ -138,14 +146,13 @@ X509* Certificates::generateCertificate(Database& db, EVP_PKEY* pkey, const stri
     getline(cin, commonName);
 
     // Создание нового X509 сертификата
-    unique_ptr<X509, decltype(&X509_free)> cert(X509_new(), X509_free);
+    X509Ptr cert(X509_new());
     if (!cert) {
         throw runtime_error("generateRootCertificate: не удалось создать структуру X509.\n");
     }
 
     // Установка серийного номера
-    unique_ptr<ASN1_INTEGER, decltype(&ASN1_INTEGER_free)> serialNumber(ASN1_INTEGER_new(), ASN1_INTEGER_free);
-    ASN1_INTEGER_set(serialNumber.get(), rand());
+    Asn1IntegerPtr serialNumber = allocateSerial();
     X509_set_serialNumber(cert.get(), serialNumber.get());
 
     // Установка сроков действия
@@ -154,11 +161,11 @@ X509* Certificates::generateCertificate(Database& db, EVP_PKEY* pkey, const stri
 
     // Установка субъекта и эмитента
     X509_NAME* name = X509_get_subject_name(cert.get());
-    X509_NAME_add_entry_by_txt(name, "C", MBSTRING_ASC,
+    X509_NAME_add_entry_by_txt(name, "C", MBSTRING_UTF8,
                                reinterpret_cast<const unsigned char*>(countryName.c_str()), -1, -1, 0);
-    X509_NAME_add_entry_by_txt(name, "O", MBSTRING_ASC,
+    X509_NAME_add_entry_by_txt(name, "O", MBSTRING_UTF8,
                                reinterpret_cast<const unsigned char*>(organizationName.c_str()), -1, -1, 0);
-    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_UTF8,
                                reinterpret_cast<const unsigned char*>(commonName.c_str()), -1, -1, 0);
     X509_set_issuer_name(cert.get(), name);
 
@@ -166,23 +173,20 @@ X509* Certificates::generateCertificate(Database& db, EVP_PKEY* pkey, const stri
     X509_set_pubkey(cert.get(), pkey);
 
     // Подпись сертификата
-    if (X509_sign(cert.get(), pkey, EVP_sha256()) <= 0) {
+    if (X509_sign(cert.get(), pkey, digestForKey(pkey)) <= 0) {
         throw runtime_error("generateRootCertificate: не удалось подписать сертификат.\n");
     }
 
     // Сохранение сертификата в файл
-    unique_ptr<BIO, decltype(&BIO_free)> certBio(BIO_new_file(certFullpath.c_str(), "w"), BIO_free);
+    BioPtr certBio(BIO_new_file(certFullpath.c_str(), "w"));
     if (!certBio || PEM_write_bio_X509(certBio.get(), cert.get()) == 0) {
         cerr << "generateRootCertificate: не удалось сохранить сертификат в файл: " << certFullpath << "\n";
     }
 
     cout << "Сертификат успешно создан и сохранён по пути: " << certFullpath << "\n";
 
-    const ASN1_INTEGER* serial = X509_get_serialNumber(cert.get());
-    BIGNUM* serialBN = ASN1_INTEGER_to_BN(serial, nullptr);
-    char* serialStr = BN_bn2dec(serialBN);
-
-    const char* info = X509_NAME_oneline(X509_get_subject_name(cert.get()), nullptr, 0);
+    string serialStr = serialToDecimal(X509_get_serialNumber(cert.get()));
+    string info = nameToOneline(X509_get_subject_name(cert.get()));
 
     try {
         db.addRootCert(certFilename, serialStr, info, days);
@@ -190,39 +194,29 @@ X509* Certificates::generateCertificate(Database& db, EVP_PKEY* pkey, const stri
         cerr << "generateRootCertificate: ошибка при добавлении сертификата в базу данных: " << ex.what() << "\n";
     }
 
-    return cert.release();
+    return cert;
 }
 
 
-X509_REQ* Certificates::genereteIssuerCSR(Database& db, EVP_PKEY* pkey, const string& uniqueName, const string& countryName, const string& organizationName, const string& commonName) {
+inline X509ReqPtr Certificates::buildIssuerCSR(EVP_PKEY* pkey, const string& countryName, const string& organizationName, const string& commonName) {
 
     if (!pkey) {
         throw runtime_error("generetaIssuerCSR: передан некорректный указатель на ключ.\n");
     }
 
-    std::filesystem::path reqPath;
-    cout << uniqueName << endl;
-    reqPath = std::filesystem::path(ISSUER_CSR_PATH) / (uniqueName + ".csr.pem");
-
-    // Проверка существования CSR
-    if (std::filesystem::exists(reqPath)) {
-        cout << "generetaIssuerCSR: Запрос с таким именем уже существует. Загружаем из файла.\n";
-        return readExistingX509_ReqFromPath(reqPath);
-    }
-
     // Создание структуры для CSR
-    unique_ptr<X509_REQ, decltype(&X509_REQ_free)> req(X509_REQ_new(), X509_REQ_free);
+    X509ReqPtr req(X509_REQ_new());
     if (!req) {
         throw runtime_error("generetaIssuerCSR: не удалось создать структуру для CSR.\n");
     }
 
     // Установка информации о субъекте
     X509_NAME* name = X509_REQ_get_subject_name(req.get());
-    X509_NAME_add_entry_by_txt(name, "C", MBSTRING_ASC,
+    X509_NAME_add_entry_by_txt(name, "C", MBSTRING_UTF8,
                                reinterpret_cast<const unsigned char*>(countryName.c_str()), -1, -1, 0);
-    X509_NAME_add_entry_by_txt(name, "O", MBSTRING_ASC,
+    X509_NAME_add_entry_by_txt(name, "O", MBSTRING_UTF8,
                                reinterpret_cast<const unsigned char*>(organizationName.c_str()), -1, -1, 0);
-    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_ASC,
+    X509_NAME_add_entry_by_txt(name, "CN", MBSTRING_UTF8,
                                reinterpret_cast<const unsigned char*>(commonName.c_str()), -1, -1, 0);
 
     // Установка ключа
@@ -231,53 +225,74 @@ X509_REQ* Certificates::genereteIssuerCSR(Database& db, EVP_PKEY* pkey, const st
     }
 
     // Подпись запроса
-    if (X509_REQ_sign(req.get(), pkey, EVP_sha256()) <= 0) {
+    if (X509_REQ_sign(req.get(), pkey, digestForKey(pkey)) <= 0) {
         throw runtime_error("generetaIssuerCSR: не удалось подписать CSR.\n");
     }
 
+    return req;
+}
+
+
+inline X509ReqPtr Certificates::genereteIssuerCSR(Database& db, EVP_PKEY* pkey, const string& uniqueName, const string& countryName, const string& organizationName, const string& commonName) {
+
+    if (!pkey) {
+        throw runtime_error("generetaIssuerCSR: передан некорректный указатель на ключ.\n");
+    }
+
+    std::filesystem::path reqPath;
+    cout << uniqueName << endl;
+    reqPath = std::filesystem::path(ISSUER_CSR_PATH) / (uniqueName + ".csr.pem");
+
+    // Проверка существования CSR
+    if (Artifacts::exists(reqPath)) {
+        cout << "generetaIssuerCSR: Запрос с таким именем уже существует. Загружаем из файла.\n";
+        return readExistingX509_ReqFromPath(reqPath);
+    }
+
+    X509ReqPtr req = buildIssuerCSR(pkey, countryName, organizationName, commonName);
+
     // Сохранение CSR в файл
-    unique_ptr<BIO, decltype(&BIO_free)> csrBio(BIO_new_file(reqPath.c_str(), "w"), BIO_free);
-    if (!csrBio || PEM_write_bio_X509_REQ(csrBio.get(), req.get()) == 0) {
+    try {
+        Artifacts::writeX509Req(reqPath, req.get(), OutputFormats::current().csr);
+    } catch (const std::runtime_error&) {
         cerr << "generetaIssuerCSR: не удалось сохранить CSR в файл: " << reqPath << "\n";
     }
 
     cout << "generetaIssuerCSR: Запрос на сертификат успешно создан и сохранён по пути: " << reqPath << "\n";
 
 
-    const char* info = X509_NAME_oneline(X509_REQ_get_subject_name(req.get()), nullptr, 0);
+    string info = nameToOneline(X509_REQ_get_subject_name(req.get()));
 
     try {
-        db.addIsuuerCSR(uniqueName, info);
+        db.addIsuuerCSR(uniqueName, info, Database::subjectFromName(X509_REQ_get_subject_name(req.get())));
     } catch (const std::exception& ex) {
         cerr << "generetaIssuerCSR: ошибка при добавлении запроса в базу данных: " << ex.what() << "\n";
     }
 
-    return req.release();
+    return req;
 }
 
-inline PKCS12 *Certificates::generatePKCS12(X509 *userCert, EVP_PKEY*userPkey, const string &password, const string &pkcs12Name)
+inline Pkcs12Ptr Certificates::generatePKCS12(X509 *userCert, EVP_PKEY*userPkey, const string &password, const string &pkcs12Name)
 {
 
     string p12Name = pkcs12Name + ".p12";
     filesystem::path p12Path = filesystem::path(PKCS12_PATH) / p12Name;
 
     // Создание PKCS#12 структуры
-    PKCS12* p12 = PKCS12_create(password.c_str(), "User Certificate", userPkey, userCert, 0, 0, 0, 0, 0, 0);
+    Pkcs12Ptr p12(PKCS12_create(password.c_str(), "User Certificate", userPkey, userCert, 0, 0, 0, 0, 0, 0));
     if (!p12) {
         cerr << "Не удалось создать PKCS#12 структуру." << endl;
-        EVP_PKEY_free(userPkey);
-        X509_free(userCert);
         return nullptr;
     }
 
-    unique_ptr<BIO, decltype(&BIO_free_all)> p12Bio(BIO_new_file(p12Path.c_str(), "wb"), BIO_free_all);
+    BioPtr p12Bio(BIO_new_file(p12Path.c_str(), "wb"));
     if (!p12Bio) {
         cerr << "Не удалось создать BIO для записи PKCS#12 в файл: " << p12Path << endl;
         return nullptr;
     }
 
     // Запись PKCS#12 контейнера в файл
-    if (i2d_PKCS12_bio(p12Bio.get(), p12) != 1) {
+    if (i2d_PKCS12_bio(p12Bio.get(), p12.get()) != 1) {
         cerr << "Не удалось записать PKCS#12 контейнер в файл." << endl;
         return nullptr;
     }
@@ -286,17 +301,19 @@ inline PKCS12 *Certificates::generatePKCS12(X509 *userCert, EVP_PKEY*userPkey, c
     return p12;
 }
 
-X509* Certificates::signIssuerReqCSR(const string& certFilename, X509_REQ* req, X509* rootCert, EVP_PKEY* pkey, Database& db) {
-
-
-    filesystem::path issuerCertPath = filesystem::path(ISSUER_CERTS_PATH) / certFilename;
+inline X509Ptr Certificates::buildIssuerCert(X509_REQ* req, X509* rootCert, EVP_PKEY* pkey, ASN1_INTEGER* serial) {
 
-    unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> reqPubKey(X509_REQ_get_pubkey(req), EVP_PKEY_free);
+    EvpPkeyPtr reqPubKey(X509_REQ_get_pubkey(req));
     if (!reqPubKey) {
         throw runtime_error("Ошибка: не удалось извлечь публичный ключ из CSR.");
     }
 
-    unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> rootPubKey(X509_get_pubkey(rootCert), EVP_PKEY_free);
+    // Проверка подписи CSR (proof-of-possession)
+    if (X509_REQ_verify(req, reqPubKey.get()) != 1) {
+        throw runtime_error("Ошибка: подпись CSR не прошла проверку.");
+    }
+
+    EvpPkeyPtr rootPubKey(X509_get_pubkey(rootCert));
     if (!rootPubKey) {
         throw runtime_error("Ошибка: не удалось извлечь публичный ключ из корневого сертификата.");
     }
@@ -311,15 +328,18 @@ X509* Certificates::signIssuerReqCSR(const string& certFilename, X509_REQ* req,
     //     throw runtime_error("Ошибка: публичный ключ CSR не соответствует публичному ключу корневого сертификата.");
     // }
 
-    unique_ptr<X509, decltype(&X509_free)> newIssuerCert(X509_new(), X509_free);
+    X509Ptr newIssuerCert(X509_new());
     if (!newIssuerCert) {
         throw std::runtime_error("Ошибка: не удалось создать структуру для нового сертификата.");
     }
 
-    // Установка серийного номера
-    unique_ptr<ASN1_INTEGER, decltype(&ASN1_INTEGER_free)> serialNumber(ASN1_INTEGER_new(), ASN1_INTEGER_free);
-    ASN1_INTEGER_set(serialNumber.get(), rand());
-    X509_set_serialNumber(newIssuerCert.get(), serialNumber.get());
+    // Установка серийного номера: заранее выделенного или случайного
+    if (serial) {
+        X509_set_serialNumber(newIssuerCert.get(), serial);
+    } else {
+        Asn1IntegerPtr serialNumber = allocateSerial();
+        X509_set_serialNumber(newIssuerCert.get(), serialNumber.get());
+    }
 
     // Установка сроков действия сертификата
     ASN1_TIME* rootNotBefore = X509_get_notBefore(rootCert);
@@ -327,12 +347,8 @@ X509* Certificates::signIssuerReqCSR(const string& certFilename, X509_REQ* req,
     if (!rootNotBefore || !rootNotAfter) {
         throw std::runtime_error("Ошибка: не удалось получить даты начала или окончания действия из корневого сертификата.");
     }
-    try {
-        X509_set_notBefore(newIssuerCert.get(), rootNotBefore);
-        X509_set_notAfter(newIssuerCert.get(), rootNotAfter);
-    } catch (const exception& ex) {
-        throw std::runtime_error(ex.what());
-    }
+    X509_set1_notBefore(newIssuerCert.get(), rootNotBefore);
+    X509_set1_notAfter(newIssuerCert.get(), rootNotAfter);
 
     // Копирование данных субъекта из CSR
     X509_set_subject_name(newIssuerCert.get(), X509_REQ_get_subject_name(req));
@@ -346,30 +362,26 @@ X509* Certificates::signIssuerReqCSR(const string& certFilename, X509_REQ* req,
     }
 
     // Подпись нового сертификата
-    if (X509_sign(newIssuerCert.get(), pkey, EVP_sha256()) <= 0) {
+    if (X509_sign(newIssuerCert.get(), pkey, digestForKey(pkey)) <= 0) {
         throw runtime_error("Ошибка: не удалось подписать новый сертификат.");
     }
 
-    // Сохранение подписанного сертификата в файл
-    unique_ptr<BIO, decltype(&BIO_free)> newIssuerCertBio(BIO_new_file(issuerCertPath.c_str(), "w"), BIO_free);
-    if (!newIssuerCertBio || PEM_write_bio_X509(newIssuerCertBio.get(), newIssuerCert.get()) == 0) {
-        cerr << "signIssuerReqCSR: не удалось сохранить подписанный сертификат в файл: " << issuerCertPath << "\n";
-    }
-
-    cout << "Сертификат успешно подписан и сохранён по пути: " << issuerCertPath << "\n";
-
+    return newIssuerCert;
+}
 
-    const ASN1_INTEGER* serial = X509_get_serialNumber(newIssuerCert.get());
-    BIGNUM* serialBN = ASN1_INTEGER_to_BN(serial, nullptr);
-    char* serialStr = BN_bn2dec(serialBN);
+inline IssuedCertInfo Certificates::describeCertificate(X509* cert) {
+    IssuedCertInfo result;
 
-    const char* info = X509_NAME_oneline(X509_get_subject_name(newIssuerCert.get()), nullptr, 0);
+    result.serial = serialToDecimal(X509_get_serialNumber(cert));
+    result.info = nameToOneline(X509_get_subject_name(cert));
+    result.subject = Database::subjectFromName(X509_get_subject_name(cert));
+    result.keyHash = publicKeyHash(X509_get0_pubkey(cert));
 
     // Извлекаем даты начала и окончания действия сертификата
-    ASN1_TIME* certNotBefore = X509_get_notBefore(newIssuerCert.get());
-    ASN1_TIME* certNotAfter = X509_get_notAfter(newIssuerCert.get());
+    const ASN1_TIME* certNotBefore = X509_get0_notBefore(cert);
+    const ASN1_TIME* certNotAfter = X509_get0_notAfter(cert);
 
-    struct tm tmNotBefore = {0}, tmNotAfter = {0};
+    struct tm tmNotBefore = {}, tmNotAfter = {};
     if (!ASN1_TIME_to_tm(certNotBefore, &tmNotBefore) || !ASN1_TIME_to_tm(certNotAfter, &tmNotAfter)) {
         throw std::runtime_error("Ошибка при преобразовании времени.");
     }
@@ -378,27 +390,115 @@ X509* Certificates::signIssuerReqCSR(const string& certFilename, X509_REQ* req,
     strftime(notBeforeStr, sizeof(notBeforeStr), "%Y-%m-%d %H:%M:%S", &tmNotBefore);
     strftime(notAfterStr, sizeof(notAfterStr), "%Y-%m-%d %H:%M:%S", &tmNotAfter);
 
-    db.addIssuerCert(certFilename, serialStr, notBeforeStr, notAfterStr, info);
+    result.notBefore = notBeforeStr;
+    result.notAfter = notAfterStr;
+    return result;
+}
+
+inline Asn1IntegerPtr Certificates::allocateSerial() {
+    unsigned char serialBytes[16];
+    if (RAND_bytes(serialBytes, sizeof(serialBytes)) != 1) {
+        throw runtime_error("allocateSerial: не удалось получить случайный серийный номер.");
+    }
+    serialBytes[0] &= 0x7f;
+    BignumPtr serialNumber(BN_bin2bn(serialBytes, sizeof(serialBytes), nullptr));
+    Asn1IntegerPtr serial(serialNumber ? BN_to_ASN1_INTEGER(serialNumber.get(), nullptr) : nullptr);
+    if (!serial) {
+        throw runtime_error("allocateSerial: не удалось сформировать серийный номер.");
+    }
+    return serial;
+}
+
+
+inline X509Ptr Certificates::buildRenewedCert(X509* oldCert, X509* caCert, EVP_PKEY* caKey, int validityDays) {
+    if (validityDays <= 0) {
+        throw runtime_error("buildRenewedCert: срок действия должен быть положительным.");
+    }
+
+    // Продлевается только сертификат, действительно подписанный этим УЦ: файл в каталоге мог быть подменен
+    if (X509_NAME_cmp(X509_get_issuer_name(oldCert), X509_get_subject_name(caCert)) != 0 ||
+        X509_verify(oldCert, X509_get0_pubkey(caCert)) != 1) {
+        throw runtime_error("buildRenewedCert: сертификат выпущен не этим УЦ.");
+    }
+
+    X509Ptr renewed(X509_new());
+    if (!renewed) {
+        throw runtime_error("buildRenewedCert: не удалось создать структуру сертификата.");
+    }
+    X509_set_version(renewed.get(), X509_get_version(oldCert));
+
+    Asn1IntegerPtr serial = allocateSerial();
+    X509_set_serialNumber(renewed.get(), serial.get());
 
+    X509_gmtime_adj(X509_getm_notBefore(renewed.get()), 0);
+    X509_gmtime_adj(X509_getm_notAfter(renewed.get()), 60L * 60 * 24 * validityDays);
+    if (ASN1_TIME_compare(X509_get0_notAfter(renewed.get()), X509_get0_notAfter(caCert)) > 0) {
+        X509_set1_notAfter(renewed.get(), X509_get0_notAfter(caCert));
+    }
 
-    return newIssuerCert.release();
+    X509_set_subject_name(renewed.get(), X509_get_subject_name(oldCert));
+    X509_set_issuer_name(renewed.get(), X509_get_subject_name(caCert));
+    if (X509_set_pubkey(renewed.get(), X509_get0_pubkey(oldCert)) != 1) {
+        throw runtime_error("buildRenewedCert: не удалось перенести публичный ключ.");
+    }
+    for (int i = 0; i < X509_get_ext_count(oldCert); ++i) {
+        X509_add_ext(renewed.get(), X509_get_ext(oldCert, i), -1);
+    }
+
+    if (X509_sign(renewed.get(), caKey, digestForKey(caKey)) <= 0) {
+        throw runtime_error("buildRenewedCert: не удалось подписать сертификат.");
+    }
+    return renewed;
 }
 
-inline void Certificates::deleteX509_ReqFromDir(const string &reqName)
+inline X509Ptr Certificates::signIssuerReqCSR(const string& certFilename, X509_REQ* req, X509* rootCert, EVP_PKEY* pkey, Database& db, const string& certsDir) {
+
+
+    filesystem::path issuerCertPath = filesystem::path(certsDir) / certFilename;
+
+    X509Ptr newIssuerCert = buildIssuerCert(req, rootCert, pkey);
+
+    // Сохранение подписанного сертификата в файл
+    try {
+        Artifacts::writeX509(issuerCertPath, newIssuerCert.get(), OutputFormats::current().certs);
+    } catch (const std::runtime_error&) {
+        cerr << "signIssuerReqCSR: не удалось сохранить подписанный сертификат в файл: " << issuerCertPath << "\n";
+    }
+
+    cout << "Сертификат успешно подписан и сохранён по пути: " << issuerCertPath << "\n";
+
+
+    IssuedCertInfo certInfo = describeCertificate(newIssuerCert.get());
+
+    db.addIssuerCert(certFilename, certInfo.serial, certInfo.notBefore, certInfo.notAfter, certInfo.info, certInfo.subject, certInfo.keyHash);
+
+
+    return newIssuerCert;
+}
+
+inline void Certificates::deleteX509_ReqFromDir(const string & /*reqName*/)
 {
-    
+
 }
 
-void Certificates::displayCertificate(const string &certPath)
+inline void Certificates::displayCertificate(const string &certPath)
 {
-    string command = "openssl x509 -in " + certPath + " -text -noout";
-    int result = system(command.c_str());
+    string path = ObjectLoader::resolve(certPath);
+    string inform = !path.empty() && path != certPath ? " -inform DER" : "";
+    string command = "openssl x509 -in " + (path.empty() ? certPath : path) + inform + " -text -noout";
+    if (system(command.c_str()) != 0) {
+        cerr << "displayCertificate: Ошибка при выводе сертификата " << certPath << "\n";
+    }
 }
 
-void Certificates::displayCertificateReq(const string& reqPath) {
-    if (!std::filesystem::exists(reqPath)) {
+inline void Certificates::displayCertificateReq(const string& reqPath) {
+    string path = ObjectLoader::resolve(reqPath);
+    if (path.empty()) {
         throw std::runtime_error("Файл не найден: " + reqPath);
     }
-    string command = "openssl req -in " + reqPath + " -text -noout";
-    int result = system(command.c_str());
-}
\ No newline at end of file
+    string inform = path != reqPath ? " -inform DER" : "";
+    string command = "openssl req -in " + path + inform + " -text -noout";
+    if (system(command.c_str()) != 0) {
+        cerr << "displayCertificateReq: Ошибка при выводе запроса " << reqPath << "\n";
+    }
+}
@@ -0,0 +1,236 @@
+#pragma once
+
+#include <iostream>
+#include <filesystem>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include <openssl/x509.h>
+#include <openssl/x509_vfy.h>
+#include <openssl/pem.h>
+#include <openssl/err.h>
+
+#include "../paths.hpp"
+#include "./ThreadPool.hpp"
+#include "./Handles.hpp"
+#include "./ObjectLoader.hpp"
+
+using namespace std;
+
+// Результат проверки одного сертификата
+struct VerificationResult {
+    string certPath;
+    bool valid = false;
+    bool crlChecked = false;    // false - CRL еще не опубликован, отзыв не проверялся
+    int errorCode = X509_V_OK;
+    string error;
+};
+
+// Сервис проверки цепочки сертификатов до корневого сертификата с учетом CRL.
+// Хранилище доверия строится один раз и перестраивается только при изменении
+// файлов сертификата УЦ или CRL на диске.
+class ChainVerifier {
+private:
+    // Отпечаток файла: время изменения и размер
+    using FileStamps = map<string, pair<filesystem::file_time_type, uintmax_t>>;
+
+    struct StoreSnapshot {
+        X509StorePtr store;
+        FileStamps stamps;
+        size_t crlCount = 0;
+    };
+
+    string caCertPath;
+    string crlDir;
+
+    mutable mutex snapshotMutex;
+    shared_ptr<const StoreSnapshot> snapshot;
+
+    FileStamps __collectStamps() const;
+    shared_ptr<const StoreSnapshot> __buildSnapshot(FileStamps stamps) const;
+    shared_ptr<const StoreSnapshot> __currentSnapshot() const;
+
+public:
+    ChainVerifier(const string& caCertPath = string(ROOT_CERTS_PATH) + "/" + ADMIN_CERT_NAME, const string& crlDir = CRL_PATH)
+        : caCertPath(caCertPath), crlDir(crlDir)
+    {
+        snapshot = __buildSnapshot(__collectStamps());
+    }
+
+    bool reloadIfChanged();
+    size_t crlCount() const { return __currentSnapshot()->crlCount; }
+
+    VerificationResult verify(X509* cert) const;
+    VerificationResult verifyFile(const string& certPath) const;
+    vector<VerificationResult> verifyBatch(const vector<string>& certPaths, size_t threadCount = thread::hardware_concurrency());
+};
+
+
+inline ChainVerifier::FileStamps ChainVerifier::__collectStamps() const {
+    FileStamps stamps;
+    error_code ec;
+
+    auto addStamp = [&stamps, &ec](const filesystem::path& path) {
+        auto mtime = filesystem::last_write_time(path, ec);
+        if (ec) {
+            return;
+        }
+        auto size = filesystem::file_size(path, ec);
+        if (ec) {
+            return;
+        }
+        stamps[path.string()] = {mtime, size};
+    };
+
+    addStamp(caCertPath);
+
+    if (filesystem::is_directory(crlDir, ec)) {
+        for (const auto& entry : filesystem::directory_iterator(crlDir, ec)) {
+            // файлы блокировок переподписи CRL (*.lock) лежат рядом с CRL и не разбираются
+            if (entry.is_regular_file() && entry.path().extension() != ".lock") {
+                addStamp(entry.path());
+            }
+        }
+    }
+
+    return stamps;
+}
+
+
+inline shared_ptr<const ChainVerifier::StoreSnapshot> ChainVerifier::__buildSnapshot(FileStamps stamps) const {
+    auto result = make_shared<StoreSnapshot>();
+    result->store.reset(X509_STORE_new());
+    if (!result->store) {
+        throw runtime_error("ChainVerifier: не удалось создать хранилище сертификатов.");
+    }
+
+    // Корневой сертификат и CRL берутся из кэша ObjectLoader: при перестройке заново разбираются только измененные файлы
+    X509Ptr caCert = ObjectLoader::loadX509(caCertPath);
+    if (!caCert || X509_STORE_add_cert(result->store.get(), caCert.get()) != 1) {
+        throw runtime_error("ChainVerifier: не удалось загрузить сертификат УЦ: " + caCertPath);
+    }
+
+    // Все CRL из директории
+    for (const auto& [path, stamp] : stamps) {
+        if (path == caCertPath) {
+            continue;
+        }
+
+        X509CrlPtr crl = ObjectLoader::loadCRL(path);
+        if (!crl) {
+            cerr << "ChainVerifier: файл не является CRL и будет пропущен: " << path << "\n";
+            continue;
+        }
+
+        if (X509_STORE_add_crl(result->store.get(), crl.get()) == 1) {
+            ++result->crlCount;
+        }
+    }
+    ERR_clear_error();
+
+    // Пока УЦ не опубликовал ни одного CRL, цепочка проверяется без отзыва: иначе на новом УЦ
+    // любая проверка завершалась бы ошибкой "unable to get certificate CRL"
+    if (result->crlCount > 0) {
+        X509_STORE_set_flags(result->store.get(), X509_V_FLAG_CRL_CHECK);
+    }
+    result->stamps = std::move(stamps);
+
+    return result;
+}
+
+
+inline shared_ptr<const ChainVerifier::StoreSnapshot> ChainVerifier::__currentSnapshot() const {
+    lock_guard<mutex> lock(snapshotMutex);
+    return snapshot;
+}
+
+
+inline bool ChainVerifier::reloadIfChanged() {
+    FileStamps stamps = __collectStamps();
+    if (stamps == __currentSnapshot()->stamps) {
+        return false;
+    }
+
+    auto rebuilt = __buildSnapshot(std::move(stamps));
+    lock_guard<mutex> lock(snapshotMutex);
+    snapshot = std::move(rebuilt);
+    return true;
+}
+
+
+inline VerificationResult ChainVerifier::verify(X509* cert) const {
+    VerificationResult result;
+
+    if (!cert) {
+        result.errorCode = X509_V_ERR_UNSPECIFIED;
+        result.error = "пустой сертификат";
+        return result;
+    }
+
+    // снимок удерживается до конца проверки, даже если хранилище перестроят параллельно
+    shared_ptr<const StoreSnapshot> current = __currentSnapshot();
+
+    X509StoreCtxPtr ctx(X509_STORE_CTX_new());
+    if (!ctx || X509_STORE_CTX_init(ctx.get(), current->store.get(), cert, nullptr) != 1) {
+        result.errorCode = X509_V_ERR_UNSPECIFIED;
+        result.error = "не удалось инициализировать контекст проверки";
+        return result;
+    }
+
+    result.crlChecked = current->crlCount > 0;
+    result.valid = X509_verify_cert(ctx.get()) == 1;
+    result.errorCode = X509_STORE_CTX_get_error(ctx.get());
+    result.error = X509_verify_cert_error_string(result.errorCode);
+    ERR_clear_error();
+
+    return result;
+}
+
+
+inline VerificationResult ChainVerifier::verifyFile(const string& certPath) const {
+    VerificationResult result;
+
+    X509Ptr cert = ObjectLoader::loadX509(certPath, false);
+
+    if (!cert) {
+        ERR_clear_error();
+        result.errorCode = X509_V_ERR_UNSPECIFIED;
+        result.error = "не удалось прочитать сертификат";
+    } else {
+        result = verify(cert.get());
+    }
+
+    result.certPath = certPath;
+    return result;
+}
+
+
+inline vector<VerificationResult> ChainVerifier::verifyBatch(const vector<string>& certPaths, size_t threadCount) {
+    reloadIfChanged();
+
+    vector<VerificationResult> results(certPaths.size());
+    if (certPaths.empty()) {
+        return results;
+    }
+
+    ThreadPool pool(min(threadCount == 0 ? size_t(1) : threadCount, certPaths.size()));
+    vector<future<void>> pending;
+    pending.reserve(certPaths.size());
+
+    for (size_t i = 0; i < certPaths.size(); ++i) {
+        pending.push_back(pool.submit([this, &certPaths, &results, i] {
+            results[i] = verifyFile(certPaths[i]);
+        }));
+    }
+
+    for (auto& task : pending) {
+        task.get();
+    }
+
+    return results;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <openssl/asn1.h>
+#include <openssl/bio.h>
+#include <openssl/bn.h>
+#include <openssl/conf.h>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/pkcs12.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+#include <openssl/x509_vfy.h>
+
+// Владеющие обертки над объектами OpenSSL.
+// Каждая обертка освобождает объект соответствующей *_free функцией,
+// поэтому функции, возвращающие объекты, передают владение вызывающей стороне.
+template <auto FreeFunction>
+struct OpenSSLDeleter {
+    template <typename T>
+    void operator()(T* object) const noexcept {
+        FreeFunction(object);
+    }
+};
+
+// Строки и буферы, выделенные OpenSSL (BN_bn2dec, X509_NAME_oneline, ASN1_STRING_to_UTF8)
+struct OpenSSLMemoryDeleter {
+    void operator()(void* memory) const noexcept {
+        OPENSSL_free(memory);
+    }
+};
+
+using BioPtr = std::unique_ptr<BIO, OpenSSLDeleter<BIO_free_all>>;
+using BignumPtr = std::unique_ptr<BIGNUM, OpenSSLDeleter<BN_free>>;
+using ConfPtr = std::unique_ptr<CONF, OpenSSLDeleter<NCONF_free>>;
+using EvpPkeyPtr = std::unique_ptr<EVP_PKEY, OpenSSLDeleter<EVP_PKEY_free>>;
+using EvpPkeyCtxPtr = std::unique_ptr<EVP_PKEY_CTX, OpenSSLDeleter<EVP_PKEY_CTX_free>>;
+using X509Ptr = std::unique_ptr<X509, OpenSSLDeleter<X509_free>>;
+using X509ReqPtr = std::unique_ptr<X509_REQ, OpenSSLDeleter<X509_REQ_free>>;
+using X509CrlPtr = std::unique_ptr<X509_CRL, OpenSSLDeleter<X509_CRL_free>>;
+using X509RevokedPtr = std::unique_ptr<X509_REVOKED, OpenSSLDeleter<X509_REVOKED_free>>;
+using X509ExtensionPtr = std::unique_ptr<X509_EXTENSION, OpenSSLDeleter<X509_EXTENSION_free>>;
+using X509StorePtr = std::unique_ptr<X509_STORE, OpenSSLDeleter<X509_STORE_free>>;
+using X509StoreCtxPtr = std::unique_ptr<X509_STORE_CTX, OpenSSLDeleter<X509_STORE_CTX_free>>;
+using Asn1IntegerPtr = std::unique_ptr<ASN1_INTEGER, OpenSSLDeleter<ASN1_INTEGER_free>>;
+using Asn1EnumeratedPtr = std::unique_ptr<ASN1_ENUMERATED, OpenSSLDeleter<ASN1_ENUMERATED_free>>;
+using Asn1TimePtr = std::unique_ptr<ASN1_TIME, OpenSSLDeleter<ASN1_TIME_free>>;
+using Pkcs12Ptr = std::unique_ptr<PKCS12, OpenSSLDeleter<PKCS12_free>>;
+using OpenSSLStringPtr = std::unique_ptr<char, OpenSSLMemoryDeleter>;
+
+
+// Серийный номер в десятичном виде
+inline std::string serialToDecimal(const ASN1_INTEGER* serial) {
+    BignumPtr serialBN(ASN1_INTEGER_to_BN(serial, nullptr));
+    if (!serialBN) {
+        return "";
+    }
+    OpenSSLStringPtr serialStr(BN_bn2dec(serialBN.get()));
+    return serialStr ? std::string(serialStr.get()) : "";
+}
+
+// Имя в однострочном формате /C=../O=../CN=..
+inline std::string nameToOneline(const X509_NAME* name) {
+    OpenSSLStringPtr oneline(X509_NAME_oneline(name, nullptr, 0));
+    return oneline ? std::string(oneline.get()) : "";
+}
+
+// Алгоритм хэширования для подписи ключом: ключи EdDSA подписывают без отдельного хэша
+inline const EVP_MD* digestForKey(EVP_PKEY* pkey) {
+    int type = EVP_PKEY_base_id(pkey);
+    if (type == EVP_PKEY_ED25519 || type == EVP_PKEY_ED448) {
+        return nullptr;
+    }
+    return EVP_sha256();
+}
+
+// SHA-256 от DER SubjectPublicKeyInfo в hex: одинаков для всех сертификатов и запросов с этим ключом
+inline std::string publicKeyHash(EVP_PKEY* pkey) {
+    int length = pkey ? i2d_PUBKEY(pkey, nullptr) : -1;
+    if (length <= 0) {
+        return "";
+    }
+
+    std::vector<unsigned char> der(length);
+    unsigned char* cursor = der.data();
+    i2d_PUBKEY(pkey, &cursor);
+
+    unsigned char digest[EVP_MAX_MD_SIZE];
+    unsigned int digestLength = 0;
+    if (EVP_Digest(der.data(), der.size(), digest, &digestLength, EVP_sha256(), nullptr) != 1) {
+        return "";
+    }
+
+    static const char hexDigits[] = "0123456789abcdef";
+    std::string hex;
+    for (unsigned int i = 0; i < digestLength; ++i) {
+        hex += hexDigits[digest[i] >> 4];
+        hex += hexDigits[digest[i] & 0x0F];
+    }
+    return hex;
+}
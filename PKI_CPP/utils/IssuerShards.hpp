@@ -0,0 +1,408 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <openssl/pem.h>
+#include <openssl/rand.h>
+#include <openssl/x509v3.h>
+
+#include "../db/database.h"
+#include "../paths.hpp"
+#include "./CRL.hpp"
+#include "./Certificates.hpp"
+#include "./Handles.hpp"
+#include "./Keys.hpp"
+#include "./ObjectLoader.hpp"
+
+using namespace std;
+
+// Несколько выпускающих УЦ (шардов), каждый со своим ключом, сертификатом, директорией выданных
+// сертификатов, базой данных и CRL. Набор шардов задается файлом SHARDS_CONFIG во время запуска:
+//
+//   [acme]                         # имя шарда; пути по умолчанию - в SHARDS_PATH/<имя>
+//   organizations = Acme, Acme Ltd # организации, закрепленные за шардом (необязательно)
+//   key = ...                      # необязательные переопределения путей
+//   cert = ...
+//   certs = ...
+//   crl = ...
+//   db = ...
+//   db-password = ...
+//
+// Без файла конфигурации используется один шард "default" на путях из paths.hpp, как и раньше.
+// Запросы маршрутизируются по организации: сначала по явному закреплению, иначе rendezvous-хэшированием,
+// поэтому добавление шарда переносит на него лишь примерно 1/N организаций.
+struct IssuerShardConfig {
+    string name;
+    string keyPath;
+    string certPath;            // сертификат выпускающего УЦ шарда
+    string certsDir;            // выданные сертификаты
+    string crlPath;
+    string dbPath;
+    string dbPassword = "1234";
+    vector<string> organizations;
+};
+
+
+class IssuerShard {
+private:
+    IssuerShardConfig config;
+    mutex shardMutex;           // операции одного шарда последовательны, разные шарды работают параллельно
+    unique_ptr<Database> db;
+    EvpPkeyPtr key;
+    X509Ptr caCert;
+
+    void __open();
+    static X509Ptr __buildShardCACert(EVP_PKEY* shardKey, const string& name, X509* rootCert, EVP_PKEY* rootKey);
+
+public:
+    explicit IssuerShard(const IssuerShardConfig& config) : config(config) {}
+
+    const IssuerShardConfig& getConfig() const { return config; }
+    bool isInitialized() const;
+
+    // Создает директории, ключ шарда, сертификат УЦ шарда (подписанный корневым ключом), пустой CRL и базу
+    void initialize(X509* rootCert, EVP_PKEY* rootKey, const string& keyType);
+
+    X509Ptr issue(X509_REQ* req, const string& certFilename);
+    size_t revoke(const vector<string>& serials, int reasonCode);
+};
+
+
+class ShardRouter {
+private:
+    vector<unique_ptr<IssuerShard>> shards;
+    unordered_map<string, size_t> pinnedOrganizations;
+
+    static uint64_t __fnv1a(const string& value);
+
+public:
+    explicit ShardRouter(const vector<IssuerShardConfig>& configs);
+
+    static vector<IssuerShardConfig> loadConfig(const string& path = SHARDS_CONFIG);
+
+    IssuerShard& route(const string& organization);
+    IssuerShard* find(const string& name);
+    size_t size() const { return shards.size(); }
+    IssuerShard& at(size_t index) { return *shards.at(index); }
+};
+
+
+static string __trimShardValue(const string& value) {
+    size_t begin = value.find_first_not_of(" \t\r");
+    if (begin == string::npos) {
+        return "";
+    }
+    size_t end = value.find_last_not_of(" \t\r");
+    return value.substr(begin, end - begin + 1);
+}
+
+
+static void __fillShardDefaults(IssuerShardConfig& config) {
+    filesystem::path base = filesystem::path(SHARDS_PATH) / config.name;
+    if (config.keyPath.empty()) config.keyPath = (base / "private" / "issuer.key.pem").string();
+    if (config.certPath.empty()) config.certPath = (base / "issuer.cert.pem").string();
+    if (config.certsDir.empty()) config.certsDir = (base / "certs").string();
+    if (config.crlPath.empty()) config.crlPath = (base / "crl" / DEFAULT_CRL_NAME).string();
+    if (config.dbPath.empty()) config.dbPath = (base / "shard.db").string();
+}
+
+
+inline vector<IssuerShardConfig> ShardRouter::loadConfig(const string& path) {
+    vector<IssuerShardConfig> configs;
+    ifstream in(path);
+
+    // Без конфигурации - единственный УЦ на путях из paths.hpp; выдачу подписывает ключ КУЦ
+    if (!in) {
+        IssuerShardConfig config;
+        config.name = "default";
+        error_code ec;
+        if (filesystem::is_directory(ROOT_PRIVATE_KEY_PATH, ec)) {
+            for (const auto& entry : filesystem::directory_iterator(ROOT_PRIVATE_KEY_PATH)) {
+                if (entry.is_regular_file()) {
+                    config.keyPath = entry.path().string();
+                }
+            }
+        }
+        config.certPath = (filesystem::path(ROOT_CERTS_PATH) / ADMIN_CERT_NAME).string();
+        config.certsDir = ISSUER_CERTS_PATH;
+        config.crlPath = (filesystem::path(CRL_PATH) / DEFAULT_CRL_NAME).string();
+        config.dbPath = DB_PATH;
+        configs.push_back(config);
+        return configs;
+    }
+
+    string line;
+    size_t lineNumber = 0;
+    while (getline(in, line)) {
+        ++lineNumber;
+        size_t comment = line.find('#');
+        if (comment != string::npos) {
+            line.erase(comment);
+        }
+        line = __trimShardValue(line);
+        if (line.empty()) {
+            continue;
+        }
+
+        if (line.front() == '[' && line.back() == ']') {
+            IssuerShardConfig config;
+            config.name = __trimShardValue(line.substr(1, line.size() - 2));
+            if (config.name.empty()) {
+                throw runtime_error("ShardRouter: пустое имя шарда в " + path + ":" + to_string(lineNumber) + ".");
+            }
+            configs.push_back(config);
+            continue;
+        }
+
+        size_t equals = line.find('=');
+        if (equals == string::npos || configs.empty()) {
+            throw runtime_error("ShardRouter: неверная строка " + path + ":" + to_string(lineNumber) + ".");
+        }
+        string key = __trimShardValue(line.substr(0, equals));
+        string value = __trimShardValue(line.substr(equals + 1));
+        IssuerShardConfig& config = configs.back();
+
+        if (key == "key") config.keyPath = value;
+        else if (key == "cert") config.certPath = value;
+        else if (key == "certs") config.certsDir = value;
+        else if (key == "crl") config.crlPath = value;
+        else if (key == "db") config.dbPath = value;
+        else if (key == "db-password") config.dbPassword = value;
+        else if (key == "organizations") {
+            stringstream list(value);
+            string organization;
+            while (getline(list, organization, ',')) {
+                organization = __trimShardValue(organization);
+                if (!organization.empty()) {
+                    config.organizations.push_back(organization);
+                }
+            }
+        } else {
+            throw runtime_error("ShardRouter: неизвестный параметр " + key + " в " + path + ":" + to_string(lineNumber) + ".");
+        }
+    }
+
+    if (configs.empty()) {
+        throw runtime_error("ShardRouter: в " + path + " не описано ни одного шарда.");
+    }
+    for (auto& config : configs) {
+        __fillShardDefaults(config);
+    }
+    return configs;
+}
+
+
+inline ShardRouter::ShardRouter(const vector<IssuerShardConfig>& configs) {
+    for (const auto& config : configs) {
+        for (const auto& shard : shards) {
+            if (shard->getConfig().name == config.name) {
+                throw runtime_error("ShardRouter: шард " + config.name + " описан дважды.");
+            }
+        }
+        for (const auto& organization : config.organizations) {
+            if (!pinnedOrganizations.emplace(organization, shards.size()).second) {
+                throw runtime_error("ShardRouter: организация " + organization + " закреплена за несколькими шардами.");
+            }
+        }
+        shards.push_back(make_unique<IssuerShard>(config));
+    }
+    if (shards.empty()) {
+        throw runtime_error("ShardRouter: не задано ни одного шарда.");
+    }
+}
+
+
+inline uint64_t ShardRouter::__fnv1a(const string& value) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : value) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    // перемешивание, чтобы близкие строки давали независимые веса
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+
+// Rendezvous-хэширование: организации достается шард с наибольшим весом hash(шард, организация)
+inline IssuerShard& ShardRouter::route(const string& organization) {
+    auto pinned = pinnedOrganizations.find(organization);
+    if (pinned != pinnedOrganizations.end()) {
+        return *shards[pinned->second];
+    }
+
+    size_t best = 0;
+    uint64_t bestWeight = 0;
+    for (size_t i = 0; i < shards.size(); ++i) {
+        uint64_t weight = __fnv1a(shards[i]->getConfig().name + '\0' + organization);
+        if (i == 0 || weight > bestWeight) {
+            best = i;
+            bestWeight = weight;
+        }
+    }
+    return *shards[best];
+}
+
+
+inline IssuerShard* ShardRouter::find(const string& name) {
+    for (auto& shard : shards) {
+        if (shard->getConfig().name == name) {
+            return shard.get();
+        }
+    }
+    return nullptr;
+}
+
+
+inline bool IssuerShard::isInitialized() const {
+    return filesystem::exists(config.keyPath) && filesystem::exists(config.certPath) && Artifacts::exists(config.crlPath);
+}
+
+
+// Ключ, сертификат и база открываются при первой операции шарда
+inline void IssuerShard::__open() {
+    if (!key) {
+        key = ObjectLoader::loadPrivateKey(config.keyPath);
+        if (!key) {
+            throw runtime_error("IssuerShard " + config.name + ": не удалось прочитать ключ " + config.keyPath + ".");
+        }
+    }
+    if (!caCert) {
+        caCert = ObjectLoader::loadX509(config.certPath);
+        if (!caCert) {
+            throw runtime_error("IssuerShard " + config.name + ": не удалось прочитать сертификат " + config.certPath + ".");
+        }
+    }
+    if (!db) {
+        db = make_unique<Database>(config.dbPath, config.dbPassword);
+    }
+}
+
+
+inline X509Ptr IssuerShard::__buildShardCACert(EVP_PKEY* shardKey, const string& name, X509* rootCert, EVP_PKEY* rootKey) {
+    X509Ptr cert(X509_new());
+    X509_set_version(cert.get(), 2);
+
+    Asn1IntegerPtr serial = Certificates::allocateSerial();
+    X509_set_serialNumber(cert.get(), serial.get());
+
+    X509_gmtime_adj(X509_getm_notBefore(cert.get()), 0);
+    X509_set1_notAfter(cert.get(), X509_get0_notAfter(rootCert));
+
+    // Субъект: C и O корневого сертификата, CN с именем шарда
+    X509_NAME* subject = X509_get_subject_name(cert.get());
+    X509_NAME* rootSubject = X509_get_subject_name(rootCert);
+    for (int nid : {NID_countryName, NID_organizationName}) {
+        int index = X509_NAME_get_index_by_NID(rootSubject, nid, -1);
+        if (index >= 0) {
+            X509_NAME_add_entry(subject, X509_NAME_get_entry(rootSubject, index), -1, 0);
+        }
+    }
+    string commonName = "Issuing CA " + name;
+    X509_NAME_add_entry_by_txt(subject, "CN", MBSTRING_UTF8, reinterpret_cast<const unsigned char*>(commonName.c_str()), -1, -1, 0);
+    X509_set_issuer_name(cert.get(), rootSubject);
+    X509_set_pubkey(cert.get(), shardKey);
+
+    X509V3_CTX ctx;
+    X509V3_set_ctx(&ctx, rootCert, cert.get(), nullptr, nullptr, 0);
+    const pair<int, const char*> extensions[] = {
+        {NID_basic_constraints, "critical,CA:TRUE,pathlen:0"},
+        {NID_key_usage, "critical,keyCertSign,cRLSign"},
+        {NID_subject_key_identifier, "hash"},
+    };
+    for (const auto& [nid, value] : extensions) {
+        X509ExtensionPtr extension(X509V3_EXT_conf_nid(nullptr, &ctx, nid, value));
+        if (!extension || X509_add_ext(cert.get(), extension.get(), -1) != 1) {
+            throw runtime_error("IssuerShard " + name + ": не удалось добавить расширение сертификата УЦ.");
+        }
+    }
+
+    if (X509_sign(cert.get(), rootKey, digestForKey(rootKey)) <= 0) {
+        throw runtime_error("IssuerShard " + name + ": не удалось подписать сертификат УЦ.");
+    }
+    return cert;
+}
+
+
+inline void IssuerShard::initialize(X509* rootCert, EVP_PKEY* rootKey, const string& keyType) {
+    lock_guard<mutex> lock(shardMutex);
+
+    for (const string& path : {config.keyPath, config.certPath, config.crlPath, config.dbPath}) {
+        filesystem::create_directories(filesystem::path(path).parent_path());
+    }
+    filesystem::create_directories(config.certsDir);
+
+    if (!filesystem::exists(config.keyPath)) {
+        EvpPkeyPtr shardKey = Keys::generateKeyOfType(keyType);
+        // Файл ключа сразу создается с правами 0600: иначе до chmod он был бы доступен по umask
+        int keyFd = open(config.keyPath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+        if (keyFd < 0) {
+            throw runtime_error("IssuerShard " + config.name + ": не удалось создать файл ключа " + config.keyPath + ".");
+        }
+        BioPtr keyBio(BIO_new_fd(keyFd, BIO_CLOSE));
+        if (!keyBio) {
+            close(keyFd);
+        }
+        if (!keyBio || PEM_write_bio_PrivateKey(keyBio.get(), shardKey.get(), nullptr, nullptr, 0, nullptr, nullptr) != 1 ||
+            BIO_flush(keyBio.get()) != 1) {
+            keyBio.reset();
+            filesystem::remove(config.keyPath);
+            throw runtime_error("IssuerShard " + config.name + ": не удалось сохранить ключ " + config.keyPath + ".");
+        }
+    }
+    key.reset();
+    caCert.reset();
+
+    EvpPkeyPtr shardKey = ObjectLoader::loadPrivateKey(config.keyPath);
+    if (!shardKey) {
+        throw runtime_error("IssuerShard " + config.name + ": не удалось прочитать ключ " + config.keyPath + ".");
+    }
+
+    if (!filesystem::exists(config.certPath)) {
+        X509Ptr cert = __buildShardCACert(shardKey.get(), config.name, rootCert, rootKey);
+        BioPtr certBio(BIO_new_file(config.certPath.c_str(), "w"));
+        if (!certBio || PEM_write_bio_X509(certBio.get(), cert.get()) != 1) {
+            throw runtime_error("IssuerShard " + config.name + ": не удалось сохранить сертификат " + config.certPath + ".");
+        }
+    }
+
+    if (!Artifacts::exists(config.crlPath)) {
+        X509Ptr cert = ObjectLoader::loadX509(config.certPath);
+        if (!cert) {
+            throw runtime_error("IssuerShard " + config.name + ": не удалось прочитать сертификат " + config.certPath + ".");
+        }
+        CRL crl(config.crlPath, shardKey.get(), cert.get());
+    }
+
+    __open();
+    db->enableWal();
+}
+
+
+inline X509Ptr IssuerShard::issue(X509_REQ* req, const string& certFilename) {
+    lock_guard<mutex> lock(shardMutex);
+    __open();
+    Certificates certificates;
+    return certificates.signIssuerReqCSR(certFilename, req, caCert.get(), key.get(), *db, config.certsDir);
+}
+
+
+inline size_t IssuerShard::revoke(const vector<string>& serials, int reasonCode) {
+    lock_guard<mutex> lock(shardMutex);
+    __open();
+    return CRL::revokeSerials(config.crlPath, serials, key.get(), *db, reasonCode);
+}
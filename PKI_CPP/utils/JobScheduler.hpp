@@ -0,0 +1,263 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Планировщик задач с кражей работы для разнородной нагрузки УЦ.
+// У каждого потока свои очереди по классам задач; владелец берет задачи с конца своей очереди,
+// свободные потоки крадут с начала чужих. Короткие задачи (запись в базу, записи CRL) берутся первыми;
+// обычные (подпись, PKCS#12) и длинные (генерация ключей) чередуются, чтобы ни один класс не голодал.
+// Длинные задачи одновременно занимают не больше threads-1 потоков, поэтому короткой задаче
+// всегда найдется поток и она не ждет секундную генерацию RSA-ключа.
+
+enum class JobClass { Short = 0, Normal = 1, Long = 2 };
+
+struct JobSchedulerStats {
+    size_t executed[3] = {0, 0, 0};
+    size_t stolen = 0;
+};
+
+class JobScheduler;
+
+// Класс задач планировщика как исполнитель для co_await resumeOn(...)
+class JobLane {
+private:
+    JobScheduler& scheduler;
+    JobClass jobClass;
+
+public:
+    JobLane(JobScheduler& scheduler, JobClass jobClass) : scheduler(scheduler), jobClass(jobClass) {}
+    void post(std::function<void()> task);
+};
+
+class JobScheduler {
+private:
+    static constexpr int classCount = 3;
+
+    struct Worker {
+        std::mutex dequeMutex;
+        std::deque<std::function<void()>> queues[classCount];
+    };
+
+    std::vector<std::unique_ptr<Worker>> workerQueues;
+    std::vector<std::thread> threads;
+
+    std::mutex sleepMutex;
+    std::condition_variable wakeup;
+    size_t pending[3] = {0, 0, 0};      // задач в очередях по классам; защищено sleepMutex
+    bool stopping = false;
+
+    std::atomic<size_t> nextWorker{0};
+    std::atomic<size_t> runningLong{0};
+    size_t maxLong;
+
+    std::atomic<size_t> executed[classCount] = {0, 0, 0};
+    std::atomic<size_t> stolen{0};
+
+    static thread_local JobScheduler* currentScheduler;
+    static thread_local size_t currentWorker;
+    static thread_local size_t picks;
+
+    bool __tryTake(size_t self, int jobClass, std::function<void()>& task);
+    bool __findTask(size_t self, std::function<void()>& task, int& jobClass);
+    void __releaseLongSlot();
+    bool __hasRunnable() const;
+    void __workerLoop(size_t self);
+
+public:
+    explicit JobScheduler(size_t threadCount = std::thread::hardware_concurrency());
+    ~JobScheduler();
+
+    JobScheduler(const JobScheduler&) = delete;
+    JobScheduler& operator=(const JobScheduler&) = delete;
+
+    size_t size() const { return threads.size(); }
+
+    void post(JobClass jobClass, std::function<void()> task);
+
+    template <typename F>
+    auto submit(JobClass jobClass, F&& task) -> std::future<std::invoke_result_t<F>>;
+
+    JobLane lane(JobClass jobClass) { return JobLane(*this, jobClass); }
+
+    JobSchedulerStats getStats() const;
+};
+
+
+inline thread_local JobScheduler* JobScheduler::currentScheduler = nullptr;
+inline thread_local size_t JobScheduler::currentWorker = 0;
+inline thread_local size_t JobScheduler::picks = 0;
+
+
+inline void JobLane::post(std::function<void()> task) {
+    scheduler.post(jobClass, std::move(task));
+}
+
+
+inline JobScheduler::JobScheduler(size_t threadCount) {
+    if (threadCount == 0) {
+        threadCount = 1;
+    }
+    maxLong = std::max<size_t>(1, threadCount - 1);
+
+    for (size_t i = 0; i < threadCount; ++i) {
+        workerQueues.push_back(std::make_unique<Worker>());
+    }
+    threads.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; ++i) {
+        threads.emplace_back([this, i] { __workerLoop(i); });
+    }
+}
+
+inline JobScheduler::~JobScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wakeup.notify_all();
+
+    for (auto& thread : threads) {
+        thread.join();
+    }
+}
+
+inline void JobScheduler::post(JobClass jobClass, std::function<void()> task) {
+    // Задача, порожденная потоком планировщика, остается в его очереди; внешние раздаются по кругу
+    size_t target = currentScheduler == this ? currentWorker : nextWorker++ % workerQueues.size();
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        if (stopping) {
+            throw std::runtime_error("JobScheduler: планировщик уже остановлен.");
+        }
+        ++pending[static_cast<int>(jobClass)];
+    }
+    {
+        Worker& worker = *workerQueues[target];
+        std::lock_guard<std::mutex> lock(worker.dequeMutex);
+        worker.queues[static_cast<int>(jobClass)].push_back(std::move(task));
+    }
+    wakeup.notify_one();
+}
+
+template <typename F>
+auto JobScheduler::submit(JobClass jobClass, F&& task) -> std::future<std::invoke_result_t<F>> {
+    using Result = std::invoke_result_t<F>;
+
+    auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+    std::future<Result> result = packaged->get_future();
+    post(jobClass, [packaged] { (*packaged)(); });
+    return result;
+}
+
+inline bool JobScheduler::__tryTake(size_t self, int jobClass, std::function<void()>& task) {
+    // Своя очередь — с конца (последняя задача еще в кэше), чужие — с начала (самые старые)
+    {
+        Worker& own = *workerQueues[self];
+        std::lock_guard<std::mutex> lock(own.dequeMutex);
+        auto& queue = own.queues[jobClass];
+        if (!queue.empty()) {
+            task = std::move(queue.back());
+            queue.pop_back();
+            return true;
+        }
+    }
+    for (size_t offset = 1; offset < workerQueues.size(); ++offset) {
+        Worker& victim = *workerQueues[(self + offset) % workerQueues.size()];
+        std::lock_guard<std::mutex> lock(victim.dequeMutex);
+        auto& queue = victim.queues[jobClass];
+        if (!queue.empty()) {
+            task = std::move(queue.front());
+            queue.pop_front();
+            ++stolen;
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool JobScheduler::__findTask(size_t self, std::function<void()>& task, int& jobClass) {
+    static constexpr int orders[2][classCount] = {{0, 1, 2}, {0, 2, 1}};
+    for (int candidate : orders[picks++ % 2]) {
+        jobClass = candidate;
+        if (jobClass == static_cast<int>(JobClass::Long)) {
+            // Место под длинную задачу занимается до извлечения, чтобы не превысить лимит при гонке потоков
+            if (runningLong.fetch_add(1) >= maxLong) {
+                __releaseLongSlot();
+                continue;
+            }
+            if (__tryTake(self, jobClass, task)) {
+                return true;
+            }
+            __releaseLongSlot();
+            continue;
+        }
+        if (__tryTake(self, jobClass, task)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Слот длинной задачи освобождается под sleepMutex, чтобы ждущий поток не пропустил пробуждение
+inline void JobScheduler::__releaseLongSlot() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        --runningLong;
+    }
+    wakeup.notify_one();
+}
+
+// Вызывается под sleepMutex
+inline bool JobScheduler::__hasRunnable() const {
+    return pending[static_cast<int>(JobClass::Short)] > 0 || pending[static_cast<int>(JobClass::Normal)] > 0 ||
+           (pending[static_cast<int>(JobClass::Long)] > 0 && runningLong < maxLong);
+}
+
+inline void JobScheduler::__workerLoop(size_t self) {
+    currentScheduler = this;
+    currentWorker = self;
+
+    while (true) {
+        std::function<void()> task;
+        int jobClass = 0;
+        if (__findTask(self, task, jobClass)) {
+            {
+                std::lock_guard<std::mutex> lock(sleepMutex);
+                --pending[jobClass];
+            }
+            task();
+            ++executed[jobClass];
+            if (jobClass == static_cast<int>(JobClass::Long)) {
+                __releaseLongSlot();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        // дорабатываем оставшиеся задачи перед остановкой
+        if (stopping && pending[0] == 0 && pending[1] == 0 && pending[2] == 0) {
+            return;
+        }
+        // Длинные задачи при занятом лимите не будят поток: его разбудит освобождение слота
+        wakeup.wait(lock, [this] { return stopping || __hasRunnable(); });
+    }
+}
+
+inline JobSchedulerStats JobScheduler::getStats() const {
+    JobSchedulerStats stats;
+    for (int i = 0; i < classCount; ++i) {
+        stats.executed[i] = executed[i].load();
+    }
+    stats.stolen = stolen.load();
+    return stats;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+
+#include "./Handles.hpp"
+#include "./JobScheduler.hpp"
+#include "./Keys.hpp"
+
+using namespace std;
+
+// Запас заранее сгенерированных ключей одного типа. Генерация (для RSA — до секунд) идет длинными
+// задачами планировщика в фоне, выпуск забирает готовый ключ. Если запас пуст, ключ генерируется
+// в вызывающем потоке, а не ожидается: длинные задачи могут стоять в очереди за лимитом планировщика.
+class KeyPool {
+private:
+    JobScheduler& scheduler;
+    string keyType;
+    size_t target;
+
+    mutex poolMutex;
+    condition_variable drained;
+    deque<EvpPkeyPtr> keys;
+    size_t inFlight = 0;
+    size_t hits = 0;
+    size_t misses = 0;
+
+    void __refillLocked();
+
+public:
+    KeyPool(JobScheduler& scheduler, const string& keyType, size_t target);
+    ~KeyPool();
+
+    KeyPool(const KeyPool&) = delete;
+    KeyPool& operator=(const KeyPool&) = delete;
+
+    EvpPkeyPtr acquire();
+    EvpPkeyPtr tryAcquire();    // пустой указатель, если запас исчерпан
+
+    size_t available();
+    size_t getHits();
+    size_t getMisses();
+};
+
+
+inline KeyPool::KeyPool(JobScheduler& scheduler, const string& keyType, size_t target)
+    : scheduler(scheduler), keyType(keyType), target(target) {
+    // Неизвестный тип ключа должен обнаружиться сразу, а не в фоновой задаче
+    EvpPkeyPtr first = Keys::generateKeyOfType(keyType);
+    lock_guard<mutex> lock(poolMutex);
+    keys.push_back(std::move(first));
+    __refillLocked();
+}
+
+inline KeyPool::~KeyPool() {
+    // Фоновые задачи обращаются к пулу, поэтому дожидаемся их завершения
+    unique_lock<mutex> lock(poolMutex);
+    target = 0;
+    drained.wait(lock, [this] { return inFlight == 0; });
+}
+
+inline void KeyPool::__refillLocked() {
+    while (keys.size() + inFlight < target) {
+        ++inFlight;
+        scheduler.post(JobClass::Long, [this] {
+            EvpPkeyPtr key;
+            try {
+                key = Keys::generateKeyOfType(keyType);
+            } catch (const std::exception&) {
+                // неудачная генерация не пополняет запас; acquire() сгенерирует ключ сам
+            }
+            lock_guard<mutex> lock(poolMutex);
+            --inFlight;
+            if (key && target > 0) {
+                keys.push_back(std::move(key));
+            }
+            drained.notify_all();
+        });
+    }
+}
+
+inline EvpPkeyPtr KeyPool::tryAcquire() {
+    lock_guard<mutex> lock(poolMutex);
+    EvpPkeyPtr key;
+    if (!keys.empty()) {
+        key = std::move(keys.front());
+        keys.pop_front();
+        ++hits;
+    } else {
+        ++misses;
+    }
+    __refillLocked();
+    return key;
+}
+
+inline EvpPkeyPtr KeyPool::acquire() {
+    EvpPkeyPtr key = tryAcquire();
+    return key ? std::move(key) : Keys::generateKeyOfType(keyType);
+}
+
+inline size_t KeyPool::available() {
+    lock_guard<mutex> lock(poolMutex);
+    return keys.size();
+}
+
+inline size_t KeyPool::getHits() {
+    lock_guard<mutex> lock(poolMutex);
+    return hits;
+}
+
+inline size_t KeyPool::getMisses() {
+    lock_guard<mutex> lock(poolMutex);
+    return misses;
+}
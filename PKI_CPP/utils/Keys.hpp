@@ -6,10 +6,17 @@
 #include <stdexcept>
 #include <variant>
 #include <filesystem>
+#include <openssl/ec.h>
 #include <openssl/rsa.h>
 #include <openssl/evp.h>
 #include <openssl/pem.h>
 
+#include <unistd.h>
+
+#include "../paths.hpp"
+#include "./Handles.hpp"
+#include "./ObjectLoader.hpp"
+
 #define ROOT_KEYS "/root-ca/private"
 #define ISSUER_KEYS "/issuing-ca/private"
 #define DEFAULT_ROOT_PRIVATE_KEY_NAME "root.key.pem"
@@ -22,6 +29,8 @@ class Keys {
 private:
     string rootPkeyName;
     string issuerPkeyName;
+
+    static EvpPkeyPtr __keygen(int type, int rsaBits, int curveNid);
 public:
     Keys() {
         // проверяем есть ли уже какой нибудь приватный ключ ROOT
@@ -51,19 +60,20 @@ public:
     void setRootPkeyName(const string& newKeyName) { this->rootPkeyName = newKeyName; }
     void setIssuerPkeyName(const string& newKeyName) { this->issuerPkeyName = newKeyName; }
 
-    EVP_PKEY* readExistingKeyFromPath(const string& keyPath);
-    EVP_PKEY* generateKey(const string& keyOutPath, string keyFullOutPath);
+    EvpPkeyPtr readExistingKeyFromPath(const string& keyPath);
+    EvpPkeyPtr generateKey(const string& keyOutPath, string keyFullOutPath);
 
+    static EvpPkeyPtr generateKeyOfType(const string& keyType);
     static void displayKey(const string& key);
 };
 
-EVP_PKEY* Keys::readExistingKeyFromPath(const string& keyPath) {
-    unique_ptr<BIO, decltype(&BIO_free_all)> keyBio(BIO_new_file(keyPath.c_str(), "r"), BIO_free_all);
-    if (!keyBio) {
+inline EvpPkeyPtr Keys::readExistingKeyFromPath(const string& keyPath) {
+    if (access(keyPath.c_str(), R_OK) != 0) {
         throw runtime_error("readExistingKeyFromPath: Ошибка при открытии файла с существующим ключом.");
     }
 
-    EVP_PKEY* existingKey = PEM_read_bio_PrivateKey(keyBio.get(), nullptr, nullptr, nullptr);
+    // Ключ (PEM или DER) кэшируется ObjectLoader до изменения файла
+    EvpPkeyPtr existingKey = ObjectLoader::loadPrivateKey(keyPath);
     if (!existingKey) {
         throw runtime_error("readExistingKeyFromPath: Ошибка при чтении существующего ключа из файла.");
     }
@@ -72,7 +82,7 @@ EVP_PKEY* Keys::readExistingKeyFromPath(const string& keyPath) {
 }
 
 
-EVP_PKEY* Keys::generateKey(const string& keyOutPath, string keyName) {
+inline EvpPkeyPtr Keys::generateKey(const string& keyOutPath, string keyName) {
     filesystem::path keyPath;
 
     keyPath = filesystem::path(keyOutPath) / keyName;
@@ -80,36 +90,17 @@ EVP_PKEY* Keys::generateKey(const string& keyOutPath, string keyName) {
 
     if (filesystem::exists(keyPath)) {
         cout << "generateKey: Приватный ключ уже существует: " << keyPath << "\n";
-        EVP_PKEY* pkey = readExistingKeyFromPath(keyPath);
-        return pkey;
-    }
-
-    // Создаем структуру для ключа
-    unique_ptr<EVP_PKEY, decltype(&EVP_PKEY_free)> pkey(EVP_PKEY_new(), EVP_PKEY_free);
-    unique_ptr<RSA, decltype(&RSA_free)> rsa(RSA_new(), RSA_free);
-    unique_ptr<BIGNUM, decltype(&BN_free)> e(BN_new(), BN_free);
-
-    if (!pkey || !rsa || !e) {
-        throw runtime_error("generateKey: Ошибка при создании структуры для ключа");
-    }
-
-    // Устанавливаем экспоненту
-    if (BN_set_word(e.get(), RSA_F4) != 1) {
-        throw runtime_error("generateKey: Ошибка при установке значения экспоненты");
+        return readExistingKeyFromPath(keyPath);
     }
 
     // Генерируем ключ
-    if (RSA_generate_key_ex(rsa.get(), SUPERADMIN_KEY_SIZE, e.get(), nullptr) != 1) {
+    EvpPkeyPtr pkey = __keygen(EVP_PKEY_RSA, SUPERADMIN_KEY_SIZE, NID_undef);
+    if (!pkey) {
         throw runtime_error("generateKey: Ошибка при генерации ключа RSA");
     }
 
-    // Привязываем RSA к EVP_PKEY
-    if (EVP_PKEY_assign_RSA(pkey.get(), rsa.release()) != 1) {
-        throw runtime_error("generateKey: Ошибка при привязке RSA к EVP_PKEY");
-    }
-
     // Сохраняем ключ в файл
-    unique_ptr<BIO, decltype(&BIO_free_all)> keyBio(BIO_new_file(keyPath.c_str(), "w"), BIO_free_all);
+    BioPtr keyBio(BIO_new_file(keyPath.c_str(), "w"));
     if (!keyBio || PEM_write_bio_PrivateKey(keyBio.get(), pkey.get(), nullptr, nullptr, 0, nullptr, nullptr) == 0) {
         cerr << "generateKey: Ошибка при записи закрытого ключа в файл\n";
     }
@@ -117,12 +108,61 @@ EVP_PKEY* Keys::generateKey(const string& keyOutPath, string keyName) {
     cout << "generateKey: Ключ успешно создан и сохранён по пути: " << keyPath << endl;
 
     // Возвращаем владение ключом вызывающей стороне
-    return pkey.release();
+    return pkey;
+}
+
+
+// Генерирует ключ в памяти без сохранения в файл.
+// Поддерживаемые типы: rsa2048, rsa3072, rsa4096, ec-p256, ec-p384, ed25519
+inline EvpPkeyPtr Keys::generateKeyOfType(const string& keyType) {
+    EvpPkeyPtr pkey;
+
+    if (keyType.rfind("rsa", 0) == 0) {
+        pkey = __keygen(EVP_PKEY_RSA, stoi(keyType.substr(3)), NID_undef);
+    } else if (keyType == "ec-p256") {
+        pkey = __keygen(EVP_PKEY_EC, 0, NID_X9_62_prime256v1);
+    } else if (keyType == "ec-p384") {
+        pkey = __keygen(EVP_PKEY_EC, 0, NID_secp384r1);
+    } else if (keyType == "ed25519") {
+        pkey = __keygen(EVP_PKEY_ED25519, 0, NID_undef);
+    } else {
+        throw runtime_error("generateKeyOfType: неизвестный тип ключа: " + keyType);
+    }
+
+    if (!pkey) {
+        throw runtime_error("generateKeyOfType: Ошибка при генерации ключа " + keyType);
+    }
+
+    return pkey;
 }
 
 
-void Keys::displayKey(const string& keyPath) {
+// Генерация через EVP_PKEY_CTX_new_id: доступна и в OpenSSL 1.1.1, и в 3.x.
+// rsaBits задается для RSA, curveNid - для EC; nullptr при ошибке
+inline EvpPkeyPtr Keys::__keygen(int type, int rsaBits, int curveNid) {
+    EvpPkeyCtxPtr ctx(EVP_PKEY_CTX_new_id(type, nullptr));
+    if (!ctx || EVP_PKEY_keygen_init(ctx.get()) != 1) {
+        return nullptr;
+    }
+    if (type == EVP_PKEY_RSA && EVP_PKEY_CTX_set_rsa_keygen_bits(ctx.get(), rsaBits) != 1) {
+        return nullptr;
+    }
+    if (type == EVP_PKEY_EC && EVP_PKEY_CTX_set_ec_paramgen_curve_nid(ctx.get(), curveNid) != 1) {
+        return nullptr;
+    }
+
+    EVP_PKEY* generated = nullptr;
+    if (EVP_PKEY_keygen(ctx.get(), &generated) != 1) {
+        return nullptr;
+    }
+    return EvpPkeyPtr(generated);
+}
+
+
+inline void Keys::displayKey(const string& keyPath) {
     string command = "openssl pkey -in " + keyPath + " -text -noout";
-    int result = system(command.c_str());
+    if (system(command.c_str()) != 0) {
+        cerr << "displayKey: Ошибка при выводе ключа " << keyPath << "\n";
+    }
 }
 
@@ -4,12 +4,20 @@
 #include <filesystem>
 #include <string>
 #include <memory>
+#include <fstream>
+#include <sstream>
+#include <limits>
+#include <mutex>
 
 #include "../paths.hpp"
 #include "./CRL.hpp"
 #include "./Certificates.hpp"
 #include "./Keys.hpp"
 #include "./UserFileParser.hpp"
+#include "./CSRValidator.hpp"
+#include "./JobScheduler.hpp"
+#include "./RevocationSnapshot.hpp"
+#include "./Renewal.hpp"
 
 
 namespace fs = std::filesystem;
@@ -20,6 +28,7 @@ private:
     unique_ptr<Keys> keys;
     unique_ptr<Certificates> certificates;
     static void displayDirectoryContents(const std::string& dir);
+    void revokeUserCertsByQuery(int reasonCode);
     int deleteFileFromPath(const std::string& pathToFile, const std::string& filename);
 
 public:
@@ -43,6 +52,7 @@ public:
     static void displayCurrentCSRInfo();
     static void displayRootCerts();
     static void displayIssuerCerts();
+    void searchIssuerCerts();
 
     //create methods
     void createRootKey();
@@ -52,8 +62,11 @@ public:
     void createCertReq();
 
     void signUserReq();
+    void signAllUserReqs();
+    void renewExpiringCerts();
     void suspendUserCert();
     void revokeUserCert();
+    void releaseUserCert();
 
     //delete methods
     void deleteIssuerCert();
@@ -70,8 +83,11 @@ inline void Menu::adminMainMenu()
     std::cout << "4. Создать эмитентский сертификат (dev in progress..)\n";
     std::cout << "5. Создать пользовательский запрос на сертификат (dev in progress..)\n\n";
 
-    std::cout << "6. Подписать пользовательский запрос на сертификат\n\n";
-    std::cout << "7. Приостановить действие пользовательского сертификата\n\n";
+    std::cout << "6. Подписать пользовательский запрос на сертификат\n";
+    std::cout << "15. Подписать все пользовательские запросы на сертификат\n";
+    std::cout << "17. Продлить истекающие пользовательские сертификаты\n\n";
+    std::cout << "7. Приостановить действие пользовательского сертификата\n";
+    std::cout << "18. Возобновить действие приостановленных сертификатов\n\n";
     std::cout << "8. Отозвать пользовательский сертификат\n\n";
 
     std::cout << "9. Удалить эмитентский сертификат\n";
@@ -80,7 +96,8 @@ inline void Menu::adminMainMenu()
     std::cout << "11. Просмотреть список отозванных сертификатов\n";
     std::cout << "12. Просмотреть список корневый шаблонов\n";
     std::cout << "13. Просмотреть список эмитенских сертификатов\n";
-    std::cout << "14. Просмотреть список пользовательских запросов\n\n";
+    std::cout << "14. Просмотреть список пользовательских запросов\n";
+    std::cout << "16. Найти эмитентские сертификаты по субъекту\n\n";
 
     std::cout << "0. Выход\n";
     std::cout << "Введите номер действия: ";
@@ -101,7 +118,7 @@ inline void Menu::registratorMainMenu()
     std::cout << "Введите номер действия: ";
 }
 
-void Menu::displayDirectoryContents(const std::string &dir)
+inline void Menu::displayDirectoryContents(const std::string &dir)
 {
 
     if (!fs::exists(dir)) {
@@ -130,12 +147,14 @@ inline int Menu::deleteFileFromPath(const std::string &pathToFile, const std::st
     try {
         filesystem::path filepath = filesystem::path(pathToFile) / filename;
 
-        if (!filesystem::exists(filepath)) {
+        // Артефакт мог быть записан в DER: удаляются оба варианта
+        if (!Artifacts::exists(filepath)) {
             std::cerr << "Файл " + filepath.string() + " не существует.\n";
             return 0;
         }
 
         filesystem::remove(filepath);
+        filesystem::remove(ObjectLoader::derPathFor(filepath));
         std::cout << "Файл " << filepath.string() << " успешно удалён.\n";
         return 1;
     } catch (const std::exception& ex) {
@@ -147,7 +166,7 @@ inline int Menu::deleteFileFromPath(const std::string &pathToFile, const std::st
 inline void Menu::displayCRLs()
 {
     std::cout << "Просмотр списка отозванных сертификатов:\n";
-    CRL::displayCRLlist(ADMIN_ISSUER_CRL_FILE);
+    CRL::displayCRLlist((filesystem::path(CRL_PATH) / DEFAULT_CRL_NAME).string());
 }
 
 inline void Menu::displayCSRs()
@@ -203,6 +222,29 @@ inline void Menu::displayIssuerCerts()
     displayDirectoryContents(ISSUER_CERTS_PATH);
 }
 
+inline void Menu::searchIssuerCerts()
+{
+    SubjectSearchQuery query;
+    std::cin.ignore();
+
+    std::cout << "Организация (O), пусто - любая: ";
+    getline(std::cin, query.organization);
+    std::cout << "Начало имени (CN), пусто - любое: ";
+    getline(std::cin, query.commonNamePrefix);
+    std::cout << "Слова для поиска по субъекту, пусто - без поиска: ";
+    getline(std::cin, query.text);
+
+    try {
+        vector<IssuerCertRecord> records = db.get()->searchIssuerCerts(query);
+        for (const auto& record : records) {
+            std::cout << record.serial << "  " << record.status << "  " << record.certDataTo << "  " << record.info << "\n";
+        }
+        std::cout << "Найдено сертификатов: " << records.size() << (records.size() == static_cast<size_t>(query.limit) ? " (показаны последние)" : "") << "\n";
+    } catch (const std::runtime_error& ex) {
+        std::cerr << "Ошибка поиска: " << ex.what() << "\n";
+    }
+}
+
 inline void Menu::createRootKey()
 {
     std::string newRootPkeyName = "";
@@ -327,12 +369,12 @@ inline void Menu::createIssuerCertificate()
 {
 }
 
-void Menu::createCertReq()
+inline void Menu::createCertReq()
 {
-    EVP_PKEY* pkey = nullptr;
+    EvpPkeyPtr pkey;
     try {
         pkey = keys.get()->readExistingKeyFromPath(filesystem::path(ROOT_PRIVATE_KEY_PATH) / keys.get()->getRootPkeyName());
-    } catch (std::runtime_error) {
+    } catch (const std::runtime_error&) {
         std::cerr << "Неудалось прочитать приватный ключ корневого центра сертификации.\n";
         return;
     }
@@ -359,7 +401,7 @@ void Menu::createCertReq()
 
     if (ans == "y") {
         string filenameWithoutEx = filesystem::path(filename).stem().string();
-        certificates.get()->genereteIssuerCSR(*db, pkey, filenameWithoutEx, userInfo.countryName, userInfo.organizationName, userInfo.fio);
+        certificates.get()->genereteIssuerCSR(*db, pkey.get(), filenameWithoutEx, userInfo.countryName, userInfo.organizationName, userInfo.fio);
         return;
     } 
     else {
@@ -371,20 +413,20 @@ void Menu::createCertReq()
 
 inline void Menu::signUserReq()
 {
-    EVP_PKEY* pkey = nullptr;
-    X509* rootCert = nullptr;
-    X509_REQ* req = nullptr;
-    X509* userCert = nullptr;
+    EvpPkeyPtr pkey;
+    X509Ptr rootCert;
+    X509ReqPtr req;
+    X509Ptr userCert;
 
     try {
         pkey = keys.get()->readExistingKeyFromPath(filesystem::path(ROOT_PRIVATE_KEY_PATH) / keys.get()->getRootPkeyName());
-    } catch (std::runtime_error) {
+    } catch (const std::runtime_error&) {
         std::cerr << "Неудалось прочитать приватный ключ КУЦ.\n";
     }
 
     try {
         rootCert = certificates.get()->readExistingX509FromPath(filesystem::path(ROOT_CERTS_PATH) / ADMIN_CERT_NAME);
-    } catch (std::runtime_error) {
+    } catch (const std::runtime_error&) {
         std::cerr << "Неудалось прочитать самоподписанный сертификат КУЦ.\n";
     }
 
@@ -398,7 +440,7 @@ inline void Menu::signUserReq()
 
         filesystem::path filepath = filesystem::path(ISSUER_CSR_PATH) / (reqFilename + ".csr.pem");
 
-        if (!filesystem::exists(filepath)) {
+        if (!Artifacts::exists(filepath)) {
             std::cerr << "ОШИБКА: Файла с именем " + reqFilename + " не существует.\n";
             throw runtime_error("");
         }
@@ -406,7 +448,13 @@ inline void Menu::signUserReq()
             req = certificates.get()->readExistingX509_ReqFromPath(filepath);
         }
 
-        userCert = certificates.get()->signIssuerReqCSR(reqFilename + ".cert.pem", req, rootCert, pkey, *db);
+        CSRValidationResult validation = CSRValidator(rootCert.get()).validate(req.get());
+        if (!validation.valid) {
+            std::cerr << "Запрос " + reqFilename + " отклонен: " + validation.reason + "\n";
+            throw runtime_error("");
+        }
+
+        userCert = certificates.get()->signIssuerReqCSR(reqFilename + ".cert.pem", req.get(), rootCert.get(), pkey.get(), *db);
 
         // EVP_PKEY* tempKeyForCryptocontainer = keys.get()->generateKey(TEMP_PATH, "temp.key.pem");
         
@@ -414,30 +462,305 @@ inline void Menu::signUserReq()
         string userPassword = parseUserInfo(userinfoFilepath).password;
 
         // certificates.get()->generatePKCS12(userCert, tempKeyForCryptocontainer, userPassword, reqFilename);
-        certificates.get()->generatePKCS12(userCert, pkey, userPassword, reqFilename);
+        certificates.get()->generatePKCS12(userCert.get(), pkey.get(), userPassword, reqFilename);
 
         // deleteFileFromPath(TEMP_PATH, "temp.key.pem");
 
-    } catch (std::runtime_error) {
+    } catch (const std::runtime_error&) {
         std::cerr << "Неудалось подписать пользовательский запрос на сертификат.\n";
     }
 
 }
 
+inline void Menu::signAllUserReqs()
+{
+    EvpPkeyPtr pkey;
+    X509Ptr rootCert;
+
+    try {
+        pkey = keys.get()->readExistingKeyFromPath(filesystem::path(ROOT_PRIVATE_KEY_PATH) / keys.get()->getRootPkeyName());
+        rootCert = certificates.get()->readExistingX509FromPath(filesystem::path(ROOT_CERTS_PATH) / ADMIN_CERT_NAME);
+    } catch (const std::runtime_error&) {
+        std::cerr << "Неудалось прочитать приватный ключ или самоподписанный сертификат КУЦ.\n";
+    }
+
+    if (!pkey || !rootCert) {
+        return;
+    }
+
+    // Загружаем все запросы из директории CSR; запрос в DER (.csr.der) берется, только если рядом нет PEM
+    const string reqExtension = ".csr.pem";
+    const string derReqExtension = ".csr.der";
+    vector<string> reqNames;
+    vector<X509ReqPtr> reqs;
+    vector<X509_REQ*> reqViews;
+
+    for (const auto& entry : fs::directory_iterator(ISSUER_CSR_PATH)) {
+        string filename = entry.path().filename().string();
+        if (!entry.is_regular_file() || filename.size() <= reqExtension.size()) {
+            continue;
+        }
+        string extension = filename.substr(filename.size() - reqExtension.size());
+        if (extension != reqExtension && (extension != derReqExtension ||
+            fs::exists(fs::path(ISSUER_CSR_PATH) / (filename.substr(0, filename.size() - derReqExtension.size()) + reqExtension)))) {
+            continue;
+        }
+
+        X509ReqPtr req = certificates.get()->readExistingX509_ReqFromPath(entry.path());
+        if (req) {
+            reqNames.push_back(filename.substr(0, filename.size() - reqExtension.size()));
+            reqViews.push_back(req.get());
+            reqs.push_back(std::move(req));
+        }
+    }
+
+    // Проверка запросов выполняется параллельно до подписи, отклоненные запросы не подписываются
+    vector<CSRValidationResult> results;
+    try {
+        results = CSRValidator(rootCert.get()).validateBatch(reqViews);
+    } catch (const std::runtime_error& ex) {
+        std::cerr << "Ошибка при проверке запросов: " << ex.what() << "\n";
+        results.assign(reqs.size(), CSRValidationResult{false, "проверка не выполнена"});
+    }
+
+    // Подпись и экспорт PKCS#12 — обычные задачи планировщика, запросы подписываются параллельно;
+    // соединение с базой одно на все задачи, поэтому запись в нее идет под dbMutex (как в IssuancePipeline)
+    JobScheduler scheduler;
+    mutex dbMutex;
+    vector<future<bool>> pending;
+    for (size_t i = 0; i < reqs.size(); ++i) {
+        if (!results[i].valid) {
+            std::cerr << "Запрос " + reqNames[i] + " отклонен: " + results[i].reason + "\n";
+            continue;
+        }
+
+        pending.push_back(scheduler.submit(JobClass::Normal, [&, i] {
+            try {
+                string certName = reqNames[i] + ".cert.pem";
+                X509Ptr userCert = Certificates::buildIssuerCert(reqs[i].get(), rootCert.get(), pkey.get());
+                Artifacts::writeX509((filesystem::path(ISSUER_CERTS_PATH) / certName).string(), userCert.get(), OutputFormats::current().certs);
+                IssuedCertInfo certInfo = Certificates::describeCertificate(userCert.get());
+                {
+                    lock_guard<mutex> lock(dbMutex);
+                    db.get()->addIssuerCert(certName, certInfo.serial, certInfo.notBefore, certInfo.notAfter, certInfo.info, certInfo.subject, certInfo.keyHash);
+                }
+
+                filesystem::path userinfoFilepath = filesystem::path(USER_REQS_PATH) / (reqNames[i] + ".txt");
+                string userPassword = parseUserInfo(userinfoFilepath).password;
+                certificates.get()->generatePKCS12(userCert.get(), pkey.get(), userPassword, reqNames[i]);
+                return true;
+            } catch (const std::exception& ex) {
+                std::cerr << "Неудалось подписать запрос " + reqNames[i] + ": " << ex.what() << "\n";
+                return false;
+            }
+        }));
+    }
+
+    size_t signedCount = 0;
+    for (auto& task : pending) {
+        signedCount += task.get();
+    }
+
+    std::cout << "Подписано запросов: " << signedCount << " из " << reqs.size() << "\n";
+}
+
+inline void Menu::renewExpiringCerts()
+{
+    RenewalOptions options;
+    string input;
+
+    std::cout << "Продлить сертификаты, истекающие в ближайшие N дней. N: ";
+    std::cin >> options.withinDays;
+    std::cout << "Срок действия новых сертификатов (дней): ";
+    std::cin >> options.validityDays;
+    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    if (std::cin.fail() || options.withinDays < 0 || options.validityDays <= 0) {
+        std::cin.clear();
+        std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        std::cerr << "Неверный ввод.\n";
+        return;
+    }
+
+    EvpPkeyPtr pkey;
+    X509Ptr rootCert;
+    try {
+        pkey = keys.get()->readExistingKeyFromPath(filesystem::path(ROOT_PRIVATE_KEY_PATH) / keys.get()->getRootPkeyName());
+        rootCert = certificates.get()->readExistingX509FromPath(filesystem::path(ROOT_CERTS_PATH) / ADMIN_CERT_NAME);
+    } catch (const std::runtime_error&) {
+        std::cerr << "Неудалось прочитать приватный ключ или самоподписанный сертификат КУЦ.\n";
+    }
+    if (!pkey || !rootCert) {
+        return;
+    }
+
+    try {
+        RenewalEngine engine(*db, rootCert.get(), pkey.get());
+
+        options.dryRun = true;
+        size_t selected = engine.run(options).selected;
+        if (selected == 0) {
+            std::cout << "Истекающих сертификатов не найдено.\n";
+            return;
+        }
+
+        std::cout << "Найдено истекающих сертификатов: " << selected << ". Отозвать старые как Superseded? (y/n): ";
+        getline(std::cin, input);
+        options.revokePredecessors = input == "y" || input == "Y";
+        options.dryRun = false;
+
+        RenewalReport report = engine.run(options);
+        for (const auto& result : report.results) {
+            if (result.serial.empty()) {
+                std::cerr << "Неудалось продлить " + result.oldCertName + ": " + result.error + "\n";
+            }
+        }
+        std::cout << "Продлено сертификатов: " << report.renewed << " из " << report.selected << "\n";
+
+        if (report.revoked > 0) {
+            std::cout << "Опубликован снимок отзыва, версия " << RevocationSnapshot::publish(*db) << "\n";
+        }
+    } catch (const std::runtime_error& ex) {
+        std::cerr << "Неудалось продлить сертификаты: " << ex.what() << "\n";
+    }
+}
+
 inline void Menu::suspendUserCert()
 {
-    
+    // Приостановка - отзыв с причиной CertificateHold
+    revokeUserCertsByQuery(CertificateHold);
 }
 
 inline void Menu::revokeUserCert()
 {
+    revokeUserCertsByQuery(CRL::getRevocationReason());
+}
+
+inline void Menu::releaseUserCert()
+{
+    std::cout << "Серийные номера приостановленных сертификатов через пробел или путь к файлу со списком: ";
+    string input;
+    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    getline(std::cin, input);
+
+    std::ifstream serialsFile(input);
+    std::istringstream serialsLine(input);
+    std::istream& serialsStream = serialsFile.is_open() ? static_cast<std::istream&>(serialsFile) : serialsLine;
+
+    vector<string> serials;
+    string serial;
+    while (serialsStream >> serial) {
+        serials.push_back(serial);
+    }
+    if (serials.empty()) {
+        std::cerr << "Не указано ни одного серийного номера.\n";
+        return;
+    }
+
+    try {
+        EvpPkeyPtr pkey = keys.get()->readExistingKeyFromPath(filesystem::path(ROOT_PRIVATE_KEY_PATH) / keys.get()->getRootPkeyName());
+        size_t removed = CRL::releaseSerials((filesystem::path(CRL_PATH) / DEFAULT_CRL_NAME).string(), serials, pkey.get(), *db);
+        std::cout << "Из CRL удалено записей: " << removed << ", CRL переподписан.\n";
+        std::cout << "Опубликован снимок отзыва, версия " << RevocationSnapshot::publish(*db) << "\n";
+    } catch (const std::runtime_error& ex) {
+        std::cerr << "Неудалось возобновить действие сертификатов: " << ex.what() << "\n";
+    }
+}
+
+inline void Menu::revokeUserCertsByQuery(int reasonCode)
+{
+    std::cout << "Отбор сертификатов:\n";
+    std::cout << "1. По списку серийных номеров\n";
+    std::cout << "2. По организации\n";
+    std::cout << "3. По периоду выпуска\n";
+    std::cout << "4. По хэшу ключа\n";
+    std::cout << "Введите номер: ";
+
+    int mode = 0;
+    std::cin >> mode;
+    std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+
+    RevocationQuery query;
+    string input;
+
+    switch (mode) {
+    case 1: {
+        std::cout << "Серийные номера через пробел или путь к файлу со списком: ";
+        getline(std::cin, input);
+
+        std::ifstream serialsFile(input);
+        std::istringstream serialsLine(input);
+        std::istream& serialsStream = serialsFile.is_open() ? static_cast<std::istream&>(serialsFile) : serialsLine;
+
+        string serial;
+        while (serialsStream >> serial) {
+            query.serials.push_back(serial);
+        }
+        break;
+    }
+    case 2:
+        std::cout << "Организация (O): ";
+        getline(std::cin, query.organization);
+        break;
+    case 3:
+        std::cout << "Выпущены начиная с (ГГГГ-ММ-ДД): ";
+        getline(std::cin, query.issuedFrom);
+        std::cout << "Выпущены до (ГГГГ-ММ-ДД, не включительно): ";
+        getline(std::cin, query.issuedTo);
+        break;
+    case 4:
+        std::cout << "Хэш ключа (SHA-256, hex): ";
+        getline(std::cin, query.keyHash);
+        break;
+    default:
+        std::cerr << "Неверный выбор.\n";
+        return;
+    }
+
+    EvpPkeyPtr pkey;
+    try {
+        vector<string> unknown = db.get()->selectUnknownSerials(query.serials);
+        if (!unknown.empty()) {
+            std::cerr << "Сертификаты не выдавались этим УЦ:";
+            for (const auto& serial : unknown) {
+                std::cerr << " " << serial;
+            }
+            std::cerr << "\n";
+            return;
+        }
+
+        vector<string> serials = db.get()->selectSerialsForRevocation(query);
+        if (serials.empty()) {
+            std::cout << "Действующих сертификатов по условию не найдено.\n";
+            return;
+        }
+
+        std::cout << "Найдено действующих сертификатов: " << serials.size() << ". Продолжить? (y/n): ";
+        getline(std::cin, input);
+        if (input != "y" && input != "Y") {
+            return;
+        }
+
+        pkey = keys.get()->readExistingKeyFromPath(filesystem::path(ROOT_PRIVATE_KEY_PATH) / keys.get()->getRootPkeyName());
+        size_t added = CRL::revokeSerials((filesystem::path(CRL_PATH) / DEFAULT_CRL_NAME).string(), serials, pkey.get(), *db, reasonCode);
+        std::cout << "В CRL добавлено записей: " << added << ", CRL переподписан.\n";
+    } catch (const std::runtime_error& ex) {
+        std::cerr << "Неудалось отозвать сертификаты: " << ex.what() << "\n";
+        return;
+    }
+
+    // Снимок статусов для других процессов
+    try {
+        std::cout << "Опубликован снимок отзыва, версия " << RevocationSnapshot::publish(*db) << "\n";
+    } catch (const std::runtime_error& ex) {
+        std::cerr << "Неудалось опубликовать снимок отзыва: " << ex.what() << "\n";
+    }
 }
 
 inline void Menu::deleteIssuerCert()
 {
 }
 
-void Menu::deleteCertReq()
+inline void Menu::deleteCertReq()
 {
     std::cout << "Укажите название файла запроса на сертификат, который нужно удалить:\n";
     string reqFileName = "";
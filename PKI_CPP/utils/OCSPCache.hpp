@@ -0,0 +1,368 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <ctime>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <openssl/ocsp.h>
+
+#include "../db/database.h"
+#include "./Handles.hpp"
+#include "./RevocationIndex.hpp"
+#include "./ThreadPool.hpp"
+
+using namespace std;
+
+using OcspRequestPtr = std::unique_ptr<OCSP_REQUEST, OpenSSLDeleter<OCSP_REQUEST_free>>;
+using OcspResponsePtr = std::unique_ptr<OCSP_RESPONSE, OpenSSLDeleter<OCSP_RESPONSE_free>>;
+using OcspBasicRespPtr = std::unique_ptr<OCSP_BASICRESP, OpenSSLDeleter<OCSP_BASICRESP_free>>;
+using OcspCertIdPtr = std::unique_ptr<OCSP_CERTID, OpenSSLDeleter<OCSP_CERTID_free>>;
+
+// Кэш заранее подписанных ответов OCSP (профиль RFC 5019) для всех действующих и отозванных сертификатов.
+//
+// refresh() сверяет кэш с issuing_certs и отозванными из archived_certs и переподписывает только новые записи,
+// записи со сменившимся статусом и записи, у которых до nextUpdate осталось меньше refreshMargin секунд. Ответ на запрос -
+// поиск готовых DER-байт по серийному номеру, без подписи. Поскольку ответы подписаны заранее,
+// nonce из запроса в них не попадает. На серийные номера, которых нет в кэше, и на запросы к чужому
+// издателю возвращается "unauthorized", как предписывает RFC 5019.
+//
+// Ответы подписывает ключ УЦ, выпускающего сертификаты (сертификат КУЦ или УЦ шарда),
+// ResponderID задается хэшем ключа. Несколько издателей обслуживаются одним адресом через
+// статический respond(), который выбирает кэш по идентификатору издателя из запроса.
+struct OCSPRefreshStats {
+    size_t signedResponses = 0;
+    size_t unchanged = 0;
+    size_t removed = 0;
+};
+
+
+class OCSPCache {
+private:
+    struct Entry {
+        shared_ptr<const string> response;
+        bool revoked = false;
+        int reasonCode = 0;
+        time_t revokedAt = 0;
+        time_t nextUpdate = 0;
+    };
+
+    struct SerialKeyHash {
+        size_t operator()(const RevocationIndex::SerialKey& key) const {
+            uint64_t h1, h2;
+            RevocationIndex::hashSerial(key, h1, h2);
+            return static_cast<size_t>(h1);
+        }
+    };
+
+    X509Ptr issuerCert;
+    EvpPkeyPtr signerKey;
+    OcspCertIdPtr issuerId;         // идентификатор издателя с хэшами SHA-1 для сверки запросов
+    int validity;
+    int refreshMargin;
+
+    mutable shared_mutex mutex;
+    unordered_map<RevocationIndex::SerialKey, Entry, SerialKeyHash> entries;
+
+    shared_ptr<const string> malformedResponse;
+    shared_ptr<const string> unauthorizedResponse;
+
+    Entry __sign(const CertStatusRecord& record, time_t now) const;
+    shared_ptr<const string> __answer(OCSP_CERTID* certId) const;
+    static shared_ptr<const string> __encode(OCSP_RESPONSE* response);
+
+public:
+    // validity - срок действия ответа в секундах; refreshMargin - за сколько секунд до nextUpdate переподписывать
+    OCSPCache(X509* issuerCert, EVP_PKEY* signerKey, int validity = 86400, int refreshMargin = 0);
+
+    OCSPCache(const OCSPCache&) = delete;
+    OCSPCache& operator=(const OCSPCache&) = delete;
+
+    // Подпись выполняется без блокировки; с пулом потоков записи подписываются параллельно пачками
+    OCSPRefreshStats refresh(Database& db, ThreadPool* pool = nullptr, time_t now = time(nullptr));
+
+    // DER OCSPResponse на DER OCSPRequest; всегда возвращает ответ (при ошибке - со статусом ошибки)
+    shared_ptr<const string> respond(string_view requestDer) const;
+    static shared_ptr<const string> respond(const vector<const OCSPCache*>& caches, string_view requestDer);
+    shared_ptr<const string> lookup(const RevocationIndex::SerialKey& serial) const;
+
+    size_t size() const;
+};
+
+
+inline OCSPCache::OCSPCache(X509* issuerCert, EVP_PKEY* signerKey, int validity, int refreshMargin)
+    : validity(validity), refreshMargin(refreshMargin > 0 ? refreshMargin : validity / 4) {
+    if (!issuerCert || !signerKey || validity <= 0) {
+        throw runtime_error("OCSPCache: не заданы сертификат издателя, ключ или срок действия ответов.");
+    }
+    X509_up_ref(issuerCert);
+    this->issuerCert.reset(issuerCert);
+    EVP_PKEY_up_ref(signerKey);
+    this->signerKey.reset(signerKey);
+
+    Asn1IntegerPtr zero(ASN1_INTEGER_new());
+    issuerId.reset(OCSP_cert_id_new(EVP_sha1(), X509_get_subject_name(issuerCert), X509_get0_pubkey_bitstr(issuerCert), zero.get()));
+    if (!issuerId) {
+        throw runtime_error("OCSPCache: не удалось построить идентификатор издателя.");
+    }
+
+    OcspResponsePtr malformed(OCSP_response_create(OCSP_RESPONSE_STATUS_MALFORMEDREQUEST, nullptr));
+    OcspResponsePtr unauthorized(OCSP_response_create(OCSP_RESPONSE_STATUS_UNAUTHORIZED, nullptr));
+    malformedResponse = __encode(malformed.get());
+    unauthorizedResponse = __encode(unauthorized.get());
+}
+
+
+inline shared_ptr<const string> OCSPCache::__encode(OCSP_RESPONSE* response) {
+    int length = i2d_OCSP_RESPONSE(response, nullptr);
+    if (length <= 0) {
+        throw runtime_error("OCSPCache: не удалось закодировать ответ OCSP.");
+    }
+    auto der = make_shared<string>(length, '\0');
+    unsigned char* cursor = reinterpret_cast<unsigned char*>(der->data());
+    i2d_OCSP_RESPONSE(response, &cursor);
+    return der;
+}
+
+
+inline OCSPCache::Entry OCSPCache::__sign(const CertStatusRecord& record, time_t now) const {
+    BIGNUM* rawSerial = nullptr;
+    if (!BN_dec2bn(&rawSerial, record.serial.c_str())) {
+        throw runtime_error("OCSPCache: неверный серийный номер " + record.serial + ".");
+    }
+    BignumPtr serialNumber(rawSerial);
+    Asn1IntegerPtr serial(BN_to_ASN1_INTEGER(serialNumber.get(), nullptr));
+
+    OcspBasicRespPtr basic(OCSP_BASICRESP_new());
+    OCSP_CERTID* certId = OCSP_cert_id_new(EVP_sha1(), X509_get_subject_name(issuerCert.get()),
+                                           X509_get0_pubkey_bitstr(issuerCert.get()), serial.get());
+    Asn1TimePtr thisUpdate(ASN1_TIME_set(nullptr, now));
+    Asn1TimePtr nextUpdate(ASN1_TIME_set(nullptr, now + validity));
+    Asn1TimePtr revokedAt(record.revoked ? ASN1_TIME_set(nullptr, record.revokedAt ? record.revokedAt : now) : nullptr);
+
+    // OCSP_basic_add1_status забирает certId во владение ответа
+    OCSP_SINGLERESP* single = OCSP_basic_add1_status(basic.get(), certId,
+        record.revoked ? V_OCSP_CERTSTATUS_REVOKED : V_OCSP_CERTSTATUS_GOOD,
+        record.revoked ? record.reasonCode : -1, revokedAt.get(), thisUpdate.get(), nextUpdate.get());
+    if (!single) {
+        OCSP_CERTID_free(certId);
+        throw runtime_error("OCSPCache: не удалось добавить статус " + record.serial + ".");
+    }
+
+    if (OCSP_basic_sign(basic.get(), issuerCert.get(), signerKey.get(), digestForKey(signerKey.get()), nullptr,
+                        OCSP_NOCERTS | OCSP_RESPID_KEY) != 1) {
+        throw runtime_error("OCSPCache: не удалось подписать ответ для " + record.serial + ".");
+    }
+
+    OcspResponsePtr response(OCSP_response_create(OCSP_RESPONSE_STATUS_SUCCESSFUL, basic.get()));
+    if (!response) {
+        throw runtime_error("OCSPCache: не удалось построить ответ для " + record.serial + ".");
+    }
+
+    Entry entry;
+    entry.response = __encode(response.get());
+    entry.revoked = record.revoked;
+    entry.reasonCode = record.reasonCode;
+    entry.revokedAt = record.revokedAt;
+    entry.nextUpdate = now + validity;
+    return entry;
+}
+
+
+inline OCSPRefreshStats OCSPCache::refresh(Database& db, ThreadPool* pool, time_t now) {
+    vector<CertStatusRecord> records = db.selectCertStatuses();
+
+    // Последняя запись по серийному номеру определяет статус
+    unordered_map<RevocationIndex::SerialKey, const CertStatusRecord*, SerialKeyHash> current;
+    for (const auto& record : records) {
+        RevocationIndex::SerialKey key;
+        if (RevocationIndex::toSerialKey(record.serial, key)) {
+            current[key] = &record;
+        }
+    }
+
+    OCSPRefreshStats stats;
+    vector<pair<RevocationIndex::SerialKey, const CertStatusRecord*>> pending;
+    {
+        shared_lock<shared_mutex> lock(mutex);
+        for (const auto& [key, record] : current) {
+            auto it = entries.find(key);
+            bool stale = it == entries.end() || it->second.revoked != record->revoked ||
+                         (record->revoked && (it->second.reasonCode != record->reasonCode || it->second.revokedAt != record->revokedAt)) ||
+                         it->second.nextUpdate - now <= refreshMargin;
+            if (stale) {
+                pending.emplace_back(key, record);
+            } else {
+                ++stats.unchanged;
+            }
+        }
+    }
+
+    vector<Entry> signedEntries(pending.size());
+    if (pool && pool->size() > 1 && pending.size() > 64) {
+        size_t chunk = (pending.size() + pool->size() - 1) / pool->size();
+        vector<future<void>> parts;
+        for (size_t begin = 0; begin < pending.size(); begin += chunk) {
+            size_t end = min(pending.size(), begin + chunk);
+            parts.push_back(pool->submit([this, &pending, &signedEntries, begin, end, now] {
+                for (size_t i = begin; i < end; ++i) {
+                    signedEntries[i] = __sign(*pending[i].second, now);
+                }
+            }));
+        }
+        for (auto& part : parts) {
+            part.get();
+        }
+    } else {
+        for (size_t i = 0; i < pending.size(); ++i) {
+            signedEntries[i] = __sign(*pending[i].second, now);
+        }
+    }
+
+    unique_lock<shared_mutex> lock(mutex);
+    for (size_t i = 0; i < pending.size(); ++i) {
+        entries[pending[i].first] = std::move(signedEntries[i]);
+    }
+    for (auto it = entries.begin(); it != entries.end();) {
+        if (!current.count(it->first)) {
+            it = entries.erase(it);
+            ++stats.removed;
+        } else {
+            ++it;
+        }
+    }
+    stats.signedResponses = pending.size();
+    return stats;
+}
+
+
+inline shared_ptr<const string> OCSPCache::lookup(const RevocationIndex::SerialKey& serial) const {
+    shared_lock<shared_mutex> lock(mutex);
+    auto it = entries.find(serial);
+    return it == entries.end() ? nullptr : it->second.response;
+}
+
+
+inline shared_ptr<const string> OCSPCache::respond(string_view requestDer) const {
+    return respond(vector<const OCSPCache*>{this}, requestDer);
+}
+
+
+inline shared_ptr<const string> OCSPCache::respond(const vector<const OCSPCache*>& caches, string_view requestDer) {
+    if (caches.empty()) {
+        throw runtime_error("OCSPCache: не задано ни одного кэша для ответа.");
+    }
+    const unsigned char* cursor = reinterpret_cast<const unsigned char*>(requestDer.data());
+    OcspRequestPtr request(d2i_OCSP_REQUEST(nullptr, &cursor, static_cast<long>(requestDer.size())));
+    if (!request || OCSP_request_onereq_count(request.get()) != 1) {
+        return caches.front()->malformedResponse;
+    }
+
+    OCSP_CERTID* certId = OCSP_onereq_get0_id(OCSP_request_onereq_get0(request.get(), 0));
+    for (const OCSPCache* cache : caches) {
+        if (OCSP_id_issuer_cmp(certId, cache->issuerId.get()) == 0) {
+            return cache->__answer(certId);
+        }
+    }
+    return caches.front()->unauthorizedResponse;
+}
+
+
+inline shared_ptr<const string> OCSPCache::__answer(OCSP_CERTID* certId) const {
+    ASN1_INTEGER* serial = nullptr;
+    if (OCSP_id_get0_info(nullptr, nullptr, nullptr, &serial, certId) != 1) {
+        return unauthorizedResponse;
+    }
+
+    RevocationIndex::SerialKey key;
+    if (!RevocationIndex::toSerialKey(serial, key)) {
+        return unauthorizedResponse;
+    }
+    auto response = lookup(key);
+    return response ? response : unauthorizedResponse;
+}
+
+
+inline size_t OCSPCache::size() const {
+    shared_lock<shared_mutex> lock(mutex);
+    return entries.size();
+}
+
+
+// Фоновое обновление кэша: собственное соединение с базой и периодический refresh()
+class OCSPScheduler {
+private:
+    OCSPCache& cache;
+    string dbPath;
+    string dbPassword;
+    int interval;
+    size_t signingThreads;
+    thread worker;
+    mutex waitMutex;
+    condition_variable wakeUp;
+    bool stopping = false;
+
+    void __run();
+
+public:
+    OCSPScheduler(OCSPCache& cache, const string& dbPath, const string& dbPassword, int interval = 60,
+                  size_t signingThreads = thread::hardware_concurrency());
+    ~OCSPScheduler() { stop(); }
+
+    OCSPScheduler(const OCSPScheduler&) = delete;
+    OCSPScheduler& operator=(const OCSPScheduler&) = delete;
+
+    void start() { worker = thread(&OCSPScheduler::__run, this); }
+    void stop();
+};
+
+
+inline OCSPScheduler::OCSPScheduler(OCSPCache& cache, const string& dbPath, const string& dbPassword, int interval, size_t signingThreads)
+    : cache(cache), dbPath(dbPath), dbPassword(dbPassword), interval(interval), signingThreads(max<size_t>(1, signingThreads)) {}
+
+
+inline void OCSPScheduler::stop() {
+    {
+        lock_guard<mutex> lock(waitMutex);
+        stopping = true;
+    }
+    wakeUp.notify_all();
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+
+inline void OCSPScheduler::__run() {
+    ThreadPool pool(signingThreads);
+    unique_ptr<Database> db;
+    while (true) {
+        try {
+            if (!db) {
+                db = make_unique<Database>(dbPath, dbPassword);
+            }
+            OCSPRefreshStats stats = cache.refresh(*db, &pool);
+            if (stats.signedResponses || stats.removed) {
+                cout << "OCSP: подписано " << stats.signedResponses << ", без изменений " << stats.unchanged
+                     << ", удалено " << stats.removed << endl;
+            }
+        } catch (const std::runtime_error& ex) {
+            cerr << ex.what() << endl;
+            db.reset();
+        }
+
+        unique_lock<mutex> lock(waitMutex);
+        if (wakeUp.wait_for(lock, chrono::seconds(interval), [this] { return stopping; })) {
+            return;
+        }
+    }
+}
@@ -0,0 +1,317 @@
+#pragma once
+
+#include <climits>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <variant>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+#include "./Handles.hpp"
+#include "./PemCodec.hpp"
+
+using namespace std;
+
+// Чтение сертификатов, запросов, ключей и CRL из файлов через mmap. Формат определяется по содержимому:
+// DER (начинается с SEQUENCE, 0x30) разбирается прямо из отображения, PEM — векторным декодером PemCodec
+// (а если он блок не принимает — через BIO поверх того же отображения), без буферизованного чтения файла. Разобранные сертификаты, ключи и CRL
+// кэшируются по пути и проверяются по inode, размеру и времени изменения, поэтому повторная загрузка
+// сертификата УЦ или многомегабайтного CRL стоит одного stat. Из кэша возвращается тот же объект
+// с увеличенным счетчиком ссылок: его нельзя изменять. Кому нужен изменяемый объект (переподпись CRL),
+// загружают его с cached = false. Запросы на сертификат читаются один раз и не кэшируются.
+// Если файла x.pem нет, читается x.der рядом с ним (см. OutputFormat.hpp), так что вызывающий код
+// продолжает работать с PEM-именами артефактов независимо от формата, в котором они записаны.
+
+class MappedFile {
+private:
+    int fd = -1;
+    void* mapping = MAP_FAILED;
+    struct stat info = {};
+
+public:
+    explicit MappedFile(const string& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool isOpen() const { return mapping != MAP_FAILED; }
+    const unsigned char* data() const { return static_cast<const unsigned char*>(mapping); }
+    size_t size() const { return static_cast<size_t>(info.st_size); }
+    const struct stat& status() const { return info; }
+};
+
+
+inline MappedFile::MappedFile(const string& path) {
+    fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0 || fstat(fd, &info) != 0 || !S_ISREG(info.st_mode) || info.st_size == 0) {
+        return;
+    }
+    mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping != MAP_FAILED) {
+        madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+    }
+}
+
+
+inline MappedFile::~MappedFile() {
+    if (mapping != MAP_FAILED) {
+        munmap(mapping, info.st_size);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+}
+
+
+enum class ObjectEncoding { PEM, DER };
+
+struct ObjectLoaderStats {
+    size_t hits = 0;
+    size_t misses = 0;          // файл отображен и разобран
+    size_t entries = 0;
+    size_t bytesParsed = 0;
+};
+
+class ObjectLoader {
+private:
+    static constexpr size_t maxEntries = 256;
+
+    enum class Kind { Certificate, CRL, PrivateKey };
+
+    struct Entry {
+        ino_t inode;
+        off_t size;
+        struct timespec modified;
+        variant<X509Ptr, X509CrlPtr, EvpPkeyPtr> object;
+        list<string>::iterator position;
+    };
+
+    struct Cache {
+        mutex cacheMutex;
+        unordered_map<string, Entry> entries;
+        list<string> recent;    // от недавно использованных к давно
+        ObjectLoaderStats stats;
+    };
+
+    // Не разрушается: объекты OpenSSL в кэше нельзя освобождать после OPENSSL_cleanup в atexit
+    static Cache& __cache() {
+        static Cache* cache = new Cache;
+        return *cache;
+    }
+
+    static string __key(Kind kind, const string& path) { return to_string(static_cast<int>(kind)) + ":" + path; }
+    static bool __sameFile(const Entry& entry, const struct stat& info);
+
+    static X509Ptr __share(const X509Ptr& cert) { X509_up_ref(cert.get()); return X509Ptr(cert.get()); }
+    static X509CrlPtr __share(const X509CrlPtr& crl) { X509_CRL_up_ref(crl.get()); return X509CrlPtr(crl.get()); }
+    static EvpPkeyPtr __share(const EvpPkeyPtr& key) { EVP_PKEY_up_ref(key.get()); return EvpPkeyPtr(key.get()); }
+
+    template <typename Object, Object* (*d2i)(Object**, const unsigned char**, long)>
+    static Object* __parseDer(const unsigned char* data, size_t size);
+    template <typename Object, Object* (*d2i)(Object**, const unsigned char**, long)>
+    static Object* __parsePem(const MappedFile& file, const char* label);
+
+    static X509Ptr __parse(const MappedFile& file, X509Ptr*);
+    static X509CrlPtr __parse(const MappedFile& file, X509CrlPtr*);
+    static EvpPkeyPtr __parse(const MappedFile& file, EvpPkeyPtr*);
+
+    template <typename Ptr>
+    static Ptr __load(Kind kind, const string& path, bool cached);
+
+public:
+    static ObjectEncoding detectEncoding(const unsigned char* data, size_t size);
+
+    static X509Ptr loadX509(const string& path, bool cached = true) { return __load<X509Ptr>(Kind::Certificate, path, cached); }
+    static X509CrlPtr loadCRL(const string& path, bool cached = true) { return __load<X509CrlPtr>(Kind::CRL, path, cached); }
+    static EvpPkeyPtr loadPrivateKey(const string& path, bool cached = true) { return __load<EvpPkeyPtr>(Kind::PrivateKey, path, cached); }
+    static X509ReqPtr loadX509Req(const string& path);
+
+    // Путь DER-варианта артефакта: ".pem" в конце заменяется на ".der", иначе ".der" дописывается
+    static string derPathFor(const string& path);
+    // Путь, по которому артефакт существует на диске (сам path или его DER-вариант), или пустая строка
+    static string resolve(const string& path);
+
+    static ObjectLoaderStats getStats();
+    static void clear();
+};
+
+
+inline ObjectEncoding ObjectLoader::detectEncoding(const unsigned char* data, size_t size) {
+    // Любая структура X.509 в DER — SEQUENCE; в PEM перед BEGIN может стоять текст, поэтому остальное считается PEM
+    return size > 0 && data[0] == 0x30 ? ObjectEncoding::DER : ObjectEncoding::PEM;
+}
+
+
+inline bool ObjectLoader::__sameFile(const Entry& entry, const struct stat& info) {
+    return entry.inode == info.st_ino && entry.size == info.st_size &&
+           entry.modified.tv_sec == info.st_mtim.tv_sec && entry.modified.tv_nsec == info.st_mtim.tv_nsec;
+}
+
+
+template <typename Object, Object* (*d2i)(Object**, const unsigned char**, long)>
+inline Object* ObjectLoader::__parseDer(const unsigned char* data, size_t size) {
+    const unsigned char* cursor = data;
+    return d2i(nullptr, &cursor, static_cast<long>(size));
+}
+
+
+// PEM с меткой label через PemCodec; nullptr, если блок требует разбора OpenSSL
+template <typename Object, Object* (*d2i)(Object**, const unsigned char**, long)>
+inline Object* ObjectLoader::__parsePem(const MappedFile& file, const char* label) {
+    string der;
+    if (!PemCodec::decode(string_view(reinterpret_cast<const char*>(file.data()), file.size()), label, der)) {
+        return nullptr;
+    }
+    return __parseDer<Object, d2i>(reinterpret_cast<const unsigned char*>(der.data()), der.size());
+}
+
+
+inline X509Ptr ObjectLoader::__parse(const MappedFile& file, X509Ptr*) {
+    if (detectEncoding(file.data(), file.size()) == ObjectEncoding::DER) {
+        return X509Ptr(__parseDer<X509, d2i_X509>(file.data(), file.size()));
+    }
+    if (X509* cert = __parsePem<X509, d2i_X509>(file, PEM_STRING_X509)) {
+        return X509Ptr(cert);
+    }
+    BioPtr bio(BIO_new_mem_buf(file.data(), static_cast<int>(file.size())));
+    return X509Ptr(bio ? PEM_read_bio_X509(bio.get(), nullptr, nullptr, nullptr) : nullptr);
+}
+
+
+inline X509CrlPtr ObjectLoader::__parse(const MappedFile& file, X509CrlPtr*) {
+    if (detectEncoding(file.data(), file.size()) == ObjectEncoding::DER) {
+        return X509CrlPtr(__parseDer<X509_CRL, d2i_X509_CRL>(file.data(), file.size()));
+    }
+    if (X509_CRL* crl = __parsePem<X509_CRL, d2i_X509_CRL>(file, PEM_STRING_X509_CRL)) {
+        return X509CrlPtr(crl);
+    }
+    BioPtr bio(BIO_new_mem_buf(file.data(), static_cast<int>(file.size())));
+    return X509CrlPtr(bio ? PEM_read_bio_X509_CRL(bio.get(), nullptr, nullptr, nullptr) : nullptr);
+}
+
+
+inline EvpPkeyPtr ObjectLoader::__parse(const MappedFile& file, EvpPkeyPtr*) {
+    const unsigned char* cursor = file.data();
+    if (detectEncoding(file.data(), file.size()) == ObjectEncoding::DER) {
+        return EvpPkeyPtr(d2i_AutoPrivateKey(nullptr, &cursor, static_cast<long>(file.size())));
+    }
+    BioPtr bio(BIO_new_mem_buf(file.data(), static_cast<int>(file.size())));
+    return EvpPkeyPtr(bio ? PEM_read_bio_PrivateKey(bio.get(), nullptr, nullptr, nullptr) : nullptr);
+}
+
+
+inline string ObjectLoader::derPathFor(const string& path) {
+    const string pemSuffix = ".pem";
+    if (path.size() >= pemSuffix.size() && path.compare(path.size() - pemSuffix.size(), pemSuffix.size(), pemSuffix) == 0) {
+        return path.substr(0, path.size() - pemSuffix.size()) + ".der";
+    }
+    return path + ".der";
+}
+
+
+inline string ObjectLoader::resolve(const string& path) {
+    if (access(path.c_str(), F_OK) == 0) {
+        return path;
+    }
+    string derPath = derPathFor(path);
+    return access(derPath.c_str(), F_OK) == 0 ? derPath : "";
+}
+
+
+template <typename Ptr>
+inline Ptr ObjectLoader::__load(Kind kind, const string& requestedPath, bool cached) {
+    Cache& cache = __cache();
+    string path = resolve(requestedPath);
+    if (path.empty()) {
+        return nullptr;
+    }
+    string key = __key(kind, path);
+
+    if (cached) {
+        struct stat info;
+        if (stat(path.c_str(), &info) == 0) {
+            lock_guard<mutex> lock(cache.cacheMutex);
+            auto found = cache.entries.find(key);
+            if (found != cache.entries.end() && __sameFile(found->second, info)) {
+                cache.recent.splice(cache.recent.begin(), cache.recent, found->second.position);
+                ++cache.stats.hits;
+                return __share(get<Ptr>(found->second.object));
+            }
+        }
+    }
+
+    // Отметка файла берется из fstat того же дескриптора, что и отображение, поэтому соответствует разобранному содержимому
+    MappedFile file(path);
+    if (!file.isOpen() || file.size() > static_cast<size_t>(INT_MAX)) {
+        return nullptr;
+    }
+    Ptr object = __parse(file, static_cast<Ptr*>(nullptr));
+
+    lock_guard<mutex> lock(cache.cacheMutex);
+    ++cache.stats.misses;
+    cache.stats.bytesParsed += file.size();
+    if (!object || !cached) {
+        return object;
+    }
+
+    auto found = cache.entries.find(key);
+    if (found != cache.entries.end()) {
+        cache.recent.erase(found->second.position);
+        cache.entries.erase(found);
+    }
+    cache.recent.push_front(key);
+    Entry entry{file.status().st_ino, file.status().st_size, file.status().st_mtim, __share(object), cache.recent.begin()};
+    cache.entries.emplace(key, std::move(entry));
+
+    while (cache.entries.size() > maxEntries) {
+        cache.entries.erase(cache.recent.back());
+        cache.recent.pop_back();
+    }
+    return object;
+}
+
+
+inline X509ReqPtr ObjectLoader::loadX509Req(const string& path) {
+    string resolved = resolve(path);
+    if (resolved.empty()) {
+        return nullptr;
+    }
+    MappedFile file(resolved);
+    if (!file.isOpen() || file.size() > static_cast<size_t>(INT_MAX)) {
+        return nullptr;
+    }
+    if (detectEncoding(file.data(), file.size()) == ObjectEncoding::DER) {
+        return X509ReqPtr(__parseDer<X509_REQ, d2i_X509_REQ>(file.data(), file.size()));
+    }
+    if (X509_REQ* req = __parsePem<X509_REQ, d2i_X509_REQ>(file, PEM_STRING_X509_REQ)) {
+        return X509ReqPtr(req);
+    }
+    BioPtr bio(BIO_new_mem_buf(file.data(), static_cast<int>(file.size())));
+    return X509ReqPtr(bio ? PEM_read_bio_X509_REQ(bio.get(), nullptr, nullptr, nullptr) : nullptr);
+}
+
+
+inline ObjectLoaderStats ObjectLoader::getStats() {
+    Cache& cache = __cache();
+    lock_guard<mutex> lock(cache.cacheMutex);
+    ObjectLoaderStats stats = cache.stats;
+    stats.entries = cache.entries.size();
+    return stats;
+}
+
+
+inline void ObjectLoader::clear() {
+    Cache& cache = __cache();
+    lock_guard<mutex> lock(cache.cacheMutex);
+    cache.entries.clear();
+    cache.recent.clear();
+}
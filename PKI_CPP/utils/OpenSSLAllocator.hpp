@@ -0,0 +1,499 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+
+#include <openssl/crypto.h>
+
+using namespace std;
+
+// Необязательная замена распределителя памяти OpenSSL через CRYPTO_set_mem_functions.
+// Выпуск сертификатов и CRL создает и освобождает множество мелких объектов ASN.1 (X509_NAME_ENTRY,
+// ASN1_TIME, ASN1_INTEGER, X509_REVOKED), поэтому режимы позволяют измерить и сократить эту нагрузку:
+//   system — стандартный malloc OpenSSL, распределитель не устанавливается;
+//   count  — тот же malloc, но со счетчиками выделений и пиком занятой памяти;
+//   pool   — счетчики и пулы блоков по классам размеров (до 4 КиБ) в кэше каждого потока.
+// Блоки пула берутся пачками из общего склада или нарезаются из слэбов по 64 КиБ; излишки и кэш
+// завершившегося потока возвращаются на склад. Память слэбов не отдается системе до конца процесса.
+// Счетчики ведет каждый поток у себя и сводит только при чтении статистики, поэтому на пути выделения
+// нет атомарных операций с общей памятью; занятый объем сводится в общий порциями по 16 КиБ,
+// и пик точен с этой погрешностью на поток.
+// Устанавливать нужно до первого обращения к OpenSSL: после первого выделения OpenSSL запрещает замену.
+
+enum class AllocatorMode { System, Count, Pool };
+
+struct AllocatorStats {
+    size_t allocations = 0;
+    size_t frees = 0;
+    size_t reallocs = 0;
+    size_t bytesInUse = 0;          // запрошенные байты, без заголовков и округления до класса
+    size_t peakBytes = 0;
+    size_t poolHits = 0;            // выделения из кэша потока без блокировок
+    size_t refills = 0;             // пополнения кэша потока со склада или из нового слэба
+    size_t largeAllocations = 0;    // больше 4 КиБ, мимо пула
+    size_t slabBytes = 0;
+};
+
+// Счетчики текущего потока: разность до и после операции дает число выделений на операцию
+struct ThreadAllocationCounters {
+    size_t allocations = 0;
+    size_t bytes = 0;
+};
+
+class OpenSSLAllocator {
+private:
+    static constexpr size_t classCount = 18;
+    static constexpr uint32_t largeClass = UINT32_MAX;
+    static constexpr size_t slabSize = 64 * 1024;
+    static constexpr ptrdiff_t flushBytes = 16 * 1024;
+    static constexpr size_t classSizes[classCount] = {16, 32, 48, 64, 80, 96, 112, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096};
+
+    // Заголовок перед каждым блоком; 16 байт сохраняют выравнивание malloc
+    struct alignas(16) BlockHeader {
+        uint32_t sizeClass;
+        size_t size;
+    };
+    static_assert(sizeof(BlockHeader) == 16);
+
+    struct FreeBlock {
+        FreeBlock* next;
+    };
+
+    struct FreeList {
+        FreeBlock* head = nullptr;
+        size_t count = 0;
+    };
+
+    // Пишет только поток-владелец (без lock-префикса), читает getStats
+    struct Counters {
+        atomic<size_t> allocations{0};
+        atomic<size_t> frees{0};
+        atomic<size_t> reallocs{0};
+        atomic<size_t> poolHits{0};
+        atomic<size_t> refills{0};
+        atomic<size_t> largeAllocations{0};
+        atomic<size_t> bytes{0};
+    };
+
+    struct ThreadState {
+        FreeList lists[classCount];
+        Counters counters;
+        atomic<ptrdiff_t> pendingBytes{0};   // еще не сведено в общий bytesInUse
+        ThreadState* prev = nullptr;
+        ThreadState* next = nullptr;
+
+        ThreadState();
+        ~ThreadState();
+    };
+
+    // Общий склад свободных блоков и список потоков; не разрушается, так как OpenSSL освобождает память и в atexit
+    struct Depot {
+        mutex depotMutex;
+        FreeList lists[classCount];
+        ThreadState* threads = nullptr;
+        Counters retired;               // счетчики завершившихся потоков и освобождений после их выхода
+    };
+
+    static inline AllocatorMode activeMode = AllocatorMode::System;
+    static inline atomic<ptrdiff_t> bytesInUse{0};
+    static inline atomic<size_t> peakBytes{0};
+    static inline atomic<size_t> slabBytes{0};
+
+    static thread_local ThreadState threadState;
+    static inline thread_local bool threadStateDestroyed = false;
+
+    static Depot& __depot();
+    static ThreadState* __currentThread() { return threadStateDestroyed ? nullptr : &threadState; }
+    static size_t __classFor(size_t size);
+    static size_t __batchFor(size_t sizeClass) { return clamp<size_t>(16 * 1024 / (classSizes[sizeClass] + sizeof(BlockHeader)), 4, 64); }
+
+    static void __count(ThreadState* state, atomic<size_t> Counters::*counter, size_t value = 1);
+    static void __account(ThreadState* state, ptrdiff_t delta);
+    static void __publishBytes(ptrdiff_t delta);
+    static void __sumCounters(const Counters& counters, AllocatorStats& stats);
+
+    static BlockHeader* __takeBlock(ThreadState* state, size_t sizeClass);
+    static void __refill(FreeList& list, size_t sizeClass);
+    static void __returnBlock(ThreadState* state, BlockHeader* header);
+    static void __moveToDepot(FreeList& list, size_t sizeClass, size_t count);
+
+    static void* __malloc(size_t num, const char* file, int line);
+    static void* __realloc(void* ptr, size_t num, const char* file, int line);
+    static void __free(void* ptr, const char* file, int line);
+
+public:
+    // Возвращает false, если OpenSSL уже выделял память и замена невозможна; режим остается system
+    static bool install(AllocatorMode mode);
+    static AllocatorMode mode() { return activeMode; }
+
+    static bool parseMode(const string& name, AllocatorMode& mode);
+    static const char* modeName(AllocatorMode mode);
+
+    static AllocatorStats getStats();
+    static ThreadAllocationCounters threadCounters();
+    static void resetPeak();
+};
+
+
+inline thread_local OpenSSLAllocator::ThreadState OpenSSLAllocator::threadState;
+
+
+inline bool OpenSSLAllocator::install(AllocatorMode mode) {
+    if (mode == AllocatorMode::System) {
+        return true;
+    }
+    // Режим выставляется до установки: первое же выделение через новые функции должно его видеть
+    activeMode = mode;
+    if (CRYPTO_set_mem_functions(&OpenSSLAllocator::__malloc, &OpenSSLAllocator::__realloc, &OpenSSLAllocator::__free) == 0) {
+        activeMode = AllocatorMode::System;
+        return false;
+    }
+    return true;
+}
+
+
+inline bool OpenSSLAllocator::parseMode(const string& name, AllocatorMode& mode) {
+    for (AllocatorMode candidate : {AllocatorMode::System, AllocatorMode::Count, AllocatorMode::Pool}) {
+        if (name == modeName(candidate)) {
+            mode = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+inline const char* OpenSSLAllocator::modeName(AllocatorMode mode) {
+    switch (mode) {
+        case AllocatorMode::Count: return "count";
+        case AllocatorMode::Pool: return "pool";
+        default: return "system";
+    }
+}
+
+
+inline void OpenSSLAllocator::__sumCounters(const Counters& counters, AllocatorStats& stats) {
+    stats.allocations += counters.allocations.load(memory_order_relaxed);
+    stats.frees += counters.frees.load(memory_order_relaxed);
+    stats.reallocs += counters.reallocs.load(memory_order_relaxed);
+    stats.poolHits += counters.poolHits.load(memory_order_relaxed);
+    stats.refills += counters.refills.load(memory_order_relaxed);
+    stats.largeAllocations += counters.largeAllocations.load(memory_order_relaxed);
+}
+
+
+inline AllocatorStats OpenSSLAllocator::getStats() {
+    AllocatorStats stats;
+    ptrdiff_t inUse = bytesInUse.load(memory_order_relaxed);
+    {
+        Depot& depot = __depot();
+        lock_guard<mutex> lock(depot.depotMutex);
+        __sumCounters(depot.retired, stats);
+        for (ThreadState* state = depot.threads; state; state = state->next) {
+            __sumCounters(state->counters, stats);
+            inUse += state->pendingBytes.load(memory_order_relaxed);
+        }
+    }
+    stats.bytesInUse = static_cast<size_t>(max<ptrdiff_t>(0, inUse));
+    stats.peakBytes = max(peakBytes.load(memory_order_relaxed), stats.bytesInUse);
+    stats.slabBytes = slabBytes.load(memory_order_relaxed);
+    return stats;
+}
+
+
+inline ThreadAllocationCounters OpenSSLAllocator::threadCounters() {
+    ThreadState* state = __currentThread();
+    if (!state) {
+        return {};
+    }
+    return {state->counters.allocations.load(memory_order_relaxed), state->counters.bytes.load(memory_order_relaxed)};
+}
+
+
+inline void OpenSSLAllocator::resetPeak() {
+    peakBytes.store(getStats().bytesInUse, memory_order_relaxed);
+}
+
+
+inline OpenSSLAllocator::Depot& OpenSSLAllocator::__depot() {
+    static Depot* depot = new Depot;
+    return *depot;
+}
+
+
+inline OpenSSLAllocator::ThreadState::ThreadState() {
+    Depot& depot = __depot();
+    lock_guard<mutex> lock(depot.depotMutex);
+    next = depot.threads;
+    if (next) {
+        next->prev = this;
+    }
+    depot.threads = this;
+}
+
+
+// Кэш возвращается на склад, счетчики переходят в retired
+inline OpenSSLAllocator::ThreadState::~ThreadState() {
+    for (size_t sizeClass = 0; sizeClass < classCount; ++sizeClass) {
+        __moveToDepot(lists[sizeClass], sizeClass, lists[sizeClass].count);
+    }
+    __publishBytes(pendingBytes.exchange(0, memory_order_relaxed));
+
+    Depot& depot = __depot();
+    lock_guard<mutex> lock(depot.depotMutex);
+    for (auto counter : {&Counters::allocations, &Counters::frees, &Counters::reallocs, &Counters::poolHits,
+                         &Counters::refills, &Counters::largeAllocations, &Counters::bytes}) {
+        (depot.retired.*counter).fetch_add((counters.*counter).load(memory_order_relaxed), memory_order_relaxed);
+    }
+    (prev ? prev->next : depot.threads) = next;
+    if (next) {
+        next->prev = prev;
+    }
+    threadStateDestroyed = true;
+}
+
+
+inline size_t OpenSSLAllocator::__classFor(size_t size) {
+    if (size <= 128) {
+        return size == 0 ? 0 : (size - 1) / 16;
+    }
+    for (size_t sizeClass = 8; sizeClass < classCount; ++sizeClass) {
+        if (size <= classSizes[sizeClass]) {
+            return sizeClass;
+        }
+    }
+    return largeClass;
+}
+
+
+inline void OpenSSLAllocator::__count(ThreadState* state, atomic<size_t> Counters::*counter, size_t value) {
+    if (state) {
+        atomic<size_t>& own = state->counters.*counter;
+        own.store(own.load(memory_order_relaxed) + value, memory_order_relaxed);
+    } else {
+        (__depot().retired.*counter).fetch_add(value, memory_order_relaxed);
+    }
+}
+
+
+inline void OpenSSLAllocator::__publishBytes(ptrdiff_t delta) {
+    ptrdiff_t current = bytesInUse.fetch_add(delta, memory_order_relaxed) + delta;
+    if (delta <= 0 || current <= 0) {
+        return;
+    }
+    size_t peak = peakBytes.load(memory_order_relaxed);
+    while (static_cast<size_t>(current) > peak && !peakBytes.compare_exchange_weak(peak, current, memory_order_relaxed)) {
+    }
+}
+
+
+inline void OpenSSLAllocator::__account(ThreadState* state, ptrdiff_t delta) {
+    if (!state) {
+        __publishBytes(delta);
+        return;
+    }
+    ptrdiff_t pending = state->pendingBytes.load(memory_order_relaxed) + delta;
+    if (pending >= flushBytes || pending <= -flushBytes) {
+        __publishBytes(pending);
+        pending = 0;
+    }
+    state->pendingBytes.store(pending, memory_order_relaxed);
+}
+
+
+// Пополняет список пачкой блоков: сначала со склада, иначе из нового слэба
+inline void OpenSSLAllocator::__refill(FreeList& list, size_t sizeClass) {
+    size_t batch = __batchFor(sizeClass);
+    {
+        Depot& depot = __depot();
+        lock_guard<mutex> lock(depot.depotMutex);
+        FreeList& stock = depot.lists[sizeClass];
+        while (stock.head && batch > 0) {
+            FreeBlock* block = stock.head;
+            stock.head = block->next;
+            --stock.count;
+            block->next = list.head;
+            list.head = block;
+            ++list.count;
+            --batch;
+        }
+    }
+    if (list.head) {
+        return;
+    }
+
+    char* slab = static_cast<char*>(malloc(slabSize));
+    if (!slab) {
+        return;
+    }
+    slabBytes.fetch_add(slabSize, memory_order_relaxed);
+    size_t blockSize = sizeof(BlockHeader) + classSizes[sizeClass];
+    for (size_t offset = 0; offset + blockSize <= slabSize; offset += blockSize) {
+        FreeBlock* block = reinterpret_cast<FreeBlock*>(slab + offset);
+        block->next = list.head;
+        list.head = block;
+        ++list.count;
+    }
+}
+
+
+inline OpenSSLAllocator::BlockHeader* OpenSSLAllocator::__takeBlock(ThreadState* state, size_t sizeClass) {
+    // После разрушения кэша (OpenSSL освобождает память потока позже thread_local) блок берется со склада
+    FreeList spare;
+    FreeList& list = state ? state->lists[sizeClass] : spare;
+    if (list.head) {
+        __count(state, &Counters::poolHits);
+    } else {
+        __count(state, &Counters::refills);
+        __refill(list, sizeClass);
+        if (!list.head) {
+            return nullptr;
+        }
+    }
+    FreeBlock* block = list.head;
+    list.head = block->next;
+    --list.count;
+    if (!state) {
+        __moveToDepot(spare, sizeClass, spare.count);
+    }
+    return reinterpret_cast<BlockHeader*>(block);
+}
+
+
+inline void OpenSSLAllocator::__moveToDepot(FreeList& list, size_t sizeClass, size_t count) {
+    if (count == 0) {
+        return;
+    }
+    // Отделяем count блоков с головы списка и переносим их на склад одной операцией
+    FreeBlock* first = list.head;
+    FreeBlock* last = first;
+    for (size_t i = 1; i < count; ++i) {
+        last = last->next;
+    }
+    list.head = last->next;
+    list.count -= count;
+
+    Depot& depot = __depot();
+    lock_guard<mutex> lock(depot.depotMutex);
+    FreeList& stock = depot.lists[sizeClass];
+    last->next = stock.head;
+    stock.head = first;
+    stock.count += count;
+}
+
+
+inline void OpenSSLAllocator::__returnBlock(ThreadState* state, BlockHeader* header) {
+    size_t sizeClass = header->sizeClass;
+    FreeBlock* block = reinterpret_cast<FreeBlock*>(header);
+    block->next = nullptr;
+    if (!state) {
+        FreeList single{block, 1};
+        __moveToDepot(single, sizeClass, 1);
+        return;
+    }
+
+    FreeList& list = state->lists[sizeClass];
+    block->next = list.head;
+    list.head = block;
+    ++list.count;
+    // Поток, который в основном освобождает чужие блоки, не должен копить их бесконечно
+    size_t batch = __batchFor(sizeClass);
+    if (list.count > 2 * batch) {
+        __moveToDepot(list, sizeClass, batch);
+    }
+}
+
+
+inline void* OpenSSLAllocator::__malloc(size_t num, const char*, int) {
+    ThreadState* state = __currentThread();
+    size_t sizeClass = activeMode == AllocatorMode::Pool ? __classFor(num) : largeClass;
+
+    BlockHeader* header;
+    if (sizeClass == largeClass) {
+        if (num > SIZE_MAX - sizeof(BlockHeader)) {
+            return nullptr;
+        }
+        header = static_cast<BlockHeader*>(malloc(sizeof(BlockHeader) + num));
+        if (activeMode == AllocatorMode::Pool) {
+            __count(state, &Counters::largeAllocations);
+        }
+    } else {
+        header = __takeBlock(state, sizeClass);
+    }
+    if (!header) {
+        return nullptr;
+    }
+
+    header->sizeClass = static_cast<uint32_t>(sizeClass);
+    header->size = num;
+    __count(state, &Counters::allocations);
+    __count(state, &Counters::bytes, num);
+    __account(state, static_cast<ptrdiff_t>(num));
+    return header + 1;
+}
+
+
+inline void OpenSSLAllocator::__free(void* ptr, const char*, int) {
+    if (!ptr) {
+        return;
+    }
+    ThreadState* state = __currentThread();
+    BlockHeader* header = static_cast<BlockHeader*>(ptr) - 1;
+    __count(state, &Counters::frees);
+    __account(state, -static_cast<ptrdiff_t>(header->size));
+    if (header->sizeClass == largeClass) {
+        free(header);
+    } else {
+        __returnBlock(state, header);
+    }
+}
+
+
+inline void* OpenSSLAllocator::__realloc(void* ptr, size_t num, const char* file, int line) {
+    if (!ptr) {
+        return __malloc(num, file, line);
+    }
+    if (num == 0) {
+        __free(ptr, file, line);
+        return nullptr;
+    }
+
+    ThreadState* state = __currentThread();
+    BlockHeader* header = static_cast<BlockHeader*>(ptr) - 1;
+    __count(state, &Counters::reallocs);
+    ptrdiff_t delta = static_cast<ptrdiff_t>(num) - static_cast<ptrdiff_t>(header->size);
+
+    if (header->sizeClass == largeClass) {
+        size_t newClass = activeMode == AllocatorMode::Pool ? __classFor(num) : largeClass;
+        if (newClass == largeClass) {
+            if (num > SIZE_MAX - sizeof(BlockHeader)) {
+                return nullptr;
+            }
+            BlockHeader* resized = static_cast<BlockHeader*>(realloc(header, sizeof(BlockHeader) + num));
+            if (!resized) {
+                return nullptr;
+            }
+            resized->size = num;
+            __account(state, delta);
+            return resized + 1;
+        }
+    } else if (num <= classSizes[header->sizeClass]) {
+        // Новый размер помещается в тот же блок
+        header->size = num;
+        __account(state, delta);
+        return ptr;
+    }
+
+    void* moved = __malloc(num, file, line);
+    if (!moved) {
+        return nullptr;
+    }
+    memcpy(moved, ptr, min(num, header->size));
+    __free(ptr, file, line);
+    return moved;
+}
@@ -0,0 +1,274 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+#include "../paths.hpp"
+#include "./Handles.hpp"
+#include "./ObjectLoader.hpp"
+#include "./PemCodec.hpp"
+
+using namespace std;
+
+// Формат файлов выданных сертификатов, запросов и CRL. Задается файлом OUTPUT_FORMAT_CONFIG:
+//
+//   certs = der        # pem, der или both
+//   csr = pem
+//   crl = both
+//
+// Без файла все пишется в PEM, как раньше. Имя артефакта не меняется (x.cert.pem в базе и API):
+// DER-файл лежит рядом под именем с ".der" вместо ".pem" (ObjectLoader::derPathFor), в режиме both
+// пишутся оба файла. Читатели через ObjectLoader принимают любой вариант, поэтому формат можно
+// сменить без преобразования уже выданных файлов. DER меньше примерно на треть и не требует base64.
+
+enum class OutputFormat { PEM, DER, Both };
+
+struct OutputFormats {
+    OutputFormat certs = OutputFormat::PEM;
+    OutputFormat csr = OutputFormat::PEM;
+    OutputFormat crl = OutputFormat::PEM;
+
+    static OutputFormats load(const string& path = OUTPUT_FORMAT_CONFIG);
+    // Конфигурация процесса: читается при первом обращении; утилиты могут заменить ее до начала работы
+    static OutputFormats current();
+    static void setCurrent(const OutputFormats& formats);
+
+    static bool parse(const string& name, OutputFormat& format);
+    static const char* name(OutputFormat format);
+    static bool writesPem(OutputFormat format) { return format != OutputFormat::DER; }
+    static bool writesDer(OutputFormat format) { return format != OutputFormat::PEM; }
+
+private:
+    struct State;
+    static State& __state();
+};
+
+struct OutputFormats::State {
+    mutex stateMutex;
+    bool loaded = false;
+    OutputFormats formats;
+};
+
+// Кодирование и запись артефактов в выбранном формате
+class Artifacts {
+private:
+    template <typename Object>
+    static string __toDer(const Object* object, int (*i2d)(const Object*, unsigned char**));
+
+public:
+    // DER объекта и его PEM-представление с меткой label (PemCodec): пары (путь назначения, содержимое)
+    static vector<pair<string, string>> encodeDer(const string& der, const char* label, const string& pemPath, OutputFormat format);
+    // Кодирует объект в памяти: пары (путь назначения, содержимое). Бросает runtime_error
+    static vector<pair<string, string>> encodeX509(X509* cert, const string& pemPath, OutputFormat format);
+    static vector<pair<string, string>> encodeX509Req(X509_REQ* req, const string& pemPath, OutputFormat format);
+    static vector<pair<string, string>> encodeCRL(X509_CRL* crl, const string& pemPath, OutputFormat format);
+
+    // Записывает закодированные файлы и удаляет вариант другого формата, оставшийся от прежней настройки.
+    // Каждый файл пишется во временный рядом с целевым и переименовывается поверх, как CRL: читатель
+    // никогда не видит обрезанный файл, а при ошибке прежнее содержимое остается на месте
+    static void write(const vector<pair<string, string>>& encoded, const string& pemPath, OutputFormat format);
+    static void writeX509(const string& pemPath, X509* cert, OutputFormat format) { write(encodeX509(cert, pemPath, format), pemPath, format); }
+    static void writeX509Req(const string& pemPath, X509_REQ* req, OutputFormat format) { write(encodeX509Req(req, pemPath, format), pemPath, format); }
+
+    // Существует ли артефакт в каком-либо формате
+    static bool exists(const string& pemPath) { return !ObjectLoader::resolve(pemPath).empty(); }
+    // Пути, которые в формате format не пишутся (устаревшие варианты)
+    static vector<string> staleVariants(const string& pemPath, OutputFormat format);
+};
+
+
+inline bool OutputFormats::parse(const string& name, OutputFormat& format) {
+    for (OutputFormat candidate : {OutputFormat::PEM, OutputFormat::DER, OutputFormat::Both}) {
+        if (name == OutputFormats::name(candidate)) {
+            format = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+inline const char* OutputFormats::name(OutputFormat format) {
+    switch (format) {
+        case OutputFormat::DER: return "der";
+        case OutputFormat::Both: return "both";
+        default: return "pem";
+    }
+}
+
+
+inline OutputFormats OutputFormats::load(const string& path) {
+    OutputFormats formats;
+    ifstream in(path);
+    if (!in) {
+        return formats;
+    }
+
+    string line;
+    size_t lineNumber = 0;
+    while (getline(in, line)) {
+        ++lineNumber;
+        size_t comment = line.find('#');
+        if (comment != string::npos) {
+            line.erase(comment);
+        }
+        line.erase(remove_if(line.begin(), line.end(), [](unsigned char c) { return isspace(c); }), line.end());
+        if (line.empty()) {
+            continue;
+        }
+
+        size_t equals = line.find('=');
+        OutputFormat format;
+        if (equals == string::npos || !parse(line.substr(equals + 1), format)) {
+            throw runtime_error("OutputFormats: неверная строка " + path + ":" + to_string(lineNumber) + ".");
+        }
+        string key = line.substr(0, equals);
+        if (key == "certs") {
+            formats.certs = format;
+        } else if (key == "csr") {
+            formats.csr = format;
+        } else if (key == "crl") {
+            formats.crl = format;
+        } else {
+            throw runtime_error("OutputFormats: неизвестный параметр " + key + " в " + path + ":" + to_string(lineNumber) + ".");
+        }
+    }
+    return formats;
+}
+
+
+inline OutputFormats::State& OutputFormats::__state() {
+    static State state;
+    return state;
+}
+
+
+inline OutputFormats OutputFormats::current() {
+    State& state = __state();
+    lock_guard<mutex> lock(state.stateMutex);
+    if (!state.loaded) {
+        state.formats = load();
+        state.loaded = true;
+    }
+    return state.formats;
+}
+
+
+inline void OutputFormats::setCurrent(const OutputFormats& formats) {
+    State& state = __state();
+    lock_guard<mutex> lock(state.stateMutex);
+    state.formats = formats;
+    state.loaded = true;
+}
+
+
+template <typename Object>
+inline string Artifacts::__toDer(const Object* object, int (*i2d)(const Object*, unsigned char**)) {
+    int length = object ? i2d(object, nullptr) : 0;
+    if (length <= 0) {
+        throw runtime_error("Artifacts: не удалось закодировать объект.");
+    }
+    string der(length, '\0');
+    unsigned char* cursor = reinterpret_cast<unsigned char*>(der.data());
+    i2d(object, &cursor);
+    return der;
+}
+
+
+inline vector<pair<string, string>> Artifacts::encodeDer(const string& der, const char* label, const string& pemPath, OutputFormat format) {
+    vector<pair<string, string>> encoded;
+    if (OutputFormats::writesPem(format)) {
+        encoded.emplace_back(pemPath, PemCodec::encode(der, label));
+    }
+    if (OutputFormats::writesDer(format)) {
+        encoded.emplace_back(ObjectLoader::derPathFor(pemPath), der);
+    }
+    return encoded;
+}
+
+
+inline vector<pair<string, string>> Artifacts::encodeX509(X509* cert, const string& pemPath, OutputFormat format) {
+    return encodeDer(__toDer(cert, i2d_X509), PEM_STRING_X509, pemPath, format);
+}
+
+
+inline vector<pair<string, string>> Artifacts::encodeX509Req(X509_REQ* req, const string& pemPath, OutputFormat format) {
+    return encodeDer(__toDer(req, i2d_X509_REQ), PEM_STRING_X509_REQ, pemPath, format);
+}
+
+
+inline vector<pair<string, string>> Artifacts::encodeCRL(X509_CRL* crl, const string& pemPath, OutputFormat format) {
+    return encodeDer(__toDer(crl, i2d_X509_CRL), PEM_STRING_X509_CRL, pemPath, format);
+}
+
+
+inline vector<string> Artifacts::staleVariants(const string& pemPath, OutputFormat format) {
+    vector<string> stale;
+    string derPath = ObjectLoader::derPathFor(pemPath);
+    if (!OutputFormats::writesPem(format)) {
+        stale.push_back(pemPath);
+    }
+    if (!OutputFormats::writesDer(format)) {
+        stale.push_back(derPath);
+    }
+    return stale;
+}
+
+
+inline void Artifacts::write(const vector<pair<string, string>>& encoded, const string& pemPath, OutputFormat format) {
+    // Номер записи в имени временного файла различает потоки одного процесса
+    static atomic<uint64_t> writeCounter{0};
+    const string suffix = ".tmp." + to_string(getpid()) + "." + to_string(writeCounter.fetch_add(1));
+
+    vector<pair<string, string>> tempFiles;
+    auto discard = [&tempFiles] {
+        for (const auto& tempFile : tempFiles) {
+            unlink(tempFile.first.c_str());
+        }
+    };
+
+    for (const auto& [path, content] : encoded) {
+        string tempPath = path + suffix;
+        int fd = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        bool written = fd >= 0;
+        for (size_t offset = 0; written && offset < content.size();) {
+            ssize_t chunk = ::write(fd, content.data() + offset, content.size() - offset);
+            written = chunk > 0;
+            offset += written ? chunk : 0;
+        }
+        written = written && fsync(fd) == 0;
+        if (fd >= 0) {
+            close(fd);
+        }
+        if (!written) {
+            unlink(tempPath.c_str());
+            discard();
+            throw runtime_error("Artifacts: не удалось сохранить файл " + path + ".");
+        }
+        tempFiles.emplace_back(tempPath, path);
+    }
+
+    for (size_t i = 0; i < tempFiles.size(); ++i) {
+        if (rename(tempFiles[i].first.c_str(), tempFiles[i].second.c_str()) != 0) {
+            tempFiles.erase(tempFiles.begin(), tempFiles.begin() + i);
+            discard();
+            throw runtime_error("Artifacts: не удалось заменить файл " + tempFiles.front().second + ".");
+        }
+    }
+    for (const auto& path : staleVariants(pemPath, format)) {
+        unlink(path.c_str());
+    }
+}
@@ -0,0 +1,571 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <string_view>
+
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PEM_CODEC_X86 1
+#endif
+
+#include "./Handles.hpp"
+
+using namespace std;
+
+// Кодирование и разбор PEM без PEM_read_bio_* / PEM_write_bio_*. Base64 считается векторно: AVX2 (24 байта
+// за итерацию), SSE4 (12 байт) или скалярно; ядро выбирается по возможностям процессора при первом вызове.
+// Результат encode совпадает с PEM_write_bio байт в байт (строки по 64 символа, "\n"). decode разбирает только
+// простой PEM без заголовков (Proc-Type и т.п.) со строгим base64 и возвращает false на все остальное —
+// вызывающий код в этом случае переходит на разбор OpenSSL. Сверка всех ядер с OpenSSL: PemCodec::selfCheck
+// (pki_bundle check).
+
+enum class Base64Kernel { Scalar, SSE4, AVX2 };
+
+class PemCodec {
+private:
+    using EncodeFunction = size_t (*)(const unsigned char* in, size_t length, char* out);
+    using DecodeFunction = bool (*)(const char* in, size_t length, unsigned char* out, size_t& written);
+
+    static constexpr size_t lineChars = 64;
+
+    static const char* __alphabet() { return "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/"; }
+    static const signed char* __decodeTable();
+
+    static size_t __encodeScalar(const unsigned char* in, size_t length, char* out);
+    static bool __decodeScalar(const char* in, size_t length, unsigned char* out, size_t& written);
+#ifdef PEM_CODEC_X86
+    static size_t __encodeSSE4(const unsigned char* in, size_t length, char* out);
+    static bool __decodeSSE4(const char* in, size_t length, unsigned char* out, size_t& written);
+    static size_t __encodeAVX2(const unsigned char* in, size_t length, char* out);
+    static bool __decodeAVX2(const char* in, size_t length, unsigned char* out, size_t& written);
+#endif
+
+    static Base64Kernel& __selected();
+    static EncodeFunction __encoder(Base64Kernel kernel);
+    static DecodeFunction __decoder(Base64Kernel kernel);
+    static bool __findBlock(string_view text, size_t& offset, string_view& label, string_view& body);
+
+public:
+    struct Block {
+        string label;
+        string der;
+    };
+
+    static bool supported(Base64Kernel kernel);
+    static Base64Kernel best();
+    static Base64Kernel kernel() { return __selected(); }
+    // Для сверки и замеров; неподдерживаемое процессором ядро не включается
+    static bool setKernel(Base64Kernel kernel);
+    static const char* kernelName(Base64Kernel kernel);
+
+    // Base64 без переносов строк; out должен вмещать (length + 2) / 3 * 4 символов
+    static size_t encodeBase64(const unsigned char* in, size_t length, char* out) { return __encoder(__selected())(in, length, out); }
+    // Строгий base64 без пробелов, длина кратна 4; out должен вмещать length / 4 * 3 байт
+    static bool decodeBase64(const char* in, size_t length, unsigned char* out, size_t& written) { return __decoder(__selected())(in, length, out, written); }
+
+    // PEM-блок с меткой label ("CERTIFICATE", "X509 CRL", ...), как его пишет PEM_write_bio
+    static string encode(const unsigned char* der, size_t length, const char* label);
+    static string encode(const string& der, const char* label) { return encode(reinterpret_cast<const unsigned char*>(der.data()), der.size(), label); }
+
+    // Следующий PEM-блок начиная с offset; offset сдвигается за строку END. false - блоков больше нет
+    // или блок не разбирается быстрым путем (тогда offset указывает на его начало)
+    static bool decodeNext(string_view text, size_t& offset, Block& block);
+    // Первый блок с меткой label
+    static bool decode(string_view text, const char* label, string& der);
+
+    // Сверяет каждое поддерживаемое ядро с EVP_EncodeBlock/EVP_DecodeBlock и PEM_write_bio/PEM_read_bio
+    // на случайных данных всех длин до maxLength; описание первого расхождения пишется в report
+    static bool selfCheck(string* report = nullptr, size_t maxLength = 1024, unsigned seed = 1);
+};
+
+
+inline const signed char* PemCodec::__decodeTable() {
+    static const auto table = [] {
+        struct Table { signed char values[256]; } result;
+        memset(result.values, -1, sizeof(result.values));
+        for (int i = 0; i < 64; ++i) {
+            result.values[static_cast<unsigned char>(__alphabet()[i])] = static_cast<signed char>(i);
+        }
+        return result;
+    }();
+    return table.values;
+}
+
+
+inline size_t PemCodec::__encodeScalar(const unsigned char* in, size_t length, char* out) {
+    const char* alphabet = __alphabet();
+    char* start = out;
+    size_t i = 0;
+    for (; i + 3 <= length; i += 3) {
+        unsigned value = (in[i] << 16) | (in[i + 1] << 8) | in[i + 2];
+        *out++ = alphabet[value >> 18];
+        *out++ = alphabet[(value >> 12) & 0x3f];
+        *out++ = alphabet[(value >> 6) & 0x3f];
+        *out++ = alphabet[value & 0x3f];
+    }
+    if (i < length) {
+        unsigned value = in[i] << 16;
+        if (i + 1 < length) {
+            value |= in[i + 1] << 8;
+        }
+        *out++ = alphabet[value >> 18];
+        *out++ = alphabet[(value >> 12) & 0x3f];
+        *out++ = i + 1 < length ? alphabet[(value >> 6) & 0x3f] : '=';
+        *out++ = '=';
+    }
+    return out - start;
+}
+
+
+inline bool PemCodec::__decodeScalar(const char* in, size_t length, unsigned char* out, size_t& written) {
+    written = 0;
+    if (length % 4 != 0) {
+        return false;
+    }
+    const signed char* table = __decodeTable();
+    for (size_t i = 0; i < length; i += 4) {
+        // Дополнение '=' допустимо только в последней четверке: "xx==" или "xxx="
+        size_t padding = 0;
+        if (i + 4 == length) {
+            padding = in[i + 3] == '=' ? (in[i + 2] == '=' ? 2 : 1) : 0;
+        }
+        int a = table[static_cast<unsigned char>(in[i])];
+        int b = table[static_cast<unsigned char>(in[i + 1])];
+        int c = padding >= 2 ? 0 : table[static_cast<unsigned char>(in[i + 2])];
+        int d = padding >= 1 ? 0 : table[static_cast<unsigned char>(in[i + 3])];
+        if ((a | b | c | d) < 0) {
+            return false;
+        }
+        unsigned value = (a << 18) | (b << 12) | (c << 6) | d;
+        out[written++] = static_cast<unsigned char>(value >> 16);
+        if (padding < 2) {
+            out[written++] = static_cast<unsigned char>(value >> 8);
+        }
+        if (padding < 1) {
+            out[written++] = static_cast<unsigned char>(value);
+        }
+    }
+    return true;
+}
+
+
+#ifdef PEM_CODEC_X86
+
+// Ядра по схеме В. Мулы и Д. Лемира: перестановка байтов pshufb, выделение 6-битных индексов умножениями,
+// перевод индексов в символы по таблице сдвигов. Хвост короче векторного блока кодируется скалярно.
+__attribute__((target("sse4.1")))
+inline size_t PemCodec::__encodeSSE4(const unsigned char* in, size_t length, char* out) {
+    const __m128i shuffle = _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    const __m128i shiftLUT = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                           '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    size_t i = 0;
+    char* cursor = out;
+    // Загружается 16 байт, используется 12
+    for (; i + 16 <= length; i += 12, cursor += 16) {
+        __m128i bytes = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)), shuffle);
+        __m128i high = _mm_mulhi_epu16(_mm_and_si128(bytes, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+        __m128i low = _mm_mullo_epi16(_mm_and_si128(bytes, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+        __m128i indices = _mm_or_si128(high, low);
+
+        __m128i reduced = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+        __m128i isUpper = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+        reduced = _mm_or_si128(reduced, _mm_and_si128(isUpper, _mm_set1_epi8(13)));
+        __m128i chars = _mm_add_epi8(_mm_shuffle_epi8(shiftLUT, reduced), indices);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(cursor), chars);
+    }
+    return (cursor - out) + __encodeScalar(in + i, length - i, cursor);
+}
+
+
+// Классификация символов сравнениями диапазонов: A-Z, a-z, 0-9, '+', '/'; любой другой байт - ошибка
+__attribute__((target("sse4.1")))
+inline bool PemCodec::__decodeSSE4(const char* in, size_t length, unsigned char* out, size_t& written) {
+    written = 0;
+    if (length % 4 != 0) {
+        return false;
+    }
+    const __m128i pack = _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    size_t i = 0;
+    // Последняя четверка (возможно, с '=') всегда остается скалярной части
+    for (; i + 16 + 4 <= length; i += 16, written += 12) {
+        __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+        __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('A' - 1)), _mm_cmplt_epi8(chars, _mm_set1_epi8('Z' + 1)));
+        __m128i lower = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(chars, _mm_set1_epi8('z' + 1)));
+        __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(chars, _mm_set1_epi8('9' + 1)));
+        __m128i plus = _mm_cmpeq_epi8(chars, _mm_set1_epi8('+'));
+        __m128i slash = _mm_cmpeq_epi8(chars, _mm_set1_epi8('/'));
+        __m128i valid = _mm_or_si128(_mm_or_si128(upper, lower), _mm_or_si128(digit, _mm_or_si128(plus, slash)));
+        if (_mm_movemask_epi8(valid) != 0xffff) {
+            return false;
+        }
+
+        __m128i shift = _mm_or_si128(
+            _mm_or_si128(_mm_and_si128(upper, _mm_set1_epi8(-65)), _mm_and_si128(lower, _mm_set1_epi8(-71))),
+            _mm_or_si128(_mm_and_si128(digit, _mm_set1_epi8(4)),
+                         _mm_or_si128(_mm_and_si128(plus, _mm_set1_epi8(19)), _mm_and_si128(slash, _mm_set1_epi8(16)))));
+        __m128i values = _mm_add_epi8(chars, shift);
+
+        __m128i pairs = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+        __m128i triples = _mm_shuffle_epi8(_mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000)), pack);
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + written), triples);
+        uint32_t tail = static_cast<uint32_t>(_mm_extract_epi32(triples, 2));
+        memcpy(out + written + 8, &tail, 4);
+    }
+    size_t tailWritten = 0;
+    if (!__decodeScalar(in + i, length - i, out + written, tailWritten)) {
+        return false;
+    }
+    written += tailWritten;
+    return true;
+}
+
+
+__attribute__((target("avx2")))
+inline size_t PemCodec::__encodeAVX2(const unsigned char* in, size_t length, char* out) {
+    const __m256i shuffle = _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+                                            10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1);
+    const __m256i shiftLUT = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                              '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+                                              'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                              '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    size_t i = 0;
+    char* cursor = out;
+    // Две половины по 12 байт, прочитанные 16-байтными загрузками: нужно 28 байт входа на 24 кодируемых
+    for (; i + 28 <= length; i += 24, cursor += 32) {
+        __m256i bytes = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i))),
+                                                _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 12)), 1);
+        bytes = _mm256_shuffle_epi8(bytes, shuffle);
+        __m256i high = _mm256_mulhi_epu16(_mm256_and_si256(bytes, _mm256_set1_epi32(0x0fc0fc00)), _mm256_set1_epi32(0x04000040));
+        __m256i low = _mm256_mullo_epi16(_mm256_and_si256(bytes, _mm256_set1_epi32(0x003f03f0)), _mm256_set1_epi32(0x01000010));
+        __m256i indices = _mm256_or_si256(high, low);
+
+        __m256i reduced = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        __m256i isUpper = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+        reduced = _mm256_or_si256(reduced, _mm256_and_si256(isUpper, _mm256_set1_epi8(13)));
+        __m256i chars = _mm256_add_epi8(_mm256_shuffle_epi8(shiftLUT, reduced), indices);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(cursor), chars);
+    }
+    return (cursor - out) + __encodeSSE4(in + i, length - i, cursor);
+}
+
+
+__attribute__((target("avx2")))
+inline bool PemCodec::__decodeAVX2(const char* in, size_t length, unsigned char* out, size_t& written) {
+    written = 0;
+    if (length % 4 != 0) {
+        return false;
+    }
+    const __m256i pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                          2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    size_t i = 0;
+    for (; i + 32 + 4 <= length; i += 32, written += 24) {
+        __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        __m256i upper = _mm256_and_si256(_mm256_cmpgt_epi8(chars, _mm256_set1_epi8('A' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('Z' + 1), chars));
+        __m256i lower = _mm256_and_si256(_mm256_cmpgt_epi8(chars, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), chars));
+        __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(chars, _mm256_set1_epi8('0' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), chars));
+        __m256i plus = _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('+'));
+        __m256i slash = _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('/'));
+        __m256i valid = _mm256_or_si256(_mm256_or_si256(upper, lower), _mm256_or_si256(digit, _mm256_or_si256(plus, slash)));
+        if (static_cast<uint32_t>(_mm256_movemask_epi8(valid)) != 0xffffffffu) {
+            return false;
+        }
+
+        __m256i shift = _mm256_or_si256(
+            _mm256_or_si256(_mm256_and_si256(upper, _mm256_set1_epi8(-65)), _mm256_and_si256(lower, _mm256_set1_epi8(-71))),
+            _mm256_or_si256(_mm256_and_si256(digit, _mm256_set1_epi8(4)),
+                            _mm256_or_si256(_mm256_and_si256(plus, _mm256_set1_epi8(19)), _mm256_and_si256(slash, _mm256_set1_epi8(16)))));
+        __m256i values = _mm256_add_epi8(chars, shift);
+
+        __m256i pairs = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+        __m256i triples = _mm256_shuffle_epi8(_mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00011000)), pack);
+        // По 12 байт в каждой половине сводятся в 24 подряд идущих
+        triples = _mm256_permutevar8x32_epi32(triples, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + written), _mm256_castsi256_si128(triples));
+        _mm_storel_epi64(reinterpret_cast<__m128i*>(out + written + 16), _mm256_extracti128_si256(triples, 1));
+    }
+    size_t tailWritten = 0;
+    if (!__decodeSSE4(in + i, length - i, out + written, tailWritten)) {
+        return false;
+    }
+    written += tailWritten;
+    return true;
+}
+
+#endif
+
+
+inline bool PemCodec::supported(Base64Kernel kernel) {
+#ifdef PEM_CODEC_X86
+    __builtin_cpu_init();
+#endif
+    switch (kernel) {
+#ifdef PEM_CODEC_X86
+        case Base64Kernel::AVX2: return __builtin_cpu_supports("avx2");
+        case Base64Kernel::SSE4: return __builtin_cpu_supports("sse4.1");
+#endif
+        case Base64Kernel::Scalar: return true;
+        default: return false;
+    }
+}
+
+
+inline Base64Kernel PemCodec::best() {
+    for (Base64Kernel kernel : {Base64Kernel::AVX2, Base64Kernel::SSE4}) {
+        if (supported(kernel)) {
+            return kernel;
+        }
+    }
+    return Base64Kernel::Scalar;
+}
+
+
+inline Base64Kernel& PemCodec::__selected() {
+    static Base64Kernel kernel = best();
+    return kernel;
+}
+
+
+inline bool PemCodec::setKernel(Base64Kernel kernel) {
+    if (!supported(kernel)) {
+        return false;
+    }
+    __selected() = kernel;
+    return true;
+}
+
+
+inline const char* PemCodec::kernelName(Base64Kernel kernel) {
+    switch (kernel) {
+        case Base64Kernel::AVX2: return "avx2";
+        case Base64Kernel::SSE4: return "sse4";
+        default: return "scalar";
+    }
+}
+
+
+inline PemCodec::EncodeFunction PemCodec::__encoder(Base64Kernel kernel) {
+#ifdef PEM_CODEC_X86
+    if (kernel == Base64Kernel::AVX2) return __encodeAVX2;
+    if (kernel == Base64Kernel::SSE4) return __encodeSSE4;
+#endif
+    return __encodeScalar;
+}
+
+
+inline PemCodec::DecodeFunction PemCodec::__decoder(Base64Kernel kernel) {
+#ifdef PEM_CODEC_X86
+    if (kernel == Base64Kernel::AVX2) return __decodeAVX2;
+    if (kernel == Base64Kernel::SSE4) return __decodeSSE4;
+#endif
+    return __decodeScalar;
+}
+
+
+inline string PemCodec::encode(const unsigned char* der, size_t length, const char* label) {
+    string begin = string("-----BEGIN ") + label + "-----\n";
+    string end = string("-----END ") + label + "-----\n";
+    size_t chars = (length + 2) / 3 * 4;
+    size_t lines = (chars + lineChars - 1) / lineChars;
+
+    string pem(begin.size() + chars + lines + end.size(), '\0');
+    memcpy(pem.data(), begin.data(), begin.size());
+    char* body = pem.data() + begin.size();
+    encodeBase64(der, length, body);
+
+    // Base64 закодирован одним куском; строки раздвигаются с конца, чтобы вставить переводы строк
+    for (size_t line = lines; line-- > 0;) {
+        size_t from = line * lineChars;
+        size_t size = min(lineChars, chars - from);
+        memmove(body + from + line, body + from, size);
+        body[from + line + size] = '\n';
+    }
+    memcpy(body + chars + lines, end.data(), end.size());
+    return pem;
+}
+
+
+inline bool PemCodec::__findBlock(string_view text, size_t& offset, string_view& label, string_view& body) {
+    static constexpr string_view beginMarker = "-----BEGIN ";
+    static constexpr string_view dashes = "-----";
+
+    size_t begin = text.find(beginMarker, offset);
+    if (begin == string_view::npos) {
+        offset = text.size();
+        return false;
+    }
+    size_t labelStart = begin + beginMarker.size();
+    size_t labelEnd = text.find(dashes, labelStart);
+    if (labelEnd == string_view::npos) {
+        return false;
+    }
+    label = text.substr(labelStart, labelEnd - labelStart);
+
+    string endLine = string("-----END ") + string(label) + "-----";
+    size_t bodyStart = labelEnd + dashes.size();
+    size_t end = text.find(endLine, bodyStart);
+    if (end == string_view::npos) {
+        return false;
+    }
+    body = text.substr(bodyStart, end - bodyStart);
+    offset = end + endLine.size();
+    return true;
+}
+
+
+inline bool PemCodec::decodeNext(string_view text, size_t& offset, Block& block) {
+    size_t start = offset;
+    string_view label, body;
+    if (!__findBlock(text, offset, label, body)) {
+        return false;
+    }
+
+    // Строки склеиваются без переводов строк. Заголовки (Proc-Type, DEK-Info) стоят в начале тела
+    // и быстрым путем не разбираются
+    size_t firstLine = body.find_first_not_of("\r\n");
+    if (firstLine != string_view::npos && body.substr(firstLine, body.find('\n', firstLine) - firstLine).find(':') != string_view::npos) {
+        offset = start;
+        return false;
+    }
+    string base64(body.size(), '\0');
+    size_t joined = 0;
+    const char* cursor = body.data();
+    const char* bodyEnd = body.data() + body.size();
+    while (cursor < bodyEnd) {
+        const char* newline = static_cast<const char*>(memchr(cursor, '\n', bodyEnd - cursor));
+        const char* lineEnd = newline ? newline : bodyEnd;
+        const char* trimmed = lineEnd;
+        while (trimmed > cursor && (trimmed[-1] == '\r' || trimmed[-1] == ' ' || trimmed[-1] == '\t')) {
+            --trimmed;
+        }
+        memcpy(base64.data() + joined, cursor, trimmed - cursor);
+        joined += trimmed - cursor;
+        cursor = lineEnd + 1;
+    }
+    base64.resize(joined);
+
+    block.label.assign(label);
+    block.der.resize(base64.size() / 4 * 3);
+    size_t written = 0;
+    if (!decodeBase64(base64.data(), base64.size(), reinterpret_cast<unsigned char*>(block.der.data()), written)) {
+        offset = start;
+        return false;
+    }
+    block.der.resize(written);
+    return true;
+}
+
+
+inline bool PemCodec::decode(string_view text, const char* label, string& der) {
+    size_t offset = 0;
+    Block block;
+    while (offset < text.size()) {
+        size_t start = offset;
+        if (!decodeNext(text, offset, block)) {
+            return false;
+        }
+        if (block.label == label) {
+            der = std::move(block.der);
+            return true;
+        }
+        if (offset == start) {
+            return false;
+        }
+    }
+    return false;
+}
+
+
+inline bool PemCodec::selfCheck(string* report, size_t maxLength, unsigned seed) {
+    auto fail = [report](const string& message) {
+        if (report) {
+            *report = message;
+        }
+        return false;
+    };
+
+    mt19937 random(seed);
+    string data(maxLength, '\0');
+    for (auto& byte : data) {
+        byte = static_cast<char>(random());
+    }
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data.data());
+
+    Base64Kernel previous = kernel();
+    for (Base64Kernel candidate : {Base64Kernel::Scalar, Base64Kernel::SSE4, Base64Kernel::AVX2}) {
+        if (!setKernel(candidate)) {
+            continue;
+        }
+        string name = kernelName(candidate);
+        for (size_t length = 0; length <= maxLength; ++length) {
+            // Base64 против EVP_EncodeBlock и обратно
+            string expected((length + 2) / 3 * 4 + 1, '\0');
+            expected.resize(EVP_EncodeBlock(reinterpret_cast<unsigned char*>(expected.data()), bytes, static_cast<int>(length)));
+            string encoded((length + 2) / 3 * 4, '\0');
+            encoded.resize(encodeBase64(bytes, length, encoded.data()));
+            if (encoded != expected) {
+                setKernel(previous);
+                return fail(name + ": base64 длины " + to_string(length) + " не совпадает с EVP_EncodeBlock");
+            }
+            string decoded(length + 3, '\0');
+            size_t written = 0;
+            if (!decodeBase64(encoded.data(), encoded.size(), reinterpret_cast<unsigned char*>(decoded.data()), written) ||
+                written != length || memcmp(decoded.data(), bytes, length) != 0) {
+                setKernel(previous);
+                return fail(name + ": обратное преобразование base64 длины " + to_string(length) + " не совпадает");
+            }
+
+            // Недопустимый символ в любой позиции должен отвергаться, как его отвергает EVP_DecodeBlock
+            if (!encoded.empty()) {
+                string corrupted = encoded;
+                size_t position = random() % corrupted.size();
+                static const char invalid[] = "-_.*!\x80\xff\x01";
+                corrupted[position] = invalid[random() % (sizeof(invalid) - 1)];
+                if (decodeBase64(corrupted.data(), corrupted.size(), reinterpret_cast<unsigned char*>(decoded.data()), written)) {
+                    setKernel(previous);
+                    return fail(name + ": принят недопустимый символ в позиции " + to_string(position) + " длины " + to_string(length));
+                }
+            }
+
+            // PEM против PEM_write_bio и разбор обратно; пустой PEM OpenSSL не пишет
+            if (length == 0) {
+                continue;
+            }
+            BioPtr bio(BIO_new(BIO_s_mem()));
+            if (!bio || PEM_write_bio(bio.get(), "CERTIFICATE", "", bytes, static_cast<long>(length)) <= 0) {
+                setKernel(previous);
+                return fail("PEM_write_bio завершился ошибкой");
+            }
+            char* pemData = nullptr;
+            long pemLength = BIO_get_mem_data(bio.get(), &pemData);
+            string pem = encode(bytes, length, "CERTIFICATE");
+            if (pem != string_view(pemData, pemLength)) {
+                setKernel(previous);
+                return fail(name + ": PEM длины " + to_string(length) + " не совпадает с PEM_write_bio");
+            }
+            char* pemName = nullptr;
+            char* header = nullptr;
+            unsigned char* expectedDer = nullptr;
+            long expectedLength = 0;
+            BioPtr pemBio(BIO_new_mem_buf(pem.data(), static_cast<int>(pem.size())));
+            bool readable = pemBio && PEM_read_bio(pemBio.get(), &pemName, &header, &expectedDer, &expectedLength) == 1;
+            string expectedText = readable ? string(reinterpret_cast<char*>(expectedDer), expectedLength) : string();
+            OPENSSL_free(pemName);
+            OPENSSL_free(header);
+            OPENSSL_free(expectedDer);
+            string der;
+            if (!readable || !decode(pem, "CERTIFICATE", der) || der != expectedText) {
+                setKernel(previous);
+                return fail(name + ": разбор PEM длины " + to_string(length) + " не совпадает с PEM_read_bio");
+            }
+        }
+    }
+    setKernel(previous);
+    return true;
+}
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <filesystem>
+#include <future>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../db/database.h"
+#include "./CRL.hpp"
+#include "./Certificates.hpp"
+#include "./Handles.hpp"
+#include "./ObjectLoader.hpp"
+#include "./OutputFormat.hpp"
+#include "./ThreadPool.hpp"
+
+using namespace std;
+
+// Массовое продление истекающих сертификатов. Кандидаты выбираются из базы по частичному индексу
+// истекающих, новые сертификаты подписываются параллельно из сохраненного сертификата (субъект и ключ
+// владельца не меняются, новый CSR не нужен). Файлы и записи в базе сохраняются одной транзакцией,
+// старый сертификат связывается с новым (renewedBy/renewedFrom). Предшественников можно сразу отозвать
+// с причиной Superseded — одной переподписью CRL на весь пакет.
+
+struct RenewalOptions {
+    int withinDays = 30;            // продлевать сертификаты, истекающие в ближайшие N дней
+    int validityDays = 365;         // срок нового сертификата
+    int limit = 0;                  // не больше стольких сертификатов за запуск; 0 - все
+    size_t threads = thread::hardware_concurrency();
+    bool revokePredecessors = false;
+    bool dryRun = false;            // только показать кандидатов
+};
+
+struct RenewalResult {
+    string oldSerial;
+    string oldCertName;
+    string serial;                  // пусто, если продление не удалось
+    string certName;
+    string certDataTo;
+    string error;
+};
+
+struct RenewalReport {
+    size_t selected = 0;
+    size_t renewed = 0;
+    size_t failed = 0;
+    size_t revoked = 0;             // новых записей в CRL
+    vector<RenewalResult> results;
+};
+
+class RenewalEngine {
+private:
+    Database& db;
+    X509* caCert;
+    EVP_PKEY* caKey;
+    string certsDir;
+    string crlPath;
+
+    struct Signed {
+        X509Ptr cert;
+        IssuedCertInfo info;
+        string error;
+    };
+
+    Signed __renewOne(const IssuerCertRecord& record, int validityDays) const;
+    static string __renewedName(const string& certName, const string& serial);
+
+public:
+    RenewalEngine(Database& db, X509* caCert, EVP_PKEY* caKey, const string& certsDir = ISSUER_CERTS_PATH,
+                  const string& crlPath = (filesystem::path(CRL_PATH) / DEFAULT_CRL_NAME).string());
+
+    RenewalReport run(const RenewalOptions& options);
+};
+
+
+inline RenewalEngine::RenewalEngine(Database& db, X509* caCert, EVP_PKEY* caKey, const string& certsDir, const string& crlPath)
+    : db(db), caCert(caCert), caKey(caKey), certsDir(certsDir), crlPath(crlPath) {
+    if (!caCert || !caKey) {
+        throw runtime_error("RenewalEngine: не задан сертификат или ключ УЦ.");
+    }
+}
+
+// Вызывается из потоков пула: только чтение файла и подпись, база не используется
+inline RenewalEngine::Signed RenewalEngine::__renewOne(const IssuerCertRecord& record, int validityDays) const {
+    Signed result;
+    try {
+        filesystem::path oldPath = filesystem::path(certsDir) / record.certName;
+        X509Ptr oldCert = ObjectLoader::loadX509(oldPath, false);
+        if (!oldCert) {
+            throw runtime_error("не удалось прочитать " + oldPath.string());
+        }
+        if (serialToDecimal(X509_get_serialNumber(oldCert.get())) != record.serial) {
+            throw runtime_error("серийный номер в файле " + oldPath.string() + " не совпадает с базой");
+        }
+
+        result.cert = Certificates::buildRenewedCert(oldCert.get(), caCert, caKey, validityDays);
+        result.info = Certificates::describeCertificate(result.cert.get());
+    } catch (const std::exception& ex) {
+        result.cert.reset();
+        result.error = ex.what();
+    }
+    return result;
+}
+
+// user1.cert.pem -> user1.<серийный номер>.cert.pem
+inline string RenewalEngine::__renewedName(const string& certName, const string& serial) {
+    const string extension = ".cert.pem";
+    string stem = certName;
+    if (stem.size() > extension.size() && stem.compare(stem.size() - extension.size(), extension.size(), extension) == 0) {
+        stem.resize(stem.size() - extension.size());
+    } else if (stem.size() > 4 && stem.compare(stem.size() - 4, 4, ".pem") == 0) {
+        stem.resize(stem.size() - 4);
+    }
+    return stem + "." + serial + extension;
+}
+
+inline RenewalReport RenewalEngine::run(const RenewalOptions& options) {
+    if (options.withinDays < 0) {
+        throw runtime_error("RenewalEngine: число дней не может быть отрицательным.");
+    }
+
+    RenewalReport report;
+    vector<IssuerCertRecord> candidates = db.selectExpiringCerts(options.withinDays, options.limit);
+    report.selected = candidates.size();
+    for (const auto& record : candidates) {
+        report.results.push_back({record.serial, record.certName, "", "", record.certDataTo, ""});
+    }
+    if (options.dryRun || candidates.empty()) {
+        return report;
+    }
+
+    // Подпись — основная стоимость продления, она идет параллельно
+    vector<Signed> signedCerts(candidates.size());
+    {
+        ThreadPool pool(options.threads);
+        vector<future<Signed>> pending;
+        pending.reserve(candidates.size());
+        for (const auto& record : candidates) {
+            pending.push_back(pool.submit([this, &record, &options] { return __renewOne(record, options.validityDays); }));
+        }
+        for (size_t i = 0; i < pending.size(); ++i) {
+            signedCerts[i] = pending[i].get();
+        }
+    }
+
+    // Файлы пишутся до транзакции; файлы продлений, не попавших в базу, удаляются
+    vector<RenewedCertRecord> records;
+    vector<size_t> recordIndex;
+    vector<string> written;
+    OutputFormat certFormat = OutputFormats::current().certs;
+    for (size_t i = 0; i < candidates.size(); ++i) {
+        RenewalResult& result = report.results[i];
+        if (!signedCerts[i].cert) {
+            result.error = signedCerts[i].error;
+            continue;
+        }
+
+        const IssuedCertInfo& info = signedCerts[i].info;
+        string certName = __renewedName(candidates[i].certName, info.serial);
+        string certPath = (filesystem::path(certsDir) / certName).string();
+        try {
+            if (Artifacts::exists(certPath)) {
+                throw runtime_error("файл уже существует");
+            }
+            vector<pair<string, string>> encoded = Artifacts::encodeX509(signedCerts[i].cert.get(), certPath, certFormat);
+            Artifacts::write(encoded, certPath, certFormat);
+            for (const auto& file : encoded) {
+                written.push_back(file.first);
+            }
+        } catch (const std::runtime_error&) {
+            result.error = "не удалось сохранить " + certPath;
+            continue;
+        }
+
+        records.push_back({candidates[i].id, candidates[i].serial, certName, info.serial, info.notBefore, info.notAfter, info.info, info.keyHash, info.subject});
+        recordIndex.push_back(i);
+    }
+
+    vector<bool> added;
+    try {
+        added = db.addRenewedCerts(records);
+    } catch (const std::exception&) {
+        for (const auto& path : written) {
+            filesystem::remove(path);
+        }
+        throw;
+    }
+
+    vector<string> supersededSerials;
+    for (size_t j = 0; j < records.size(); ++j) {
+        RenewalResult& result = report.results[recordIndex[j]];
+        if (!added[j]) {
+            string certPath = (filesystem::path(certsDir) / records[j].certName).string();
+            filesystem::remove(certPath);
+            filesystem::remove(ObjectLoader::derPathFor(certPath));
+            result.error = "сертификат отозван или продлен другим процессом";
+            continue;
+        }
+        result.serial = records[j].serial;
+        result.certName = records[j].certName;
+        result.certDataTo = records[j].certDataTo;
+        supersededSerials.push_back(records[j].oldSerial);
+    }
+
+    report.renewed = supersededSerials.size();
+    report.failed = report.selected - report.renewed;
+
+    if (options.revokePredecessors && !supersededSerials.empty()) {
+        report.revoked = CRL::revokeSerials(crlPath, supersededSerials, caKey, db, Superseded);
+    }
+    return report;
+}
@@ -0,0 +1,466 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <openssl/asn1.h>
+#include <openssl/bn.h>
+
+#include "../db/database.h"
+#include "./Handles.hpp"
+
+using namespace std;
+
+// Статус сертификата по серийному номеру
+struct RevocationStatus {
+    bool issued = true;         // false - номер не выдавался; определяет только снимок, где есть все выданные номера
+    bool revoked = false;
+    int reasonCode = 0;
+    time_t revokedAt = 0;
+};
+
+// Индекс отозванных серийных номеров в памяти для частых проверок статуса.
+// Серийный номер хранится как 20 байт big-endian (максимальная длина по RFC 5280).
+// Основной массив отсортирован и защищен фильтром Блума, новые отзывы попадают в небольшой
+// отсортированный массив-дельту и сливаются с основным, когда дельта разрастается. Снятие приостановки
+// и смена причины (редкие операции) собирают основной массив заново.
+// Чтение не берет блокировок: снимок публикуется атомарным указателем, а старый снимок
+// освобождается писателем только после того, как его покинули все читатели (две эпохи со счетчиками).
+class RevocationIndex {
+public:
+    using SerialKey = array<uint8_t, 20>;
+
+    // Параметры фильтра Блума; хэш-функция входит и в формат файлового снимка (RevocationSnapshot)
+    static constexpr int BLOOM_HASHES = 7;
+    static constexpr size_t BLOOM_BITS_PER_ENTRY = 10;  // ~1% ложных срабатываний
+
+    static void hashSerial(const SerialKey& serial, uint64_t& h1, uint64_t& h2);
+    static size_t bloomBitsFor(size_t entryCount);
+
+private:
+    struct Entry {
+        SerialKey serial;
+        int32_t reasonCode;
+        int64_t revokedAt;
+
+        bool operator<(const Entry& other) const { return serial < other.serial; }
+    };
+
+    struct Base {
+        vector<Entry> entries;
+        vector<uint64_t> bloom;
+        uint64_t bloomMask = 0;     // число бит фильтра минус один (степень двойки)
+    };
+
+    struct Snapshot {
+        shared_ptr<const Base> base;
+        vector<Entry> delta;
+    };
+
+    static constexpr size_t DELTA_MIN_MERGE = 1024;
+
+    atomic<const Snapshot*> current;
+    mutable atomic<uint64_t> epoch{0};
+    mutable atomic<size_t> readers[2] = {{0}, {0}};
+
+    mutex writerMutex;
+    time_t watermark = 0;   // время последнего отзыва, прочитанного из базы
+    long long eventSeq = 0; // последнее прочитанное событие журнала: снятие приостановки и смена причины
+
+    static shared_ptr<const Base> __buildBase(vector<Entry> entries);
+    static const Entry* __find(const vector<Entry>& entries, const SerialKey& serial);
+
+    const Snapshot* __enterRead(size_t& slot) const;
+    void __leaveRead(size_t slot) const { readers[slot].fetch_sub(1); }
+    void __publish(unique_ptr<Snapshot> next);
+    size_t __addEntries(vector<Entry> entries);
+    size_t __updateEntries(vector<Entry> updated, vector<SerialKey> removed);
+    static vector<SerialKey> __toKeys(const vector<string>& serials);
+
+public:
+    RevocationIndex() : current(new Snapshot{__buildBase({}), {}}) {}
+    ~RevocationIndex() { delete current.load(); }
+
+    RevocationIndex(const RevocationIndex&) = delete;
+    RevocationIndex& operator=(const RevocationIndex&) = delete;
+
+    static bool toSerialKey(const string& decimalSerial, SerialKey& key);
+    static bool toSerialKey(const ASN1_INTEGER* serial, SerialKey& key);
+
+    void rebuild(Database& db);
+    size_t refresh(Database& db);
+    size_t add(const vector<string>& serials, int reasonCode, time_t revokedAt);
+    size_t remove(const vector<string>& serials);
+
+    RevocationStatus lookup(const SerialKey& serial) const;
+    RevocationStatus lookup(const string& decimalSerial) const;
+    RevocationStatus lookup(const ASN1_INTEGER* serial) const;
+    size_t size() const;
+};
+
+
+inline bool RevocationIndex::toSerialKey(const string& decimalSerial, SerialKey& key) {
+    BIGNUM* raw = nullptr;
+    if (decimalSerial.empty() || BN_dec2bn(&raw, decimalSerial.c_str()) != static_cast<int>(decimalSerial.size())) {
+        BN_free(raw);
+        return false;
+    }
+    BignumPtr bn(raw);
+    return !BN_is_negative(bn.get()) && BN_bn2binpad(bn.get(), key.data(), key.size()) == static_cast<int>(key.size());
+}
+
+
+inline bool RevocationIndex::toSerialKey(const ASN1_INTEGER* serial, SerialKey& key) {
+    BignumPtr bn(ASN1_INTEGER_to_BN(serial, nullptr));
+    return bn && !BN_is_negative(bn.get()) && BN_bn2binpad(bn.get(), key.data(), key.size()) == static_cast<int>(key.size());
+}
+
+
+// Две независимые 64-битные хэш-функции для двойного хэширования фильтра Блума (перемешивание splitmix64)
+inline void RevocationIndex::hashSerial(const SerialKey& serial, uint64_t& h1, uint64_t& h2) {
+    auto mix = [](uint64_t x) {
+        x += 0x9E3779B97F4A7C15ULL;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+        return x ^ (x >> 31);
+    };
+
+    uint64_t words[3] = {0, 0, 0};
+    memcpy(words, serial.data(), serial.size());
+
+    h1 = mix(words[0] ^ mix(words[1] ^ mix(words[2])));
+    h2 = mix(h1 ^ words[2]) | 1;
+}
+
+
+// Размер фильтра - степень двойки, чтобы номер бита вычислялся маской
+inline size_t RevocationIndex::bloomBitsFor(size_t entryCount) {
+    size_t bits = 64;
+    while (bits < entryCount * BLOOM_BITS_PER_ENTRY) {
+        bits <<= 1;
+    }
+    return bits;
+}
+
+
+inline shared_ptr<const RevocationIndex::Base> RevocationIndex::__buildBase(vector<Entry> entries) {
+    auto base = make_shared<Base>();
+    base->entries = std::move(entries);
+
+    size_t bits = bloomBitsFor(base->entries.size());
+    base->bloom.assign(bits / 64, 0);
+    base->bloomMask = bits - 1;
+
+    for (const auto& entry : base->entries) {
+        uint64_t h1, h2;
+        hashSerial(entry.serial, h1, h2);
+        for (int i = 0; i < BLOOM_HASHES; ++i) {
+            uint64_t bit = (h1 + i * h2) & base->bloomMask;
+            base->bloom[bit >> 6] |= 1ULL << (bit & 63);
+        }
+    }
+
+    return base;
+}
+
+
+inline const RevocationIndex::Entry* RevocationIndex::__find(const vector<Entry>& entries, const SerialKey& serial) {
+    auto it = lower_bound(entries.begin(), entries.end(), serial,
+                          [](const Entry& entry, const SerialKey& key) { return entry.serial < key; });
+    return it != entries.end() && it->serial == serial ? &*it : nullptr;
+}
+
+
+// Читатель отмечается в счетчике текущей эпохи; если эпоха сменилась до отметки, попытка повторяется
+inline const RevocationIndex::Snapshot* RevocationIndex::__enterRead(size_t& slot) const {
+    while (true) {
+        uint64_t observed = epoch.load();
+        slot = observed & 1;
+        readers[slot].fetch_add(1);
+        if (epoch.load() == observed) {
+            return current.load();
+        }
+        readers[slot].fetch_sub(1);
+    }
+}
+
+
+// Вызывается под writerMutex: новый снимок публикуется, эпоха переключается,
+// и старый снимок удаляется после выхода читателей предыдущей эпохи
+inline void RevocationIndex::__publish(unique_ptr<Snapshot> next) {
+    const Snapshot* previous = current.exchange(next.release());
+    uint64_t previousEpoch = epoch.fetch_add(1);
+    while (readers[previousEpoch & 1].load() != 0) {
+        this_thread::yield();
+    }
+    delete previous;
+}
+
+
+inline size_t RevocationIndex::__addEntries(vector<Entry> entries) {
+    sort(entries.begin(), entries.end());
+
+    const Snapshot* snapshot = current.load();  // писатели сериализованы, снимок не изменится
+    vector<Entry> fresh;
+    for (size_t i = 0; i < entries.size(); ++i) {
+        if ((i > 0 && entries[i].serial == entries[i - 1].serial) ||
+            __find(snapshot->delta, entries[i].serial) || __find(snapshot->base->entries, entries[i].serial)) {
+            continue;
+        }
+        fresh.push_back(entries[i]);
+    }
+
+    if (fresh.empty()) {
+        return 0;
+    }
+
+    auto next = make_unique<Snapshot>();
+    next->delta.resize(snapshot->delta.size() + fresh.size());
+    merge(snapshot->delta.begin(), snapshot->delta.end(), fresh.begin(), fresh.end(), next->delta.begin());
+
+    // Дельта сливается с основным массивом, когда ее поиск становится заметным
+    if (next->delta.size() > max(DELTA_MIN_MERGE, snapshot->base->entries.size() / 16)) {
+        vector<Entry> merged(snapshot->base->entries.size() + next->delta.size());
+        merge(snapshot->base->entries.begin(), snapshot->base->entries.end(), next->delta.begin(), next->delta.end(), merged.begin());
+        next->base = __buildBase(std::move(merged));
+        next->delta.clear();
+    } else {
+        next->base = snapshot->base;
+    }
+
+    __publish(std::move(next));
+    return fresh.size();
+}
+
+
+// Меняет причину у присутствующих в индексе номеров из updated и удаляет номера removed; вызывается под writerMutex.
+// Если менять нечего, снимок не пересобирается
+inline size_t RevocationIndex::__updateEntries(vector<Entry> updated, vector<SerialKey> removed) {
+    const Snapshot* snapshot = current.load();
+    auto findCurrent = [snapshot](const SerialKey& serial) {
+        const Entry* found = __find(snapshot->delta, serial);
+        return found ? found : __find(snapshot->base->entries, serial);
+    };
+
+    sort(updated.begin(), updated.end());
+    sort(removed.begin(), removed.end());
+    bool changed = false;
+    for (size_t i = 0; i < updated.size() && !changed; ++i) {
+        const Entry* found = findCurrent(updated[i].serial);
+        changed = found && found->reasonCode != updated[i].reasonCode;
+    }
+    for (size_t i = 0; i < removed.size() && !changed; ++i) {
+        changed = findCurrent(removed[i]) != nullptr;
+    }
+    if (!changed) {
+        return 0;
+    }
+
+    vector<Entry> entries(snapshot->base->entries.size() + snapshot->delta.size());
+    merge(snapshot->base->entries.begin(), snapshot->base->entries.end(), snapshot->delta.begin(), snapshot->delta.end(), entries.begin());
+
+    size_t count = 0;
+    vector<Entry> kept;
+    kept.reserve(entries.size());
+    for (auto& entry : entries) {
+        if (binary_search(removed.begin(), removed.end(), entry.serial)) {
+            ++count;
+            continue;
+        }
+        const Entry* update = __find(updated, entry.serial);
+        if (update && update->reasonCode != entry.reasonCode) {
+            entry.reasonCode = update->reasonCode;
+            ++count;
+        }
+        kept.push_back(entry);
+    }
+
+    __publish(make_unique<Snapshot>(Snapshot{__buildBase(std::move(kept)), {}}));
+    return count;
+}
+
+
+inline vector<RevocationIndex::SerialKey> RevocationIndex::__toKeys(const vector<string>& serials) {
+    vector<SerialKey> keys;
+    keys.reserve(serials.size());
+    for (const auto& serial : serials) {
+        SerialKey key;
+        if (toSerialKey(serial, key)) {
+            keys.push_back(key);
+        }
+    }
+    return keys;
+}
+
+
+// Полная загрузка отозванных сертификатов из issuing_certs
+inline void RevocationIndex::rebuild(Database& db) {
+    // Журнал отмечается до чтения: событие, записанное между ними, при refresh просто применится повторно
+    long long lastSeq = db.lastEventSeq();
+    vector<RevokedCertRecord> records = db.selectRevokedCerts();
+
+    vector<Entry> entries;
+    entries.reserve(records.size());
+    time_t latest = 0;
+    for (const auto& record : records) {
+        Entry entry{};
+        if (toSerialKey(record.serial, entry.serial)) {
+            entry.reasonCode = record.reasonCode;
+            entry.revokedAt = record.revokedAt;
+            entries.push_back(entry);
+            latest = max(latest, record.revokedAt);
+        }
+    }
+
+    sort(entries.begin(), entries.end());
+    entries.erase(unique(entries.begin(), entries.end(),
+                         [](const Entry& a, const Entry& b) { return a.serial == b.serial; }), entries.end());
+
+    lock_guard<mutex> lock(writerMutex);
+    __publish(make_unique<Snapshot>(Snapshot{__buildBase(std::move(entries)), {}}));
+    watermark = latest;
+    eventSeq = lastSeq;
+}
+
+
+// Догружает отзывы, сделанные после последней загрузки (в том числе другими процессами), а по журналу events -
+// снятия приостановки и смену причины: дата отзыва у них не меняется, и по watermark их не найти
+inline size_t RevocationIndex::refresh(Database& db) {
+    lock_guard<mutex> lock(writerMutex);
+
+    // Для каждого номера важно последнее событие: cert_reactivated удаляет номер, cert_revoked задает причину
+    map<string, ChangeEvent> latestEvents;
+    for (vector<ChangeEvent> events; !(events = db.readEvents(eventSeq)).empty();) {
+        for (auto& event : events) {
+            eventSeq = event.seq;
+            if (event.type == "cert_reactivated" || (event.type == "cert_revoked" && event.reasonCode >= 0)) {
+                latestEvents[event.serial] = std::move(event);
+            }
+        }
+    }
+
+    // отзывы в ту же секунду, что и последний прочитанный, перечитываются; повторы отбрасываются
+    vector<RevokedCertRecord> records = db.selectRevokedCerts(max<time_t>(watermark, 1));
+
+    vector<Entry> entries;
+    for (const auto& record : records) {
+        Entry entry{};
+        if (toSerialKey(record.serial, entry.serial)) {
+            entry.reasonCode = record.reasonCode;
+            entry.revokedAt = record.revokedAt;
+            entries.push_back(entry);
+            watermark = max(watermark, record.revokedAt);
+        }
+    }
+
+    size_t changed = __addEntries(std::move(entries));
+
+    vector<Entry> updated;
+    vector<SerialKey> removed;
+    for (const auto& [serial, event] : latestEvents) {
+        Entry entry{};
+        if (!toSerialKey(serial, entry.serial)) {
+            continue;
+        }
+        if (event.type == "cert_reactivated") {
+            removed.push_back(entry.serial);
+        } else {
+            entry.reasonCode = event.reasonCode;
+            updated.push_back(entry);
+        }
+    }
+    return changed + __updateEntries(std::move(updated), std::move(removed));
+}
+
+
+// Учитывает отзыв, выполненный в этом процессе, без обращения к базе
+inline size_t RevocationIndex::add(const vector<string>& serials, int reasonCode, time_t revokedAt) {
+    vector<Entry> entries;
+    entries.reserve(serials.size());
+    for (const auto& serial : serials) {
+        Entry entry{};
+        if (toSerialKey(serial, entry.serial)) {
+            entry.reasonCode = reasonCode;
+            entry.revokedAt = revokedAt;
+            entries.push_back(entry);
+        }
+    }
+
+    lock_guard<mutex> lock(writerMutex);
+    size_t changed = __addEntries(entries);
+    // Окончательный отзыв приостановленного номера меняет причину уже присутствующей записи
+    return changed + __updateEntries(std::move(entries), {});
+}
+
+
+// Учитывает снятие приостановки (CRL::releaseSerials), выполненное в этом процессе
+inline size_t RevocationIndex::remove(const vector<string>& serials) {
+    vector<SerialKey> keys = __toKeys(serials);
+    lock_guard<mutex> lock(writerMutex);
+    return __updateEntries({}, std::move(keys));
+}
+
+
+inline RevocationStatus RevocationIndex::lookup(const SerialKey& serial) const {
+    RevocationStatus status;
+    size_t slot;
+    const Snapshot* snapshot = __enterRead(slot);
+
+    const Entry* found = snapshot->delta.empty() ? nullptr : __find(snapshot->delta, serial);
+
+    if (!found) {
+        // Фильтр Блума отсекает большинство неотозванных номеров без бинарного поиска
+        const Base& base = *snapshot->base;
+        uint64_t h1, h2;
+        hashSerial(serial, h1, h2);
+
+        bool maybePresent = true;
+        for (int i = 0; i < BLOOM_HASHES && maybePresent; ++i) {
+            uint64_t bit = (h1 + i * h2) & base.bloomMask;
+            maybePresent = (base.bloom[bit >> 6] >> (bit & 63)) & 1;
+        }
+
+        if (maybePresent) {
+            found = __find(base.entries, serial);
+        }
+    }
+
+    if (found) {
+        status.revoked = true;
+        status.reasonCode = found->reasonCode;
+        status.revokedAt = static_cast<time_t>(found->revokedAt);
+    }
+
+    __leaveRead(slot);
+    return status;
+}
+
+
+inline RevocationStatus RevocationIndex::lookup(const string& decimalSerial) const {
+    SerialKey key;
+    return toSerialKey(decimalSerial, key) ? lookup(key) : RevocationStatus{};
+}
+
+
+inline RevocationStatus RevocationIndex::lookup(const ASN1_INTEGER* serial) const {
+    SerialKey key;
+    return toSerialKey(serial, key) ? lookup(key) : RevocationStatus{};
+}
+
+
+inline size_t RevocationIndex::size() const {
+    size_t slot;
+    const Snapshot* snapshot = __enterRead(slot);
+    size_t total = snapshot->base->entries.size() + snapshot->delta.size();
+    __leaveRead(slot);
+    return total;
+}
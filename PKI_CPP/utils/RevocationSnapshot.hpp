@@ -0,0 +1,343 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../db/database.h"
+#include "../paths.hpp"
+#include "./IssuerShards.hpp"
+#include "./RevocationIndex.hpp"
+
+using namespace std;
+
+// Файловый снимок статусов выданных сертификатов для чтения из любых локальных процессов через mmap.
+//
+// Формат (little-endian): заголовок 64 байта, фильтр Блума (bloomWords слов по 8 байт),
+// затем entryCount отсортированных записей по 32 байта, по одной на каждый выданный серийный номер:
+//   серийный номер 20 байт big-endian | код причины int32 (-1 - не отозван) | время отзыва int64 (unix time).
+// Номер, которого нет в снимке, не выдавался (статус unknown). Фильтр использует RevocationIndex::hashSerial.
+// publish(Database&) добавляет к базе основного УЦ базы шардов из SHARDS_CONFIG; серийные номера
+// случайные (16 байт), поэтому общий для всех издателей индекс по номеру не дает коллизий на практике.
+//
+// Новый снимок пишется во временный файл и атомарно переименовывается поверх старого,
+// после чего в старом файле выставляется флаг superseded: читатели видят его через общее
+// отображение без системных вызовов и переоткрывают файл только при смене версии.
+struct RevocationSnapshotHeader {
+    char magic[8];              // "PKIRVSN1"
+    uint32_t formatVersion;
+    uint32_t superseded;        // 1 - файл заменен новым снимком
+    uint64_t generation;        // растет на единицу при каждой публикации
+    int64_t createdAt;
+    uint64_t entryCount;
+    uint64_t bloomWords;
+    uint32_t bloomHashes;
+    uint32_t entrySize;
+    uint64_t entriesOffset;
+};
+
+static_assert(sizeof(RevocationSnapshotHeader) == 64, "Заголовок снимка должен занимать 64 байта");
+
+#define REVOCATION_SNAPSHOT_MAGIC "PKIRVSN1"
+#define REVOCATION_SNAPSHOT_FORMAT 2
+#define REVOCATION_SNAPSHOT_NOT_REVOKED -1
+#define REVOCATION_SNAPSHOT_ENTRY_SIZE 32
+
+
+class RevocationSnapshot {
+private:
+    string path;
+    const uint8_t* mapping = nullptr;
+    size_t mappingSize = 0;
+
+    const RevocationSnapshotHeader* __header() const { return reinterpret_cast<const RevocationSnapshotHeader*>(mapping); }
+    void __map();
+    void __unmap();
+
+public:
+    explicit RevocationSnapshot(const string& path = REVOCATION_SNAPSHOT_PATH) : path(path) { __map(); }
+    ~RevocationSnapshot() { __unmap(); }
+
+    RevocationSnapshot(const RevocationSnapshot&) = delete;
+    RevocationSnapshot& operator=(const RevocationSnapshot&) = delete;
+
+    static uint64_t publish(Database& db, const string& path = REVOCATION_SNAPSHOT_PATH);
+    static uint64_t publish(const vector<RevokedCertRecord>& revoked, const vector<string>& issued,
+                            const string& path = REVOCATION_SNAPSHOT_PATH);
+
+    // Поиск не выполняет системных вызовов, пока снимок не заменен.
+    // Экземпляр не потокобезопасен: каждому потоку нужен свой объект.
+    RevocationStatus lookup(const RevocationIndex::SerialKey& serial);
+    RevocationStatus lookup(const string& decimalSerial);
+
+    bool reloadIfSuperseded();
+    uint64_t generation() const { return __header()->generation; }
+    size_t size() const { return __header()->entryCount; }
+};
+
+
+inline void RevocationSnapshot::__map() {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw runtime_error("RevocationSnapshot: не удалось открыть снимок " + path + ".");
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(RevocationSnapshotHeader))) {
+        close(fd);
+        throw runtime_error("RevocationSnapshot: снимок " + path + " поврежден.");
+    }
+
+    void* mapped = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        throw runtime_error("RevocationSnapshot: не удалось отобразить снимок " + path + " в память.");
+    }
+
+    mapping = static_cast<const uint8_t*>(mapped);
+    mappingSize = info.st_size;
+
+    const RevocationSnapshotHeader* header = __header();
+    uint64_t expectedSize = header->entriesOffset + header->entryCount * REVOCATION_SNAPSHOT_ENTRY_SIZE;
+    if (memcmp(header->magic, REVOCATION_SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 ||
+        header->formatVersion != REVOCATION_SNAPSHOT_FORMAT || header->entrySize != REVOCATION_SNAPSHOT_ENTRY_SIZE ||
+        header->bloomWords == 0 || (header->bloomWords & (header->bloomWords - 1)) != 0 ||
+        header->entriesOffset != sizeof(RevocationSnapshotHeader) + header->bloomWords * 8 || expectedSize != mappingSize) {
+        __unmap();
+        throw runtime_error("RevocationSnapshot: неверный формат снимка " + path + ".");
+    }
+}
+
+
+inline void RevocationSnapshot::__unmap() {
+    if (mapping) {
+        munmap(const_cast<uint8_t*>(mapping), mappingSize);
+        mapping = nullptr;
+        mappingSize = 0;
+    }
+}
+
+
+// Переоткрывает файл, если опубликован новый снимок; старое отображение сохраняется при ошибке
+inline bool RevocationSnapshot::reloadIfSuperseded() {
+    if (__atomic_load_n(&__header()->superseded, __ATOMIC_ACQUIRE) == 0) {
+        return false;
+    }
+
+    const uint8_t* previous = mapping;
+    size_t previousSize = mappingSize;
+    mapping = nullptr;
+
+    try {
+        __map();
+    } catch (const std::runtime_error&) {
+        mapping = previous;
+        mappingSize = previousSize;
+        return false;
+    }
+
+    munmap(const_cast<uint8_t*>(previous), previousSize);
+    return true;
+}
+
+
+inline RevocationStatus RevocationSnapshot::lookup(const RevocationIndex::SerialKey& serial) {
+    reloadIfSuperseded();
+
+    RevocationStatus status;
+    status.issued = false;
+    const RevocationSnapshotHeader* header = __header();
+    const uint64_t* bloom = reinterpret_cast<const uint64_t*>(mapping + sizeof(RevocationSnapshotHeader));
+    const uint64_t bloomMask = header->bloomWords * 64 - 1;
+
+    uint64_t h1, h2;
+    RevocationIndex::hashSerial(serial, h1, h2);
+    for (uint32_t i = 0; i < header->bloomHashes; ++i) {
+        uint64_t bit = (h1 + i * h2) & bloomMask;
+        if (((bloom[bit >> 6] >> (bit & 63)) & 1) == 0) {
+            return status;
+        }
+    }
+
+    const uint8_t* entries = mapping + header->entriesOffset;
+    size_t low = 0, high = header->entryCount;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        const uint8_t* entry = entries + middle * REVOCATION_SNAPSHOT_ENTRY_SIZE;
+        int order = memcmp(entry, serial.data(), serial.size());
+
+        if (order == 0) {
+            int32_t reasonCode;
+            int64_t revokedAt;
+            memcpy(&reasonCode, entry + 20, sizeof(reasonCode));
+            memcpy(&revokedAt, entry + 24, sizeof(revokedAt));
+
+            status.issued = true;
+            if (reasonCode != REVOCATION_SNAPSHOT_NOT_REVOKED) {
+                status.revoked = true;
+                status.reasonCode = reasonCode;
+                status.revokedAt = static_cast<time_t>(revokedAt);
+            }
+            return status;
+        }
+
+        if (order < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    return status;
+}
+
+
+inline RevocationStatus RevocationSnapshot::lookup(const string& decimalSerial) {
+    RevocationIndex::SerialKey key;
+    if (!RevocationIndex::toSerialKey(decimalSerial, key)) {
+        RevocationStatus status;
+        status.issued = false;
+        return status;
+    }
+    return lookup(key);
+}
+
+
+inline uint64_t RevocationSnapshot::publish(Database& db, const string& path) {
+    vector<RevokedCertRecord> revoked = db.selectRevokedCerts();
+    vector<string> issued = db.selectIssuedSerials();
+
+    for (const auto& config : ShardRouter::loadConfig()) {
+        if (filesystem::path(config.dbPath).lexically_normal() == filesystem::path(DB_PATH).lexically_normal() ||
+            !filesystem::exists(config.dbPath)) {
+            continue;
+        }
+        Database shardDb(config.dbPath, config.dbPassword);
+        vector<RevokedCertRecord> shardRevoked = shardDb.selectRevokedCerts();
+        vector<string> shardIssued = shardDb.selectIssuedSerials();
+        revoked.insert(revoked.end(), shardRevoked.begin(), shardRevoked.end());
+        issued.insert(issued.end(), shardIssued.begin(), shardIssued.end());
+    }
+
+    return publish(revoked, issued, path);
+}
+
+
+inline uint64_t RevocationSnapshot::publish(const vector<RevokedCertRecord>& revoked, const vector<string>& issued, const string& path) {
+    struct Row {
+        RevocationIndex::SerialKey serial;
+        int32_t reasonCode;
+        int64_t revokedAt;
+    };
+
+    // Отозванные записи идут первыми и при повторе номера остаются после unique
+    vector<Row> rows;
+    rows.reserve(revoked.size() + issued.size());
+    for (const auto& record : revoked) {
+        Row row{};
+        if (RevocationIndex::toSerialKey(record.serial, row.serial)) {
+            row.reasonCode = record.reasonCode;
+            row.revokedAt = record.revokedAt;
+            rows.push_back(row);
+        }
+    }
+    for (const auto& serial : issued) {
+        Row row{};
+        if (RevocationIndex::toSerialKey(serial, row.serial)) {
+            row.reasonCode = REVOCATION_SNAPSHOT_NOT_REVOKED;
+            rows.push_back(row);
+        }
+    }
+    stable_sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) { return a.serial < b.serial; });
+    rows.erase(unique(rows.begin(), rows.end(), [](const Row& a, const Row& b) { return a.serial == b.serial; }), rows.end());
+
+    size_t bloomBits = RevocationIndex::bloomBitsFor(rows.size());
+    vector<uint64_t> bloom(bloomBits / 64, 0);
+    for (const auto& row : rows) {
+        uint64_t h1, h2;
+        RevocationIndex::hashSerial(row.serial, h1, h2);
+        for (int i = 0; i < RevocationIndex::BLOOM_HASHES; ++i) {
+            uint64_t bit = (h1 + i * h2) & (bloomBits - 1);
+            bloom[bit >> 6] |= 1ULL << (bit & 63);
+        }
+    }
+
+    // Публикации из разных процессов сериализуются блокировкой на отдельном файле
+    string lockPath = path + ".lock";
+    int lockFd = open(lockPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (lockFd < 0 || flock(lockFd, LOCK_EX) != 0) {
+        if (lockFd >= 0) {
+            close(lockFd);
+        }
+        throw runtime_error("RevocationSnapshot: не удалось заблокировать " + lockPath + ".");
+    }
+
+    // Открытый дескриптор старого снимка нужен, чтобы пометить его замененным после переименования
+    int previousFd = open(path.c_str(), O_RDWR | O_CLOEXEC);
+    RevocationSnapshotHeader previous{};
+    bool hasPrevious = previousFd >= 0 && pread(previousFd, &previous, sizeof(previous), 0) == sizeof(previous) &&
+                       memcmp(previous.magic, REVOCATION_SNAPSHOT_MAGIC, sizeof(previous.magic)) == 0;
+
+    RevocationSnapshotHeader header{};
+    memcpy(header.magic, REVOCATION_SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.formatVersion = REVOCATION_SNAPSHOT_FORMAT;
+    header.generation = hasPrevious ? previous.generation + 1 : 1;
+    header.createdAt = time(nullptr);
+    header.entryCount = rows.size();
+    header.bloomWords = bloom.size();
+    header.bloomHashes = RevocationIndex::BLOOM_HASHES;
+    header.entrySize = REVOCATION_SNAPSHOT_ENTRY_SIZE;
+    header.entriesOffset = sizeof(header) + bloom.size() * sizeof(uint64_t);
+
+    vector<uint8_t> content(header.entriesOffset + rows.size() * REVOCATION_SNAPSHOT_ENTRY_SIZE, 0);
+    memcpy(content.data(), &header, sizeof(header));
+    memcpy(content.data() + sizeof(header), bloom.data(), bloom.size() * sizeof(uint64_t));
+    for (size_t i = 0; i < rows.size(); ++i) {
+        uint8_t* entry = content.data() + header.entriesOffset + i * REVOCATION_SNAPSHOT_ENTRY_SIZE;
+        memcpy(entry, rows[i].serial.data(), rows[i].serial.size());
+        memcpy(entry + 20, &rows[i].reasonCode, sizeof(int32_t));
+        memcpy(entry + 24, &rows[i].revokedAt, sizeof(int64_t));
+    }
+
+    string tempPath = path + ".tmp." + to_string(getpid());
+    int fd = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    bool written = fd >= 0;
+    for (size_t offset = 0; written && offset < content.size();) {
+        ssize_t chunk = write(fd, content.data() + offset, content.size() - offset);
+        written = chunk > 0;
+        offset += written ? chunk : 0;
+    }
+    written = written && fsync(fd) == 0;
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    if (!written || rename(tempPath.c_str(), path.c_str()) != 0) {
+        unlink(tempPath.c_str());
+        if (previousFd >= 0) {
+            close(previousFd);
+        }
+        close(lockFd);
+        throw runtime_error("RevocationSnapshot: не удалось записать снимок " + path + ".");
+    }
+
+    if (hasPrevious) {
+        uint32_t superseded = 1;
+        pwrite(previousFd, &superseded, sizeof(superseded), offsetof(RevocationSnapshotHeader, superseded));
+    }
+    if (previousFd >= 0) {
+        close(previousFd);
+    }
+    close(lockFd);
+
+    return header.generation;
+}
@@ -16,7 +16,7 @@ struct UserInfo {
 };
 
 // Функция для парсинга данных из файла
-UserInfo parseUserInfo(const std::string& filePath) {
+inline UserInfo parseUserInfo(const std::string& filePath) {
     std::ifstream file(filePath);
     if (!file.is_open()) {
         throw std::runtime_error("Не удалось открыть файл для чтения: " + filePath);
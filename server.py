@@ -1,15 +1,30 @@
-from fastapi import FastAPI, HTTPException
+from fastapi import Depends, FastAPI, HTTPException
+from fastapi.security import HTTPBasic, HTTPBasicCredentials
 from pydantic import BaseModel
 from dotenv import load_dotenv
 import os
 import json
 import subprocess
 import pty
+import mmap
+import struct
+import sys
+import threading
+from typing import List
 
 
 SUPERADMIN_CPP_PATH = "./PKI_CPP/build/superadmin"
 REGISTRATOR_CPP_PATH = "./PKI_CPP/build/registrar"
 ADMIN_CPP_PATH = "./PKI_CPP/build/admin"
+REVOCATION_SNAPSHOT_PATH = "./PKI_CPP/db/revocation.snapshot"
+PKI_MODULE_PATH = "./PKI_CPP/build"
+
+# Модуль pki (PKI_CPP/lib/pkimodule.cpp) собирается вместе с C++ частью, если найдены заголовки Python
+sys.path.insert(0, PKI_MODULE_PATH)
+try:
+    import pki
+except ImportError:
+    pki = None
 
 load_dotenv()
 
@@ -23,6 +38,84 @@ class CreateRequest(BaseModel):
     registrar: str
     request_data: str
 
+class IssueRequest(BaseModel):
+    username: str
+    password: str
+    csr_pem: str
+    cert_name: str
+
+class RevokeRequest(BaseModel):
+    username: str
+    password: str
+    serials: List[str]
+    reason: int = 0
+
+class RevocationSnapshot:
+    """Снимок статусов, публикуемый C++ частью (PKI_CPP/utils/RevocationSnapshot.hpp), читается через mmap"""
+
+    HEADER = struct.Struct("<8sIIQqQQIIQ")
+    SUPERSEDED_OFFSET = 12
+    FORMAT_VERSION = 2
+    NOT_REVOKED = -1
+
+    def __init__(self, path):
+        self.path = path
+        self._map()
+
+    def _map(self):
+        with open(self.path, "rb") as snapshot_file:
+            self.mapping = mmap.mmap(snapshot_file.fileno(), 0, access=mmap.ACCESS_READ)
+        (magic, format_version, _, self.generation, _, self.count,
+         _, _, self.entry_size, self.entries_offset) = self.HEADER.unpack_from(self.mapping, 0)
+        if magic != b"PKIRVSN1" or format_version != self.FORMAT_VERSION:
+            self.mapping.close()
+            raise ValueError("Неверный формат снимка отзыва")
+
+    def lookup(self, serial):
+        # при публикации нового снимка в старом файле выставляется флаг superseded
+        if struct.unpack_from("<I", self.mapping, self.SUPERSEDED_OFFSET)[0]:
+            self.mapping.close()
+            self._map()
+
+        key = serial.to_bytes(20, "big")
+        low, high = 0, self.count
+        while low < high:
+            middle = (low + high) // 2
+            offset = self.entries_offset + middle * self.entry_size
+            current = self.mapping[offset:offset + 20]
+            if current == key:
+                reason, revoked_at = struct.unpack_from("<iq", self.mapping, offset + 20)
+                if reason == self.NOT_REVOKED:
+                    return {"status": "good"}
+                return {"status": "revoked", "reason": reason, "revoked_at": revoked_at}
+            if current < key:
+                low = middle + 1
+            else:
+                high = middle
+        # в снимке есть все выданные номера: отсутствующий номер этим УЦ не выдавался
+        return {"status": "unknown"}
+
+
+revocation_snapshot = None
+
+authority_opened = False
+authority_lock = threading.Lock()
+
+def authority():
+    """Ядро УЦ в процессе сервера; открывается при первом обращении"""
+    global authority_opened
+
+    if pki is None:
+        raise HTTPException(status_code=503, detail="Модуль pki не собран")
+    with authority_lock:
+        if not authority_opened:
+            try:
+                pki.open(db_password=os.getenv('PKI_DB_PASSWORD', '1234'))
+            except pki.Error as error:
+                raise HTTPException(status_code=503, detail=str(error))
+            authority_opened = True
+    return pki
+
 # Состояние системы
 system_initialized = False
 users_connected = {
@@ -38,6 +131,13 @@ admin_password = os.getenv('ADMIN_PASSWORD')
 registrator_login = os.getenv('REGISTRATOR_LOGIN')
 registrator_password = os.getenv('REGISTRATOR_PASSWORD')
 
+basic_auth = HTTPBasic()
+
+def require_admin(credentials: HTTPBasicCredentials = Depends(basic_auth)):
+    """GET-запросы к реестру и очередям: учетные данные администратора в заголовке Authorization (Basic)"""
+    if credentials.username != admin_login or credentials.password != admin_password:
+        raise HTTPException(status_code=401, detail="Unauthorized", headers={"WWW-Authenticate": "Basic"})
+
 @app.post("/init")
 def init_system(request: ConnectRequest):
     global system_initialized
@@ -95,6 +195,84 @@ def authorize_registrator(request: ConnectRequest):
         "cpp_program": ADMIN_CPP_PATH,
     }
 
+@app.get("/status/{serial}")
+def certificate_status(serial: str):
+    global revocation_snapshot
+
+    if not serial.isdigit():
+        raise HTTPException(status_code=400, detail="Серийный номер должен быть десятичным числом")
+
+    if revocation_snapshot is None:
+        try:
+            revocation_snapshot = RevocationSnapshot(REVOCATION_SNAPSHOT_PATH)
+        except (OSError, ValueError):
+            raise HTTPException(status_code=503, detail="Снимок отзыва еще не опубликован")
+
+    try:
+        result = revocation_snapshot.lookup(int(serial))
+    except OverflowError:
+        raise HTTPException(status_code=400, detail="Серийный номер длиннее 20 байт")
+
+    return {"serial": serial, "generation": revocation_snapshot.generation, **result}
+
+# Выпуск, отзыв и запросы выполняются ядром в процессе сервера, без запуска C++ программ.
+# Обработчики объявлены синхронными: FastAPI выполняет их в пуле потоков, а модуль отпускает GIL на время подписи.
+@app.post("/certificates")
+def issue_certificate(request: IssueRequest):
+    if request.username != admin_login or request.password != admin_password:
+        raise HTTPException(status_code=401, detail="Unauthorized")
+
+    core = authority()
+    try:
+        return core.issue(request.csr_pem, request.cert_name)
+    except pki.Overloaded as error:
+        # очередь выпуска переполнена: клиенту стоит повторить позже, отзыв при этом не задерживается
+        raise HTTPException(status_code=503, detail=str(error), headers={"Retry-After": "1"})
+    except pki.Error as error:
+        raise HTTPException(status_code=400, detail=str(error))
+
+@app.post("/revoke")
+def revoke_certificates(request: RevokeRequest):
+    if request.username != admin_login or request.password != admin_password:
+        raise HTTPException(status_code=401, detail="Unauthorized")
+    if not all(serial.isdigit() for serial in request.serials):
+        raise HTTPException(status_code=400, detail="Серийный номер должен быть десятичным числом")
+
+    core = authority()
+    try:
+        return {"added": core.revoke(request.serials, request.reason)}
+    except pki.Error as error:
+        raise HTTPException(status_code=400, detail=str(error))
+
+@app.get("/certificates", dependencies=[Depends(require_admin)])
+def search_certificates(organization: str = "", cn_prefix: str = "", text: str = "", limit: int = 100):
+    core = authority()
+    try:
+        return core.search(organization=organization, cn_prefix=cn_prefix, text=text, limit=limit)
+    except pki.Error as error:
+        raise HTTPException(status_code=400, detail=str(error))
+
+@app.get("/certificates/{serial}", dependencies=[Depends(require_admin)])
+def certificate_record(serial: str):
+    return authority().status(serial)
+
+@app.post("/crl/publish")
+def publish_crl(request: ConnectRequest):
+    if request.username != admin_login or request.password != admin_password:
+        raise HTTPException(status_code=401, detail="Unauthorized")
+
+    core = authority()
+    try:
+        core.publish_crl()
+    except pki.Error as error:
+        raise HTTPException(status_code=500, detail=str(error))
+    return {"message": "CRL переподписан"}
+
+# Глубина очередей и время ожидания по классам запросов: revocation, crl, issuance
+@app.get("/queue", dependencies=[Depends(require_admin)])
+def queue_stats():
+    return authority().queue_stats()
+
 if __name__ == '__main__':
     import uvicorn
     uvicorn.run(app, host="0.0.0.0", port=5050)
\ No newline at end of file